@@ -5,6 +5,7 @@ const ffi = require('ffi-napi');
 
 let parserLib = ffi.Library('./libgpxparser', {
   'getGPXDataIfValid': [ 'string', ['string', 'string'] ],
+  'getDirSummaries': ['string', ['string', 'string']],
   'getRoutesAndTracksFromFile': ['string', ['string', 'string']],
   'getOtherData': ['string', ['string', 'string', 'int', 'int']],
   'renameRoute': ['int', ['string', 'string', 'int', 'int', 'string']],
@@ -13,11 +14,30 @@ let parserLib = ffi.Library('./libgpxparser', {
   'addWaypointToRouteInFile': ['int', ['string', 'string']],
   'getRoutesBetweenJSON': ['string', ['string', 'float', 'float', 'float', 'float', 'float']],
   'getTracksBetweenJSON': ['string', ['string', 'float', 'float', 'float', 'float', 'float']],
+  'loadCorpus': ['int', ['string', 'string']],
+  'getPathsBetweenInCorpus': ['string', ['float', 'float', 'float', 'float', 'float', 'string']],
+  'countPathsWithLengthInCorpus': ['string', ['float', 'float', 'string']],
   'getPathsWithLength': ['string', ['string', 'float']],
   'waypointListToJSON': ['string', ['string', 'int']],
-  'lastRouteToJSON': ['string', ['string']]
+  'lastRouteToJSON': ['string', ['string']],
+  'initSchemaCache': ['int', ['string']],
+  'gpxOpen': ['int', ['string', 'string']],
+  'gpxClose': ['int', ['int']],
+  'gpxSave': ['int', ['int']],
+  'gpxGetGPXData': ['string', ['int']],
+  'gpxAddRoute': ['int', ['int', 'string']],
+  'gpxAddWaypointToLastRoute': ['int', ['int', 'string']],
+  'gpxGetRoutesWithWaypoints': ['string', ['int']],
+  'getParserStatsJSON': ['string', []],
+  'getParserStatsPrometheus': ['string', []],
+  'setParserTracing': ['void', ['bool']],
+  'getParserTraceJSON': ['string', []],
+  'clearParserTrace': ['void', []]
 });
 
+// Compile the GPX schema once up front, every parser call after this reuses it
+parserLib.initSchemaCache('gpx.xsd');
+
 // Express App (Routes)
 const express = require("express");
 const app     = express();
@@ -88,29 +108,20 @@ app.get('/uploads/:name', function(req , res){
 
 // Endpoint for getting file information on page load
 app.get('/getFiles', function(req , res){
-  fs.readdir(__dirname+'/uploads', function(err, files) {
+  // Every file is parsed and validated on the parser's own worker threads, and the call runs off the event loop
+  parserLib.getDirSummaries.async('uploads', 'gpx.xsd', function(err, stringReturned) {
     if (err) {
       console.log(err);
-    } else {
-      let ret_arr = [];
-      // Verify each file with createvalidgpxdoc and validategpxdoc before uploading
-      files.forEach(file => {
-        if (path.extname(file) == ".gpx") {
-          let stringReturned = parserLib.getGPXDataIfValid('uploads/'+file, 'gpx.xsd');
-          if (stringReturned == '{}') {
-            // If invalid dont upload and just return
-            return;
-          }
-          let gpxInfo = JSON.parse(stringReturned);
-          gpxInfo["filename"] = file;
-          console.log(gpxInfo);
-          console.log(file+' was found');
-          ret_arr.push(gpxInfo);
-        }
-      });
-      // Otherwise send information about the uploaded file
-      res.send(ret_arr);
+      res.send([]);
+      return;
     }
+    // Invalid files are already left out
+    let ret_arr = JSON.parse(stringReturned);
+    ret_arr.forEach(gpxInfo => {
+      console.log(gpxInfo);
+      console.log(gpxInfo.filename+' was found');
+    });
+    res.send(ret_arr);
   });
 });
 
@@ -171,7 +182,10 @@ app.get('/addRoute', function(req, res) {
   let routeJSON = req.query.routeJSON;
   let waypointsJSONArray = req.query.waypoints;
 
-  if (parserLib.addRouteToFile('uploads/'+chosenFile, routeJSON) === 0) {
+  // Keep the file resident while the route and all its waypoints are added, then write it once
+  let handle = parserLib.gpxOpen('uploads/'+chosenFile, 'gpx.xsd');
+  if (handle === 0 || parserLib.gpxAddRoute(handle, routeJSON) === 0) {
+    parserLib.gpxClose(handle);
     res.send('New route was not added.');
     console.log('New route was not added');
     return;
@@ -181,20 +195,35 @@ app.get('/addRoute', function(req, res) {
     waypointsJSONArray = [];
   }
 
-  if (waypointsJSONArray.length > 0) {
-    waypointsJSONArray.forEach(waypoint => {
-      console.log(waypoint);
-      if (parserLib.addWaypointToRouteInFile('uploads/'+chosenFile, waypoint) === 0) {
-        res.send('One or more waypoints could not be added.');
-        return;
-      };
-    });
-  }
+  let allWaypointsAdded = true;
+  waypointsJSONArray.forEach(waypoint => {
+    console.log(waypoint);
+    if (parserLib.gpxAddWaypointToLastRoute(handle, waypoint) === 0) {
+      allWaypointsAdded = false;
+    };
+  });
 
-  res.send('Route added successfully.');
+  let saved = parserLib.gpxSave(handle);
+  parserLib.gpxClose(handle);
+
+  if (saved === 0) {
+    res.send('New route was not added.');
+  } else if (!allWaypointsAdded) {
+    res.send('One or more waypoints could not be added.');
+  } else {
+    res.send('Route added successfully.');
+  }
 
 });
 
+// The file names a request asked for, one per line as the corpus takes them. Without any, every file is searched
+function corpusFileNames(filenames) {
+  if (filenames === undefined) {
+    return null;
+  }
+  return [].concat(filenames).join('\n');
+}
+
 // Endpoint for finding all paths between two points
 app.get('/findPaths', function(req, res) {
   let filenames = req.query.filenames;
@@ -204,23 +233,15 @@ app.get('/findPaths', function(req, res) {
   let lon2 = req.query.lon2;
   let delta = req.query.delta;
 
-  let retObject = {};
-  let routesArray = [];
-  let tracksArray = [];
-
-  // For each file get the matching routes and matching tracks
-  filenames.forEach(filename => {
-    let returnedJSONRoutes = parserLib.getRoutesBetweenJSON('uploads/'+filename, lat1, lon1, lat2, lon2, delta);
-    routesArray = routesArray.concat(JSON.parse(returnedJSONRoutes));
-    console.log(routesArray);
-    let returnedJSONTracks = parserLib.getTracksBetweenJSON('uploads/'+filename, lat1, lon1, lat2, lon2, delta);
-    tracksArray = tracksArray.concat(JSON.parse(returnedJSONTracks));
-    console.log(tracksArray);
-  });
+  // Bring the index over the uploads up to date, only new or changed files get parsed
+  if (parserLib.loadCorpus('uploads', 'gpx.xsd') < 0) {
+    res.send({routes: [], tracks: []});
+    return;
+  }
 
-  // Add them to the return object
-  retObject["routes"] = routesArray;
-  retObject["tracks"] = tracksArray;
+  // One lookup for the matching routes and tracks of the requested files
+  let fileNames = corpusFileNames(filenames);
+  let retObject = JSON.parse(parserLib.getPathsBetweenInCorpus(lat1, lon1, lat2, lon2, delta, fileNames));
   res.send(retObject);
 
 });
@@ -234,19 +255,42 @@ app.get('/findPathsWithLength', function(req, res) {
   returnNums["totalForRoutes"] = 0;
   returnNums["totalForTracks"] = 0;
 
-  // For each file count the number of matched paths and add it to the total
-  filenames.forEach(filename => {
-    let returnedJSON = parserLib.getPathsWithLength('uploads/'+filename, length);
-    let tmpObject = JSON.parse(returnedJSON);
-    returnNums["totalForRoutes"] += tmpObject["rt"];
-    returnNums["totalForTracks"] += tmpObject["tr"];
-  });
+  // The corpus counts the requested files at once
+  if (parserLib.loadCorpus('uploads', 'gpx.xsd') >= 0) {
+    let tmpObject = JSON.parse(parserLib.countPathsWithLengthInCorpus(length, 10, corpusFileNames(filenames)));
+    returnNums["totalForRoutes"] = tmpObject["rt"];
+    returnNums["totalForTracks"] = tmpObject["tr"];
+  }
 
   returnNums["total"] = returnNums["totalForRoutes"] + returnNums["totalForTracks"];
   res.send(returnNums);
 
 });
 
+// Endpoint for the parser's call counts, times and bytes per stage, to see where a slow endpoint spends its time
+app.get('/parserStats', function(req, res) {
+  res.send(JSON.parse(parserLib.getParserStatsJSON()));
+});
+
+// Same statistics for a Prometheus scraper
+app.get('/metrics', function(req, res) {
+  res.set('Content-Type', 'text/plain; version=0.0.4');
+  res.send(parserLib.getParserStatsPrometheus());
+});
+
+// Endpoint for the parser's trace, to load into chrome://tracing or Perfetto. ?enable=1 or ?enable=0 turns tracing
+// on or off first, and ?clear=1 drops the spans recorded so far after they are sent
+app.get('/parserTrace', function(req, res) {
+  if (req.query.enable !== undefined) {
+    parserLib.setParserTracing(req.query.enable === '1');
+  }
+  res.set('Content-Type', 'application/json');
+  res.send(parserLib.getParserTraceJSON());
+  if (req.query.clear === '1') {
+    parserLib.clearParserTrace();
+  }
+});
+
 // Endpoint for logging in to database and creating tables if they do not exist
 app.get('/loginToDatabase', async function(req, res) {
   let dbUsername = req.query.username;
@@ -351,9 +395,11 @@ app.get('/storeFiles', async function(req, res) {
         res.send('Failed to get count from FILE table');
       }
       
-      // Get the file data to place in the database fields
-      let stringReturned = parserLib.getGPXDataIfValid('uploads/'+file, 'gpx.xsd');
+      // Get the file data to place in the database fields, the file stays resident for the rest of this iteration
+      let handle = parserLib.gpxOpen('uploads/'+file, 'gpx.xsd');
+      let stringReturned = parserLib.gpxGetGPXData(handle);
       if (stringReturned == '{}') {
+        parserLib.gpxClose(handle);
         return;
       }
       let gpxInfo = JSON.parse(stringReturned);
@@ -379,12 +425,9 @@ app.get('/storeFiles', async function(req, res) {
           res.send('Failed to check if file exists in FILE table');
         }
         
-        // Get the route information from the file
-        let fileDataArrayString = parserLib.getRoutesAndTracksFromFile('uploads/'+file, 'gpx.xsd');
-        let fileDataArray = JSON.parse(fileDataArrayString);
-        let routesArray = fileDataArray["routes"];
+        // Get every route of the file together with its points in one call
+        let routesArray = JSON.parse(parserLib.gpxGetRoutesWithWaypoints(handle));
 
-        let i = 0;
         for (let route of routesArray) {
           try {
             // If the route has no name, default value is NULL
@@ -416,12 +459,8 @@ app.get('/storeFiles', async function(req, res) {
                 res.send('Failed to find route from ROUTE table');
               }
 
-              // Get all the route points from the route in the file, with the given index
-              let waypointArrayString = parserLib.waypointListToJSON('uploads/'+file, i);
-              let waypointArray = JSON.parse(waypointArrayString);
-
               let j = 0;
-              for (let point of waypointArray) {
+              for (let point of route["waypoints"]) {
 
                 try {
                   // If point has no name, default value is NULL
@@ -455,8 +494,6 @@ app.get('/storeFiles', async function(req, res) {
             res.send('Failed to insert route into ROUTE table');
           }
 
-          i++;
-
         }
 
       } catch (e) {
@@ -464,6 +501,8 @@ app.get('/storeFiles', async function(req, res) {
         res.send('Failed to insert file into FILE table');
       }
 
+      parserLib.gpxClose(handle);
+
     };
 
     res.send('Added successfully!');
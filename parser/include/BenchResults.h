@@ -0,0 +1,69 @@
+#ifndef BENCHRESULTS_H
+#define BENCHRESULTS_H
+
+#include <stdbool.h>
+
+/** Results of a benchmark run, their JSON format and the comparison of two runs, for bin/benchmark.
+ *
+ *  The JSON is an object with the format version and a "results" array, one result per line:
+ *      {"size": 1000, "operation": "createGPXdoc", "points": 1000, "bytes": 103921, "mean": 0.00079,
+ *       "stddev": 0.00001, "median": 0.00079, "samples": [0.00078, 0.00079, ...]}
+ *  Times are in seconds. An operation that failed has no samples. The reader only understands files laid out the
+ *  way writeBenchResults lays them out, one result per line. */
+
+#define MAX_BENCH_REPEATS 100
+#define MAX_BENCH_RESULTS 256
+#define MAX_BENCH_THRESHOLDS 32
+#define MAX_OPERATION_NAME 64
+
+typedef struct {
+    // Points in the generated file, and the operation that was timed on it
+    long size;
+    char operation[MAX_OPERATION_NAME];
+
+    // Work done by one run, for the throughput. bytes is 0 if megabytes per second mean nothing for the operation
+    long points;
+    long bytes;
+
+    // Seconds each run took, in ascending order. 0 samples if the operation failed
+    int numSamples;
+    double samples[MAX_BENCH_REPEATS];
+} BenchResult;
+
+typedef struct {
+    int length;
+    BenchResult results[MAX_BENCH_RESULTS];
+} BenchResults;
+
+// How much slower than the baseline an operation may get, in percent, before it counts as a regression
+typedef struct {
+    double defaultPercent;
+
+    // Thresholds for single operations, by name, that replace the default
+    int length;
+    char operations[MAX_BENCH_THRESHOLDS][MAX_OPERATION_NAME];
+    double percents[MAX_BENCH_THRESHOLDS];
+} BenchThresholds;
+
+// Functions to summarize the samples of a result
+double getBenchMean(const BenchResult *result);
+
+double getBenchStdDev(const BenchResult *result);
+
+double getBenchMedian(const BenchResult *result);
+
+// Function to find the result of an operation at a size. NULL if there is none
+const BenchResult *findBenchResult(const BenchResults *results, long size, const char *operation);
+
+// Function to write results as JSON. Returns false if the file can not be written
+bool writeBenchResults(const char *fileName, const BenchResults *results);
+
+// Function to read results written by writeBenchResults. Returns NULL if the file can not be read, or has no results
+BenchResults *readBenchResults(const char *fileName);
+
+// Function to print the change of every result of current from its baseline, with a 95% confidence interval.
+// An operation regresses if it got slower by more than its threshold even at the low end of the interval, if it
+// failed, or if the baseline has it at a size current ran but current does not. Returns the number of regressions
+int compareBenchResults(const BenchResults *baseline, const BenchResults *current, const BenchThresholds *thresholds);
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef GPXARENA_H
+#define GPXARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/** Per-document bump allocator.
+ *  A loaded GPXdoc is made of many small allocations (every Waypoint, name, GPXData, List and list Node). Documents
+ *  built by the loaders and JSONtoGPX take all of that memory from one arena instead, in large blocks, so building
+ *  a document is mostly pointer bumps and deleting it frees a handful of blocks instead of every object.
+ *  Objects allocated with malloc that are later added to an arena document (e.g. a Route from JSONtoRoute passed to
+ *  addRoute) are adopted: the arena remembers them and calls their delete function when it is destroyed. */
+typedef struct GPXArena GPXArena;
+
+// The arena's record of an adopted object
+typedef struct ArenaCleanup ArenaCleanup;
+
+// Function to create an empty arena. Returns NULL if malloc fails
+GPXArena *createArena(void);
+
+// Function to run the delete function of every adopted object and then free all the arena's memory
+void destroyArena(GPXArena *arena);
+
+// Function to get size bytes from the arena, suitably aligned for any type. Returns NULL if malloc fails
+void *arenaAlloc(GPXArena *arena, size_t size);
+
+// Function with the allocator signature of initializeListWithAllocator, so arena lists can allocate their nodes
+void *arenaAllocNode(void *context, size_t size);
+
+// Function to copy a string into the arena
+char *arenaCopyString(GPXArena *arena, const char *str);
+
+// Function to check if ptr points into memory that belongs to the arena
+bool arenaOwns(const GPXArena *arena, const void *ptr);
+
+/** Function to make the arena responsible for a heap object. Does nothing if the object is already arena memory
+ *@return the record to pass to arenaReleaseCleanup, NULL if nothing was adopted
+ *@param arena - arena of the document the object is added to, may be NULL
+ *@param data - the object
+ *@param deleteFunction - function the arena frees the object with
+**/
+ArenaCleanup *arenaAdopt(GPXArena *arena, void *data, void (*deleteFunction)(void *data));
+
+// Function to hand an adopted object back to the caller, so the arena no longer deletes it. Searches the adopted
+// objects, so objects that are released often (e.g. caches) should keep their record and use arenaReleaseCleanup
+void arenaRelease(GPXArena *arena, void *data);
+
+// Function to hand an adopted object back in O(1) by the record arenaAdopt returned. The record is reused by a
+// later adopt, so it must not be used again. Does nothing if cleanup is NULL
+void arenaReleaseCleanup(GPXArena *arena, ArenaCleanup *cleanup);
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef GPXCORPUS_H
+#define GPXCORPUS_H
+
+#include "GPXParser.h"
+
+/** Endpoint index over every valid GPX file in a directory.
+ *  Finding the paths between two points across many files used to mean parsing and validating every file for
+ *  every query. The corpus keeps, for each file, the JSON of its routes and tracks, their end points and lengths, and
+ *  merges the end points and the lengths of all files into one index each (see GPXIndex.h and GPXLengthIndex.h), so a
+ *  query is a single lookup.
+ *  Files are identified by name, modification time and size: loading the same directory again only parses the
+ *  files that were added or changed since the last load, and drops the ones that are gone.
+ *  The corpus is shared by the whole process. Queries can run in parallel with each other; a load or free waits
+ *  for the queries in progress and blocks new ones until it is done. */
+
+/** Function to index every valid .gpx file in a directory, replacing any corpus built from another directory or
+ *  schema. Unchanged files are not parsed again, so it is cheap to call before every query
+ *@return the number of valid files in the corpus, or -1 if the directory could not be read
+ *@param dirName - the name of the directory
+ *@param schemaFile - the name of a schema file, only files valid against it are indexed
+**/
+int loadCorpus (char *dirName, char *schemaFile);
+
+/** Function to find the paths between two points in the files of the corpus
+ *@return a JSON object {"routes":[...],"tracks":[...]} with the same objects getRoutesBetweenJSON and
+ *        getTracksBetweenJSON return, files in name order and paths in file order
+ *@param lat1, lon1 - the source point
+ *@param lat2, lon2 - the destination point
+ *@param delta - how far in metres the ends of a path may be from the points
+ *@param fileNames - the names of the files to search, one per line, or NULL to search every file. Names that are
+ *                   not in the corpus are skipped
+**/
+char *getPathsBetweenInCorpus (float lat1, float lon1, float lat2, float lon2, float delta, char *fileNames);
+
+/** Function to count the paths in the files of the corpus within delta of a length
+ *@return a JSON object {"rt":...,"tr":...}, the sums of what getPathsWithLength returns for each file when delta is 10
+ *@param len - the length in metres
+ *@param delta - how far in metres a path's length may be from len
+ *@param fileNames - the files to count, as for getPathsBetweenInCorpus
+**/
+char *countPathsWithLengthInCorpus (float len, float delta, char *fileNames);
+
+/** Function to find the paths counted by countPathsWithLengthInCorpus
+ *@return a JSON object {"routes":[...],"tracks":[...]} with the same objects as getPathsBetweenInCorpus, files in name
+ *        order and paths in file order
+ *@param len - the length in metres
+ *@param delta - how far in metres a path's length may be from len
+ *@param fileNames - the files to search, as for getPathsBetweenInCorpus
+**/
+char *getPathsWithLengthInCorpus (float len, float delta, char *fileNames);
+
+// Function to free the corpus
+void freeCorpus (void);
+
+// Function to get the names of the .gpx files in a directory, sorted. Returns the number of names, or -1 if the
+// directory can not be read. The caller frees each name and the array
+int listGPXFiles(const char *dirName, char ***names);
+
+#endif
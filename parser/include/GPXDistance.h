@@ -0,0 +1,53 @@
+#ifndef GPXDISTANCE_H
+#define GPXDISTANCE_H
+
+#include <stdbool.h>
+
+/** Batched haversine for path lengths.
+ *  haversineBatch computes the distance of every consecutive pair of points in a pair of lat/lon arrays, with the
+ *  cosines of the latitudes precomputed. On x86-64 it works on several pairs at a time with vector instructions, AVX2
+ *  if the CPU has it (checked once, when the library is loaded) and SSE2 otherwise, using polynomial sin and a
+ *  rational atan instead of the libm calls of haversine. Anywhere else it falls back to haversineWithCos for each
+ *  pair.
+ *
+ *  Error bound: for coordinates inside the GPX ranges (|lat| <= 90, |lon| <= 180) the vector sin/atan are
+ *  within a few ulp of libm, and the distances stay within 1e-12 relative (or 1e-6 m absolute, for distances
+ *  under a metre) of haversine. Lengths are accumulated in a float by the callers, so in practice they are the same.
+ *  Angles much larger than the GPX ranges lose accuracy in the range reduction, and stop being meaningful past
+ *  about 1e15 radians. */
+
+// Function to fill distances[i] with the haversine distance in metres between point i and point i + 1, for i from
+// 0 to length - 2. cosLatitudes[i] must be cos(latitudes[i] * (M_PI/180)). Does nothing if there are fewer than 2 points
+void haversineBatch(const double *latitudes, const double *longitudes, const double *cosLatitudes, int length,
+    double *distances);
+
+// Function to get the total distance along a path in metres, the same float sum getTotalWaypointsLen makes of the
+// distances haversineBatch computes. The arrays are as for haversineBatch
+float getPathLength(const double *latitudes, const double *longitudes, const double *cosLatitudes, int length);
+
+// The points of one path for getPathLengths, arrays as for haversineBatch
+typedef struct {
+    const double *latitudes;
+    const double *longitudes;
+    const double *cosLatitudes;
+    int length;
+} PathPoints;
+
+// Function to set lengths[i] to the getPathLength of paths[i], for count paths. Paths with many points in total are
+// cut into chunks that run on the task pool (see GPXTaskPool.h); the sums are still made in the order getPathLength
+// makes them, so the lengths are exactly the same
+void getPathLengths(const PathPoints *paths, int count, float *lengths);
+
+// Function to get the length of a track made of paths, each with at least one point: the length of each path and the
+// gap from its end to the start of the next one, added up in that order like getTotalTrackSegLen does
+float getJoinedPathLength(const PathPoints *paths, int count);
+
+// Function to get the name of the code path haversineBatch uses on this machine: "avx2", "sse2" or "scalar"
+const char *getDistanceKernelName(void);
+
+// Function to make haversineBatch use a code path by name, as getDistanceKernelName gives it, so tests can check each
+// one on the same machine. Returns false, leaving the path as it was, if this machine can not run it. Not safe while
+// other threads compute distances
+bool setDistanceKernel(const char *name);
+
+#endif
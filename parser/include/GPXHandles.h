@@ -0,0 +1,67 @@
+#ifndef GPXHANDLES_H
+#define GPXHANDLES_H
+
+#include "GPXParser.h"
+
+/** Resident document handles for the backend.
+ *  The file based wrappers in GPXParser.c parse and validate the file on every call. A handle keeps the
+ *  validated GPXdoc in memory instead, so any number of queries against one file cost a single parse.
+ *  Handles are small positive integers so they can be passed through ffi as plain ints; 0 is never a valid handle.
+ *  Edits made through a handle only change the resident GPXdoc until gpxSave writes it back to the file.
+ *  Different handles can be used from different threads at the same time. Calls on the same handle are
+ *  serialized, each one runs to the end before the next starts, and a call that was waiting on a handle that
+ *  gets closed behaves as if the handle was never open. */
+
+/** Function to parse and validate a GPX file and keep it resident
+ *@return a handle for the document, or 0 if the file could not be opened or is not valid
+ *@param gpxFile - the name of the GPX file
+ *@param schemaFile - the name of a schema file
+**/
+int gpxOpen (char *gpxFile, char *schemaFile);
+
+/** Function to release a handle and free its document
+ *@return 1 on success, 0 if the handle is not open
+ *@param handle - a handle returned by gpxOpen
+**/
+int gpxClose (int handle);
+
+/** Function to write a resident document back to the file it was opened from
+ *@return 1 on success, 0 on fail
+ *@param handle - a handle returned by gpxOpen
+**/
+int gpxSave (int handle);
+
+// Function to get the GPXdoc behind a handle, NULL if the handle is not open. The handle keeps ownership.
+// The doc is not locked: only use it while no other thread can call a function on or close the same handle
+GPXdoc *getHandleDoc (int handle);
+
+/* Handle versions of the backend wrappers. They return the same JSON as their file based counterparts,
+   and "{}" (or 0) if the handle is not open */
+
+char *gpxGetGPXData (int handle);
+
+char *gpxGetRoutesAndTracks (int handle);
+
+char *gpxGetOtherData (int handle, int type, int index);
+
+int gpxRenamePath (int handle, int type, int index, char *newName);
+
+int gpxRemovePath (int handle, int type, int index);
+
+int gpxAddRoute (int handle, char *routeNameJSON);
+
+int gpxAddWaypointToLastRoute (int handle, char *waypointJSON);
+
+char *gpxGetRoutesBetween (int handle, float lat1, float lon1, float lat2, float lon2, float delta);
+
+char *gpxGetTracksBetween (int handle, float lat1, float lon1, float lat2, float lon2, float delta);
+
+char *gpxGetPathsWithLength (int handle, float length);
+
+char *gpxGetRouteWaypoints (int handle, int index);
+
+char *gpxGetLastRoute (int handle);
+
+char *gpxGetRoutesWithWaypoints (int handle);
+
+#endif
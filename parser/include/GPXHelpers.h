@@ -3,6 +3,7 @@
 
 #include <ctype.h>
 #include "GPXParser.h"
+#include "GPXStringBuilder.h"
 
 /** Used the same looping format used in the file found at: http://www.xmlsoft.org/examples/tree1.c 
  *  in order to parse the tree. Also used the edited version provided in the file libXmlExample.c */
@@ -13,16 +14,6 @@ void insertWaypoints(xmlNode *cur_node, Waypoint *tmpWpt, List *listToInsertInto
 // Function to recursively read the tree returned by the XML parser and change the GPXdoc accordingly
 void recursiveReader(xmlNode *a_node, GPXdoc *docToEdit);
 
-int addGPXDataChildren(List *otherData, xmlNode *parentNode);
-
-int addWaypointChildren(List *waypoints, xmlNode *parentNode, char *type);
-
-int addRouteChildren(List *routes, xmlNode *parentNode);
-
-int addTrackSegChildren(List *trackSegs, xmlNode *parentNode);
-
-int addTrackChildren(List *tracks, xmlNode *parentNode);
-
 int checkGPXData(List *otherData);
 
 int checkWaypoints(List *waypoints);
@@ -33,14 +24,92 @@ int checkTrackSeg(List *trackSegs);
 
 int checkTracks(List *tracks);
 
-xmlDoc *gpxDocToXMLDoc(GPXdoc *doc);
-
 double haversine(double lat1, double lon1, double lat2, double lon2);
 
+double haversineWithCos(double lat1, double lon1, double cosLat1, double lat2, double lon2, double cosLat2);
+
 float getTotalWaypointsLen (List *waypoints);
 
 float getTotalTrackSegLen(List *trackSegs);
 
 void dummyDelete(void* data);
 
+/** GPXdoc versions of the backend wrappers in GPXParser.c, shared by the file based wrappers and the handle API */
+
+char *routesAndTracksToJSON (const GPXdoc *doc);
+
+char *otherDataToJSON (const GPXdoc *doc, int type, int index);
+
+int renamePath (GPXdoc *doc, int type, int index, char *newName);
+
+int removePath (GPXdoc *doc, int type, int index);
+
+char *routesBetweenToJSON (const GPXdoc *doc, float lat1, float lon1, float lat2, float lon2, float delta);
+
+char *tracksBetweenToJSON (const GPXdoc *doc, float lat1, float lon1, float lat2, float lon2, float delta);
+
+char *pathsWithLengthToJSON (const GPXdoc *doc, float length);
+
+char *routeWaypointsToJSON (const GPXdoc *doc, int index);
+
+char *routePointsToJSON (const Route *rt);
+
+char *routesWithWaypointsToJSON (const GPXdoc *doc);
+
+/** Constructors shared by the loaders and the JSONto* functions. With an arena every allocation, including the lists
+ *  and their nodes, comes from it; with NULL they use malloc, for objects that live on their own */
+
+GPXArena *getListArena(const List *list);
+
+void *allocFromArena(GPXArena *arena, size_t size);
+
+char *copyString(GPXArena *arena, const char *str);
+
+List *newModelList(GPXArena *arena, char *(*printFunction)(void *toBePrinted), void (*deleteFunction)(void *toBeDeleted),
+    int (*compareFunction)(const void *first, const void *second));
+
+GPXdoc *newGPXdoc(GPXArena *arena);
+
+Waypoint *newWaypoint(GPXArena *arena);
+
+Route *newRoute(GPXArena *arena);
+
+// Function to add a route at the end of a doc's routes, so that addWaypoint on the route makes the doc's index stale
+void insertRoute(GPXdoc *doc, Route *rt);
+
+TrackSegment *newTrackSegment(GPXArena *arena);
+
+Track *newTrack(GPXArena *arena);
+
+GPXData *newGPXData(GPXArena *arena, const char *name, const char *value);
+
+/** Functions that write the *ToString and *ToJSON representations straight into a string builder, so nested and
+ *  list output is built in one buffer instead of concatenating separately allocated strings */
+
+void appendListString(StringBuilder *sb, List *list, void (*appendData)(StringBuilder *sb, const void *data));
+
+void appendGpxDataString(StringBuilder *sb, const void *data);
+
+void appendWaypointString(StringBuilder *sb, const void *data);
+
+void appendRouteString(StringBuilder *sb, const void *data);
+
+void appendTrackSegmentString(StringBuilder *sb, const void *data);
+
+void appendTrackString(StringBuilder *sb, const void *data);
+
+void appendTrackJSON(StringBuilder *sb, const Track *tr);
+
+void appendRouteJSONFields(StringBuilder *sb, const Route *rt);
+
+void appendRouteJSON(StringBuilder *sb, const Route *rt);
+
+void appendNewTrackJSON (StringBuilder *sb, const Track *tr);
+
+void appendGpxDataJSON (StringBuilder *sb, const GPXData *data);
+
+void appendWaypointJSON (StringBuilder *sb, const Waypoint *wpt);
+
+void appendRoutePointsJSON (StringBuilder *sb, const Route *rt);
+
 #endif
@@ -0,0 +1,164 @@
+#ifndef GPXIMAGE_H
+#define GPXIMAGE_H
+
+#include <stdint.h>
+#include "GPXParser.h"
+
+/** Binary image of a parsed GPX file, used as an on-disk cache.
+ *  Parsing and validating the XML is most of the cost of createValidGPXdoc, and the files in uploads rarely change.
+ *  After a file is parsed, its GPXdoc is written to a hidden file next to it (see getImageFileName). The next
+ *  createValidGPXdoc of the file maps the image with mmap and builds the GPXdoc from it, without libxml2, as long as
+ *  the file and the schema are still the ones the image was made from.
+ *
+ *  The image is one flat block with offsets instead of pointers, so it can be used wherever it is mapped:
+ *      header
+ *      latitudes, longitudes, cosLatitudes  one double per point
+ *      pointNames                           one string offset per point
+ *      pointData                            pointCount + 1 indexes, the data of point i are pointData[i] to pointData[i + 1]
+ *      routes, tracks, segments, data       arrays of the records below
+ *      strings                              every distinct string once, null terminated. Offset 0 is ""
+ *  The points are the doc's waypoints, then the points of each route, then the points of each track segment, all in
+ *  document order, so the points of a route or segment are a contiguous range. Numbers are in the byte order of the
+ *  machine that wrote the image; an image from a machine with another byte order is rejected like a corrupt one. */
+
+#define GPX_IMAGE_MAGIC "GPXIMG\r\n"
+#define GPX_IMAGE_FORMAT_VERSION 1
+
+// What an image was made from: the size, modification time and inode of the GPX file and of the schema it was
+// validated against. An image is only used if all of them still match
+typedef struct {
+    int64_t fileSize;
+    int64_t fileModifiedSec;
+    int64_t fileModifiedNsec;
+    int64_t fileInode;
+    int64_t schemaSize;
+    int64_t schemaModifiedSec;
+    int64_t schemaModifiedNsec;
+    int64_t schemaInode;
+} GPXImageKey;
+
+typedef struct {
+    char magic[8];
+    uint32_t formatVersion;
+
+    // 0x01020304 as written by the machine that made the image
+    uint32_t byteOrder;
+
+    // Size of the whole image in bytes
+    uint64_t imageSize;
+
+    GPXImageKey key;
+
+    // Fields of the GPXdoc, the strings are offsets into the string table
+    double version;
+    uint32_t namespaceName;
+    uint32_t creator;
+
+    uint32_t waypointCount;
+    uint32_t routeCount;
+    uint32_t trackCount;
+    uint32_t segmentCount;
+    uint32_t pointCount;
+    uint32_t dataCount;
+
+    // Offset of each section from the start of the image
+    uint64_t latitudes;
+    uint64_t longitudes;
+    uint64_t cosLatitudes;
+    uint64_t pointNames;
+    uint64_t pointData;
+    uint64_t routes;
+    uint64_t tracks;
+    uint64_t segments;
+    uint64_t data;
+    uint64_t strings;
+    uint64_t stringsSize;
+} GPXImageHeader;
+
+typedef struct {
+    uint32_t name;
+    uint32_t firstPoint;
+    uint32_t pointCount;
+    uint32_t firstData;
+    uint32_t dataCount;
+} GPXImageRoute;
+
+typedef struct {
+    uint32_t name;
+    uint32_t firstSegment;
+    uint32_t segmentCount;
+    uint32_t firstData;
+    uint32_t dataCount;
+} GPXImageTrack;
+
+typedef struct {
+    uint32_t firstPoint;
+    uint32_t pointCount;
+} GPXImageSegment;
+
+typedef struct {
+    uint32_t name;
+    uint32_t value;
+} GPXImageData;
+
+// An image, mapped from a file or built in memory, with its sections resolved to pointers into it
+typedef struct {
+    void *base;
+    size_t size;
+
+    // False for an image built in memory by createGPXImage, whose block is malloc'd
+    bool mapped;
+
+    const GPXImageHeader *header;
+    const double *latitudes;
+    const double *longitudes;
+    const double *cosLatitudes;
+    const uint32_t *pointNames;
+    const uint32_t *pointData;
+    const GPXImageRoute *routes;
+    const GPXImageTrack *tracks;
+    const GPXImageSegment *segments;
+    const GPXImageData *data;
+    const char *strings;
+} GPXImage;
+
+// Function to get the name of the image of a GPX file, ".<name>.gpxb" in the same directory. The caller frees it
+char *getImageFileName(const char *fileName);
+
+// Function to get the key of a GPX file and a schema file. Returns false if either of them can not be read
+bool getImageKey(const char *fileName, const char *schemaFile, GPXImageKey *key);
+
+// Function to write a GPXdoc as an image. The image is written to a temporary file and renamed over imageFile, so
+// readers never see a partial image. Returns 1 on success, 0 on failure
+int writeGPXImage(const GPXdoc *doc, const GPXImageKey *key, const char *imageFile);
+
+// Function to map an image read only and check that it is well formed: every offset, range and string in it must be
+// inside the image. Returns NULL if the file is missing, from another version or byte order, truncated or corrupt
+GPXImage *openGPXImage(const char *imageFile);
+
+// Function to build the image of a GPXdoc in memory, for a file that has no image on disk. Returns NULL if malloc
+// fails or the doc is too large for 32 bit indexes
+GPXImage *createGPXImage(const GPXdoc *doc);
+
+// Function to unmap or free an image
+void closeGPXImage(GPXImage *image);
+
+// Function to build a GPXdoc from an image, in its own arena like the loaders do. Returns NULL if malloc fails
+GPXdoc *imageToGPXdoc(const GPXImage *image);
+
+// Function to get a string of an image from its offset
+const char *getImageString(const GPXImage *image, uint32_t offset);
+
+/** Functions used by createValidGPXdoc */
+
+// Function to open the image of a GPX file, if it has one made from the current file and schema. NULL otherwise
+GPXImage *openCachedGPXImage(const char *fileName, const char *schemaFile);
+
+// Function to load a GPX file from its image, if it has one made from the current file and schema. NULL otherwise
+GPXdoc *loadCachedGPXdoc(const char *fileName, const char *schemaFile);
+
+// Function to write the image of a GPX file that was just parsed and validated. Nothing is written for a file that
+// was modified in the last two seconds, since a change within the same clock tick would not change its key
+void saveCachedGPXdoc(const GPXdoc *doc, const char *fileName, const char *schemaFile);
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef GPXINDEX_H
+#define GPXINDEX_H
+
+#include "GPXParser.h"
+
+/** Spatial index over the start and end points of paths, for the getRoutesBetween style queries.
+ *  Entries are sorted by start latitude. A query first narrows them down to the band of latitudes that can be within
+ *  delta of the source, since no point further away in latitude alone can be, then drops the ones outside the
+ *  longitude range the band allows, and only checks what is left with the exact haversine test the linear scan used.
+ *  Points that the box can not describe (a latitude outside [-90, 90] or a non finite coordinate) are kept apart and
+ *  always checked exactly, so the index returns exactly what a scan would. */
+
+typedef struct {
+    // First point of the path and the cosine of its latitude
+    double startLatitude;
+    double startLongitude;
+    double startCosLatitude;
+
+    // Last point of the path and the cosine of its latitude
+    double endLatitude;
+    double endLongitude;
+    double endCosLatitude;
+
+    // Set by the caller, e.g. the position of the path in its list. Queries return the ids of the matches
+    int id;
+} EndpointEntry;
+
+typedef struct EndpointIndex EndpointIndex;
+
+// Function to fill the endpoints of an entry from the first and last point of a route. Returns false if the route
+// has no points, such a route is never between anything
+bool setRouteEntry(EndpointEntry *entry, const Route *rt);
+
+// Same for a track, from the first point of its first segment to the last point of its last segment
+bool setTrackEntry(EndpointEntry *entry, const Track *tr);
+
+// Function to build an index over a copy of the entries. Returns NULL if malloc fails
+EndpointIndex *createEndpointIndex(const EndpointEntry *entries, int length);
+
+void deleteEndpointIndex(void *data);
+
+// Function to get the number of entries in an index
+int getEndpointIndexLength(const EndpointIndex *index);
+
+// Function to find every entry that starts within delta metres of the source and ends within delta of the
+// destination, by the same haversine test getRoutesBetween uses. ids must have room for every entry in the index.
+// The ids are written in ascending order, and the number of matches is returned
+int findEndpointsBetween(const EndpointIndex *index, double sourceLat, double sourceLong, double destLat,
+    double destLong, double delta, int *ids);
+
+/** Index of the routes and tracks of one GPXdoc.
+ *  It is built the first time getRoutesBetween or getTracksBetween (or one of the length queries) is called on the doc
+ *  and kept in doc->index.
+ *  It is rebuilt when the doc's generation changes, which addRoute, removePath and addWaypoint on one of its routes
+ *  bump, so edits to other docs never make it stale. Paths added or removed with the List API instead are caught as
+ *  long as the number of paths or the first or last path changed. */
+
+// Function to get the index of a doc, building it first if it is missing or stale. Returns NULL if malloc fails
+const GPXIndex *getGPXIndex(const GPXdoc *doc);
+
+void deleteGPXIndex(void *data);
+
+// Functions to find the routes or tracks of an indexed doc between two points, in the order they are in the doc.
+// Same results and the same list type as getRoutesBetween and getTracksBetween, NULL if there are none
+List *findRoutesBetween(const GPXIndex *index, float sourceLat, float sourceLong, float destLat, float destLong,
+    float delta);
+
+List *findTracksBetween(const GPXIndex *index, float sourceLat, float sourceLong, float destLat, float destLong,
+    float delta);
+
+// Functions to count the routes or tracks of an indexed doc within delta of a length, same as numRoutesWithLength and
+// numTracksWithLength. The lengths are sorted (see GPXLengthIndex.h) the first time one of these is called on the index
+int countRoutesWithLength(const GPXIndex *index, float len, float delta);
+
+int countTracksWithLength(const GPXIndex *index, float len, float delta);
+
+// Functions to find the routes or tracks counted by the last two, in the order they are in the doc, with the same
+// list type as findRoutesBetween. NULL if there are none
+List *findRoutesWithLength(const GPXIndex *index, float len, float delta);
+
+List *findTracksWithLength(const GPXIndex *index, float len, float delta);
+
+#endif
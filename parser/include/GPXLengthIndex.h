@@ -0,0 +1,35 @@
+#ifndef GPXLENGTHINDEX_H
+#define GPXLENGTHINDEX_H
+
+#include "GPXParser.h"
+
+/** Sorted index of path lengths, for the numRoutesWithLength style queries.
+ *  A path matches a length if fabs(length - len) <= delta, with the difference taken in float like the scan does.
+ *  That difference only grows with the length, so the matches are one run of the sorted lengths, found with two
+ *  binary searches, and counting them costs nothing more. NaN lengths never match and are left out. */
+
+typedef struct {
+    float length;
+
+    // Set by the caller, e.g. the position of the path in its list. Queries return the ids of the matches
+    int id;
+} LengthEntry;
+
+typedef struct LengthIndex LengthIndex;
+
+// Function to build an index over a copy of the entries. Returns NULL if malloc fails
+LengthIndex *createLengthIndex(const LengthEntry *entries, int length);
+
+void deleteLengthIndex(void *data);
+
+// Function to get the number of entries in an index
+int getLengthIndexLength(const LengthIndex *index);
+
+// Function to count the entries within delta of len. 0 if len or delta is negative, like numRoutesWithLength
+int countLengthsWithin(const LengthIndex *index, float len, float delta);
+
+// Function to find the entries within delta of len. ids must have room for every entry in the index. The ids are
+// written in ascending order, and the number of matches is returned
+int findLengthsWithin(const LengthIndex *index, float len, float delta, int *ids);
+
+#endif
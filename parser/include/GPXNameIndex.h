@@ -0,0 +1,40 @@
+#ifndef GPXNAMEINDEX_H
+#define GPXNAMEINDEX_H
+
+#include "GPXParser.h"
+
+/** Hash index from names to the waypoints, routes and tracks of one GPXdoc, for getWaypoint, getRoute and getTrack.
+ *  It is built the first time one of them is called on the doc and kept in doc->names. Each type has its own table,
+ *  with the objects in list order and one hash chain per bucket. Objects with the same name share a chain, kept in
+ *  list order, so a lookup still returns the first of them like the linear scan did.
+ *  addRoute, renamePath and removePath keep the index up to date. A table is rebuilt when its list changes some other
+ *  way, as long as the length or the first or last object changed. A name that is changed by hand is not in its
+ *  chain, so a lookup that misses falls back to the linear scan, and the table is rebuilt if the scan finds it.
+ *  A lookup that hits is not checked against the scan, so unlike the scan it can return a later object with the name
+ *  when an earlier one was given the same name by hand. renamePath does not have this problem. */
+
+// Function to find the first waypoint, route or track of a doc with a name. NULL if there is none
+Waypoint *findWaypointByName(const GPXdoc *doc, const char *name);
+
+Route *findRouteByName(const GPXdoc *doc, const char *name);
+
+Track *findTrackByName(const GPXdoc *doc, const char *name);
+
+// Functions to get the route or track at an index (starting at 1, like the backend wrappers count them) of a doc,
+// without walking the list. NULL if the index is out of range
+Route *getRouteAt(const GPXdoc *doc, int index);
+
+Track *getTrackAt(const GPXdoc *doc, int index);
+
+// Function to add a route that was just appended to doc->routes to the index, if the doc has one
+void addRouteToNameIndex(const GPXdoc *doc, Route *rt);
+
+// Function to update the index after the route (type 1) or track at an index (starting at 1) was given a new name
+void renameInNameIndex(const GPXdoc *doc, int type, int index);
+
+// Function to drop the route (type 1) or track table after a path was removed, which renumbers the ones after it
+void invalidateNameIndex(const GPXdoc *doc, int type);
+
+void deleteNameIndex(void *data);
+
+#endif
@@ -10,6 +10,7 @@
 #include <libxml/xmlwriter.h>
 #include <libxml/xmlschemastypes.h>
 #include "LinkedListAPI.h"
+#include "GPXArena.h"
 
 //M_PI is not declared in the C standard, so we declare it manually
 //We will need it for A2
@@ -46,6 +47,18 @@ typedef struct {
     List* otherData;
 } Waypoint;
 
+//Packed copy of the points of a route or track segment, see GPXWaypointArray.h
+typedef struct WaypointArray WaypointArray;
+
+//Cached length, point count and bounding box of a route or track, see GPXPathMetrics.h
+typedef struct PathMetrics PathMetrics;
+
+//Spatial index over the ends of the paths in a GPXdoc, see GPXIndex.h
+typedef struct GPXIndex GPXIndex;
+
+//Hash index from names to the waypoints, routes and tracks of a GPXdoc, see GPXNameIndex.h
+typedef struct GPXNameIndex GPXNameIndex;
+
 typedef struct {
     //Route name.  Must not be NULL.  May be an empty string.
     char* name;
@@ -60,12 +73,30 @@ typedef struct {
     //the name already has its own dedicated filed in the Waypoint sruct - so do not place the name in this list
     //All objects in the list will be of type GPXData.  It must not be NULL.  It may be empty.
     List* otherData;
+
+    //Packed copy of waypoints used by the length, loop and between queries, built when first needed.
+    //Must be NULL for a route that is built by hand.
+    WaypointArray* points;
+
+    //Length, number of points, loop ends and bounding box of the route, worked out when first needed.
+    //Must be NULL for a route that is built by hand.
+    PathMetrics* metrics;
+
+    //Number of times points were added to the route with addWaypoint, so its metrics can tell they are stale
+    unsigned long generation;
+
+    //Generation of the doc the route is in, which addWaypoint bumps as well so the doc's index sees the change.
+    //Set when the route is added to a doc, must be NULL for a route that is in no doc.
+    unsigned long* docGeneration;
 } Route;
 
 typedef struct {
     //Waypoints that make up the track segment
     //All objects in the list will be of type Waypoint.  It must not be NULL.  It may be empty.
     List* waypoints;
+
+    //Packed copy of waypoints, same as in Route.  Must be NULL for a segment that is built by hand.
+    WaypointArray* points;
 } TrackSegment;
 
 typedef struct {
@@ -82,6 +113,9 @@ typedef struct {
     //the name already has its own dedicated filed in the Waypoint sruct - so do not place the name in this list
     //All objects in the list will be of type GPXData.  It must not be NULL.  It may be empty.
     List* otherData;
+
+    //Same as the metrics of a Route, over all segments.  Must be NULL for a track that is built by hand.
+    PathMetrics* metrics;
 } Track;
 
 
@@ -108,6 +142,22 @@ typedef struct {
     //Tracks in the GPX file
     //All objects in the list will be of type Track.  It must not be NULL.  It may be empty.
     List* tracks;
+
+    //Arena that owns the memory of the doc and everything in it, see GPXArena.h. Documents from the loaders and
+    //JSONtoGPX have one. Must be NULL for a GPXdoc that is put together with malloc, which is then freed object by object
+    GPXArena* arena;
+
+    //Index used by getRoutesBetween and getTracksBetween, built the first time one of them is called.
+    //Must be NULL for a GPXdoc that is put together by hand.
+    GPXIndex* index;
+
+    //Number of times a route or track of the doc was added or removed, or got points, through the API. The index
+    //compares it to tell it is stale. Must be 0 for a GPXdoc that is put together by hand.
+    unsigned long generation;
+
+    //Index used by getWaypoint, getRoute and getTrack, built the first time one of them is called.
+    //Must be NULL for a GPXdoc that is put together by hand.
+    GPXNameIndex* names;
 } GPXdoc;
 
 
@@ -274,6 +324,25 @@ int numRoutesWithLength(const GPXdoc* doc, float len, float delta);
 **/
 int numTracksWithLength(const GPXdoc* doc, float len, float delta);
 
+/** Function that returns the routes numRoutesWithLength counts
+ *@pre GPXdoc object exists, is not null
+ *@post GPXdoc object exists, is not null, has not been modified
+ *@return a list of the routes with the specified length, in the order they are in the doc, or NULL if there are none.
+ *        The list does not own the routes, freeing it leaves the doc as it was
+ *@param doc - a pointer to a GPXdoc struct
+ *@param len - search route length
+ *@param delta - the tolerance used for comparing route lengths
+**/
+List* getRoutesWithLength(const GPXdoc* doc, float len, float delta);
+
+/** Same as getRoutesWithLength, for the tracks numTracksWithLength counts
+ *@return a list of the tracks with the specified length, or NULL if there are none
+ *@param doc - a pointer to a GPXdoc struct
+ *@param len - search track length
+ *@param delta - the tolerance used for comparing track lengths
+**/
+List* getTracksWithLength(const GPXdoc* doc, float len, float delta);
+
 /** Function that checks if the current route is a loop
  *@pre Route object exists, is not null
  *@post Route object exists, is not null, has not been modified
@@ -472,4 +541,13 @@ char *waypointListToJSON (char *gpxFile, int index);
 
 char *lastRouteToJSON (char *gpxFile);
 
+/** Function to convert every route of a file, with its waypoints, to a JSON array in one parse
+ *@pre File name and schema file name are not NULL
+ *@post File has not been modified in any way
+ *@return A JSON array of route objects, each with an extra "waypoints" array. "[]" if the file is not valid
+ *@param gpxFile - the name of the GPX file
+ *@param schemaFile - the name of a schema file
+ **/
+char *getRoutesWithWaypoints (char *gpxFile, char *schemaFile);
+
 #endif
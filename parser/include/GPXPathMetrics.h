@@ -0,0 +1,53 @@
+#ifndef GPXPATHMETRICS_H
+#define GPXPATHMETRICS_H
+
+#include "GPXParser.h"
+
+/** Measurements of a route or track, kept on the path after the first time they are asked for.
+ *  The JSON of a path needs its length, number of points and loop flag, and the length queries ask for the lengths
+ *  of every path again on each call. Each of those used to go over every point of the path. The metrics are
+ *  worked out in one pass the first time any of them is needed and kept in rt->metrics or tr->metrics, so asking
+ *  again costs nothing.
+ *  The metrics go stale when points are added to the route with addWaypoint, which bumps its generation, or when
+ *  the path gains or loses points (segments for a track) some other way, and are worked out again the next time
+ *  they are asked for. Edits to one path never make the metrics of any other path stale. */
+struct PathMetrics {
+    // Same as getRouteLen or getTrackLen
+    float length;
+
+    // Number of points, of all segments for a track
+    int numPoints;
+
+    // Distance in metres between the ends isLoopRoute or isLoopTrack compare, or -1 if the path can not be a loop
+    // (fewer than 4 points, or an empty first or last segment). The path is a loop for delta if it is under delta
+    double endDistance;
+
+    // Bounding box of all the points. Only set if numPoints is not 0
+    double minLatitude;
+    double minLongitude;
+    double maxLatitude;
+    double maxLongitude;
+
+    // What the metrics were worked out from: the generation of the route (0 for a track), and the number of points
+    // of the route or segments of the track
+    unsigned long generation;
+    int sourceLength;
+
+    // Record of the metrics in the arena of the path, NULL if the path is not arena memory
+    ArenaCleanup *cleanup;
+};
+
+// Function to get the metrics of a route, working them out first if they are missing or stale. NULL if rt is NULL
+// or malloc fails
+const PathMetrics *getRouteMetrics(const Route *rt);
+
+// Function to get the metrics of a track, same as getRouteMetrics
+const PathMetrics *getTrackMetrics(const Track *tr);
+
+// Function to free the metrics of a path
+void deletePathMetrics(void *data);
+
+// Function to throw away the metrics of a path, and set *metrics to NULL. list is a list of the path, to find its arena
+void invalidatePathMetrics(const List *list, PathMetrics **metrics);
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef GPXSCHEMACACHE_H
+#define GPXSCHEMACACHE_H
+
+#include <libxml/xmlschemas.h>
+#include "GPXParser.h"
+
+/** Process-wide cache of compiled XSD schemas, keyed by schema path and modification time.
+ *  Compiling gpx.xsd is far more expensive than validating a typical file against it, so every
+ *  entry point borrows the compiled schema from here instead of parsing the .xsd on every call.
+ *  Entries are reference counted; if the .xsd changes on disk a fresh schema is compiled and the
+ *  old one is freed once the last borrower releases it. */
+
+/** Function to compile a schema file and keep it resident in the cache.
+ *  Optional, acquireSchema compiles lazily, but calling this at startup moves the cost off the first request
+ *@return 1 if the schema compiled (or was already cached), 0 otherwise
+ *@param gpxSchemaFile - the name of a schema file
+**/
+int initSchemaCache(char *gpxSchemaFile);
+
+/** Function to free every cached schema and tear down libxml2's global state.
+ *  Must only be called once no other thread is using the library, normally at process exit
+**/
+void cleanupSchemaCache(void);
+
+// Function to borrow the compiled schema for a schema file, compiling it on a cache miss. Returns NULL on failure
+xmlSchema *acquireSchema(const char *gpxSchemaFile);
+
+// Function to give back a schema returned by acquireSchema
+void releaseSchema(xmlSchema *schema);
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef GPXSTATS_H
+#define GPXSTATS_H
+
+#include <stdint.h>
+
+/** Statistics of the hot paths of the parser library: for each stage, how many times it ran, the total and the
+ *  longest time it took in nanoseconds, and the bytes it read or produced.
+ *  Every thread counts into its own counters, so recording a call takes no lock and touches no shared cache line.
+ *  Reading the statistics adds up the counters of all threads, including the ones that have exited. */
+
+// The stages that are counted. Keep in step with statNames in GPXStats.c
+typedef enum {
+    // Loaders. Bytes are the bytes of XML read; a createValidGPXdoc answered from the binary image reads none.
+    // These nest: the time of createGPXdoc and createValidGPXdoc includes the readGPXdoc, recursiveReader and schema
+    // stages they run, so only add up the outer ones to get the time spent loading
+    STAT_CREATE_GPXDOC,
+    STAT_CREATE_VALID_GPXDOC,
+    STAT_READ_GPXDOC,
+    STAT_RECURSIVE_READER,
+
+    // Compiling a schema for the schema cache, and validating a GPXdoc against one (validateGPXdocStream, which
+    // stands in for xmlSchemaValidateDoc). Bytes are the bytes of XML validated
+    STAT_SCHEMA_COMPILE,
+    STAT_SCHEMA_VALIDATE,
+
+    // Bytes are the bytes written to the file
+    STAT_WRITE_GPXDOC,
+
+    // JSON producers. Bytes are the length of the JSON. These do not nest, a producer that writes the output of
+    // another one into its own does not count it as a run of that one
+    STAT_GPX_TO_JSON,
+    STAT_ROUTE_TO_JSON,
+    STAT_TRACK_TO_JSON,
+    STAT_ROUTE_LIST_TO_JSON,
+    STAT_TRACK_LIST_TO_JSON,
+    STAT_NEW_TRACK_TO_JSON,
+    STAT_NEW_TRACK_LIST_TO_JSON,
+    STAT_ROUTES_AND_TRACKS_TO_JSON,
+    STAT_GPX_DATA_TO_JSON,
+    STAT_GPX_DATA_LIST_TO_JSON,
+    STAT_OTHER_DATA_TO_JSON,
+    STAT_ROUTES_BETWEEN_TO_JSON,
+    STAT_TRACKS_BETWEEN_TO_JSON,
+    STAT_PATHS_WITH_LENGTH_TO_JSON,
+    STAT_WAYPOINT_TO_JSON,
+    STAT_ROUTE_POINTS_TO_JSON,
+    STAT_ROUTE_WAYPOINTS_TO_JSON,
+    STAT_ROUTES_WITH_WAYPOINTS_TO_JSON,
+    STAT_VIEW_TO_JSON,
+    STAT_VIEW_ROUTE_LIST_TO_JSON,
+    STAT_VIEW_TRACK_LIST_TO_JSON,
+    STAT_VIEW_ROUTES_AND_TRACKS_TO_JSON,
+    STAT_VIEW_ROUTES_BETWEEN_TO_JSON,
+    STAT_VIEW_TRACKS_BETWEEN_TO_JSON,
+    STAT_VIEW_PATHS_WITH_LENGTH_TO_JSON,
+
+    NUM_PARSER_STATS
+} ParserStat;
+
+// Function to get the time a stage starts at, to pass to endParserStat
+uint64_t startParserStat(void);
+
+// Function to count one run of a stage that started at start and processed bytes bytes
+void endParserStat(ParserStat stat, uint64_t start, uint64_t bytes);
+
+// Same for a JSON producer, counting the length of the JSON it made. Returns json, so a producer can end with
+// return endJSONStat(stat, start, json);
+char *endJSONStat(ParserStat stat, uint64_t start, char *json);
+
+/** Function to get the statistics as a JSON object with one member per stage, e.g.
+ *  {"createValidGPXdoc":{"calls":3,"totalNs":5180342,"maxNs":2204113,"bytes":310521},...}
+ *@return a JSON string the caller must free, "{}" if malloc fails
+**/
+char *getParserStatsJSON(void);
+
+/** Function to get the statistics in the Prometheus text exposition format, as the counters gpxparser_calls_total,
+ *  gpxparser_seconds_total and gpxparser_bytes_total and the gauge gpxparser_max_seconds, labelled by stage.
+ *  The loader stages nest, so summing gpxparser_seconds_total over all stages counts loading time more than once
+ *@return a string the caller must free, "" if malloc fails
+**/
+char *getParserStatsPrometheus(void);
+
+// Function to set every counter back to 0. Calls that are being counted while it runs may keep part of their counts
+void resetParserStats(void);
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef GPXSTREAMREADER_H
+#define GPXSTREAMREADER_H
+
+#include <libxml/xmlreader.h>
+#include "GPXParser.h"
+
+/** Streaming GPX loader.
+ *  createGPXdoc reads the whole file into a libxml2 DOM and then copies it into a GPXdoc, so at its peak it holds
+ *  two full copies of the file. This loader walks the file with an xmlTextReader instead and only expands one
+ *  point (wpt, rtept or trkpt) or one small child element at a time, which libxml2 frees as soon as the reader
+ *  moves past it. Memory use is then proportional to the GPXdoc being built, not to the size of the file.
+ *  The resulting GPXdoc is the same as the one createGPXdoc builds for wpt, rte and trk elements found at any depth
+ *  outside of each other. */
+
+/** Function to create a GPX object from a GPX file without building a DOM of the whole file
+ *@pre File name cannot be an empty string or NULL.
+       File represented by this name must exist and must be readable.
+ *@post Either:
+        A valid GPXdoc has been created and its address was returned
+		or 
+		An error occurred, and NULL was returned
+ *@return the pointer to the new struct or NULL
+ *@param fileName - a string containing the name of the GPX file
+**/
+GPXdoc *createGPXdocStreaming(char *fileName);
+
+// Function to build a GPXdoc from a reader positioned before the root element. The caller keeps ownership of the reader
+GPXdoc *readGPXdoc(xmlTextReader *reader);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef GPXSTRINGBUILDER_H
+#define GPXSTRINGBUILDER_H
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/** Growable string used by all the *ToJSON and *ToString producers.
+ *  The buffer grows geometrically and the current length is tracked, so appending is amortized O(1) per character
+ *  instead of the realloc + strcat pattern, which rescans the whole string on every append. */
+typedef struct {
+    // The string built so far, always null terminated. NULL if an allocation failed
+    char *str;
+
+    // Number of characters in str, not counting the null terminator
+    size_t length;
+
+    // Number of bytes allocated for str
+    size_t capacity;
+} StringBuilder;
+
+// Function to set up an empty builder with room for at least initialCapacity characters
+void initStringBuilder(StringBuilder *sb, size_t initialCapacity);
+
+// Function to append the first len characters of a string
+void appendStringLength(StringBuilder *sb, const char *str, size_t len);
+
+// Function to append a null terminated string
+void appendString(StringBuilder *sb, const char *str);
+
+// Function to append a single character
+void appendChar(StringBuilder *sb, char c);
+
+// Function to append printf style formatted output
+void appendFormat(StringBuilder *sb, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+// Function to hand the built string to the caller, who must free it. Returns NULL if any allocation failed
+char *finishStringBuilder(StringBuilder *sb);
+
+#endif
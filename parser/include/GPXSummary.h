@@ -0,0 +1,32 @@
+#ifndef GPXSUMMARY_H
+#define GPXSUMMARY_H
+
+#include "GPXParser.h"
+
+/** Summaries of many GPX files at once, for the file log of the page.
+ *  Getting the summary of each file with getGPXDataIfValid parses and validates the files one after another. These
+ *  functions hand the files to a pool of worker threads instead, one per core, each taking the next file that is
+ *  left until there are none. Every file has its own slot in the result, so the summaries come back in the order
+ *  of the files no matter which thread finished first. */
+
+// Most worker threads used for one call
+#define MAX_SUMMARY_THREADS 16
+
+/** Function to get the summary of every valid GPX file in a list
+ *@return a JSON array with {"filename":...,"version":...,"creator":...,"numWaypoints":...,"numRoutes":...,
+ *        "numTracks":...} for each valid file, in the order of the list. Invalid files are left out
+ *@param fileNames - the names of the GPX files, used as the filename of each summary
+ *@param count - the number of names
+ *@param schemaFile - the name of a schema file
+**/
+char *getFileSummaries (char **fileNames, int count, char *schemaFile);
+
+/** Function to get the summary of every valid .gpx file in a directory
+ *@return the same JSON array as getFileSummaries, files in name order and filename without the directory.
+ *        "[]" if the directory can not be read
+ *@param dirName - the name of the directory
+ *@param schemaFile - the name of a schema file
+**/
+char *getDirSummaries (char *dirName, char *schemaFile);
+
+#endif
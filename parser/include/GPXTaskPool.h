@@ -0,0 +1,26 @@
+#ifndef GPXTASKPOOL_H
+#define GPXTASKPOOL_H
+
+/** Process-wide pool of worker threads for splitting one large computation, e.g. the length of a huge track, across
+ *  cores.
+ *  Every thread that runs tasks has its own deque. A thread pushes and pops tasks at the bottom of its own deque,
+ *  and when that is empty it steals from the top of another one. parallelFor starts a whole range of indexes as one
+ *  task, and whoever runs a task larger than the grain splits it in half and pushes one half, so the first pieces
+ *  pushed, and the first ones stolen, are the biggest. Idle threads pick the work up without a central queue.
+ *  The calling thread is one of the workers: it runs tasks until its whole range is done. The pool starts on first
+ *  use with one thread per core, the caller included. On a single core everything runs on the caller. */
+
+// Most threads that run tasks, the callers included
+#define MAX_POOL_THREADS 16
+
+// Body of a parallelFor, called with the pieces [begin, end) of the range in any order and on any thread
+typedef void (*RangeFunction)(void *arg, int begin, int end);
+
+// Function to call body for every index from 0 to count - 1, in pieces of at most grain indexes (at least 1) spread
+// over the pool. Returns when every piece is done. Can be called from several threads at once, and from a body
+void parallelFor(int count, int grain, RangeFunction body, void *arg);
+
+// Function to get the number of threads parallelFor spreads work over, the caller included
+int getTaskPoolThreadCount(void);
+
+#endif
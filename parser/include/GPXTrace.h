@@ -0,0 +1,50 @@
+#ifndef GPXTRACE_H
+#define GPXTRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Opt-in tracing of the stages of a call into the parser library, e.g. for renameRoute the parse in
+ *  createValidGPXdoc, the schema, readGPXdoc, the edit and the save in writeGPXdoc, as spans that can be dumped in
+ *  the trace event format of chrome://tracing and Perfetto.
+ *
+ *  Tracing is off unless it is turned on with setParserTracing, or by setting GPXPARSER_TRACE in the environment
+ *  before the library is loaded. GPXPARSER_TRACE=1 only turns it on; any other value is taken as a file name, and
+ *  the trace is also written there when the process exits.
+ *
+ *  Every thread records its spans into its own ring buffer of the last MAX_TRACE_SPANS spans, without locks. A
+ *  span is recorded when it ends, so calls still running when the trace is dumped are left out. Every stage counted
+ *  in GPXStats.h is traced too, under the name it has there. */
+
+#define MAX_TRACE_SPANS 16384
+
+// Function to turn tracing on or off. Spans already recorded are kept
+void setParserTracing(bool enabled);
+
+bool isParserTracing(void);
+
+// Function to get the time a span starts at, to pass to endTraceSpan. 0 if tracing is off, so spans that start
+// while it is off are not recorded
+uint64_t beginTraceSpan(void);
+
+// Function to record a span that started at start and ends now. name must be a string literal, since only the
+// pointer is kept
+void endTraceSpan(const char *name, uint64_t start);
+
+// Same, for a span whose end was already taken, as by endParserStat
+void recordTraceSpan(const char *name, uint64_t start, uint64_t end);
+
+/** Function to get the recorded spans of all threads, oldest first within each thread, as trace event JSON:
+ *  {"traceEvents":[{"name":"readGPXdoc","cat":"gpxparser","ph":"X","ts":10.512,"dur":830.044,"pid":7,"tid":1},...]}
+ *  Times are in microseconds. tid numbers the threads in the order they first recorded a span
+ *@return a JSON string the caller must free, "{"traceEvents":[]}" if malloc fails
+**/
+char *getParserTraceJSON(void);
+
+// Function to write getParserTraceJSON to a file. Returns false if it can not be written
+bool writeParserTrace(const char *fileName);
+
+// Function to drop every span recorded so far
+void clearParserTrace(void);
+
+#endif
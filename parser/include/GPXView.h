@@ -0,0 +1,73 @@
+#ifndef GPXVIEW_H
+#define GPXVIEW_H
+
+#include "GPXImage.h"
+
+/** Read only queries that run directly on a GPX image (see GPXImage.h), without building a GPXdoc.
+ *  A GPXdoc needs a List, Node and Waypoint allocation for every point before anything can be asked of it. The
+ *  image already has the points as packed arrays and the paths as ranges of them, so these counterparts of the
+ *  GPXdoc functions only read it: they allocate nothing but the strings they return, and every request that opens
+ *  the image of the same file shares its pages in the page cache.
+ *  Each function gives exactly what its GPXdoc counterpart gives for the doc the image was made from. */
+
+// Function to get the image of a valid GPX file to query. The image next to the file is used when it is fresh;
+// otherwise the file is parsed and validated once, which also writes the image for next time. If the image can not
+// be written, e.g. the file was just modified, it is built in memory instead. NULL if the file is not valid.
+// Close the view with closeGPXImage
+GPXImage *openGPXView(char *fileName, char *schemaFile);
+
+// Counterparts of getNumWaypoints, getNumRoutes, getNumTracks and getNumSegments
+int getViewNumWaypoints(const GPXImage *view);
+
+int getViewNumRoutes(const GPXImage *view);
+
+int getViewNumTracks(const GPXImage *view);
+
+int getViewNumSegments(const GPXImage *view);
+
+// Counterparts of getRouteLen and getTrackLen, for the route or track at an index. 0 if the index is out of range
+float getViewRouteLen(const GPXImage *view, int route);
+
+float getViewTrackLen(const GPXImage *view, int track);
+
+// Counterparts of isLoopRoute and isLoopTrack
+bool isViewLoopRoute(const GPXImage *view, int route, float delta);
+
+bool isViewLoopTrack(const GPXImage *view, int track, float delta);
+
+// Counterparts of numRoutesWithLength and numTracksWithLength
+int numViewRoutesWithLength(const GPXImage *view, float len, float delta);
+
+int numViewTracksWithLength(const GPXImage *view, float len, float delta);
+
+// Counterparts of getRoutesBetween and getTracksBetween. The indexes of the matching paths are written to paths, in
+// document order, and the number of matches is returned. paths must have room for every route (or track) of the view
+int getViewRoutesBetween(const GPXImage *view, float sourceLat, float sourceLong, float destLat, float destLong,
+    float delta, int *paths);
+
+int getViewTracksBetween(const GPXImage *view, float sourceLat, float sourceLong, float destLat, float destLong,
+    float delta, int *paths);
+
+/** JSON summaries, the same strings as the GPXdoc functions in brackets */
+
+// GPXtoJSON
+char *viewToJSON(const GPXImage *view);
+
+// routeListToJSON of the doc's routes
+char *viewRouteListToJSON(const GPXImage *view);
+
+// newTrackListToJSON of the doc's tracks
+char *viewTrackListToJSON(const GPXImage *view);
+
+// routesAndTracksToJSON
+char *viewRoutesAndTracksToJSON(const GPXImage *view);
+
+// routesBetweenToJSON and tracksBetweenToJSON
+char *viewRoutesBetweenToJSON(const GPXImage *view, float lat1, float lon1, float lat2, float lon2, float delta);
+
+char *viewTracksBetweenToJSON(const GPXImage *view, float lat1, float lon1, float lat2, float lon2, float delta);
+
+// pathsWithLengthToJSON
+char *viewPathsWithLengthToJSON(const GPXImage *view, float length);
+
+#endif
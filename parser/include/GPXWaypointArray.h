@@ -0,0 +1,65 @@
+#ifndef GPXWAYPOINTARRAY_H
+#define GPXWAYPOINTARRAY_H
+
+#include "GPXParser.h"
+
+/** Packed structure-of-arrays copy of the points of a route or track segment.
+ *  The waypoints List stays the source of truth and the API every caller edits, but walking it for a length, loop
+ *  or between query means chasing a Node and a Waypoint pointer per point. The geometric queries read this instead:
+ *  the coordinates are two plain double arrays, names are interned into one string table and referenced by offset,
+ *  and otherData, which the queries never look at, stays on the side in the original Waypoint structs.
+ *  The array is built from the list the first time it is asked for and thrown away whenever the list is changed
+ *  through the API (e.g. addWaypoint), so it is rebuilt on the next query. */
+struct WaypointArray {
+    // Number of points
+    int length;
+
+    // Point coordinates, index i is the i-th point of the list
+    double *latitudes;
+    double *longitudes;
+
+    // Cosine of each latitude, computed once per point when the array is built. Every interior point is an end of
+    // two segments, and haversine would otherwise compute it for both
+    double *cosLatitudes;
+
+    // Offset of each point's name in names. Points with the same name share one copy
+    int *nameOffsets;
+
+    // All the distinct names, each null terminated
+    char *names;
+
+    // Compatibility view, the original Waypoint of each point. Its otherData is the point's side storage
+    Waypoint **waypoints;
+
+    // Record of the array in the arena of the list, NULL if the list is not arena memory
+    ArenaCleanup *cleanup;
+};
+
+// Function to build the packed array for a list of waypoints. Returns NULL if list is NULL or malloc fails
+WaypointArray *createWaypointArray(const List *waypoints);
+
+// Function to free a packed array
+void deleteWaypointArray(void *data);
+
+// Function to throw away the packed array of a list after the list has changed, and set *points to NULL
+void invalidateWaypointArray(const List *waypoints, WaypointArray **points);
+
+// Function to get the packed points of a route, building them if they are missing or stale. NULL if rt is NULL
+const WaypointArray *getRoutePoints(const Route *rt);
+
+// Function to get the packed points of a track segment, building them if they are missing or stale
+const WaypointArray *getSegmentPoints(const TrackSegment *seg);
+
+// Accessors for point i of a packed array. i must be between 0 and length - 1
+double getPointLatitude(const WaypointArray *points, int i);
+
+double getPointLongitude(const WaypointArray *points, int i);
+
+const char *getPointName(const WaypointArray *points, int i);
+
+List *getPointOtherData(const WaypointArray *points, int i);
+
+// Function to get the total distance between consecutive points, same result as getTotalWaypointsLen
+float getPointsLen(const WaypointArray *points);
+
+#endif
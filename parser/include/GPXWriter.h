@@ -0,0 +1,45 @@
+#ifndef GPXWRITER_H
+#define GPXWRITER_H
+
+#include <libxml/xmlschemas.h>
+#include "GPXParser.h"
+
+/** Serializes a GPXdoc in one sequential pass, without building a DOM. The XML is collected in a buffer of its own
+ *  and handed to an output function in chunks as it is written. Indented, the bytes are the same as
+ *  xmlSaveFormatFileEnc wrote for the libxml2 tree the parser used to build for a doc */
+
+// Function that receives the XML, same as libxml2's xmlOutputWriteCallback. Returns len, or -1 to stop the writing
+typedef int (*GPXOutputFunction)(void *context, const char *buffer, int len);
+
+/** Function to write a GPXdoc as a complete XML document to an output function
+ *@return 0 on success, -1 if the doc can not be written as GPX (a NULL creator or path name, an empty otherData name
+ *        or value, coordinates out of range) or the output failed
+ *@param doc - the GPXdoc to write
+ *@param output - the function the XML goes to, called with context
+ *@param context - passed to output as is
+ *@param indent - true to put every element on its own line, indented by two spaces per level, false for compact XML
+**/
+int writeGPXdocToOutput(const GPXdoc *doc, GPXOutputFunction output, void *context, bool indent);
+
+/** Function to write a GPXdoc to a file with writeGPXdocToOutput. The XML goes to a temporary file next to it that
+ *  only replaces the file once it is complete, so a doc that can not be written leaves the file as it was.
+ *  A file that is replaced keeps its permissions, and its owner where allowed; a new file gets 0666 less the umask.
+ *  A symbolic link is written through to its target, and a file with other hard links is overwritten in place once
+ *  the temporary file is complete, so the links stay as they were
+ *@return the number of bytes written, -1 if the doc breaks the constraints writeGPXdocToOutput checks or the file
+ *        could not be written
+ *@param doc - the GPXdoc to write
+ *@param fileName - the file to write
+ *@param indent - true for the indented XML writeGPXdoc writes, false for compact XML
+**/
+long writeGPXdocToFile(const GPXdoc *doc, const char *fileName, bool indent);
+
+/** Function to validate a GPXdoc against a compiled schema in one pass. The XML is fed to a schema validating
+ *  push parser as it is written, so neither a DOM nor the whole serialized document is kept in memory
+ *@return true if the doc could be written and the XML is valid, false otherwise
+ *@param doc - the GPXdoc to validate
+ *@param schema - a compiled schema, e.g. from acquireSchema
+**/
+bool validateGPXdocStream(const GPXdoc *doc, xmlSchema *schema);
+
+#endif
@@ -37,6 +37,10 @@ typedef struct listHead{
     void (*deleteData)(void* toBeDeleted);
     int (*compare)(const void* first,const void* second);
     char* (*printData)(void* toBePrinted);
+    //Optional allocator for the List struct and its nodes, called with allocContext. NULL means malloc and free are used.
+    //Memory that comes from a custom allocator is never freed by the list, the allocator owns it
+    void* (*allocNode)(void* context, size_t size);
+    void* allocContext;
 } List;
 
 
@@ -63,6 +67,21 @@ typedef struct iter{
 List* initializeList(char* (*printFunction)(void* toBePrinted),void (*deleteFunction)(void* toBeDeleted),int (*compareFunction)(const void* first,const void* second));
 
 
+/** Function to initialize a list whose List struct and nodes are allocated by allocFunction instead of malloc,
+* e.g. from an arena. The list never frees that memory; freeList and clearList still call the delete function
+* on the data, and deleteDataFromList only unlinks the node
+*@pre function pointer arguments must not be NULL
+*@post List structure has been allocated and initialized
+*@return On success returns the new List struct. Returns NULL if allocFunction fails
+*@param printFunction - function pointer to print a single node of the list
+*@param deleteFunction - function pointer to delete a single piece of data from the list
+*@param compareFunction - function pointer to compare two nodes of the list in order to test for equality or order
+*@param allocFunction - function pointer that returns size bytes of memory, given allocContext
+*@param allocContext - passed to allocFunction on every call
+**/
+List* initializeListWithAllocator(char* (*printFunction)(void* toBePrinted),void (*deleteFunction)(void* toBeDeleted),int (*compareFunction)(const void* first,const void* second),void* (*allocFunction)(void* context, size_t size),void* allocContext);
+
+
 
 /**Function for creating a node for the linked list. 
 * This node contains abstracted (void *) data as well as previous and next
@@ -140,6 +159,17 @@ void insertSorted(List* list, void* toBeAdded);
 void* deleteDataFromList(List* list, void* toBeDeleted);
 
 
+/** Same as deleteDataFromList, but finds the node holding exactly the pointer toBeRemoved instead of asking the
+ * compare function, for lists whose data can compare equal (e.g. two routes with the same name)
+ *@pre List must exist and have memory allocated to it
+ *@post The node holding toBeRemoved has been unlinked and freed. The data itself is not freed
+ *@param list - a pointer to the List struct
+ *@param toBeRemoved - a pointer to data that is to be removed from the list
+ *@return on success: toBeRemoved  on failure: NULL
+ **/
+void* removeDataFromList(List* list, void* toBeRemoved);
+
+
 
 /**Returns a pointer to the data at the front of the list. Does not alter list structure.
  *@pre The list exists and has memory allocated to it
@@ -0,0 +1,47 @@
+#ifndef SYNTHETICGPX_H
+#define SYNTHETICGPX_H
+
+#include <stdbool.h>
+
+/** Generator of synthetic GPX files for the benchmarks. The same parameters always give the same file.
+ *  Every path starts near one of a few hubs and wanders off in small steps, so the files have paths between common
+ *  points and paths of similar lengths, like real ones. The files are valid against gpx.xsd. */
+
+// Most otherData elements a point can get, one each of the kinds the generator knows
+#define MAX_SYNTHETIC_OTHER_DATA 12
+
+// First of the hubs, in Guelph. The others are a few kilometres north and east of it
+#define SYNTHETIC_HUB_LATITUDE 43.5448
+#define SYNTHETIC_HUB_LONGITUDE -80.2482
+
+typedef struct {
+    // Number of waypoints in the doc
+    int waypoints;
+
+    // Number of routes and of points in each route
+    int routes;
+    int routePoints;
+
+    // Number of tracks, of segments in each track and of points in each segment
+    int tracks;
+    int segments;
+    int segmentPoints;
+
+    // Number of otherData elements on each point, up to MAX_SYNTHETIC_OTHER_DATA. Routes and tracks get a desc if it
+    // is not 0
+    int otherData;
+
+    unsigned int seed;
+} SyntheticParams;
+
+// Function to get parameters with about totalPoints points in all, spread over waypoints, routes and tracks the way
+// a typical file has them
+SyntheticParams getSyntheticParams(long totalPoints);
+
+// Function to get the number of points a file made from the parameters has
+long getSyntheticPointCount(const SyntheticParams *params);
+
+// Function to write a file. Returns false if the parameters are negative or the file can not be written
+bool writeSyntheticGPX(const char *fileName, const SyntheticParams *params);
+
+#endif
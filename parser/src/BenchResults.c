@@ -0,0 +1,300 @@
+#define _POSIX_C_SOURCE 200809L
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "BenchResults.h"
+
+// Version written at the top of the JSON, bumped if the layout of a result changes
+#define BENCH_FORMAT "gpxbench 1"
+
+// Two sided 97.5% quantiles of Student's t distribution for 1 to 30 degrees of freedom, for 95% intervals
+static const double tQuantiles[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228, 2.201, 2.179, 2.160, 2.145, 2.131,
+    2.120, 2.110, 2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+};
+
+double getBenchMean(const BenchResult *result) {
+
+    if (result->numSamples == 0) {
+        return 0;
+    }
+
+    double sum = 0;
+    for (int i = 0; i < result->numSamples; i++) {
+        sum += result->samples[i];
+    }
+
+    return sum / result->numSamples;
+
+}
+
+double getBenchStdDev(const BenchResult *result) {
+
+    if (result->numSamples < 2) {
+        return 0;
+    }
+
+    double mean = getBenchMean(result);
+    double sum = 0;
+
+    for (int i = 0; i < result->numSamples; i++) {
+        sum += (result->samples[i] - mean) * (result->samples[i] - mean);
+    }
+
+    return sqrt(sum / (result->numSamples - 1));
+
+}
+
+double getBenchMedian(const BenchResult *result) {
+
+    int n = result->numSamples;
+    if (n == 0) {
+        return 0;
+    }
+
+    return n % 2 == 1 ? result->samples[n / 2] : (result->samples[n / 2 - 1] + result->samples[n / 2]) / 2;
+
+}
+
+const BenchResult *findBenchResult(const BenchResults *results, long size, const char *operation) {
+
+    for (int i = 0; i < results->length; i++) {
+        if (results->results[i].size == size && strcmp(results->results[i].operation, operation) == 0) {
+            return &results->results[i];
+        }
+    }
+
+    return NULL;
+
+}
+
+bool writeBenchResults(const char *fileName, const BenchResults *results) {
+
+    FILE *file = fopen(fileName, "w");
+    if (file == NULL) {
+        return false;
+    }
+
+    fprintf(file, "{\n  \"format\": \"%s\",\n  \"results\": [\n", BENCH_FORMAT);
+
+    for (int i = 0; i < results->length; i++) {
+
+        const BenchResult *result = &results->results[i];
+
+        // %.9g keeps nanoseconds, and reads back as the same number
+        fprintf(file, "    {\"size\": %ld, \"operation\": \"%s\", \"points\": %ld, \"bytes\": %ld, \"mean\": %.9g, "
+            "\"stddev\": %.9g, \"median\": %.9g, \"samples\": [", result->size, result->operation, result->points,
+            result->bytes, getBenchMean(result), getBenchStdDev(result), getBenchMedian(result));
+
+        for (int j = 0; j < result->numSamples; j++) {
+            fprintf(file, j == 0 ? "%.9g" : ", %.9g", result->samples[j]);
+        }
+
+        fprintf(file, "]}%s\n", i + 1 < results->length ? "," : "");
+
+    }
+
+    fprintf(file, "  ]\n}\n");
+
+    bool written = !ferror(file);
+    if (fclose(file) != 0) {
+        written = false;
+    }
+
+    return written;
+
+}
+
+// Read the samples of a result from the text after "samples": [. Returns false if the array is not closed
+static bool readSamples(const char *text, BenchResult *result) {
+
+    result->numSamples = 0;
+
+    while (*text != ']') {
+
+        char *end;
+        double sample = strtod(text, &end);
+        if (end == text) {
+            return false;
+        }
+
+        if (result->numSamples < MAX_BENCH_REPEATS) {
+            result->samples[result->numSamples++] = sample;
+        }
+
+        // Skip the comma and spaces before the next sample
+        for (text = end; *text == ',' || *text == ' '; text++);
+
+    }
+
+    return true;
+
+}
+
+BenchResults *readBenchResults(const char *fileName) {
+
+    FILE *file = fopen(fileName, "r");
+    if (file == NULL) {
+        return NULL;
+    }
+
+    BenchResults *results = malloc(sizeof(BenchResults));
+    if (results == NULL) {
+        fclose(file);
+        return NULL;
+    }
+
+    results->length = 0;
+
+    char *line = NULL;
+    size_t capacity = 0;
+
+    while (getline(&line, &capacity, file) != -1 && results->length < MAX_BENCH_RESULTS) {
+
+        BenchResult *result = &results->results[results->length];
+
+        // Lines that are not a result, like the brackets and the format, are skipped
+        if (sscanf(line, " {\"size\": %ld, \"operation\": \"%63[^\"]\", \"points\": %ld, \"bytes\": %ld,",
+            &result->size, result->operation, &result->points, &result->bytes) != 4) {
+            continue;
+        }
+
+        const char *samples = strstr(line, "\"samples\": [");
+        if (samples == NULL || !readSamples(samples + strlen("\"samples\": ["), result)) {
+            continue;
+        }
+
+        results->length++;
+
+    }
+
+    free(line);
+    fclose(file);
+
+    if (results->length == 0) {
+        free(results);
+        return NULL;
+    }
+
+    return results;
+
+}
+
+static double getThreshold(const BenchThresholds *thresholds, const char *operation) {
+
+    for (int i = 0; i < thresholds->length; i++) {
+        if (strcmp(thresholds->operations[i], operation) == 0) {
+            return thresholds->percents[i];
+        }
+    }
+
+    return thresholds->defaultPercent;
+
+}
+
+// Half width, in percent, of the 95% interval of the change of the mean from baseline to current. The ratio of the
+// means is taken as normal with the first order (delta method) variance, and the degrees of freedom are Welch's.
+// 0 if either side has fewer than 2 samples, when the change itself is all there is to go on
+static double getChangeInterval(const BenchResult *baseline, const BenchResult *current) {
+
+    if (baseline->numSamples < 2 || current->numSamples < 2) {
+        return 0;
+    }
+
+    double mean0 = getBenchMean(baseline);
+    double mean1 = getBenchMean(current);
+    if (mean0 <= 0 || mean1 <= 0) {
+        return 0;
+    }
+
+    // Squared relative standard errors of the two means
+    double relative0 = pow(getBenchStdDev(baseline) / mean0, 2) / baseline->numSamples;
+    double relative1 = pow(getBenchStdDev(current) / mean1, 2) / current->numSamples;
+    if (relative0 + relative1 == 0) {
+        return 0;
+    }
+
+    double degrees = pow(relative0 + relative1, 2)
+        / (relative0 * relative0 / (baseline->numSamples - 1) + relative1 * relative1 / (current->numSamples - 1));
+    int index = (int)degrees;
+
+    double quantile = index < 1 ? tQuantiles[0] : index <= 30 ? tQuantiles[index - 1] : 1.96;
+
+    return quantile * (mean1 / mean0) * sqrt(relative0 + relative1) * 100;
+
+}
+
+// Check if a run timed anything at a size
+static bool hasBenchSize(const BenchResults *results, long size) {
+
+    for (int i = 0; i < results->length; i++) {
+        if (results->results[i].size == size) {
+            return true;
+        }
+    }
+
+    return false;
+
+}
+
+int compareBenchResults(const BenchResults *baseline, const BenchResults *current, const BenchThresholds *thresholds) {
+
+    int regressions = 0;
+
+    printf("\n%-8s %-28s %12s %12s %9s %11s %10s\n", "size", "operation", "base ms", "current ms", "change",
+        "95% CI", "threshold");
+
+    for (int i = 0; i < current->length; i++) {
+
+        const BenchResult *result = &current->results[i];
+        const BenchResult *base = findBenchResult(baseline, result->size, result->operation);
+        double threshold = getThreshold(thresholds, result->operation);
+
+        printf("%-8ld %-28s ", result->size, result->operation);
+
+        if (base == NULL || base->numSamples == 0) {
+            printf("%12s %12.3f   not in baseline\n", "-", getBenchMean(result) * 1e3);
+            continue;
+        }
+
+        if (result->numSamples == 0) {
+            printf("%12.3f %12s   REGRESSION: failed\n", getBenchMean(base) * 1e3, "-");
+            regressions++;
+            continue;
+        }
+
+        double change = (getBenchMean(result) / getBenchMean(base) - 1) * 100;
+        double interval = getChangeInterval(base, result);
+
+        printf("%12.3f %12.3f %+8.1f%% +/-%7.1f%% %9.1f%%", getBenchMean(base) * 1e3, getBenchMean(result) * 1e3,
+            change, interval, threshold);
+
+        if (change - interval > threshold) {
+            printf("   REGRESSION\n");
+            regressions++;
+        } else if (change + interval < -threshold) {
+            printf("   faster\n");
+        } else {
+            printf("\n");
+        }
+
+    }
+
+    // An operation the run left out would otherwise pass unseen, as when a benchmark case is deleted or renamed.
+    // Sizes the run did not do at all were left out on purpose
+    for (int i = 0; i < baseline->length; i++) {
+
+        const BenchResult *base = &baseline->results[i];
+
+        if (hasBenchSize(current, base->size) && findBenchResult(current, base->size, base->operation) == NULL) {
+            printf("%-8ld %-28s %12.3f %12s   REGRESSION: missing from this run\n", base->size, base->operation,
+                getBenchMean(base) * 1e3, "-");
+            regressions++;
+        }
+
+    }
+
+    return regressions;
+
+}
@@ -0,0 +1,548 @@
+/*
+ * Benchmark driver for the parser library. Generates synthetic GPX files of several sizes (see SyntheticGPX.h) and
+ * times the main operations of GPXParser.h on each, reporting the median and fastest of several runs, the throughput
+ * in points and megabytes per second, and the peak RSS of the process.
+ *
+ * With --json the results are also written as JSON (see BenchResults.h). With --compare they are compared to a
+ * baseline written that way, and the run fails if an operation got slower than its threshold allows.
+ *
+ * Usage: benchmark [--sizes N,N,...] [--repeat N] [--schema gpx.xsd] [--dir directory] [--json results.json]
+ *        [--compare baseline.json] [--threshold percent | operation=percent ...]
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include "GPXParser.h"
+#include "GPXImage.h"
+#include "GPXSchemaCache.h"
+#include "GPXWriter.h"
+#include "SyntheticGPX.h"
+#include "BenchResults.h"
+
+#define MAX_SIZES 16
+
+// Radius around the first hub for getRoutesBetween, and the length numRoutesWithLength looks for, about the length
+// of a synthetic route
+#define BETWEEN_DELTA 3000
+#define QUERY_LENGTH 1200
+#define QUERY_LENGTH_DELTA 100
+
+// A generated file and what is in it
+typedef struct {
+    char fileName[512];
+    char outFileName[512];
+    const char *schemaFile;
+
+    long points;
+    long routePoints;
+    long trackPoints;
+    long fileBytes;
+} BenchInput;
+
+// Work done by one run of an operation, for the throughput
+typedef struct {
+    long points;
+
+    // 0 if megabytes per second mean nothing for the operation
+    long bytes;
+} Amount;
+
+// An operation is set up and torn down outside of the timing, only run is timed
+typedef struct {
+    const char *name;
+
+    // Returns the state run works on, e.g. a loaded doc. May be NULL
+    void *(*setUp)(const BenchInput *input);
+
+    // Returns false if the operation failed. What it makes goes in *result, for tearDown to free
+    bool (*run)(const BenchInput *input, void *state, void **result);
+
+    // Frees the state and the result, and fills in the work done
+    void (*tearDown)(const BenchInput *input, void *state, void *result, Amount *amount);
+} Operation;
+
+// Keeps the compiler from dropping the length computations
+static volatile float lengthSink;
+
+static double getSeconds(void) {
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec / 1e9;
+
+}
+
+static long getFileBytes(const char *fileName) {
+
+    struct stat info;
+
+    return stat(fileName, &info) == 0 ? (long)info.st_size : 0;
+
+}
+
+static void removeImage(const char *fileName) {
+
+    char *imageFileName = getImageFileName(fileName);
+    if (imageFileName != NULL) {
+        remove(imageFileName);
+        free(imageFileName);
+    }
+
+}
+
+/* Set up and tear down functions shared by the operations */
+
+static void *loadDoc(const BenchInput *input) {
+
+    return createGPXdoc((char *)input->fileName);
+
+}
+
+static void *removeImageFirst(const BenchInput *input) {
+
+    removeImage(input->fileName);
+
+    return NULL;
+
+}
+
+// Load the file once so the next load finds its image
+static void *makeImageFirst(const BenchInput *input) {
+
+    deleteGPXdoc(createValidGPXdoc((char *)input->fileName, (char *)input->schemaFile));
+
+    return NULL;
+
+}
+
+static void deleteResultDoc(const BenchInput *input, void *state, void *result, Amount *amount) {
+
+    deleteGPXdoc(result);
+
+    amount->points = input->points;
+    amount->bytes = input->fileBytes;
+
+}
+
+static void deleteStateDoc(const BenchInput *input, void *state, void *result, Amount *amount) {
+
+    deleteGPXdoc(state);
+
+    amount->points = input->points;
+    amount->bytes = input->fileBytes;
+
+}
+
+/* Operations */
+
+static bool runCreateGPXdoc(const BenchInput *input, void *state, void **result) {
+
+    *result = createGPXdoc((char *)input->fileName);
+
+    return *result != NULL;
+
+}
+
+static bool runCreateValidGPXdoc(const BenchInput *input, void *state, void **result) {
+
+    *result = createValidGPXdoc((char *)input->fileName, (char *)input->schemaFile);
+
+    return *result != NULL;
+
+}
+
+static bool runValidateGPXDoc(const BenchInput *input, void *state, void **result) {
+
+    return validateGPXDoc(state, (char *)input->schemaFile);
+
+}
+
+static bool runWriteGPXdoc(const BenchInput *input, void *state, void **result) {
+
+    return writeGPXdoc(state, (char *)input->outFileName);
+
+}
+
+static bool runWriteCompact(const BenchInput *input, void *state, void **result) {
+
+    return writeGPXdocToFile(state, input->outFileName, false) >= 0;
+
+}
+
+static void tearDownWrite(const BenchInput *input, void *state, void *result, Amount *amount) {
+
+    deleteGPXdoc(state);
+
+    amount->points = input->points;
+    amount->bytes = getFileBytes(input->outFileName);
+
+}
+
+static bool runGPXtoJSON(const BenchInput *input, void *state, void **result) {
+
+    *result = GPXtoJSON(state);
+
+    return *result != NULL;
+
+}
+
+static bool runRouteListToJSON(const BenchInput *input, void *state, void **result) {
+
+    *result = routeListToJSON(((GPXdoc *)state)->routes);
+
+    return *result != NULL;
+
+}
+
+static void tearDownJSON(const BenchInput *input, void *state, void *result, Amount *amount) {
+
+    deleteGPXdoc(state);
+
+    amount->points = input->routePoints;
+    amount->bytes = result != NULL ? strlen(result) : 0;
+
+    free(result);
+
+}
+
+// Every track of a freshly loaded doc, so nothing is cached yet
+static bool runGetTrackLen(const BenchInput *input, void *state, void **result) {
+
+    float total = 0;
+
+    void *elem;
+    ListIterator iter = createIterator(((GPXdoc *)state)->tracks);
+
+    while ((elem = nextElement(&iter)) != NULL) {
+        total += getTrackLen(elem);
+    }
+
+    lengthSink = total;
+
+    return true;
+
+}
+
+static void tearDownTrackQuery(const BenchInput *input, void *state, void *result, Amount *amount) {
+
+    deleteGPXdoc(state);
+
+    amount->points = input->trackPoints;
+    amount->bytes = 0;
+
+}
+
+static bool runGetRoutesBetween(const BenchInput *input, void *state, void **result) {
+
+    *result = getRoutesBetween(state, SYNTHETIC_HUB_LATITUDE, SYNTHETIC_HUB_LONGITUDE, SYNTHETIC_HUB_LATITUDE,
+        SYNTHETIC_HUB_LONGITUDE, BETWEEN_DELTA);
+
+    return true;
+
+}
+
+static bool runNumRoutesWithLength(const BenchInput *input, void *state, void **result) {
+
+    lengthSink = numRoutesWithLength(state, QUERY_LENGTH, QUERY_LENGTH_DELTA);
+
+    return true;
+
+}
+
+static void tearDownRouteQuery(const BenchInput *input, void *state, void *result, Amount *amount) {
+
+    deleteGPXdoc(state);
+
+    if (result != NULL) {
+        freeList(result);
+    }
+
+    amount->points = input->routePoints;
+    amount->bytes = 0;
+
+}
+
+static const Operation operations[] = {
+    { "createGPXdoc", NULL, &runCreateGPXdoc, &deleteResultDoc },
+    { "createValidGPXdoc", &removeImageFirst, &runCreateValidGPXdoc, &deleteResultDoc },
+    { "createValidGPXdoc (image)", &makeImageFirst, &runCreateValidGPXdoc, &deleteResultDoc },
+    { "validateGPXDoc", &loadDoc, &runValidateGPXDoc, &deleteStateDoc },
+    { "writeGPXdoc", &loadDoc, &runWriteGPXdoc, &tearDownWrite },
+    { "writeGPXdocToFile (compact)", &loadDoc, &runWriteCompact, &tearDownWrite },
+    { "GPXtoJSON", &loadDoc, &runGPXtoJSON, &tearDownJSON },
+    { "routeListToJSON", &loadDoc, &runRouteListToJSON, &tearDownJSON },
+    { "getTrackLen", &loadDoc, &runGetTrackLen, &tearDownTrackQuery },
+    { "getRoutesBetween", &loadDoc, &runGetRoutesBetween, &tearDownRouteQuery },
+    { "numRoutesWithLength", &loadDoc, &runNumRoutesWithLength, &tearDownRouteQuery },
+};
+
+static int compareDoubles(const void *first, const void *second) {
+
+    double value1 = *(const double *)first;
+    double value2 = *(const double *)second;
+
+    return (value1 > value2) - (value1 < value2);
+
+}
+
+// Run an operation once untimed, to warm up caches like the compiled schema, and then repeat times, keeping the
+// sorted times in the result. Returns false, with no samples, if any run failed
+static bool timeOperation(const Operation *operation, const BenchInput *input, int repeat, BenchResult *benchResult) {
+
+    Amount amount = { 0, 0 };
+    benchResult->numSamples = 0;
+
+    for (int i = -1; i < repeat; i++) {
+
+        void *state = operation->setUp != NULL ? operation->setUp(input) : NULL;
+        void *result = NULL;
+
+        double start = getSeconds();
+        bool succeeded = operation->run(input, state, &result);
+        double elapsed = getSeconds() - start;
+
+        operation->tearDown(input, state, result, &amount);
+
+        if (!succeeded) {
+            benchResult->numSamples = 0;
+            return false;
+        }
+
+        if (i >= 0) {
+            benchResult->samples[benchResult->numSamples++] = elapsed;
+        }
+
+    }
+
+    qsort(benchResult->samples, benchResult->numSamples, sizeof(double), &compareDoubles);
+
+    benchResult->points = amount.points;
+    benchResult->bytes = amount.bytes;
+
+    return true;
+
+}
+
+static long getPeakRSSKilobytes(void) {
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    // Kilobytes on Linux, bytes on macOS
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+
+}
+
+// Time every operation on a file of about size points, adding a result for each to results
+static bool benchmarkSize(long size, int repeat, const char *schemaFile, const char *dir, BenchResults *results) {
+
+    BenchInput input;
+    snprintf(input.fileName, sizeof(input.fileName), "%s/gpxbench_%ld.gpx", dir, size);
+    snprintf(input.outFileName, sizeof(input.outFileName), "%s/gpxbench_%ld_out.gpx", dir, size);
+    input.schemaFile = schemaFile;
+
+    SyntheticParams params = getSyntheticParams(size);
+    if (!writeSyntheticGPX(input.fileName, &params)) {
+        fprintf(stderr, "Could not write %s\n", input.fileName);
+        return false;
+    }
+
+    input.points = getSyntheticPointCount(&params);
+    input.routePoints = (long)params.routes * params.routePoints;
+    input.trackPoints = (long)params.tracks * params.segments * params.segmentPoints;
+    input.fileBytes = getFileBytes(input.fileName);
+
+    printf("\n%ld points, %.2f MB\n", input.points, input.fileBytes / 1e6);
+    printf("%-28s %12s %12s %14s %10s\n", "operation", "median ms", "min ms", "points/s", "MB/s");
+
+    bool succeeded = true;
+
+    for (int i = 0; i < sizeof(operations) / sizeof(operations[0]) && results->length < MAX_BENCH_RESULTS; i++) {
+
+        BenchResult *result = &results->results[results->length++];
+        result->size = size;
+        snprintf(result->operation, sizeof(result->operation), "%s", operations[i].name);
+        result->points = result->bytes = 0;
+
+        if (!timeOperation(&operations[i], &input, repeat, result)) {
+            printf("%-28s failed\n", operations[i].name);
+            succeeded = false;
+            continue;
+        }
+
+        double median = getBenchMedian(result);
+
+        printf("%-28s %12.3f %12.3f %14.0f", operations[i].name, median * 1e3, result->samples[0] * 1e3,
+            median > 0 ? result->points / median : 0);
+
+        if (result->bytes > 0 && median > 0) {
+            printf(" %10.1f\n", result->bytes / median / 1e6);
+        } else {
+            printf(" %10s\n", "-");
+        }
+
+    }
+
+    printf("peak RSS so far: %.1f MB\n", getPeakRSSKilobytes() / 1024.0);
+
+    removeImage(input.fileName);
+    remove(input.fileName);
+    remove(input.outFileName);
+
+    return succeeded;
+
+}
+
+// Parse a --threshold value, either a percent for every operation or operation=percent for one
+static bool addThreshold(BenchThresholds *thresholds, const char *value) {
+
+    const char *equals = strrchr(value, '=');
+    if (equals == NULL) {
+        thresholds->defaultPercent = strtod(value, NULL);
+        return true;
+    }
+
+    if (thresholds->length == MAX_BENCH_THRESHOLDS || equals - value >= MAX_OPERATION_NAME) {
+        return false;
+    }
+
+    int index = thresholds->length++;
+    snprintf(thresholds->operations[index], MAX_OPERATION_NAME, "%.*s", (int)(equals - value), value);
+    thresholds->percents[index] = strtod(equals + 1, NULL);
+
+    return true;
+
+}
+
+static void printUsage(const char *program) {
+
+    fprintf(stderr, "Usage: %s [--sizes N,N,...] [--repeat N] [--schema gpx.xsd] [--dir directory]\n"
+        "       [--json results.json] [--compare baseline.json] [--threshold percent | operation=percent ...]\n"
+        "Exits with 1 if an operation failed and 2 if one regressed against the baseline\n", program);
+
+}
+
+int main(int argc, char **argv) {
+
+    long sizes[MAX_SIZES] = { 1000, 10000, 100000 };
+    int numSizes = 3;
+    bool sizesGiven = false;
+    int repeat = 5;
+    const char *schemaFile = "../gpx.xsd";
+    const char *dir = "/tmp";
+    const char *jsonFile = NULL;
+    const char *baselineFile = NULL;
+    BenchThresholds thresholds = { .defaultPercent = 10, .length = 0 };
+
+    for (int i = 1; i < argc; i++) {
+
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 1;
+        }
+
+        const char *option = argv[i];
+        char *value = argv[++i];
+
+        if (strcmp(option, "--sizes") == 0) {
+            numSizes = 0;
+            sizesGiven = true;
+            for (char *saveptr, *token = strtok_r(value, ",", &saveptr); token != NULL && numSizes < MAX_SIZES;
+                token = strtok_r(NULL, ",", &saveptr)) {
+                sizes[numSizes++] = strtol(token, NULL, 10);
+            }
+        } else if (strcmp(option, "--repeat") == 0) {
+            repeat = strtol(value, NULL, 10);
+        } else if (strcmp(option, "--schema") == 0) {
+            schemaFile = value;
+        } else if (strcmp(option, "--dir") == 0) {
+            dir = value;
+        } else if (strcmp(option, "--json") == 0) {
+            jsonFile = value;
+        } else if (strcmp(option, "--compare") == 0) {
+            baselineFile = value;
+        } else if (strcmp(option, "--threshold") == 0) {
+            if (!addThreshold(&thresholds, value)) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+
+    }
+
+    if (repeat < 1 || repeat > MAX_BENCH_REPEATS || numSizes == 0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    BenchResults *baseline = NULL;
+    if (baselineFile != NULL) {
+
+        baseline = readBenchResults(baselineFile);
+        if (baseline == NULL) {
+            fprintf(stderr, "Could not read the baseline %s\n", baselineFile);
+            return 1;
+        }
+
+        // Unless told otherwise, run the sizes the baseline has
+        if (!sizesGiven) {
+            numSizes = 0;
+            for (int i = 0; i < baseline->length && numSizes < MAX_SIZES; i++) {
+                if (numSizes == 0 || sizes[numSizes - 1] != baseline->results[i].size) {
+                    sizes[numSizes++] = baseline->results[i].size;
+                }
+            }
+        }
+
+    }
+
+    BenchResults *results = malloc(sizeof(BenchResults));
+    if (results == NULL) {
+        free(baseline);
+        return 1;
+    }
+
+    results->length = 0;
+
+    bool succeeded = true;
+    for (int i = 0; i < numSizes; i++) {
+        succeeded = benchmarkSize(sizes[i], repeat, schemaFile, dir, results) && succeeded;
+    }
+
+    cleanupSchemaCache();
+
+    if (jsonFile != NULL && !writeBenchResults(jsonFile, results)) {
+        fprintf(stderr, "Could not write %s\n", jsonFile);
+        succeeded = false;
+    }
+
+    int regressions = 0;
+    if (baseline != NULL) {
+
+        regressions = compareBenchResults(baseline, results, &thresholds);
+        printf("\n%d regression%s against %s\n", regressions, regressions == 1 ? "" : "s", baselineFile);
+
+    }
+
+    free(baseline);
+    free(results);
+
+    if (regressions > 0) {
+        return 2;
+    }
+
+    return succeeded ? 0 : 1;
+
+}
@@ -0,0 +1,154 @@
+/*
+ * Test of the distance kernels (see GPXDistance.h). Runs haversineBatch with each code path this machine can run,
+ * AVX2, SSE2 and scalar, on pairs of points from a latitude/longitude grid that includes the poles, both sides of the
+ * antimeridian and coincident points, and checks every distance against haversine within the error bound
+ * GPXDistance.h states.
+ *
+ * Usage: distanceTest
+ * Prints every distance out of bounds, and exits with 1 if there were any.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "GPXDistance.h"
+#include "GPXHelpers.h"
+
+// Near the poles, the equator and the antimeridian, so the range reduction and atan are tested at their edges
+static const double gridLatitudes[] = { -90, -89.9999, -75, -45, -10, -0.0001, 0, 0.0001, 10, 45, 75, 89.9999, 90 };
+static const double gridLongitudes[] = { -180, -179.9999, -135, -90, -45, -0.0001, 0, 0.0001, 45, 90, 135, 179.9999,
+    180 };
+
+#define NUM_GRID_LATITUDES (sizeof(gridLatitudes) / sizeof(gridLatitudes[0]))
+#define NUM_GRID_LONGITUDES (sizeof(gridLongitudes) / sizeof(gridLongitudes[0]))
+#define NUM_GRID_POINTS (NUM_GRID_LATITUDES * NUM_GRID_LONGITUDES)
+
+// Degrees a point is moved for the short pairs, about a metre and about a centimetre
+static const double shortSteps[] = { 1e-5, 1e-7 };
+
+static const char *kernels[] = { "avx2", "sse2", "scalar" };
+
+static int numChecks = 0;
+static int numFailures = 0;
+
+static void addPoint(double *latitudes, double *longitudes, int *length, double lat, double lon) {
+
+    latitudes[*length] = lat;
+    longitudes[*length] = lon;
+    (*length)++;
+
+}
+
+// The error bound of GPXDistance.h: 1e-12 relative, or 1e-6 m absolute for distances under a metre
+static bool isWithinBound(double distance, double expected) {
+
+    double error = fabs(distance - expected);
+
+    return expected < 1 ? error <= 1e-6 : error <= 1e-12 * expected;
+
+}
+
+// Check every pair of the points with the current kernel. Returns the largest relative error seen
+static double checkKernel(const char *kernel, const double *latitudes, const double *longitudes,
+    const double *cosLatitudes, int length, double *distances) {
+
+    double maxError = 0;
+
+    haversineBatch(latitudes, longitudes, cosLatitudes, length, distances);
+
+    for (int i = 0; i < length - 1; i++) {
+
+        double expected = haversine(latitudes[i], longitudes[i], latitudes[i + 1], longitudes[i + 1]);
+        double error = fabs(distances[i] - expected) / (expected > 1 ? expected : 1);
+
+        if (error > maxError) {
+            maxError = error;
+        }
+
+        numChecks++;
+
+        if (!isWithinBound(distances[i], expected)) {
+            printf("FAIL %s: (%.7f, %.7f) to (%.7f, %.7f) is %.9f m, haversine says %.9f m\n", kernel, latitudes[i],
+                longitudes[i], latitudes[i + 1], longitudes[i + 1], distances[i], expected);
+            numFailures++;
+        }
+
+    }
+
+    return maxError;
+
+}
+
+int main(void) {
+
+    // Every grid point to every grid point, including itself, then every grid point to a point a short step away
+    int maxLength = NUM_GRID_POINTS * NUM_GRID_POINTS * 2 + NUM_GRID_POINTS * 4;
+
+    double *latitudes = malloc(sizeof(double) * maxLength);
+    double *longitudes = malloc(sizeof(double) * maxLength);
+    double *cosLatitudes = malloc(sizeof(double) * maxLength);
+    double *distances = malloc(sizeof(double) * maxLength);
+
+    if (latitudes == NULL || longitudes == NULL || cosLatitudes == NULL || distances == NULL) {
+        printf("FAIL out of memory\n");
+        free(latitudes);
+        free(longitudes);
+        free(cosLatitudes);
+        free(distances);
+        return 1;
+    }
+
+    int length = 0;
+
+    for (int from = 0; from < NUM_GRID_POINTS; from++) {
+        for (int to = 0; to < NUM_GRID_POINTS; to++) {
+            addPoint(latitudes, longitudes, &length, gridLatitudes[from / NUM_GRID_LONGITUDES],
+                gridLongitudes[from % NUM_GRID_LONGITUDES]);
+            addPoint(latitudes, longitudes, &length, gridLatitudes[to / NUM_GRID_LONGITUDES],
+                gridLongitudes[to % NUM_GRID_LONGITUDES]);
+        }
+    }
+
+    // The step is taken towards the equator and the prime meridian, so the points stay in range
+    for (int i = 0; i < NUM_GRID_POINTS; i++) {
+
+        double lat = gridLatitudes[i / NUM_GRID_LONGITUDES];
+        double lon = gridLongitudes[i % NUM_GRID_LONGITUDES];
+
+        for (int s = 0; s < sizeof(shortSteps) / sizeof(shortSteps[0]); s++) {
+            addPoint(latitudes, longitudes, &length, lat, lon);
+            addPoint(latitudes, longitudes, &length, lat > 0 ? lat - shortSteps[s] : lat + shortSteps[s],
+                lon > 0 ? lon - shortSteps[s] : lon + shortSteps[s]);
+        }
+
+    }
+
+    for (int i = 0; i < length; i++) {
+        cosLatitudes[i] = cos(latitudes[i] * (M_PI / 180));
+    }
+
+    const char *defaultKernel = getDistanceKernelName();
+
+    for (int k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+
+        if (!setDistanceKernel(kernels[k])) {
+            printf("%s: not supported here, skipped\n", kernels[k]);
+            continue;
+        }
+
+        double maxError = checkKernel(kernels[k], latitudes, longitudes, cosLatitudes, length, distances);
+        printf("%s: %d pairs, largest relative error %.3g\n", kernels[k], length - 1, maxError);
+
+    }
+
+    setDistanceKernel(defaultKernel);
+
+    free(latitudes);
+    free(longitudes);
+    free(cosLatitudes);
+    free(distances);
+
+    printf("%d checks, %d failed\n", numChecks, numFailures);
+
+    return numFailures > 0 ? 1 : 0;
+
+}
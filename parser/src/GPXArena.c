@@ -0,0 +1,252 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "GPXArena.h" // Included necessary header
+
+// Blocks start small so tiny documents stay cheap, and double up to a limit for large ones
+#define ARENA_FIRST_BLOCK_SIZE (16 * 1024)
+#define ARENA_MAX_BLOCK_SIZE (4 * 1024 * 1024)
+
+// Every allocation is rounded up to this, which suits any type the parser stores
+#define ARENA_ALIGNMENT 16
+
+// One chunk of arena memory, the allocations follow the header
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t size;
+    size_t used;
+    _Alignas(ARENA_ALIGNMENT) unsigned char data[];
+} ArenaBlock;
+
+// A heap object the arena deletes when it is destroyed. Records are doubly linked so one can be unlinked in O(1)
+struct ArenaCleanup {
+    struct ArenaCleanup *next;
+    struct ArenaCleanup *prev;
+    void *data;
+    void (*deleteFunction)(void *data);
+};
+
+struct GPXArena {
+    // The block allocations are made from, followed by the full ones
+    ArenaBlock *blocks;
+    size_t nextBlockSize;
+    ArenaCleanup *cleanups;
+
+    // Records of released objects, reused by the next adopt. Only next is used in this list
+    ArenaCleanup *freeCleanups;
+};
+
+static ArenaBlock *newBlock(size_t size) {
+
+    ArenaBlock *block = malloc(sizeof(ArenaBlock) + size);
+    if (block == NULL) {
+        return NULL;
+    }
+
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+
+    return block;
+
+}
+
+GPXArena *createArena(void) {
+
+    GPXArena *arena = malloc(sizeof(GPXArena));
+    if (arena == NULL) {
+        return NULL;
+    }
+
+    arena->blocks = NULL;
+    arena->nextBlockSize = ARENA_FIRST_BLOCK_SIZE;
+    arena->cleanups = NULL;
+    arena->freeCleanups = NULL;
+
+    return arena;
+
+}
+
+void destroyArena(GPXArena *arena) {
+
+    if (arena == NULL) {
+        return;
+    }
+
+    // Adopted objects first, their delete functions may still look at arena memory
+    for (ArenaCleanup *cleanup = arena->cleanups; cleanup != NULL; cleanup = cleanup->next) {
+        cleanup->deleteFunction(cleanup->data);
+    }
+
+    ArenaBlock *block = arena->blocks;
+    while (block != NULL) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+
+    free(arena);
+
+}
+
+void *arenaAlloc(GPXArena *arena, size_t size) {
+
+    if (arena == NULL) {
+        return NULL;
+    }
+
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+    ArenaBlock *block = arena->blocks;
+    if (block != NULL && block->size - block->used >= size) {
+        void *ptr = block->data + block->used;
+        block->used += size;
+        return ptr;
+    }
+
+    // Allocations that would waste most of a block get a block of their own, kept behind the current one
+    if (size > arena->nextBlockSize / 4 && block != NULL) {
+
+        ArenaBlock *bigBlock = newBlock(size);
+        if (bigBlock == NULL) {
+            return NULL;
+        }
+
+        bigBlock->used = size;
+        bigBlock->next = block->next;
+        block->next = bigBlock;
+
+        return bigBlock->data;
+
+    }
+
+    size_t blockSize = arena->nextBlockSize;
+    while (blockSize < size) {
+        blockSize *= 2;
+    }
+
+    ArenaBlock *fresh = newBlock(blockSize);
+    if (fresh == NULL) {
+        return NULL;
+    }
+
+    fresh->next = arena->blocks;
+    arena->blocks = fresh;
+
+    if (arena->nextBlockSize < ARENA_MAX_BLOCK_SIZE) {
+        arena->nextBlockSize *= 2;
+    }
+
+    fresh->used = size;
+
+    return fresh->data;
+
+}
+
+void *arenaAllocNode(void *context, size_t size) {
+
+    return arenaAlloc((GPXArena *)context, size);
+
+}
+
+char *arenaCopyString(GPXArena *arena, const char *str) {
+
+    size_t length = strlen(str) + 1;
+
+    char *copy = arenaAlloc(arena, length);
+    if (copy != NULL) {
+        memcpy(copy, str, length);
+    }
+
+    return copy;
+
+}
+
+bool arenaOwns(const GPXArena *arena, const void *ptr) {
+
+    if (arena == NULL || ptr == NULL) {
+        return false;
+    }
+
+    uintptr_t address = (uintptr_t)ptr;
+
+    for (const ArenaBlock *block = arena->blocks; block != NULL; block = block->next) {
+        uintptr_t start = (uintptr_t)block->data;
+        if (address >= start && address < start + block->size) {
+            return true;
+        }
+    }
+
+    return false;
+
+}
+
+ArenaCleanup *arenaAdopt(GPXArena *arena, void *data, void (*deleteFunction)(void *data)) {
+
+    if (arena == NULL || data == NULL || deleteFunction == NULL || arenaOwns(arena, data)) {
+        return NULL;
+    }
+
+    // The record of an object released earlier is reused, so caches rebuilt over and over do not grow the arena
+    ArenaCleanup *cleanup = arena->freeCleanups;
+    if (cleanup != NULL) {
+        arena->freeCleanups = cleanup->next;
+    } else {
+        cleanup = arenaAlloc(arena, sizeof(ArenaCleanup));
+        if (cleanup == NULL) {
+            return NULL;
+        }
+    }
+
+    cleanup->data = data;
+    cleanup->deleteFunction = deleteFunction;
+    cleanup->prev = NULL;
+    cleanup->next = arena->cleanups;
+
+    if (arena->cleanups != NULL) {
+        arena->cleanups->prev = cleanup;
+    }
+    arena->cleanups = cleanup;
+
+    return cleanup;
+
+}
+
+void arenaReleaseCleanup(GPXArena *arena, ArenaCleanup *cleanup) {
+
+    if (arena == NULL || cleanup == NULL) {
+        return;
+    }
+
+    if (cleanup->prev != NULL) {
+        cleanup->prev->next = cleanup->next;
+    } else {
+        arena->cleanups = cleanup->next;
+    }
+
+    if (cleanup->next != NULL) {
+        cleanup->next->prev = cleanup->prev;
+    }
+
+    // The record itself is arena memory, so it goes on the free list for the next adopt
+    cleanup->data = NULL;
+    cleanup->prev = NULL;
+    cleanup->next = arena->freeCleanups;
+    arena->freeCleanups = cleanup;
+
+}
+
+void arenaRelease(GPXArena *arena, void *data) {
+
+    if (arena == NULL || data == NULL) {
+        return;
+    }
+
+    for (ArenaCleanup *cleanup = arena->cleanups; cleanup != NULL; cleanup = cleanup->next) {
+        if (cleanup->data == data) {
+            arenaReleaseCleanup(arena, cleanup);
+            return;
+        }
+    }
+
+}
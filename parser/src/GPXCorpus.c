@@ -0,0 +1,766 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "GPXCorpus.h" // Included necessary header
+#include "GPXHelpers.h"
+#include "GPXIndex.h"
+#include "GPXLengthIndex.h"
+
+// What the corpus keeps of one file
+typedef struct {
+    // Name inside the directory, and the modification time and size it had when it was parsed
+    char *fileName;
+    struct timespec mtime;
+    off_t size;
+
+    // Invalid files are remembered too, so they are not parsed again until they change
+    bool valid;
+
+    // JSON and length of every route and track, by position in the file
+    int routeCount;
+    char **routeJSON;
+    float *routeLengths;
+    int trackCount;
+    char **trackJSON;
+    float *trackLengths;
+
+    // End points of the paths that have any, the ids are the positions in the file
+    int routeEntryCount;
+    EndpointEntry *routeEntries;
+    int trackEntryCount;
+    EndpointEntry *trackEntries;
+
+    // Ids of its first route and first track in the merged indexes, set by mergeCorpus
+    int routeBase;
+    int trackBase;
+} CorpusFile;
+
+// The directory and schema the corpus was loaded with
+static char *corpusDirName = NULL;
+static char *corpusSchemaFile = NULL;
+
+// Every .gpx file in the directory, sorted by name
+static CorpusFile *corpusFiles = NULL;
+static int corpusFileCount = 0;
+
+// End points of all files merged into one index per path type. The ids number the paths of all files in order,
+// and index the JSON tables, which point into the files
+static EndpointIndex *corpusRoutes = NULL;
+static EndpointIndex *corpusTracks = NULL;
+static LengthIndex *corpusRouteLengths = NULL;
+static LengthIndex *corpusTrackLengths = NULL;
+static char **corpusRouteJSON = NULL;
+static char **corpusTrackJSON = NULL;
+
+// Queries only read the corpus and share the lock, loading and freeing it take the lock on their own
+static pthread_rwlock_t corpusLock = PTHREAD_RWLOCK_INITIALIZER;
+
+static void freeCorpusFile(CorpusFile *file) {
+
+    for (int i = 0; i < file->routeCount; i++) {
+        free(file->routeJSON[i]);
+    }
+    for (int i = 0; i < file->trackCount; i++) {
+        free(file->trackJSON[i]);
+    }
+
+    free(file->fileName);
+    free(file->routeJSON);
+    free(file->trackJSON);
+    free(file->routeLengths);
+    free(file->trackLengths);
+    free(file->routeEntries);
+    free(file->trackEntries);
+
+}
+
+static void freeMergedIndex(void) {
+
+    deleteEndpointIndex(corpusRoutes);
+    deleteEndpointIndex(corpusTracks);
+    deleteLengthIndex(corpusRouteLengths);
+    deleteLengthIndex(corpusTrackLengths);
+    free(corpusRouteJSON);
+    free(corpusTrackJSON);
+
+    corpusRoutes = NULL;
+    corpusTracks = NULL;
+    corpusRouteLengths = NULL;
+    corpusTrackLengths = NULL;
+    corpusRouteJSON = NULL;
+    corpusTrackJSON = NULL;
+
+}
+
+// Parse and validate a file and keep the JSON, lengths and end points of its paths. Returns false if malloc fails
+static bool loadCorpusFile(CorpusFile *file, const char *path, const char *schemaFile) {
+
+    GPXdoc *doc = createValidGPXdoc((char *)path, (char *)schemaFile);
+
+    file->valid = doc != NULL;
+    if (doc == NULL) {
+        return true;
+    }
+
+    int routeCount = getLength(doc->routes);
+    int trackCount = getLength(doc->tracks);
+
+    file->routeJSON = calloc(routeCount > 0 ? routeCount : 1, sizeof(char *));
+    file->trackJSON = calloc(trackCount > 0 ? trackCount : 1, sizeof(char *));
+    file->routeLengths = malloc(sizeof(float) * (routeCount > 0 ? routeCount : 1));
+    file->trackLengths = malloc(sizeof(float) * (trackCount > 0 ? trackCount : 1));
+    file->routeEntries = malloc(sizeof(EndpointEntry) * (routeCount > 0 ? routeCount : 1));
+    file->trackEntries = malloc(sizeof(EndpointEntry) * (trackCount > 0 ? trackCount : 1));
+
+    if (file->routeJSON == NULL || file->trackJSON == NULL || file->routeLengths == NULL || file->trackLengths == NULL
+        || file->routeEntries == NULL || file->trackEntries == NULL) {
+        deleteGPXdoc(doc);
+        return false;
+    }
+
+    void *elem;
+    ListIterator routeIter = createIterator(doc->routes);
+
+    while ((elem = nextElement(&routeIter)) != NULL) {
+
+        Route *tmpRte = (Route *)elem;
+
+        // Same JSON as routeListToJSON writes for each route
+        StringBuilder sb;
+        initStringBuilder(&sb, 128);
+        appendRouteJSON(&sb, tmpRte);
+        file->routeJSON[file->routeCount] = finishStringBuilder(&sb);
+        file->routeLengths[file->routeCount] = getRouteLen(tmpRte);
+
+        EndpointEntry *entry = &file->routeEntries[file->routeEntryCount];
+        if (setRouteEntry(entry, tmpRte)) {
+            entry->id = file->routeCount;
+            file->routeEntryCount++;
+        }
+
+        file->routeCount++;
+
+    }
+
+    ListIterator trackIter = createIterator(doc->tracks);
+
+    while ((elem = nextElement(&trackIter)) != NULL) {
+
+        Track *tmpTrk = (Track *)elem;
+
+        StringBuilder sb;
+        initStringBuilder(&sb, 128);
+        appendNewTrackJSON(&sb, tmpTrk);
+        file->trackJSON[file->trackCount] = finishStringBuilder(&sb);
+        file->trackLengths[file->trackCount] = getTrackLen(tmpTrk);
+
+        EndpointEntry *entry = &file->trackEntries[file->trackEntryCount];
+        if (setTrackEntry(entry, tmpTrk)) {
+            entry->id = file->trackCount;
+            file->trackEntryCount++;
+        }
+
+        file->trackCount++;
+
+    }
+
+    deleteGPXdoc(doc);
+
+    return true;
+
+}
+
+static int compareFileNames(const void *first, const void *second) {
+
+    return strcmp(*(char * const *)first, *(char * const *)second);
+
+}
+
+int listGPXFiles(const char *dirName, char ***names) {
+
+    DIR *dir = opendir(dirName);
+    if (dir == NULL) {
+        return -1;
+    }
+
+    int count = 0;
+    int capacity = 16;
+    *names = malloc(sizeof(char *) * capacity);
+
+    bool outOfMemory = *names == NULL;
+
+    struct dirent *entry;
+    while (!outOfMemory && (entry = readdir(dir)) != NULL) {
+
+        size_t length = strlen(entry->d_name);
+        if (length <= 4 || strcmp(entry->d_name + length - 4, ".gpx") != 0) {
+            continue;
+        }
+
+        if (count == capacity) {
+            capacity *= 2;
+            char **newNames = realloc(*names, sizeof(char *) * capacity);
+            if (newNames == NULL) {
+                outOfMemory = true;
+                break;
+            }
+            *names = newNames;
+        }
+
+        (*names)[count] = malloc(length + 1);
+        if ((*names)[count] == NULL) {
+            outOfMemory = true;
+            break;
+        }
+
+        strcpy((*names)[count], entry->d_name);
+        count++;
+
+    }
+
+    closedir(dir);
+
+    // A partial list would drop the files that were not listed from the corpus, so it is not returned
+    if (outOfMemory) {
+        for (int i = 0; i < count; i++) {
+            free((*names)[i]);
+        }
+        free(*names);
+        *names = NULL;
+        return -1;
+    }
+
+    qsort(*names, count, sizeof(char *), &compareFileNames);
+
+    return count;
+
+}
+
+// Find a file of the current corpus by name, NULL if it is not in it
+static CorpusFile *findCorpusFile(const char *fileName) {
+
+    int low = 0;
+    int high = corpusFileCount;
+
+    while (low < high) {
+
+        int middle = low + (high - low) / 2;
+        int cmp = strcmp(corpusFiles[middle].fileName, fileName);
+
+        if (cmp == 0) {
+            return &corpusFiles[middle];
+        } else if (cmp < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+
+    }
+
+    return NULL;
+
+}
+
+// Merge the end points and lengths of all valid files into the corpus indexes, numbering the paths in file order
+static bool mergeCorpus(void) {
+
+    freeMergedIndex();
+
+    int routeCount = 0, trackCount = 0, routeEntryCount = 0, trackEntryCount = 0;
+    for (int i = 0; i < corpusFileCount; i++) {
+        routeCount += corpusFiles[i].routeCount;
+        trackCount += corpusFiles[i].trackCount;
+        routeEntryCount += corpusFiles[i].routeEntryCount;
+        trackEntryCount += corpusFiles[i].trackEntryCount;
+    }
+
+    corpusRouteJSON = malloc(sizeof(char *) * (routeCount > 0 ? routeCount : 1));
+    corpusTrackJSON = malloc(sizeof(char *) * (trackCount > 0 ? trackCount : 1));
+    EndpointEntry *routeEntries = malloc(sizeof(EndpointEntry) * (routeEntryCount > 0 ? routeEntryCount : 1));
+    EndpointEntry *trackEntries = malloc(sizeof(EndpointEntry) * (trackEntryCount > 0 ? trackEntryCount : 1));
+    LengthEntry *routeLengths = malloc(sizeof(LengthEntry) * (routeCount > 0 ? routeCount : 1));
+    LengthEntry *trackLengths = malloc(sizeof(LengthEntry) * (trackCount > 0 ? trackCount : 1));
+
+    if (corpusRouteJSON != NULL && corpusTrackJSON != NULL && routeEntries != NULL && trackEntries != NULL
+        && routeLengths != NULL && trackLengths != NULL) {
+
+        int routeBase = 0, trackBase = 0, routeEntry = 0, trackEntry = 0;
+
+        for (int i = 0; i < corpusFileCount; i++) {
+
+            CorpusFile *file = &corpusFiles[i];
+            file->routeBase = routeBase;
+            file->trackBase = trackBase;
+
+            if (!file->valid) {
+                continue;
+            }
+
+            memcpy(corpusRouteJSON + routeBase, file->routeJSON, sizeof(char *) * file->routeCount);
+            memcpy(corpusTrackJSON + trackBase, file->trackJSON, sizeof(char *) * file->trackCount);
+
+            // The ids in a file are positions in it, so they are shifted past the paths of the files before it
+            for (int j = 0; j < file->routeEntryCount; j++) {
+                routeEntries[routeEntry] = file->routeEntries[j];
+                routeEntries[routeEntry++].id += routeBase;
+            }
+            for (int j = 0; j < file->trackEntryCount; j++) {
+                trackEntries[trackEntry] = file->trackEntries[j];
+                trackEntries[trackEntry++].id += trackBase;
+            }
+
+            for (int j = 0; j < file->routeCount; j++) {
+                routeLengths[routeBase + j] = (LengthEntry){file->routeLengths[j], routeBase + j};
+            }
+            for (int j = 0; j < file->trackCount; j++) {
+                trackLengths[trackBase + j] = (LengthEntry){file->trackLengths[j], trackBase + j};
+            }
+
+            routeBase += file->routeCount;
+            trackBase += file->trackCount;
+
+        }
+
+        corpusRoutes = createEndpointIndex(routeEntries, routeEntryCount);
+        corpusTracks = createEndpointIndex(trackEntries, trackEntryCount);
+        corpusRouteLengths = createLengthIndex(routeLengths, routeBase);
+        corpusTrackLengths = createLengthIndex(trackLengths, trackBase);
+
+    }
+
+    free(routeEntries);
+    free(trackEntries);
+    free(routeLengths);
+    free(trackLengths);
+
+    if (corpusRoutes == NULL || corpusTracks == NULL || corpusRouteLengths == NULL || corpusTrackLengths == NULL) {
+        freeMergedIndex();
+        return false;
+    }
+
+    return true;
+
+}
+
+// Free everything in the corpus, with the lock held by the caller
+static void freeCorpusFiles(void) {
+
+    freeMergedIndex();
+
+    for (int i = 0; i < corpusFileCount; i++) {
+        freeCorpusFile(&corpusFiles[i]);
+    }
+    free(corpusFiles);
+
+    free(corpusDirName);
+    free(corpusSchemaFile);
+
+    corpusFiles = NULL;
+    corpusFileCount = 0;
+    corpusDirName = NULL;
+    corpusSchemaFile = NULL;
+
+}
+
+// Load the corpus, with the lock held by the caller
+// Give up a load that ran out of memory part way. Files may already have moved from the old corpus to the new one,
+// so both are freed and the next load starts over
+static int abandonLoad(CorpusFile *newFiles, int newCount, char **names, int nameCount) {
+
+    for (int i = 0; i < newCount; i++) {
+        freeCorpusFile(&newFiles[i]);
+    }
+    free(newFiles);
+
+    for (int i = 0; i < nameCount; i++) {
+        free(names[i]);
+    }
+    free(names);
+
+    freeCorpusFiles();
+
+    return -1;
+
+}
+
+static int loadCorpusFiles(char *dirName, char *schemaFile) {
+
+    // A different directory or schema starts a new corpus
+    if (corpusDirName != NULL && (strcmp(corpusDirName, dirName) != 0 || strcmp(corpusSchemaFile, schemaFile) != 0)) {
+        freeCorpusFiles();
+    }
+
+    char **names = NULL;
+    int nameCount = listGPXFiles(dirName, &names);
+    if (nameCount < 0) {
+        return -1;
+    }
+
+    CorpusFile *newFiles = calloc(nameCount > 0 ? nameCount : 1, sizeof(CorpusFile));
+    if (newFiles == NULL) {
+        for (int i = 0; i < nameCount; i++) {
+            free(names[i]);
+        }
+        free(names);
+        return -1;
+    }
+
+    bool changed = corpusRoutes == NULL;
+    int newCount = 0;
+    int validCount = 0;
+
+    for (int i = 0; i < nameCount; i++) {
+
+        char *path = malloc(strlen(dirName) + strlen(names[i]) + 2);
+        if (path == NULL) {
+            return abandonLoad(newFiles, newCount, names, nameCount);
+        }
+
+        sprintf(path, "%s/%s", dirName, names[i]);
+
+        struct stat st;
+        if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+            free(path);
+            free(names[i]);
+            continue;
+        }
+
+        CorpusFile *file = &newFiles[newCount];
+        CorpusFile *oldFile = findCorpusFile(names[i]);
+
+        if (oldFile != NULL && oldFile->size == st.st_size && oldFile->mtime.tv_sec == st.st_mtim.tv_sec
+            && oldFile->mtime.tv_nsec == st.st_mtim.tv_nsec) {
+
+            // Unchanged, so the old data moves over. The old entry keeps its name, so the search still works
+            *file = *oldFile;
+            file->fileName = names[i];
+            names[i] = NULL;
+
+            char *oldName = oldFile->fileName;
+            memset(oldFile, 0, sizeof(CorpusFile));
+            oldFile->fileName = oldName;
+
+        } else {
+
+            file->fileName = names[i];
+            names[i] = NULL;
+            file->mtime = st.st_mtim;
+            file->size = st.st_size;
+
+            if (!loadCorpusFile(file, path, schemaFile)) {
+                freeCorpusFile(file);
+                memset(file, 0, sizeof(CorpusFile));
+                free(path);
+                continue;
+            }
+
+            changed = true;
+
+        }
+
+        free(path);
+
+        if (file->valid) {
+            validCount++;
+        }
+
+        newCount++;
+
+    }
+
+    // Whatever paths are left in the old corpus belong to files that are gone or changed
+    for (int i = 0; i < corpusFileCount; i++) {
+        if (corpusFiles[i].valid) {
+            changed = true;
+        }
+        freeCorpusFile(&corpusFiles[i]);
+    }
+    free(corpusFiles);
+
+    for (int i = 0; i < nameCount; i++) {
+        free(names[i]);
+    }
+    free(names);
+
+    corpusFiles = newFiles;
+    corpusFileCount = newCount;
+
+    if (changed && !mergeCorpus()) {
+        return -1;
+    }
+
+    if (corpusDirName == NULL) {
+
+        corpusDirName = malloc(strlen(dirName) + 1);
+        corpusSchemaFile = malloc(strlen(schemaFile) + 1);
+
+        // Without them the next load could not tell a different directory apart
+        if (corpusDirName == NULL || corpusSchemaFile == NULL) {
+            freeCorpusFiles();
+            return -1;
+        }
+
+        strcpy(corpusDirName, dirName);
+        strcpy(corpusSchemaFile, schemaFile);
+
+    }
+
+    return validCount;
+
+}
+
+int loadCorpus (char *dirName, char *schemaFile) {
+
+    if (dirName == NULL || schemaFile == NULL) {
+        return -1;
+    }
+
+    pthread_rwlock_wrlock(&corpusLock);
+    int validCount = loadCorpusFiles(dirName, schemaFile);
+    pthread_rwlock_unlock(&corpusLock);
+
+    return validCount;
+
+}
+
+// Mark the files of the corpus named in fileNames, one name per line; names not in the corpus are skipped. Returns
+// NULL if fileNames is NULL, which selects every file, or if malloc fails. With the lock held by the caller
+static bool *selectCorpusFiles(const char *fileNames) {
+
+    if (fileNames == NULL) {
+        return NULL;
+    }
+
+    bool *selected = calloc(corpusFileCount > 0 ? corpusFileCount : 1, sizeof(bool));
+    char *names = malloc(strlen(fileNames) + 1);
+
+    if (selected == NULL || names == NULL) {
+        free(selected);
+        free(names);
+        return NULL;
+    }
+
+    strcpy(names, fileNames);
+
+    char *savePtr = NULL;
+    for (char *name = strtok_r(names, "\n", &savePtr); name != NULL; name = strtok_r(NULL, "\n", &savePtr)) {
+        CorpusFile *file = findCorpusFile(name);
+        if (file != NULL) {
+            selected[file - corpusFiles] = true;
+        }
+    }
+
+    free(names);
+
+    return selected;
+
+}
+
+// Check if a path of the merged indexes comes from a selected file. The files hold the ids in order, so its file is
+// the last one whose first id is not past it
+static bool isPathSelected(const bool *selected, bool isRoute, int id) {
+
+    if (selected == NULL) {
+        return true;
+    }
+
+    int low = 0;
+    int high = corpusFileCount - 1;
+
+    while (low < high) {
+
+        int middle = low + (high - low + 1) / 2;
+        int base = isRoute ? corpusFiles[middle].routeBase : corpusFiles[middle].trackBase;
+
+        if (base <= id) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+
+    }
+
+    return selected[low];
+
+}
+
+// Write the JSON of the paths in an index that are between the points, as a JSON array
+static void appendPathsBetween(StringBuilder *sb, const EndpointIndex *index, char **pathJSON, const bool *selected,
+    bool isRoute, float lat1, float lon1, float lat2, float lon2, float delta) {
+
+    appendChar(sb, '[');
+
+    int length = getEndpointIndexLength(index);
+    int *ids = malloc(sizeof(int) * (length > 0 ? length : 1));
+
+    if (ids != NULL) {
+
+        int count = findEndpointsBetween(index, lat1, lon1, lat2, lon2, delta, ids);
+        int written = 0;
+
+        for (int i = 0; i < count; i++) {
+            if (!isPathSelected(selected, isRoute, ids[i])) {
+                continue;
+            }
+            if (written++ > 0) {
+                appendChar(sb, ',');
+            }
+            appendString(sb, pathJSON[ids[i]]);
+        }
+
+        free(ids);
+
+    }
+
+    appendChar(sb, ']');
+
+}
+
+char *getPathsBetweenInCorpus (float lat1, float lon1, float lat2, float lon2, float delta, char *fileNames) {
+
+    StringBuilder sb;
+    initStringBuilder(&sb, 256);
+
+    pthread_rwlock_rdlock(&corpusLock);
+
+    bool *selected = selectCorpusFiles(fileNames);
+
+    if (fileNames != NULL && selected == NULL) {
+        appendString(&sb, "{\"routes\":[],\"tracks\":[]}");
+    } else {
+        appendString(&sb, "{\"routes\":");
+        appendPathsBetween(&sb, corpusRoutes, corpusRouteJSON, selected, true, lat1, lon1, lat2, lon2, delta);
+        appendString(&sb, ",\"tracks\":");
+        appendPathsBetween(&sb, corpusTracks, corpusTrackJSON, selected, false, lat1, lon1, lat2, lon2, delta);
+        appendChar(&sb, '}');
+    }
+
+    pthread_rwlock_unlock(&corpusLock);
+
+    free(selected);
+
+    return finishStringBuilder(&sb);
+
+}
+
+// Count the paths of the selected files in a length index that are within delta of len
+static int countPathsWithLength(const LengthIndex *index, const bool *selected, bool isRoute, float len, float delta) {
+
+    if (selected == NULL) {
+        return countLengthsWithin(index, len, delta);
+    }
+
+    int length = getLengthIndexLength(index);
+    int *ids = malloc(sizeof(int) * (length > 0 ? length : 1));
+    if (ids == NULL) {
+        return 0;
+    }
+
+    int count = findLengthsWithin(index, len, delta, ids);
+    int selectedCount = 0;
+
+    for (int i = 0; i < count; i++) {
+        if (isPathSelected(selected, isRoute, ids[i])) {
+            selectedCount++;
+        }
+    }
+
+    free(ids);
+
+    return selectedCount;
+
+}
+
+// Write the JSON of the paths in a length index that are within delta of len, as a JSON array
+static void appendPathsWithLength(StringBuilder *sb, const LengthIndex *index, char **pathJSON, const bool *selected,
+    bool isRoute, float len, float delta) {
+
+    appendChar(sb, '[');
+
+    int length = getLengthIndexLength(index);
+    int *ids = malloc(sizeof(int) * (length > 0 ? length : 1));
+
+    if (ids != NULL) {
+
+        int count = findLengthsWithin(index, len, delta, ids);
+        int written = 0;
+
+        for (int i = 0; i < count; i++) {
+            if (!isPathSelected(selected, isRoute, ids[i])) {
+                continue;
+            }
+            if (written++ > 0) {
+                appendChar(sb, ',');
+            }
+            appendString(sb, pathJSON[ids[i]]);
+        }
+
+        free(ids);
+
+    }
+
+    appendChar(sb, ']');
+
+}
+
+char *countPathsWithLengthInCorpus (float len, float delta, char *fileNames) {
+
+    StringBuilder sb;
+    initStringBuilder(&sb, 32);
+
+    pthread_rwlock_rdlock(&corpusLock);
+
+    bool *selected = selectCorpusFiles(fileNames);
+
+    if (fileNames != NULL && selected == NULL) {
+        appendString(&sb, "{\"rt\":0,\"tr\":0}");
+    } else {
+        appendFormat(&sb, "{\"rt\":%d,\"tr\":%d}",
+            countPathsWithLength(corpusRouteLengths, selected, true, len, delta),
+            countPathsWithLength(corpusTrackLengths, selected, false, len, delta));
+    }
+
+    pthread_rwlock_unlock(&corpusLock);
+
+    free(selected);
+
+    return finishStringBuilder(&sb);
+
+}
+
+char *getPathsWithLengthInCorpus (float len, float delta, char *fileNames) {
+
+    StringBuilder sb;
+    initStringBuilder(&sb, 256);
+
+    pthread_rwlock_rdlock(&corpusLock);
+
+    bool *selected = selectCorpusFiles(fileNames);
+
+    if (fileNames != NULL && selected == NULL) {
+        appendString(&sb, "{\"routes\":[],\"tracks\":[]}");
+    } else {
+        appendString(&sb, "{\"routes\":");
+        appendPathsWithLength(&sb, corpusRouteLengths, corpusRouteJSON, selected, true, len, delta);
+        appendString(&sb, ",\"tracks\":");
+        appendPathsWithLength(&sb, corpusTrackLengths, corpusTrackJSON, selected, false, len, delta);
+        appendChar(&sb, '}');
+    }
+
+    pthread_rwlock_unlock(&corpusLock);
+
+    free(selected);
+
+    return finishStringBuilder(&sb);
+
+}
+
+void freeCorpus (void) {
+
+    pthread_rwlock_wrlock(&corpusLock);
+    freeCorpusFiles();
+    pthread_rwlock_unlock(&corpusLock);
+
+}
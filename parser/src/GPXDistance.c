@@ -0,0 +1,440 @@
+#include "GPXDistance.h" // Included necessary header
+#include "GPXHelpers.h"
+#include "GPXTaskPool.h"
+
+// Same radius haversine uses, in metres
+#define EARTH_RADIUS 6371e3
+
+// One call to haversineWithCos per pair, used where there are no vector instructions and for the pairs left over
+static void haversineBatchScalar(const double *latitudes, const double *longitudes, const double *cosLatitudes,
+    int length, double *distances) {
+
+    for (int i = 0; i < length - 1; i++) {
+        distances[i] = haversineWithCos(latitudes[i], longitudes[i], cosLatitudes[i],
+            latitudes[i + 1], longitudes[i + 1], cosLatitudes[i + 1]);
+    }
+
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+
+/** The vector code is written once with GCC vector extensions and compiled twice, for AVX2 and for plain x86-64
+ *  (SSE2, where each 4 lane operation becomes two 2 lane ones). Everything it calls is always_inline, so each copy
+ *  is compiled for the instruction set of the function it ends up in. */
+
+typedef double VectorDouble __attribute__((vector_size(32)));
+typedef long long VectorMask __attribute__((vector_size(32)));
+
+#define LANES 4
+#define VECTOR_INLINE static inline __attribute__((always_inline))
+
+// pi/2 split in three parts, the first two with trailing zero bits so multiplying them by the quadrant is exact
+#define PIO2_1 1.57079632673412561417e+00
+#define PIO2_2 6.07710050630396597660e-11
+#define PIO2_3 2.02226624871116645580e-21
+
+// Adding and subtracting 1.5 * 2^52 rounds a double to the nearest integer and leaves it in the low mantissa bits
+#define ROUND_MAGIC 6755399441055744.0
+
+VECTOR_INLINE VectorDouble vectorSelect(VectorMask mask, VectorDouble ifTrue, VectorDouble ifFalse) {
+
+    return (VectorDouble)((mask & (VectorMask)ifTrue) | (~mask & (VectorMask)ifFalse));
+
+}
+
+VECTOR_INLINE VectorDouble broadcast(double x) {
+
+    return (VectorDouble){x, x, x, x};
+
+}
+
+// Flip the sign of the lanes where mask is set
+VECTOR_INLINE VectorDouble negateWhere(VectorMask mask, VectorDouble x) {
+
+    VectorMask signBit = (VectorMask)broadcast(-0.0);
+
+    return (VectorDouble)((VectorMask)x ^ (mask & signBit));
+
+}
+
+// sin of every lane. The angle is reduced to r in [-pi/4, pi/4] plus a quadrant, and sin(r) and cos(r) come from
+// the Cephes minimax polynomials, which are within 1 ulp on that interval
+VECTOR_INLINE VectorDouble vectorSin(VectorDouble x) {
+
+    VectorDouble shifted = x * (2 / M_PI) + ROUND_MAGIC;
+    VectorDouble n = shifted - ROUND_MAGIC;
+    VectorMask quadrant = (VectorMask)shifted & 3;
+
+    VectorDouble r = ((x - n * PIO2_1) - n * PIO2_2) - n * PIO2_3;
+    VectorDouble z = r * r;
+
+    VectorDouble sinPoly = ((((( 1.58962301576546568060e-10 * z
+        - 2.50507477628578072866e-8) * z
+        + 2.75573136213857245213e-6) * z
+        - 1.98412698295895385996e-4) * z
+        + 8.33333333332211858878e-3) * z
+        - 1.66666666666666307295e-1);
+    VectorDouble sinR = r + r * z * sinPoly;
+
+    VectorDouble cosPoly = (((((-1.13585365213876817300e-11 * z
+        + 2.08757008419747316778e-9) * z
+        - 2.75573141792967388112e-7) * z
+        + 2.48015872888517045348e-5) * z
+        - 1.38888888888730564116e-3) * z
+        + 4.16666666666665929218e-2);
+    VectorDouble cosR = 1.0 - 0.5 * z + z * z * cosPoly;
+
+    // In odd quadrants sin(x) is +-cos(r), and quadrants 2 and 3 flip the sign
+    VectorMask odd = (quadrant & 1) != 0;
+
+    return negateWhere((quadrant & 2) != 0, vectorSelect(odd, cosR, sinR));
+
+}
+
+// atan2(y, x) for y, x >= 0 and not both 0. The ratio is reduced to [0, 1] by swapping, then to [-0.21, 0.66] with
+// atan(t) = pi/4 + atan((t - 1) / (t + 1)), where the Cephes rational approximation is within 1 ulp
+VECTOR_INLINE VectorDouble vectorAtan2Positive(VectorDouble y, VectorDouble x) {
+
+    VectorMask swap = y > x;
+    VectorDouble t = vectorSelect(swap, x, y) / vectorSelect(swap, y, x);
+
+    VectorMask big = t > 0.66;
+    VectorDouble base = vectorSelect(big, broadcast(M_PI / 4), broadcast(0.0));
+    t = vectorSelect(big, (t - 1.0) / (t + 1.0), t);
+
+    VectorDouble z = t * t;
+    VectorDouble p = ((((-8.750608600031904122785e-1 * z
+        - 1.615753718733365076637e1) * z
+        - 7.500855792314704667340e1) * z
+        - 1.228866684490136173410e2) * z
+        - 6.485021904942025371773e1);
+    VectorDouble q = (((((z
+        + 2.485846490142306297962e1) * z
+        + 1.650270098316988542046e2) * z
+        + 4.328810604912902668951e2) * z
+        + 4.853903996359136964868e2) * z
+        + 1.945506571482613964425e2);
+
+    VectorDouble angle = base + (t + t * z * p / q);
+
+    return vectorSelect(swap, M_PI / 2 - angle, angle);
+
+}
+
+// The haversine formula for LANES consecutive pairs starting at latitudes[0], same steps as haversine
+VECTOR_INLINE void haversineLanes(const double *latitudes, const double *longitudes, const double *cosLatitudes,
+    double *distances) {
+
+    VectorDouble lat1, lon1, cosLat1, lat2, lon2, cosLat2;
+    memcpy(&lat1, latitudes, sizeof(VectorDouble));
+    memcpy(&lon1, longitudes, sizeof(VectorDouble));
+    memcpy(&cosLat1, cosLatitudes, sizeof(VectorDouble));
+    memcpy(&lat2, latitudes + 1, sizeof(VectorDouble));
+    memcpy(&lon2, longitudes + 1, sizeof(VectorDouble));
+    memcpy(&cosLat2, cosLatitudes + 1, sizeof(VectorDouble));
+
+    VectorDouble deltaLat = (lat2 - lat1) * (M_PI / 180);
+    VectorDouble deltaLon = (lon2 - lon1) * (M_PI / 180);
+
+    VectorDouble sinLat = vectorSin(deltaLat / 2);
+    VectorDouble sinLon = vectorSin(deltaLon / 2);
+
+    VectorDouble a = (sinLat * sinLat) + (cosLat1 * cosLat2 * sinLon * sinLon);
+
+    // Rounding can push a just past 1 for antipodal points, where sqrt(1 - a) would be NaN
+    a = vectorSelect(a > 1.0, broadcast(1.0), a);
+
+    VectorDouble rootA, rootOneMinusA;
+    for (int k = 0; k < LANES; k++) {
+        rootA[k] = sqrt(a[k]);
+        rootOneMinusA[k] = sqrt(1 - a[k]);
+    }
+
+    VectorDouble c = 2 * vectorAtan2Positive(rootA, rootOneMinusA);
+    VectorDouble distance = EARTH_RADIUS * c;
+
+    memcpy(distances, &distance, sizeof(VectorDouble));
+
+}
+
+VECTOR_INLINE void haversineBatchVector(const double *latitudes, const double *longitudes, const double *cosLatitudes,
+    int length, double *distances) {
+
+    // Each step needs LANES + 1 points
+    int i = 0;
+    for (; i + LANES < length; i += LANES) {
+        haversineLanes(latitudes + i, longitudes + i, cosLatitudes + i, distances + i);
+    }
+
+    haversineBatchScalar(latitudes + i, longitudes + i, cosLatitudes + i, length - i, distances + i);
+
+}
+
+__attribute__((target("avx2,fma")))
+static void haversineBatchAVX2(const double *latitudes, const double *longitudes, const double *cosLatitudes,
+    int length, double *distances) {
+
+    haversineBatchVector(latitudes, longitudes, cosLatitudes, length, distances);
+
+}
+
+static void haversineBatchSSE2(const double *latitudes, const double *longitudes, const double *cosLatitudes,
+    int length, double *distances) {
+
+    haversineBatchVector(latitudes, longitudes, cosLatitudes, length, distances);
+
+}
+
+static void (*selectedBatch)(const double *, const double *, const double *, int, double *) = &haversineBatchSSE2;
+static const char *selectedName = "sse2";
+
+// Pick the widest code path the CPU supports, once, when the library is loaded
+__attribute__((constructor))
+static void selectDistanceKernel(void) {
+
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        selectedBatch = &haversineBatchAVX2;
+        selectedName = "avx2";
+    }
+
+}
+
+bool setDistanceKernel(const char *name) {
+
+    if (name == NULL) {
+        return false;
+    }
+
+    __builtin_cpu_init();
+
+    // The names are kept as literals, name may not outlive the call
+    if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        selectedBatch = &haversineBatchAVX2;
+        selectedName = "avx2";
+    } else if (strcmp(name, "sse2") == 0) {
+        selectedBatch = &haversineBatchSSE2;
+        selectedName = "sse2";
+    } else if (strcmp(name, "scalar") == 0) {
+        selectedBatch = &haversineBatchScalar;
+        selectedName = "scalar";
+    } else {
+        return false;
+    }
+
+    return true;
+
+}
+
+#else
+
+static void (*selectedBatch)(const double *, const double *, const double *, int, double *) = &haversineBatchScalar;
+static const char *selectedName = "scalar";
+
+bool setDistanceKernel(const char *name) {
+
+    return name != NULL && strcmp(name, "scalar") == 0;
+
+}
+
+#endif
+
+void haversineBatch(const double *latitudes, const double *longitudes, const double *cosLatitudes, int length,
+    double *distances) {
+
+    if (latitudes == NULL || longitudes == NULL || cosLatitudes == NULL || distances == NULL || length < 2) {
+        return;
+    }
+
+    selectedBatch(latitudes, longitudes, cosLatitudes, length, distances);
+
+}
+
+const char *getDistanceKernelName(void) {
+
+    return selectedName;
+
+}
+
+float getPathLength(const double *latitudes, const double *longitudes, const double *cosLatitudes, int length) {
+
+    float total = 0.0;
+
+    if (length < 2) {
+        return total;
+    }
+
+    // The distances are computed a block at a time, then accumulated in a float one step at a time, same as
+    // getTotalWaypointsLen
+    double distances[256];
+
+    for (int start = 0; start < length - 1; start += 256) {
+
+        int count = length - 1 - start;
+        if (count > 256) {
+            count = 256;
+        }
+
+        haversineBatch(latitudes + start, longitudes + start, cosLatitudes + start, count + 1, distances);
+
+        for (int i = 0; i < count; i++) {
+            total += distances[i];
+        }
+
+    }
+
+    return total;
+
+}
+
+// Pairs of points per chunk in getPathLengths. A multiple of the block getPathLength passes to haversineBatch, so
+// every pair takes the same vector or scalar path it takes there
+#define PATH_CHUNK_PAIRS (256 * 64)
+
+// Fewest pairs in all paths together before getPathLengths uses the task pool
+#define PARALLEL_MIN_PAIRS (4 * PATH_CHUNK_PAIRS)
+
+// A run of at most PATH_CHUNK_PAIRS pairs of one path, and where its distances go
+typedef struct {
+    const PathPoints *path;
+    int firstPoint;
+    int pairCount;
+    double *distances;
+} PathChunk;
+
+static void computeChunks(void *arg, int begin, int end) {
+
+    const PathChunk *chunks = (const PathChunk *)arg;
+
+    for (int i = begin; i < end; i++) {
+        const PathChunk *chunk = &chunks[i];
+        const PathPoints *path = chunk->path;
+        haversineBatch(path->latitudes + chunk->firstPoint, path->longitudes + chunk->firstPoint,
+            path->cosLatitudes + chunk->firstPoint, chunk->pairCount + 1, chunk->distances);
+    }
+
+}
+
+void getPathLengths(const PathPoints *paths, int count, float *lengths) {
+
+    if (paths == NULL || lengths == NULL || count <= 0) {
+        return;
+    }
+
+    long totalPairs = 0;
+    long chunkCount = 0;
+    for (int i = 0; i < count; i++) {
+        if (paths[i].length > 1) {
+            totalPairs += paths[i].length - 1;
+            chunkCount += (paths[i].length - 2) / PATH_CHUNK_PAIRS + 1;
+        }
+    }
+
+    double *distances = NULL;
+    PathChunk *chunks = NULL;
+
+    if (totalPairs >= PARALLEL_MIN_PAIRS && getTaskPoolThreadCount() > 1) {
+        distances = malloc(totalPairs * sizeof(double));
+        chunks = malloc(chunkCount * sizeof(PathChunk));
+    }
+
+    // Small inputs, one core, or no memory: one path after the other on this thread
+    if (distances == NULL || chunks == NULL) {
+
+        free(distances);
+        free(chunks);
+
+        for (int i = 0; i < count; i++) {
+            lengths[i] = getPathLength(paths[i].latitudes, paths[i].longitudes, paths[i].cosLatitudes, paths[i].length);
+        }
+
+        return;
+
+    }
+
+    // The distances of every path go one after the other in one buffer
+    int nextChunk = 0;
+    double *nextDistance = distances;
+
+    for (int i = 0; i < count; i++) {
+        for (int start = 0; start < paths[i].length - 1; start += PATH_CHUNK_PAIRS) {
+
+            int pairCount = paths[i].length - 1 - start;
+            if (pairCount > PATH_CHUNK_PAIRS) {
+                pairCount = PATH_CHUNK_PAIRS;
+            }
+
+            chunks[nextChunk] = (PathChunk){&paths[i], start, pairCount, nextDistance};
+            nextChunk++;
+            nextDistance += pairCount;
+
+        }
+    }
+
+    parallelFor(chunkCount, 1, &computeChunks, chunks);
+
+    // The sums stay on this thread, in point order, same as getPathLength
+    nextDistance = distances;
+
+    for (int i = 0; i < count; i++) {
+
+        float total = 0.0;
+
+        for (int j = 0; j < paths[i].length - 1; j++) {
+            total += nextDistance[j];
+        }
+
+        if (paths[i].length > 1) {
+            nextDistance += paths[i].length - 1;
+        }
+
+        lengths[i] = total;
+
+    }
+
+    free(chunks);
+    free(distances);
+
+}
+
+float getJoinedPathLength(const PathPoints *paths, int count) {
+
+    float total = 0.0;
+
+    if (paths == NULL || count <= 0) {
+        return total;
+    }
+
+    float stackLengths[16];
+    float *lengths = stackLengths;
+    if (count > 16) {
+        lengths = malloc(sizeof(float) * count);
+        if (lengths == NULL) {
+            return total;
+        }
+    }
+
+    getPathLengths(paths, count, lengths);
+
+    for (int i = 0; i < count; i++) {
+
+        total += lengths[i];
+
+        // The gap from the end of the previous path to the start of this one
+        if (i > 0) {
+            const PathPoints *previous = &paths[i - 1];
+            int last = previous->length - 1;
+            total += haversineWithCos(previous->latitudes[last], previous->longitudes[last], previous->cosLatitudes[last],
+                paths[i].latitudes[0], paths[i].longitudes[0], paths[i].cosLatitudes[0]);
+        }
+
+    }
+
+    if (lengths != stackLengths) {
+        free(lengths);
+    }
+
+    return total;
+
+}
@@ -0,0 +1,424 @@
+#include <pthread.h>
+#include "GPXHandles.h" // Included necessary header
+#include "GPXHelpers.h"
+
+// A resident document and the file it was opened from
+typedef struct {
+    GPXdoc *doc;
+    char *fileName;
+
+    // Held for the whole of every call on the handle, a GPXdoc must not be used by two threads at once
+    pthread_mutex_t lock;
+
+    // Calls that have looked the slot up and not released it yet, and whether the handle was closed. Both are
+    // guarded by the table lock; a closed slot is freed by the last call that releases it
+    int users;
+    bool closed;
+} HandleSlot;
+
+// Table of open documents, handle n lives in slot n - 1. Each slot is allocated on its own, so a slot in use stays
+// where it is when the table grows
+static HandleSlot **handleTable = NULL;
+static int handleTableSize = 0;
+static pthread_mutex_t handleTableLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Give back a slot returned by acquireHandle
+static void releaseHandle(HandleSlot *slot) {
+
+    pthread_mutex_unlock(&slot->lock);
+
+    pthread_mutex_lock(&handleTableLock);
+    slot->users--;
+    bool unused = slot->closed && slot->users == 0;
+    pthread_mutex_unlock(&handleTableLock);
+
+    if (unused) {
+        pthread_mutex_destroy(&slot->lock);
+        free(slot);
+    }
+
+}
+
+// Get the slot for a handle and lock it for the caller, NULL if the handle is not open.
+// Every slot returned must be given back with releaseHandle
+static HandleSlot *acquireHandle(int handle) {
+
+    pthread_mutex_lock(&handleTableLock);
+
+    HandleSlot *slot = NULL;
+    if (handle >= 1 && handle <= handleTableSize) {
+        slot = handleTable[handle - 1];
+    }
+
+    if (slot != NULL) {
+        slot->users++;
+    }
+
+    pthread_mutex_unlock(&handleTableLock);
+
+    if (slot == NULL) {
+        return NULL;
+    }
+
+    // Wait for any other call on the same handle. It may have closed the handle in the meantime
+    pthread_mutex_lock(&slot->lock);
+
+    if (slot->doc == NULL) {
+        releaseHandle(slot);
+        return NULL;
+    }
+
+    return slot;
+
+}
+
+// Return a newly allocated "{}" for calls made on handles that are not open
+static char *emptyJSONObject(void) {
+
+    char *retString = malloc(3);
+    strcpy(retString, "{}");
+
+    return retString;
+
+}
+
+// Parse, validate and keep a document resident
+int gpxOpen (char *gpxFile, char *schemaFile) {
+
+    if (gpxFile == NULL || schemaFile == NULL) {
+        return 0;
+    }
+
+    GPXdoc *doc = createValidGPXdoc(gpxFile, schemaFile);
+    if (doc == NULL) {
+        return 0;
+    }
+
+    HandleSlot *newSlot = malloc(sizeof(HandleSlot));
+    char *fileName = malloc(strlen(gpxFile) + 1);
+    if (newSlot == NULL || fileName == NULL) {
+        free(newSlot);
+        free(fileName);
+        deleteGPXdoc(doc);
+        return 0;
+    }
+
+    strcpy(fileName, gpxFile);
+    newSlot->doc = doc;
+    newSlot->fileName = fileName;
+    pthread_mutex_init(&newSlot->lock, NULL);
+    newSlot->users = 0;
+    newSlot->closed = false;
+
+    pthread_mutex_lock(&handleTableLock);
+
+    // Reuse the first free slot, otherwise grow the table
+    int i;
+    for (i = 0; i < handleTableSize; i++) {
+        if (handleTable[i] == NULL) {
+            break;
+        }
+    }
+
+    if (i == handleTableSize) {
+
+        int newSize = handleTableSize == 0 ? 16 : handleTableSize * 2;
+        HandleSlot **newTable = realloc(handleTable, newSize * sizeof(HandleSlot *));
+        if (newTable == NULL) {
+            pthread_mutex_unlock(&handleTableLock);
+            pthread_mutex_destroy(&newSlot->lock);
+            free(newSlot);
+            free(fileName);
+            deleteGPXdoc(doc);
+            return 0;
+        }
+
+        memset(newTable + handleTableSize, 0, (newSize - handleTableSize) * sizeof(HandleSlot *));
+        handleTable = newTable;
+        handleTableSize = newSize;
+
+    }
+
+    handleTable[i] = newSlot;
+
+    pthread_mutex_unlock(&handleTableLock);
+
+    return i + 1;
+
+}
+
+// Free a resident document
+int gpxClose (int handle) {
+
+    HandleSlot *slot = acquireHandle(handle);
+    if (slot == NULL) {
+        return 0;
+    }
+
+    // Take the handle out of the table first, so no new call can find it
+    pthread_mutex_lock(&handleTableLock);
+    handleTable[handle - 1] = NULL;
+    slot->closed = true;
+    pthread_mutex_unlock(&handleTableLock);
+
+    // Calls already waiting for the slot see that the doc is gone
+    deleteGPXdoc(slot->doc);
+    free(slot->fileName);
+    slot->doc = NULL;
+    slot->fileName = NULL;
+
+    releaseHandle(slot);
+
+    return 1;
+
+}
+
+// Write a resident document back to its file
+int gpxSave (int handle) {
+
+    HandleSlot *slot = acquireHandle(handle);
+    if (slot == NULL) {
+        return 0;
+    }
+
+    int saved = writeGPXdoc(slot->doc, slot->fileName) ? 1 : 0;
+
+    releaseHandle(slot);
+
+    return saved;
+
+}
+
+GPXdoc *getHandleDoc (int handle) {
+
+    HandleSlot *slot = acquireHandle(handle);
+    if (slot == NULL) {
+        return NULL;
+    }
+
+    GPXdoc *doc = slot->doc;
+
+    releaseHandle(slot);
+
+    return doc;
+
+}
+
+char *gpxGetGPXData (int handle) {
+
+    HandleSlot *slot = acquireHandle(handle);
+    if (slot == NULL) {
+        return emptyJSONObject();
+    }
+
+    char *retString = GPXtoJSON(slot->doc);
+
+    releaseHandle(slot);
+
+    return retString;
+
+}
+
+char *gpxGetRoutesAndTracks (int handle) {
+
+    HandleSlot *slot = acquireHandle(handle);
+    if (slot == NULL) {
+        return emptyJSONObject();
+    }
+
+    char *retString = routesAndTracksToJSON(slot->doc);
+
+    releaseHandle(slot);
+
+    return retString;
+
+}
+
+char *gpxGetOtherData (int handle, int type, int index) {
+
+    HandleSlot *slot = acquireHandle(handle);
+    if (slot == NULL) {
+        char *retString = malloc(3);
+        strcpy(retString, "[]");
+        return retString;
+    }
+
+    char *retString = otherDataToJSON(slot->doc, type, index);
+
+    releaseHandle(slot);
+
+    return retString;
+
+}
+
+int gpxRenamePath (int handle, int type, int index, char *newName) {
+
+    HandleSlot *slot = acquireHandle(handle);
+    if (slot == NULL) {
+        return 0;
+    }
+
+    int renamed = renamePath(slot->doc, type, index, newName);
+
+    releaseHandle(slot);
+
+    return renamed;
+
+}
+
+int gpxRemovePath (int handle, int type, int index) {
+
+    HandleSlot *slot = acquireHandle(handle);
+    if (slot == NULL) {
+        return 0;
+    }
+
+    int removed = removePath(slot->doc, type, index);
+
+    releaseHandle(slot);
+
+    return removed;
+
+}
+
+int gpxAddRoute (int handle, char *routeNameJSON) {
+
+    if (routeNameJSON == NULL) {
+        return 0;
+    }
+
+    // Without a new route the caller's waypoints would go to whatever route is last in the file
+    Route *tmpRte = JSONtoRoute(routeNameJSON);
+    if (tmpRte == NULL) {
+        return 0;
+    }
+
+    HandleSlot *slot = acquireHandle(handle);
+    if (slot == NULL) {
+        deleteRoute(tmpRte);
+        return 0;
+    }
+
+    addRoute(slot->doc, tmpRte);
+
+    releaseHandle(slot);
+
+    return 1;
+
+}
+
+int gpxAddWaypointToLastRoute (int handle, char *waypointJSON) {
+
+    if (waypointJSON == NULL) {
+        return 0;
+    }
+
+    HandleSlot *slot = acquireHandle(handle);
+    if (slot == NULL) {
+        return 0;
+    }
+
+    // It will always be the latest route that was added
+    Route *tmpRoute = getFromBack(slot->doc->routes);
+    Waypoint *tmpWpt = tmpRoute != NULL ? JSONtoWaypoint(waypointJSON) : NULL;
+    if (tmpWpt != NULL) {
+        addWaypoint(tmpRoute, tmpWpt);
+    }
+
+    releaseHandle(slot);
+
+    return tmpWpt != NULL ? 1 : 0;
+
+}
+
+char *gpxGetRoutesBetween (int handle, float lat1, float lon1, float lat2, float lon2, float delta) {
+
+    HandleSlot *slot = acquireHandle(handle);
+    if (slot == NULL) {
+        return emptyJSONObject();
+    }
+
+    char *retString = routesBetweenToJSON(slot->doc, lat1, lon1, lat2, lon2, delta);
+
+    releaseHandle(slot);
+
+    return retString;
+
+}
+
+char *gpxGetTracksBetween (int handle, float lat1, float lon1, float lat2, float lon2, float delta) {
+
+    HandleSlot *slot = acquireHandle(handle);
+    if (slot == NULL) {
+        return emptyJSONObject();
+    }
+
+    char *retString = tracksBetweenToJSON(slot->doc, lat1, lon1, lat2, lon2, delta);
+
+    releaseHandle(slot);
+
+    return retString;
+
+}
+
+char *gpxGetPathsWithLength (int handle, float length) {
+
+    HandleSlot *slot = acquireHandle(handle);
+    if (slot == NULL) {
+        return emptyJSONObject();
+    }
+
+    char *retString = pathsWithLengthToJSON(slot->doc, length);
+
+    releaseHandle(slot);
+
+    return retString;
+
+}
+
+char *gpxGetRouteWaypoints (int handle, int index) {
+
+    HandleSlot *slot = acquireHandle(handle);
+    if (slot == NULL) {
+        return emptyJSONObject();
+    }
+
+    char *retString = routeWaypointsToJSON(slot->doc, index);
+
+    releaseHandle(slot);
+
+    return retString;
+
+}
+
+char *gpxGetLastRoute (int handle) {
+
+    HandleSlot *slot = acquireHandle(handle);
+    if (slot == NULL) {
+        return emptyJSONObject();
+    }
+
+    char *retString = routeToJSON(getFromBack(slot->doc->routes));
+
+    releaseHandle(slot);
+
+    return retString;
+
+}
+
+char *gpxGetRoutesWithWaypoints (int handle) {
+
+    HandleSlot *slot = acquireHandle(handle);
+    if (slot == NULL) {
+        char *retString = malloc(3);
+        strcpy(retString, "[]");
+        return retString;
+    }
+
+    char *retString = routesWithWaypointsToJSON(slot->doc);
+
+    releaseHandle(slot);
+
+    return retString;
+
+}
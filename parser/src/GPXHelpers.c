@@ -1,4 +1,6 @@
 #include "GPXHelpers.h" // Included necessary header
+#include "GPXWaypointArray.h"
+#include "GPXDistance.h"
 
 // Function to insert a waypoint or similar into a given list
 void insertWaypoints(xmlNode *cur_node, Waypoint *tmpWpt, List *listToInsertInto) {
@@ -11,6 +13,9 @@ void insertWaypoints(xmlNode *cur_node, Waypoint *tmpWpt, List *listToInsertInto
         return;
     }
 
+    // Points are allocated from the same arena as the list they go into, if it has one
+    GPXArena *arena = getListArena(listToInsertInto);
+
     // Iterate through the children until NULL is hit
     for (tmpIter = cur_node->children; tmpIter != NULL; tmpIter = tmpIter->next) {
 
@@ -20,10 +25,8 @@ void insertWaypoints(xmlNode *cur_node, Waypoint *tmpWpt, List *listToInsertInto
             // Variable to store the content
             char *content = (char *)xmlNodeGetContent(tmpIter);
             
-            // Malloc enough space for waypoint->name and then copy the name
-            int length = strlen(content) + 1;
-            tmpWpt->name = malloc(length);
-            strcpy(tmpWpt->name, content);
+            // Copy the name into the waypoint
+            tmpWpt->name = copyString(arena, content);
 
             // Free to avoid leaks
             xmlFree(content);
@@ -36,15 +39,8 @@ void insertWaypoints(xmlNode *cur_node, Waypoint *tmpWpt, List *listToInsertInto
             // If neither name nor value is empty
             if (tmpIter->name[0] != '\0' && !isspace(tmpIter->name[0]) && tmpIter->children && content[0] != '\0') {
 
-                // Malloc enough space for the GPXData element
-                GPXData *tmpData = malloc(sizeof(GPXData) + strlen(content) + 1);
-
-                // Copying name and value
-                strcpy(tmpData->name, (const char *)tmpIter->name);
-                strcpy(tmpData->value, content);
-
-                // Inserting into the otherData list of the waypoint
-                insertBack(tmpWpt->otherData, tmpData);
+                // Copying name and value into a new GPXData element, and inserting it into the otherData list of the waypoint
+                insertBack(tmpWpt->otherData, newGPXData(arena, (const char *)tmpIter->name, content));
 
             }
 
@@ -85,16 +81,18 @@ void insertWaypoints(xmlNode *cur_node, Waypoint *tmpWpt, List *listToInsertInto
         }
     }
 
-    // If lat or lon are not attributes, waypoint is invalid, so delete the waypoint and return 
+    // If lat or lon are not attributes, waypoint is invalid, so delete the waypoint and return. Arena memory is
+    // just left behind and freed with the arena
     if (lat_count == 0 || lon_count == 0) {
-        deleteWaypoint(tmpWpt);
+        if (arena == NULL) {
+            deleteWaypoint(tmpWpt);
+        }
         return;
     }
 
     // If name was not copied, because it had no name, assign an empty string
     if (tmpWpt->name == NULL) {
-        tmpWpt->name = malloc(1);
-        tmpWpt->name[0] = '\0';
+        tmpWpt->name = copyString(arena, "");
     }
 
     // Insert waypoint into the given list
@@ -108,6 +106,9 @@ void recursiveReader(xmlNode *a_node, GPXdoc *docToEdit) {
     // Initialize iterator
     xmlNode *cur_node = NULL;
 
+    // Everything read into the doc is allocated from its arena
+    GPXArena *arena = docToEdit->arena;
+
     // Loop through all nodes until NULL is hit
     for (cur_node = a_node; cur_node != NULL; cur_node = cur_node->next) {
 
@@ -117,29 +118,16 @@ void recursiveReader(xmlNode *a_node, GPXdoc *docToEdit) {
             // If the tag is wpt
             if (strcmp((const char *)cur_node->name, "wpt") == 0) {
 
-                // Malloc space for a new Waypoint
-                Waypoint *tmpWpt = malloc(sizeof(Waypoint));
-
-                // Name starts off as NULL for checking inside the function
-                tmpWpt->name = NULL;
-
-                // Initialize list in case of any otherData, cannot be NULL
-                tmpWpt->otherData = initializeList(&gpxDataToString, &deleteGpxData, &compareGpxData);
+                // Create a new Waypoint, its name starts off as NULL for checking inside insertWaypoints
+                Waypoint *tmpWpt = newWaypoint(arena);
 
                 // Call insertWaypoints function to read waypoint from cur_node and add to the list if it is valid
                 insertWaypoints(cur_node, tmpWpt, docToEdit->waypoints);
 
             } else if (strcmp((const char *)cur_node->name, "rte") == 0) { // If the tag is rte
 
-                // Malloc space for a new Route
-                Route *tmpRte = malloc(sizeof(Route));
-
-                // Name starts off as NULL for checking inside the function
-                tmpRte->name = NULL;
-
-                // Initialize lists in case of any waypoints/otherData, cannot be NULL
-                tmpRte->waypoints = initializeList(&waypointToString, &deleteWaypoint, &compareWaypoints);
-                tmpRte->otherData = initializeList(&gpxDataToString, &deleteGpxData, &compareGpxData);
+                // Create a new Route, with a NULL name and empty lists for any waypoints/otherData
+                Route *tmpRte = newRoute(arena);
 
                 // Declare iterator
                 xmlNode *tmpIter;
@@ -153,10 +141,8 @@ void recursiveReader(xmlNode *a_node, GPXdoc *docToEdit) {
                         // Variable to store the content
                         char *content = (char *)xmlNodeGetContent(tmpIter);
 
-                        // Malloc enough space for the name and copy it
-                        int length = strlen(content) + 1;
-                        tmpRte->name = malloc(length);
-                        strcpy(tmpRte->name, content);
+                        // Copy the name
+                        tmpRte->name = copyString(arena, content);
 
                         // Free to avoid leaks
                         xmlFree(content);
@@ -164,9 +150,7 @@ void recursiveReader(xmlNode *a_node, GPXdoc *docToEdit) {
                     } else if (strcmp((const char *)tmpIter->name, "rtept") == 0 ) { // If the rtept tag is found
                         
                         // Same process as adding a Waypoint, just with a different list
-                        Waypoint *newWpt = malloc(sizeof(Waypoint));
-                        newWpt->name = NULL;
-                        newWpt->otherData = initializeList(&gpxDataToString, &deleteGpxData, &compareGpxData);
+                        Waypoint *newWpt = newWaypoint(arena);
 
                         // Call insertWaypoints function to read waypoint from tmpIter and add to the list if it is valid
                         insertWaypoints(tmpIter, newWpt, tmpRte->waypoints);
@@ -177,12 +161,7 @@ void recursiveReader(xmlNode *a_node, GPXdoc *docToEdit) {
                         // Same process as previous otherData
                         char *content = (char *)xmlNodeGetContent(tmpIter);
 
-                        GPXData *tmpData = malloc(sizeof(GPXData) + strlen(content) + 1);
-
-                        strcpy(tmpData->name, (const char *)tmpIter->name);
-                        strcpy(tmpData->value, content);
-
-                        insertBack(tmpRte->otherData, tmpData);
+                        insertBack(tmpRte->otherData, newGPXData(arena, (const char *)tmpIter->name, content));
 
                         xmlFree(content);
                     }
@@ -191,24 +170,16 @@ void recursiveReader(xmlNode *a_node, GPXdoc *docToEdit) {
                 // Same check at the end of the insertWaypoints function
                 // if the name is NULL, then assign it an empty string
                 if (tmpRte->name == NULL) {
-                    tmpRte->name = malloc(1);
-                    tmpRte->name[0] = '\0';
+                    tmpRte->name = copyString(arena, "");
                 }
 
                 // Insert new Route into GPXdoc's routes list
-                insertBack(docToEdit->routes, tmpRte);
+                insertRoute(docToEdit, tmpRte);
 
             } else if (strcmp((const char *)cur_node->name, "trk") == 0) { // If the tag is trk
 
-                // Malloc space for a new Track
-                Track *tmpTrk = malloc(sizeof(Track));
-
-                // Name starts off as NULL for checking inside the function
-                tmpTrk->name = NULL;
-
-                // Initialize lists in case of any segments/otherData, cannot be NULL
-                tmpTrk->segments = initializeList(&trackSegmentToString, &deleteTrackSegment, &compareTrackSegments);
-                tmpTrk->otherData = initializeList(&gpxDataToString, &deleteGpxData, &compareGpxData);
+                // Create a new Track, with a NULL name and empty lists for any segments/otherData
+                Track *tmpTrk = newTrack(arena);
 
                 // Declare iterator
                 xmlNode *tmpIter;
@@ -222,21 +193,16 @@ void recursiveReader(xmlNode *a_node, GPXdoc *docToEdit) {
                         // Variable to store the content
                         char *content = (char *)xmlNodeGetContent(tmpIter);
 
-                        // Malloc enough space for the name and copy it
-                        int length = strlen(content) + 1;
-                        tmpTrk->name = malloc(length);
-                        strcpy(tmpTrk->name, content);
+                        // Copy the name
+                        tmpTrk->name = copyString(arena, content);
 
                         // Free to avoid leaks
                         xmlFree(content);
 
                     } else if (strcmp((const char *)tmpIter->name, "trkseg") == 0 ) { // If the trkseg tag is found
 
-                        // Malloc space for a new TrackSegment
-                        TrackSegment *tmpTrkSeg = malloc(sizeof(TrackSegment));
-
-                        // Initialize the waypoints list, cannot be NULL
-                        tmpTrkSeg->waypoints = initializeList(&waypointToString, &deleteWaypoint, &compareWaypoints);
+                        // Create a new TrackSegment with an empty waypoints list
+                        TrackSegment *tmpTrkSeg = newTrackSegment(arena);
 
                         // Declare Iterator
                         xmlNode *newIter;
@@ -247,10 +213,8 @@ void recursiveReader(xmlNode *a_node, GPXdoc *docToEdit) {
                             // If a trkpt is found
                             if (strcmp((const char *)newIter->name, "trkpt") == 0 ) {
 
-                                // Malloc space for a new waypoint and initialize other variables
-                                Waypoint *newWpt = malloc(sizeof(Waypoint));
-                                newWpt->name = NULL;
-                                newWpt->otherData = initializeList(&gpxDataToString, &deleteGpxData, &compareGpxData);
+                                // Create a new waypoint
+                                Waypoint *newWpt = newWaypoint(arena);
 
                                 // Call insertWaypoints function to read waypoint from newIter and add to the list if it is valid
                                 insertWaypoints(newIter, newWpt, tmpTrkSeg->waypoints);
@@ -267,15 +231,17 @@ void recursiveReader(xmlNode *a_node, GPXdoc *docToEdit) {
                         
                         // Same process as previous otherData
                         char *content = (char *)xmlNodeGetContent(tmpIter);
-                        GPXData *tmpData = malloc(sizeof(GPXData) + strlen(content) + 1);
-                        strcpy(tmpData->name, (const char *)tmpIter->name);
-                        strcpy(tmpData->value, content);
-                        insertBack(tmpTrk->otherData, tmpData);
+                        insertBack(tmpTrk->otherData, newGPXData(arena, (const char *)tmpIter->name, content));
                         xmlFree(content);
 
                     }
 
                 }
+
+                // Same as the route, a track without a name gets an empty string
+                if (tmpTrk->name == NULL) {
+                    tmpTrk->name = copyString(arena, "");
+                }
                 
                 // Insert new Track into GPXdoc's tracks list
                 insertBack(docToEdit->tracks, tmpTrk);
@@ -291,248 +257,6 @@ void recursiveReader(xmlNode *a_node, GPXdoc *docToEdit) {
 
 }
 
-// Add GPXdata to XML tree
-int addGPXDataChildren(List *otherData, xmlNode *parentNode) {
-
-    void *data;
-    List *otherDataList = otherData;
-    ListIterator otherDataIter = createIterator(otherDataList);
-
-    while ((data = nextElement(&otherDataIter)) != NULL) {
-
-        GPXData *tmpData = (GPXData *)data;
-
-        if (tmpData->name[0] == '\0' || tmpData->value[0] == '\0') {
-            return -1;
-        }
-        xmlNewChild(parentNode, NULL, BAD_CAST tmpData->name, BAD_CAST tmpData->value);
-
-    }
-
-    return 0;
-
-}
-
-// Add waypoints to XML tree
-int addWaypointChildren(List *waypoints, xmlNode *parentNode, char *type) {
-
-    // Iterate through the waypoints list
-    void *elem;
-    List *waypointList = waypoints;
-    ListIterator waypointIter = createIterator(waypointList);
-
-	while ((elem = nextElement(&waypointIter)) != NULL) {
-
-        char buffer[256];
-
-        // Cast to Waypoint
-        Waypoint *tmpWpt = (Waypoint *)elem;
-
-        xmlNode *waypointNode = xmlNewChild(parentNode, NULL, BAD_CAST type, NULL);
-
-        // Error checking
-        if ((tmpWpt->latitude > 90 || tmpWpt->latitude < -90) || (tmpWpt->longitude > 180 || tmpWpt->longitude < -180)) {
-            return -1;
-        }
-
-        // Add latitude and longitude as properties to the new node
-        sprintf(buffer, "%f", tmpWpt->latitude);
-        xmlNewProp(waypointNode, BAD_CAST "lat", BAD_CAST buffer);
-        sprintf(buffer, "%f", tmpWpt->longitude);
-        xmlNewProp(waypointNode, BAD_CAST "lon", BAD_CAST buffer);
-
-        // Invalid waypoint
-        if (tmpWpt->name == NULL) {
-            return -1;
-        }
-        // If no name, value is NULL
-        if (tmpWpt->name[0] != '\0') {
-            xmlNewChild(waypointNode, NULL, BAD_CAST "name", BAD_CAST tmpWpt->name);
-        }
-
-        // Try and add other data
-        int childAdded = addGPXDataChildren(tmpWpt->otherData, waypointNode);
-
-        if (childAdded != 0) {
-            return -1;
-        }
-
-	}
-    
-    return 0;
-
-}
-
-// Add routes to XML tree
-int addRouteChildren(List *routes, xmlNode *parentNode) {
-
-    void *elem;
-    List *routeList = routes;
-    ListIterator routeIter = createIterator(routeList);
-
-	while ((elem = nextElement(&routeIter)) != NULL) {
-
-        // Cast to Waypoint
-        Route *tmpRte = (Route *)elem;
-
-        xmlNode *routeNode = xmlNewChild(parentNode, NULL, BAD_CAST "rte", NULL);
-
-        if (tmpRte->name == NULL) {
-            return -1;
-        }
-        if (tmpRte->name[0] != '\0') {
-        xmlNewChild(routeNode, NULL, BAD_CAST "name", BAD_CAST tmpRte->name);
-        }
-
-        // Try and add other data
-        int childAdded = addGPXDataChildren(tmpRte->otherData, routeNode);
-        if (childAdded != 0) {
-            return -1;
-        }
-
-        // Try and add the route points
-        int rteptsAdded = addWaypointChildren(tmpRte->waypoints, routeNode, "rtept");
-        if (rteptsAdded != 0) {
-            return -1;
-        }
-
-	}
-    
-    return 0;
-
-}
-
-// Add track seg to XML tree
-int addTrackSegChildren(List *trackSegs, xmlNode *parentNode) {
-
-    void *elem;
-    List *trackSegList = trackSegs;
-    ListIterator trackSegIter = createIterator(trackSegList);
-
-    while((elem = nextElement(&trackSegIter)) != NULL) {
-
-        TrackSegment *tmpTrkSeg = (TrackSegment *)elem;
-
-        xmlNode *trackSegmentNode = xmlNewChild(parentNode, NULL, BAD_CAST "trkseg", NULL);
-
-        // Try and add wayppoints list to tree
-        int tracksAdded = addWaypointChildren(tmpTrkSeg->waypoints, trackSegmentNode, "trkpt");
-        if (tracksAdded != 0) {
-            return -1;
-        }
-
-    }
-
-    return 0;
-
-}
-
-// Add track to XML tree
-int addTrackChildren(List *tracks, xmlNode *parentNode) {
-
-    void *elem;
-    List *trackList = tracks;
-    ListIterator trackIter = createIterator(trackList);
-
-	while ((elem = nextElement(&trackIter)) != NULL) {
-
-        // Cast to Waypoint
-        Track *tmpTrk = (Track *)elem;
-
-        xmlNode *trackNode = xmlNewChild(parentNode, NULL, BAD_CAST "trk", NULL);
-
-        if (tmpTrk->name == NULL) {
-            return -1;
-        }
-        if (tmpTrk->name[0] != '\0') {
-            xmlNewChild(trackNode, NULL, BAD_CAST "name", BAD_CAST tmpTrk->name);
-        }
-
-        // Try and add other data 
-        int childAdded = addGPXDataChildren(tmpTrk->otherData, trackNode);
-        if (childAdded != 0) {
-            return -1;
-        }
-
-        // Try and add track segs
-        int trksegsAdded = addTrackSegChildren(tmpTrk->segments, trackNode);
-        if (trksegsAdded != 0) {
-            return -1;
-        }
-
-	}
-    
-    return 0;
-
-}
-
-// Convert a GPXdoc struct to XML doc
-xmlDoc *gpxDocToXMLDoc(GPXdoc *docToConvert) {
-
-    if (docToConvert == NULL) {
-        return NULL;
-    }
-
-    xmlDoc *doc = NULL;
-    char buffer[256];
-
-    LIBXML_TEST_VERSION;
-
-    // Set root element of the XML tree as gpx
-    doc = xmlNewDoc(BAD_CAST "1.0");
-    xmlNode *rootNode = xmlNewNode(NULL, BAD_CAST "gpx");
-    xmlDocSetRootElement(doc, rootNode);
-
-    // Set version property on the gpx root element
-    sprintf(buffer, "%g", docToConvert->version);
-    xmlNewProp(rootNode, BAD_CAST "version", BAD_CAST buffer);
-    if (docToConvert->creator == NULL) {
-        xmlFreeDoc(doc);
-        xmlCleanupParser();
-        return NULL;
-    }
-    // Set creator property on the gpx root element
-    xmlNewProp(rootNode, BAD_CAST "creator", BAD_CAST docToConvert->creator);
-    if (docToConvert->namespace == NULL) {
-        xmlFreeDoc(doc);
-        xmlCleanupParser();
-        return NULL;
-    }
-    // Set namespace
-    xmlNs *namespace = xmlNewNs(rootNode, BAD_CAST docToConvert->namespace, NULL);
-    xmlSetNs(rootNode, namespace);
-
-    // Add all the waypoints to gpx root element as children
-    int waypointsAdded = addWaypointChildren(docToConvert->waypoints, rootNode, "wpt");
-    if (waypointsAdded != 0) {
-        xmlFreeDoc(doc);
-        xmlCleanupParser();
-        return NULL;
-    }
-
-    // Add all the routes to gpx root element as children
-    int routesAdded = addRouteChildren(docToConvert->routes, rootNode);
-    if (routesAdded != 0) {
-        xmlFreeDoc(doc);
-        xmlCleanupParser();
-        return NULL;
-    }
-
-    // Add all the tracks to gpx root element as children
-    int tracksAdded = addTrackChildren(docToConvert->tracks, rootNode);
-    if (tracksAdded != 0) {
-        xmlFreeDoc(doc);
-        xmlCleanupParser();
-        return NULL;
-    }
-
-    // Cleanup any variables used by XML functions
-    xmlCleanupParser();
-
-    return doc;
-
-}
-
 // Check if list of GPX Data is valid
 int checkGPXData(List *otherData) {
 
@@ -676,15 +400,22 @@ int checkTracks(List *tracks) {
 // Function implementing haversine formula
 double haversine(double lat1, double lon1, double lat2, double lon2) {
 
-    const int radius =  6371e3;
-
     double lat1InRadians = lat1 * (M_PI/180);
     double lat2InRadians = lat2 * (M_PI/180);
 
+    return haversineWithCos(lat1, lon1, cos(lat1InRadians), lat2, lon2, cos(lat2InRadians));
+
+}
+
+// Haversine formula with the cosines of the latitudes already computed, gives exactly the same result as haversine
+double haversineWithCos(double lat1, double lon1, double cosLat1, double lat2, double lon2, double cosLat2) {
+
+    const int radius =  6371e3;
+
     double deltaLat = (lat2 - lat1) * (M_PI/180);
     double deltaLon = (lon2 - lon1) * (M_PI/180);
 
-    double a = (sin(deltaLat/2) * sin(deltaLat/2)) + (cos(lat1InRadians) * cos(lat2InRadians) * sin(deltaLon/2) * sin(deltaLon/2));
+    double a = (sin(deltaLat/2) * sin(deltaLat/2)) + (cosLat1 * cosLat2 * sin(deltaLon/2) * sin(deltaLon/2));
 
     double c = 2 * atan2(sqrt(a), sqrt(1-a));
 
@@ -743,32 +474,43 @@ float getTotalTrackSegLen(List *trackSegs) {
         return total;
     }
 
+    // The points of the segments, on the stack for the usual handful of segments
+    PathPoints stackPaths[16];
+    PathPoints *paths = stackPaths;
+
+    int segCount = getLength(trackSegs);
+    if (segCount > 16) {
+        paths = malloc(sizeof(PathPoints) * segCount);
+        if (paths == NULL) {
+            return total;
+        }
+    }
+
     void *elem;
     List *trackSegList = trackSegs;
     ListIterator trackSegIter = createIterator(trackSegList);
 
-    double tmpLat1, tmpLon1, tmpLat2, tmpLon2;
-
-    int i = 0;
+    int pathCount = 0;
     while((elem = nextElement(&trackSegIter)) != NULL) {
 
-        TrackSegment *tmpTrkSeg = (TrackSegment *)elem;
-
-        total += getTotalWaypointsLen(tmpTrkSeg->waypoints);
+        // The packed points of the segment, so the loop reads plain arrays instead of walking the list
+        const WaypointArray *points = getSegmentPoints((TrackSegment *)elem);
 
-        if (i > 0) {
-            Waypoint *tmpWpt2 = getFromFront(tmpTrkSeg->waypoints);
-            tmpLat2 = tmpWpt2->latitude;
-            tmpLon2 = tmpWpt2->longitude;
-            total += haversine(tmpLat1, tmpLon1, tmpLat2, tmpLon2);
+        // An empty segment has no ends to join, so it is skipped
+        if (points == NULL || points->length == 0) {
+            continue;
         }
 
-        Waypoint *tmpWpt = getFromBack(tmpTrkSeg->waypoints);
-        tmpLat1 = tmpWpt->latitude;
-        tmpLon1 = tmpWpt->longitude;
+        paths[pathCount] = (PathPoints){points->latitudes, points->longitudes, points->cosLatitudes, points->length};
+        pathCount++;
 
-        i++;
+    }
+
+    // A very long track has its segments, and the chunks of each segment, measured on several cores
+    total = getJoinedPathLength(paths, pathCount);
 
+    if (paths != stackPaths) {
+        free(paths);
     }
 
     return total;
@@ -777,3 +519,149 @@ float getTotalTrackSegLen(List *trackSegs) {
 
 // Dummy delete function that does nothing, for use in getRoutesBetween/getTracksBetween
 void dummyDelete(void* data) {}
+
+// Get the arena a list allocates from, NULL for a normal heap list
+GPXArena *getListArena(const List *list) {
+
+    if (list == NULL || list->allocNode != &arenaAllocNode) {
+        return NULL;
+    }
+
+    return (GPXArena *)list->allocContext;
+
+}
+
+// Allocate from the arena, or with malloc if there is none
+void *allocFromArena(GPXArena *arena, size_t size) {
+
+    if (arena == NULL) {
+        return malloc(size);
+    }
+
+    return arenaAlloc(arena, size);
+
+}
+
+// Copy a string into the arena, or with malloc if there is none
+char *copyString(GPXArena *arena, const char *str) {
+
+    if (arena == NULL) {
+        char *copy = malloc(strlen(str) + 1);
+        strcpy(copy, str);
+        return copy;
+    }
+
+    return arenaCopyString(arena, str);
+
+}
+
+// Create a list for a GPX object. An arena list never deletes its data, the arena owns all of it
+List *newModelList(GPXArena *arena, char *(*printFunction)(void *toBePrinted), void (*deleteFunction)(void *toBeDeleted),
+    int (*compareFunction)(const void *first, const void *second)) {
+
+    if (arena == NULL) {
+        return initializeList(printFunction, deleteFunction, compareFunction);
+    }
+
+    return initializeListWithAllocator(printFunction, &dummyDelete, compareFunction, &arenaAllocNode, arena);
+
+}
+
+GPXdoc *newGPXdoc(GPXArena *arena) {
+
+    GPXdoc *newDoc = allocFromArena(arena, sizeof(GPXdoc));
+    if (newDoc == NULL) {
+        return NULL;
+    }
+
+    newDoc->namespace[0] = '\0';
+    newDoc->version = 0;
+    newDoc->creator = NULL;
+    newDoc->arena = arena;
+    newDoc->index = NULL;
+    newDoc->names = NULL;
+    newDoc->generation = 0;
+
+    // Initialize all the lists in the struct, because they can't be NULL
+    newDoc->waypoints = newModelList(arena, &waypointToString, &deleteWaypoint, &compareWaypoints);
+    newDoc->routes = newModelList(arena, &routeToString, &deleteRoute, &compareRoutes);
+    newDoc->tracks = newModelList(arena, &trackToString, &deleteTrack, &compareTracks);
+
+    return newDoc;
+
+}
+
+Waypoint *newWaypoint(GPXArena *arena) {
+
+    Waypoint *tmpWpt = allocFromArena(arena, sizeof(Waypoint));
+
+    // Name starts off as NULL for checking inside insertWaypoints
+    tmpWpt->name = NULL;
+    tmpWpt->latitude = 0;
+    tmpWpt->longitude = 0;
+
+    // Initialize list in case of any otherData, cannot be NULL
+    tmpWpt->otherData = newModelList(arena, &gpxDataToString, &deleteGpxData, &compareGpxData);
+
+    return tmpWpt;
+
+}
+
+Route *newRoute(GPXArena *arena) {
+
+    Route *tmpRte = allocFromArena(arena, sizeof(Route));
+
+    tmpRte->name = NULL;
+    tmpRte->waypoints = newModelList(arena, &waypointToString, &deleteWaypoint, &compareWaypoints);
+    tmpRte->otherData = newModelList(arena, &gpxDataToString, &deleteGpxData, &compareGpxData);
+    tmpRte->points = NULL;
+    tmpRte->metrics = NULL;
+    tmpRte->generation = 0;
+    tmpRte->docGeneration = NULL;
+
+    return tmpRte;
+
+}
+
+void insertRoute(GPXdoc *doc, Route *rt) {
+
+    insertBack(doc->routes, rt);
+    rt->docGeneration = &doc->generation;
+
+}
+
+TrackSegment *newTrackSegment(GPXArena *arena) {
+
+    TrackSegment *tmpTrkSeg = allocFromArena(arena, sizeof(TrackSegment));
+
+    tmpTrkSeg->waypoints = newModelList(arena, &waypointToString, &deleteWaypoint, &compareWaypoints);
+    tmpTrkSeg->points = NULL;
+
+    return tmpTrkSeg;
+
+}
+
+Track *newTrack(GPXArena *arena) {
+
+    Track *tmpTrk = allocFromArena(arena, sizeof(Track));
+
+    tmpTrk->name = NULL;
+    tmpTrk->segments = newModelList(arena, &trackSegmentToString, &deleteTrackSegment, &compareTrackSegments);
+    tmpTrk->otherData = newModelList(arena, &gpxDataToString, &deleteGpxData, &compareGpxData);
+    tmpTrk->metrics = NULL;
+
+    return tmpTrk;
+
+}
+
+GPXData *newGPXData(GPXArena *arena, const char *name, const char *value) {
+
+    // The value is stored in the flexible array at the end of the struct
+    GPXData *tmpData = allocFromArena(arena, sizeof(GPXData) + strlen(value) + 1);
+
+    strcpy(tmpData->name, name);
+    strcpy(tmpData->value, value);
+
+    return tmpData;
+
+}
@@ -0,0 +1,984 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "GPXImage.h" // Included necessary header
+#include "GPXHelpers.h"
+
+#define IMAGE_BYTE_ORDER 0x01020304u
+
+// Files modified more recently than this many seconds are not cached, see saveCachedGPXdoc
+#define IMAGE_MIN_AGE 2
+
+// Distinct strings of an image being written, interned with an open addressing table of offsets into the blob
+typedef struct {
+    char *blob;
+    size_t size;
+    size_t capacity;
+
+    // Offset + 1 of the string in each slot, 0 for an empty slot. At most half full
+    uint32_t *slots;
+    size_t slotCount;
+    size_t used;
+} StringTable;
+
+// Counts of everything in the image of a doc
+typedef struct {
+    uint32_t waypointCount;
+    uint32_t routeCount;
+    uint32_t trackCount;
+    uint32_t segmentCount;
+    uint32_t pointCount;
+    uint32_t dataCount;
+} ImageCounts;
+
+static unsigned int hashString(const char *str) {
+
+    // FNV-1a, same as the names of a WaypointArray
+    unsigned int hash = 2166136261u;
+    for (; *str != '\0'; str++) {
+        hash = (hash ^ (unsigned char)*str) * 16777619u;
+    }
+
+    return hash;
+
+}
+
+static bool initStringTable(StringTable *table) {
+
+    table->capacity = 4096;
+    table->blob = malloc(table->capacity);
+    table->slotCount = 1024;
+    table->slots = calloc(table->slotCount, sizeof(uint32_t));
+    table->used = 0;
+
+    if (table->blob == NULL || table->slots == NULL) {
+        free(table->blob);
+        free(table->slots);
+        return false;
+    }
+
+    // Offset 0 is the empty string, which is never put in the table
+    table->blob[0] = '\0';
+    table->size = 1;
+
+    return true;
+
+}
+
+static void freeStringTable(StringTable *table) {
+
+    free(table->blob);
+    free(table->slots);
+
+}
+
+// Double the table and put every string back in it
+static bool growSlots(StringTable *table) {
+
+    size_t slotCount = table->slotCount * 2;
+    uint32_t *slots = calloc(slotCount, sizeof(uint32_t));
+    if (slots == NULL) {
+        return false;
+    }
+
+    for (size_t i = 0; i < table->slotCount; i++) {
+
+        if (table->slots[i] == 0) {
+            continue;
+        }
+
+        size_t slot = hashString(table->blob + table->slots[i] - 1) & (slotCount - 1);
+        while (slots[slot] != 0) {
+            slot = (slot + 1) & (slotCount - 1);
+        }
+        slots[slot] = table->slots[i];
+
+    }
+
+    free(table->slots);
+    table->slots = slots;
+    table->slotCount = slotCount;
+
+    return true;
+
+}
+
+// Get the offset of a string in the blob, adding it if it is not there yet. Returns UINT32_MAX on failure
+static uint32_t internString(StringTable *table, const char *str) {
+
+    if (str == NULL || str[0] == '\0') {
+        return 0;
+    }
+
+    if (table->used * 2 >= table->slotCount && !growSlots(table)) {
+        return UINT32_MAX;
+    }
+
+    size_t slot = hashString(str) & (table->slotCount - 1);
+
+    while (table->slots[slot] != 0) {
+        if (strcmp(table->blob + table->slots[slot] - 1, str) == 0) {
+            return table->slots[slot] - 1;
+        }
+        slot = (slot + 1) & (table->slotCount - 1);
+    }
+
+    size_t length = strlen(str) + 1;
+
+    // Offsets are 32 bit, and one more than the offset is kept in the slots
+    if (table->size + length >= UINT32_MAX) {
+        return UINT32_MAX;
+    }
+
+    if (table->size + length > table->capacity) {
+
+        size_t capacity = table->capacity;
+        while (capacity < table->size + length) {
+            capacity *= 2;
+        }
+
+        char *blob = realloc(table->blob, capacity);
+        if (blob == NULL) {
+            return UINT32_MAX;
+        }
+        table->blob = blob;
+        table->capacity = capacity;
+
+    }
+
+    uint32_t offset = table->size;
+    memcpy(table->blob + offset, str, length);
+    table->size += length;
+
+    table->slots[slot] = offset + 1;
+    table->used++;
+
+    return offset;
+
+}
+
+char *getImageFileName(const char *fileName) {
+
+    if (fileName == NULL) {
+        return NULL;
+    }
+
+    const char *slash = strrchr(fileName, '/');
+    size_t dirLength = slash != NULL ? slash - fileName + 1 : 0;
+
+    char *imageFile = malloc(strlen(fileName) + 7);
+    if (imageFile == NULL) {
+        return NULL;
+    }
+
+    sprintf(imageFile, "%.*s.%s.gpxb", (int)dirLength, fileName, fileName + dirLength);
+
+    return imageFile;
+
+}
+
+bool getImageKey(const char *fileName, const char *schemaFile, GPXImageKey *key) {
+
+    struct stat fileStat;
+    struct stat schemaStat;
+
+    if (fileName == NULL || schemaFile == NULL || stat(fileName, &fileStat) != 0 || stat(schemaFile, &schemaStat) != 0) {
+        return false;
+    }
+
+    memset(key, 0, sizeof(GPXImageKey));
+    key->fileSize = fileStat.st_size;
+    key->fileModifiedSec = fileStat.st_mtim.tv_sec;
+    key->fileModifiedNsec = fileStat.st_mtim.tv_nsec;
+    key->fileInode = fileStat.st_ino;
+    key->schemaSize = schemaStat.st_size;
+    key->schemaModifiedSec = schemaStat.st_mtim.tv_sec;
+    key->schemaModifiedNsec = schemaStat.st_mtim.tv_nsec;
+    key->schemaInode = schemaStat.st_ino;
+
+    return true;
+
+}
+
+static bool sameImageKey(const GPXImageKey *first, const GPXImageKey *second) {
+
+    return first->fileSize == second->fileSize && first->fileModifiedSec == second->fileModifiedSec
+        && first->fileModifiedNsec == second->fileModifiedNsec && first->fileInode == second->fileInode
+        && first->schemaSize == second->schemaSize && first->schemaModifiedSec == second->schemaModifiedSec
+        && first->schemaModifiedNsec == second->schemaModifiedNsec && first->schemaInode == second->schemaInode;
+
+}
+
+// Add up the counts of a list into a 32 bit count, false if it overflows
+static bool addCount(uint32_t *count, int length) {
+
+    if ((uint64_t)*count + length > UINT32_MAX - 1) {
+        return false;
+    }
+
+    *count += length;
+
+    return true;
+
+}
+
+// Count everything a doc's image holds. Returns false if it is too large for 32 bit indexes
+static bool countImage(const GPXdoc *doc, ImageCounts *counts) {
+
+    memset(counts, 0, sizeof(ImageCounts));
+
+    void *elem;
+    ListIterator waypointIter = createIterator(doc->waypoints);
+
+    while ((elem = nextElement(&waypointIter)) != NULL) {
+        if (!addCount(&counts->dataCount, getLength(((Waypoint *)elem)->otherData))) {
+            return false;
+        }
+    }
+
+    counts->waypointCount = getLength(doc->waypoints);
+    counts->pointCount = counts->waypointCount;
+
+    ListIterator routeIter = createIterator(doc->routes);
+
+    while ((elem = nextElement(&routeIter)) != NULL) {
+
+        Route *tmpRte = (Route *)elem;
+
+        if (!addCount(&counts->routeCount, 1) || !addCount(&counts->pointCount, getLength(tmpRte->waypoints))
+            || !addCount(&counts->dataCount, getLength(tmpRte->otherData))) {
+            return false;
+        }
+
+        void *pointElem;
+        ListIterator pointIter = createIterator(tmpRte->waypoints);
+        while ((pointElem = nextElement(&pointIter)) != NULL) {
+            if (!addCount(&counts->dataCount, getLength(((Waypoint *)pointElem)->otherData))) {
+                return false;
+            }
+        }
+
+    }
+
+    ListIterator trackIter = createIterator(doc->tracks);
+
+    while ((elem = nextElement(&trackIter)) != NULL) {
+
+        Track *tmpTrk = (Track *)elem;
+
+        if (!addCount(&counts->trackCount, 1) || !addCount(&counts->segmentCount, getLength(tmpTrk->segments))
+            || !addCount(&counts->dataCount, getLength(tmpTrk->otherData))) {
+            return false;
+        }
+
+        void *segElem;
+        ListIterator segIter = createIterator(tmpTrk->segments);
+
+        while ((segElem = nextElement(&segIter)) != NULL) {
+
+            List *waypoints = ((TrackSegment *)segElem)->waypoints;
+            if (!addCount(&counts->pointCount, getLength(waypoints))) {
+                return false;
+            }
+
+            void *pointElem;
+            ListIterator pointIter = createIterator(waypoints);
+            while ((pointElem = nextElement(&pointIter)) != NULL) {
+                if (!addCount(&counts->dataCount, getLength(((Waypoint *)pointElem)->otherData))) {
+                    return false;
+                }
+            }
+
+        }
+
+    }
+
+    return true;
+
+}
+
+// Round a section size up, so every section starts 8 byte aligned
+static uint64_t alignSection(uint64_t size) {
+
+    return (size + 7) & ~(uint64_t)7;
+
+}
+
+// Set the section offsets of a header from its counts. Returns the size of everything before the strings
+static uint64_t layOutImage(GPXImageHeader *header) {
+
+    uint64_t offset = alignSection(sizeof(GPXImageHeader));
+
+    header->latitudes = offset;
+    offset += alignSection(sizeof(double) * (uint64_t)header->pointCount);
+    header->longitudes = offset;
+    offset += alignSection(sizeof(double) * (uint64_t)header->pointCount);
+    header->cosLatitudes = offset;
+    offset += alignSection(sizeof(double) * (uint64_t)header->pointCount);
+    header->pointNames = offset;
+    offset += alignSection(sizeof(uint32_t) * (uint64_t)header->pointCount);
+    header->pointData = offset;
+    offset += alignSection(sizeof(uint32_t) * ((uint64_t)header->pointCount + 1));
+    header->routes = offset;
+    offset += alignSection(sizeof(GPXImageRoute) * (uint64_t)header->routeCount);
+    header->tracks = offset;
+    offset += alignSection(sizeof(GPXImageTrack) * (uint64_t)header->trackCount);
+    header->segments = offset;
+    offset += alignSection(sizeof(GPXImageSegment) * (uint64_t)header->segmentCount);
+    header->data = offset;
+    offset += alignSection(sizeof(GPXImageData) * (uint64_t)header->dataCount);
+    header->strings = offset;
+
+    return offset;
+
+}
+
+// State of an image being filled in, pointers into the buffer of everything before the strings
+typedef struct {
+    double *latitudes;
+    double *longitudes;
+    double *cosLatitudes;
+    uint32_t *pointNames;
+    uint32_t *pointData;
+    GPXImageData *data;
+    StringTable strings;
+    uint32_t point;
+    uint32_t dataUsed;
+    bool failed;
+} ImageWriter;
+
+static uint32_t writeString(ImageWriter *writer, const char *str) {
+
+    uint32_t offset = internString(&writer->strings, str);
+    if (offset == UINT32_MAX) {
+        writer->failed = true;
+        return 0;
+    }
+
+    return offset;
+
+}
+
+static void writeOtherData(ImageWriter *writer, const List *otherData) {
+
+    void *elem;
+    ListIterator dataIter = createIterator((List *)otherData);
+
+    while ((elem = nextElement(&dataIter)) != NULL) {
+
+        GPXData *tmpData = (GPXData *)elem;
+
+        writer->data[writer->dataUsed].name = writeString(writer, tmpData->name);
+        writer->data[writer->dataUsed].value = writeString(writer, tmpData->value);
+        writer->dataUsed++;
+
+    }
+
+}
+
+// Write the points of a list, with their otherData. Returns the index of the first one
+static uint32_t writePoints(ImageWriter *writer, const List *waypoints) {
+
+    uint32_t first = writer->point;
+
+    void *elem;
+    ListIterator waypointIter = createIterator((List *)waypoints);
+
+    while ((elem = nextElement(&waypointIter)) != NULL) {
+
+        Waypoint *tmpWpt = (Waypoint *)elem;
+        uint32_t i = writer->point++;
+
+        writer->latitudes[i] = tmpWpt->latitude;
+        writer->longitudes[i] = tmpWpt->longitude;
+        writer->cosLatitudes[i] = cos(tmpWpt->latitude * (M_PI/180));
+        writer->pointNames[i] = writeString(writer, tmpWpt->name);
+        writer->pointData[i] = writer->dataUsed;
+
+        writeOtherData(writer, tmpWpt->otherData);
+
+    }
+
+    return first;
+
+}
+
+// Write a buffer to a file descriptor, retrying short writes
+static bool writeAll(int fd, const void *buffer, size_t size) {
+
+    const char *bytes = buffer;
+
+    while (size > 0) {
+
+        ssize_t written = write(fd, bytes, size);
+        if (written <= 0) {
+            return false;
+        }
+
+        bytes += written;
+        size -= written;
+
+    }
+
+    return true;
+
+}
+
+// Build the image of a doc in one malloc'd block. Returns NULL on failure
+static char *buildImage(const GPXdoc *doc, const GPXImageKey *key, size_t *imageSize) {
+
+    ImageCounts countsOfDoc;
+    const ImageCounts *counts = &countsOfDoc;
+    if (!countImage(doc, &countsOfDoc)) {
+        return NULL;
+    }
+
+    GPXImageHeader header;
+    memset(&header, 0, sizeof(GPXImageHeader));
+
+    memcpy(header.magic, GPX_IMAGE_MAGIC, sizeof(header.magic));
+    header.formatVersion = GPX_IMAGE_FORMAT_VERSION;
+    header.byteOrder = IMAGE_BYTE_ORDER;
+    header.key = *key;
+    header.version = doc->version;
+    header.waypointCount = counts->waypointCount;
+    header.routeCount = counts->routeCount;
+    header.trackCount = counts->trackCount;
+    header.segmentCount = counts->segmentCount;
+    header.pointCount = counts->pointCount;
+    header.dataCount = counts->dataCount;
+
+    uint64_t stringsOffset = layOutImage(&header);
+
+    // Everything but the strings, whose size is only known once they are all interned
+    char *buffer = calloc(stringsOffset, 1);
+    if (buffer == NULL) {
+        return NULL;
+    }
+
+    ImageWriter writer;
+    if (!initStringTable(&writer.strings)) {
+        free(buffer);
+        return NULL;
+    }
+
+    writer.latitudes = (double *)(buffer + header.latitudes);
+    writer.longitudes = (double *)(buffer + header.longitudes);
+    writer.cosLatitudes = (double *)(buffer + header.cosLatitudes);
+    writer.pointNames = (uint32_t *)(buffer + header.pointNames);
+    writer.pointData = (uint32_t *)(buffer + header.pointData);
+    writer.data = (GPXImageData *)(buffer + header.data);
+    writer.point = 0;
+    writer.dataUsed = 0;
+    writer.failed = false;
+
+    GPXImageRoute *routes = (GPXImageRoute *)(buffer + header.routes);
+    GPXImageTrack *tracks = (GPXImageTrack *)(buffer + header.tracks);
+    GPXImageSegment *segments = (GPXImageSegment *)(buffer + header.segments);
+
+    header.namespaceName = writeString(&writer, doc->namespace);
+    header.creator = writeString(&writer, doc->creator);
+
+    // All the points first, so the data of each point directly follows the data of the point before it
+    writePoints(&writer, doc->waypoints);
+
+    void *elem;
+    ListIterator routeIter = createIterator(doc->routes);
+
+    uint32_t r = 0;
+    while ((elem = nextElement(&routeIter)) != NULL) {
+
+        Route *tmpRte = (Route *)elem;
+
+        routes[r].name = writeString(&writer, tmpRte->name);
+        routes[r].pointCount = getLength(tmpRte->waypoints);
+        routes[r].firstPoint = writePoints(&writer, tmpRte->waypoints);
+        r++;
+
+    }
+
+    ListIterator trackIter = createIterator(doc->tracks);
+
+    uint32_t t = 0, s = 0;
+    while ((elem = nextElement(&trackIter)) != NULL) {
+
+        Track *tmpTrk = (Track *)elem;
+
+        tracks[t].name = writeString(&writer, tmpTrk->name);
+        tracks[t].firstSegment = s;
+        tracks[t].segmentCount = getLength(tmpTrk->segments);
+
+        void *segElem;
+        ListIterator segIter = createIterator(tmpTrk->segments);
+
+        while ((segElem = nextElement(&segIter)) != NULL) {
+
+            List *waypoints = ((TrackSegment *)segElem)->waypoints;
+
+            segments[s].pointCount = getLength(waypoints);
+            segments[s].firstPoint = writePoints(&writer, waypoints);
+            s++;
+
+        }
+
+        t++;
+
+    }
+
+    writer.pointData[writer.point] = writer.dataUsed;
+
+    // Then the otherData of the paths
+    routeIter = createIterator(doc->routes);
+    for (r = 0; (elem = nextElement(&routeIter)) != NULL; r++) {
+        routes[r].firstData = writer.dataUsed;
+        routes[r].dataCount = getLength(((Route *)elem)->otherData);
+        writeOtherData(&writer, ((Route *)elem)->otherData);
+    }
+
+    trackIter = createIterator(doc->tracks);
+    for (t = 0; (elem = nextElement(&trackIter)) != NULL; t++) {
+        tracks[t].firstData = writer.dataUsed;
+        tracks[t].dataCount = getLength(((Track *)elem)->otherData);
+        writeOtherData(&writer, ((Track *)elem)->otherData);
+    }
+
+    header.stringsSize = writer.strings.size;
+    header.imageSize = stringsOffset + writer.strings.size;
+    memcpy(buffer, &header, sizeof(GPXImageHeader));
+
+    // Then the strings go at the end
+    char *image = writer.failed ? NULL : realloc(buffer, header.imageSize);
+    if (image == NULL) {
+        freeStringTable(&writer.strings);
+        free(buffer);
+        return NULL;
+    }
+
+    memcpy(image + stringsOffset, writer.strings.blob, writer.strings.size);
+    freeStringTable(&writer.strings);
+
+    *imageSize = header.imageSize;
+
+    return image;
+
+}
+
+int writeGPXImage(const GPXdoc *doc, const GPXImageKey *key, const char *imageFile) {
+
+    if (doc == NULL || key == NULL || imageFile == NULL) {
+        return 0;
+    }
+
+    size_t imageSize;
+    char *image = buildImage(doc, key, &imageSize);
+    if (image == NULL) {
+        return 0;
+    }
+
+    // Write to a unique temporary file next to the image, and only rename it into place once it is complete
+    char *tmpFile = malloc(strlen(imageFile) + 8);
+    if (tmpFile == NULL) {
+        free(image);
+        return 0;
+    }
+    sprintf(tmpFile, "%s.XXXXXX", imageFile);
+
+    int fd = mkstemp(tmpFile);
+    if (fd < 0) {
+        free(tmpFile);
+        free(image);
+        return 0;
+    }
+
+    // mkstemp makes the file private to the user, give the image the usual permissions of a data file
+    fchmod(fd, 0644);
+
+    bool written = writeAll(fd, image, imageSize);
+    free(image);
+
+    if (close(fd) != 0) {
+        written = false;
+    }
+
+    if (!written || rename(tmpFile, imageFile) != 0) {
+        unlink(tmpFile);
+        free(tmpFile);
+        return 0;
+    }
+
+    free(tmpFile);
+
+    return 1;
+
+}
+
+// Check that count records of size bytes at offset are inside the image and aligned for their type
+static bool validSection(const GPXImageHeader *header, uint64_t offset, uint64_t count, uint64_t size) {
+
+    return offset % 8 == 0 && offset >= sizeof(GPXImageHeader) && offset <= header->imageSize
+        && count * size <= header->imageSize - offset;
+
+}
+
+// Check that a range of records is inside an array of count records
+static bool validRange(uint32_t first, uint32_t length, uint32_t count) {
+
+    return (uint64_t)first + length <= count;
+
+}
+
+// Check that a string offset points to a string shorter than maxLength
+static bool validString(const GPXImage *image, uint32_t offset, size_t maxLength) {
+
+    if (offset >= image->header->stringsSize) {
+        return false;
+    }
+
+    return maxLength == 0 || strnlen(image->strings + offset, maxLength) < maxLength;
+
+}
+
+// Check the header of an image and that every section of it is inside the image
+static bool verifyHeader(const GPXImageHeader *header, size_t size) {
+
+    if (memcmp(header->magic, GPX_IMAGE_MAGIC, sizeof(header->magic)) != 0
+        || header->formatVersion != GPX_IMAGE_FORMAT_VERSION || header->byteOrder != IMAGE_BYTE_ORDER
+        || header->imageSize != size || header->waypointCount > header->pointCount) {
+        return false;
+    }
+
+    return validSection(header, header->latitudes, header->pointCount, sizeof(double))
+        && validSection(header, header->longitudes, header->pointCount, sizeof(double))
+        && validSection(header, header->cosLatitudes, header->pointCount, sizeof(double))
+        && validSection(header, header->pointNames, header->pointCount, sizeof(uint32_t))
+        && validSection(header, header->pointData, (uint64_t)header->pointCount + 1, sizeof(uint32_t))
+        && validSection(header, header->routes, header->routeCount, sizeof(GPXImageRoute))
+        && validSection(header, header->tracks, header->trackCount, sizeof(GPXImageTrack))
+        && validSection(header, header->segments, header->segmentCount, sizeof(GPXImageSegment))
+        && validSection(header, header->data, header->dataCount, sizeof(GPXImageData))
+        && validSection(header, header->strings, header->stringsSize, 1);
+
+}
+
+// Check every offset, range and string in the sections of an image, so the rest of the code can trust them
+static bool verifyContents(const GPXImage *image) {
+
+    const GPXImageHeader *header = image->header;
+
+    // The string table must end in a null, so no string runs past the image
+    if (header->stringsSize == 0 || image->strings[header->stringsSize - 1] != '\0') {
+        return false;
+    }
+
+    if (!validString(image, header->namespaceName, 256) || !validString(image, header->creator, 0)) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < header->pointCount; i++) {
+        if (!validString(image, image->pointNames[i], 0) || image->pointData[i] > image->pointData[i + 1]) {
+            return false;
+        }
+    }
+
+    if (image->pointData[header->pointCount] > header->dataCount) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < header->routeCount; i++) {
+        const GPXImageRoute *route = &image->routes[i];
+        if (!validString(image, route->name, 0) || !validRange(route->firstPoint, route->pointCount, header->pointCount)
+            || !validRange(route->firstData, route->dataCount, header->dataCount)) {
+            return false;
+        }
+    }
+
+    for (uint32_t i = 0; i < header->trackCount; i++) {
+        const GPXImageTrack *track = &image->tracks[i];
+        if (!validString(image, track->name, 0)
+            || !validRange(track->firstSegment, track->segmentCount, header->segmentCount)
+            || !validRange(track->firstData, track->dataCount, header->dataCount)) {
+            return false;
+        }
+    }
+
+    for (uint32_t i = 0; i < header->segmentCount; i++) {
+        if (!validRange(image->segments[i].firstPoint, image->segments[i].pointCount, header->pointCount)) {
+            return false;
+        }
+    }
+
+    // GPXData names are copied into a 256 byte array
+    for (uint32_t i = 0; i < header->dataCount; i++) {
+        if (!validString(image, image->data[i].name, 256) || !validString(image, image->data[i].value, 0)) {
+            return false;
+        }
+    }
+
+    return true;
+
+}
+
+// Point the section pointers of an image at the offsets in its header
+static void resolveSections(GPXImage *image) {
+
+    const char *bytes = image->base;
+    const GPXImageHeader *header = image->header;
+
+    image->latitudes = (const double *)(bytes + header->latitudes);
+    image->longitudes = (const double *)(bytes + header->longitudes);
+    image->cosLatitudes = (const double *)(bytes + header->cosLatitudes);
+    image->pointNames = (const uint32_t *)(bytes + header->pointNames);
+    image->pointData = (const uint32_t *)(bytes + header->pointData);
+    image->routes = (const GPXImageRoute *)(bytes + header->routes);
+    image->tracks = (const GPXImageTrack *)(bytes + header->tracks);
+    image->segments = (const GPXImageSegment *)(bytes + header->segments);
+    image->data = (const GPXImageData *)(bytes + header->data);
+    image->strings = bytes + header->strings;
+
+}
+
+GPXImage *openGPXImage(const char *imageFile) {
+
+    if (imageFile == NULL) {
+        return NULL;
+    }
+
+    int fd = open(imageFile, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat imageStat;
+    if (fstat(fd, &imageStat) != 0 || imageStat.st_size < (off_t)sizeof(GPXImageHeader)) {
+        close(fd);
+        return NULL;
+    }
+
+    // The mapping stays valid after the file is closed, or replaced by a newer image
+    void *base = mmap(NULL, imageStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+
+    GPXImage *image = malloc(sizeof(GPXImage));
+    if (image == NULL) {
+        munmap(base, imageStat.st_size);
+        return NULL;
+    }
+
+    image->base = base;
+    image->size = imageStat.st_size;
+    image->mapped = true;
+    image->header = base;
+
+    if (!verifyHeader(image->header, image->size)) {
+        closeGPXImage(image);
+        return NULL;
+    }
+
+    resolveSections(image);
+
+    if (!verifyContents(image)) {
+        closeGPXImage(image);
+        return NULL;
+    }
+
+    return image;
+
+}
+
+void closeGPXImage(GPXImage *image) {
+
+    if (image == NULL) {
+        return;
+    }
+
+    if (image->mapped) {
+        munmap(image->base, image->size);
+    } else {
+        free(image->base);
+    }
+    free(image);
+
+}
+
+GPXImage *createGPXImage(const GPXdoc *doc) {
+
+    if (doc == NULL) {
+        return NULL;
+    }
+
+    // An image that is never written has no file to be the key of
+    GPXImageKey key;
+    memset(&key, 0, sizeof(GPXImageKey));
+
+    GPXImage *image = malloc(sizeof(GPXImage));
+    if (image == NULL) {
+        return NULL;
+    }
+
+    image->base = buildImage(doc, &key, &image->size);
+    if (image->base == NULL) {
+        free(image);
+        return NULL;
+    }
+
+    image->mapped = false;
+    image->header = image->base;
+    resolveSections(image);
+
+    return image;
+
+}
+
+const char *getImageString(const GPXImage *image, uint32_t offset) {
+
+    return image->strings + offset;
+
+}
+
+// Add the data records of a range to an otherData list
+static void readOtherData(const GPXImage *image, uint32_t first, uint32_t count, List *otherData) {
+
+    GPXArena *arena = getListArena(otherData);
+
+    for (uint32_t i = first; i < first + count; i++) {
+        insertBack(otherData, newGPXData(arena, getImageString(image, image->data[i].name),
+            getImageString(image, image->data[i].value)));
+    }
+
+}
+
+// Add the points of a range to a list of waypoints
+static void readPoints(const GPXImage *image, uint32_t first, uint32_t count, List *waypoints) {
+
+    GPXArena *arena = getListArena(waypoints);
+
+    for (uint32_t i = first; i < first + count; i++) {
+
+        Waypoint *tmpWpt = newWaypoint(arena);
+
+        tmpWpt->name = copyString(arena, getImageString(image, image->pointNames[i]));
+        tmpWpt->latitude = image->latitudes[i];
+        tmpWpt->longitude = image->longitudes[i];
+        readOtherData(image, image->pointData[i], image->pointData[i + 1] - image->pointData[i], tmpWpt->otherData);
+
+        insertBack(waypoints, tmpWpt);
+
+    }
+
+}
+
+GPXdoc *imageToGPXdoc(const GPXImage *image) {
+
+    if (image == NULL) {
+        return NULL;
+    }
+
+    GPXArena *arena = createArena();
+    if (arena == NULL) {
+        return NULL;
+    }
+
+    const GPXImageHeader *header = image->header;
+
+    GPXdoc *newDoc = newGPXdoc(arena);
+    strcpy(newDoc->namespace, getImageString(image, header->namespaceName));
+    newDoc->version = header->version;
+    newDoc->creator = copyString(arena, getImageString(image, header->creator));
+
+    readPoints(image, 0, header->waypointCount, newDoc->waypoints);
+
+    for (uint32_t r = 0; r < header->routeCount; r++) {
+
+        const GPXImageRoute *route = &image->routes[r];
+        Route *tmpRte = newRoute(arena);
+
+        tmpRte->name = copyString(arena, getImageString(image, route->name));
+        readPoints(image, route->firstPoint, route->pointCount, tmpRte->waypoints);
+        readOtherData(image, route->firstData, route->dataCount, tmpRte->otherData);
+
+        insertRoute(newDoc, tmpRte);
+
+    }
+
+    for (uint32_t t = 0; t < header->trackCount; t++) {
+
+        const GPXImageTrack *track = &image->tracks[t];
+        Track *tmpTrk = newTrack(arena);
+
+        tmpTrk->name = copyString(arena, getImageString(image, track->name));
+
+        for (uint32_t s = track->firstSegment; s < track->firstSegment + track->segmentCount; s++) {
+            TrackSegment *tmpTrkSeg = newTrackSegment(arena);
+            readPoints(image, image->segments[s].firstPoint, image->segments[s].pointCount, tmpTrkSeg->waypoints);
+            insertBack(tmpTrk->segments, tmpTrkSeg);
+        }
+
+        readOtherData(image, track->firstData, track->dataCount, tmpTrk->otherData);
+
+        insertBack(newDoc->tracks, tmpTrk);
+
+    }
+
+    return newDoc;
+
+}
+
+GPXImage *openCachedGPXImage(const char *fileName, const char *schemaFile) {
+
+    GPXImageKey key;
+    if (!getImageKey(fileName, schemaFile, &key)) {
+        return NULL;
+    }
+
+    char *imageFile = getImageFileName(fileName);
+    GPXImage *image = openGPXImage(imageFile);
+    free(imageFile);
+
+    if (image != NULL && !sameImageKey(&image->header->key, &key)) {
+        closeGPXImage(image);
+        return NULL;
+    }
+
+    return image;
+
+}
+
+GPXdoc *loadCachedGPXdoc(const char *fileName, const char *schemaFile) {
+
+    GPXImage *image = openCachedGPXImage(fileName, schemaFile);
+    GPXdoc *doc = imageToGPXdoc(image);
+    closeGPXImage(image);
+
+    return doc;
+
+}
+
+void saveCachedGPXdoc(const GPXdoc *doc, const char *fileName, const char *schemaFile) {
+
+    GPXImageKey key;
+    if (doc == NULL || !getImageKey(fileName, schemaFile, &key)) {
+        return;
+    }
+
+    // A file written again within the same tick of the file system clock, with the same size, would keep its key.
+    // Once a file is a couple of seconds old any later write changes its modification time, so only those are cached
+    struct timespec now;
+    if (clock_gettime(CLOCK_REALTIME, &now) != 0 || key.fileModifiedSec > now.tv_sec - IMAGE_MIN_AGE) {
+        return;
+    }
+
+    char *imageFile = getImageFileName(fileName);
+    if (imageFile != NULL) {
+        writeGPXImage(doc, &key, imageFile);
+    }
+    free(imageFile);
+
+}
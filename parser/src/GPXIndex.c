@@ -0,0 +1,634 @@
+#include "GPXIndex.h" // Included necessary header
+#include "GPXHelpers.h"
+#include "GPXLengthIndex.h"
+
+// Same radius haversine uses, in metres
+#define EARTH_RADIUS 6371e3
+
+// Relative and absolute (in degrees) slack added to the search box, far more than the rounding error of haversine,
+// so the box never drops a path the exact test would keep
+#define BOX_SLACK 1e-9
+
+struct EndpointIndex {
+    // Total number of entries
+    int length;
+
+    // The first sortedLength entries are sorted by start latitude, the rest are the ones the box can not describe
+    int sortedLength;
+    EndpointEntry *entries;
+};
+
+struct GPXIndex {
+    // Generation of the doc and the lengths of its lists when the index was built, to tell if it is stale
+    unsigned long generation;
+    int routeCount;
+    int trackCount;
+
+    // Routes and tracks of the doc by position, the ids in the endpoint indexes
+    Route **routes;
+    Track **tracks;
+
+    EndpointIndex *routeEndpoints;
+    EndpointIndex *trackEndpoints;
+
+    // Lengths of the routes and tracks, only built the first time a length query needs them
+    LengthIndex *routeLengths;
+    LengthIndex *trackLengths;
+
+    // Record of the index in the doc's arena, NULL if the doc has none
+    ArenaCleanup *cleanup;
+};
+
+static void setEntryPoint(double *latitude, double *longitude, double *cosLatitude, const Waypoint *wpt) {
+
+    *latitude = wpt->latitude;
+    *longitude = wpt->longitude;
+    *cosLatitude = cos(wpt->latitude * (M_PI/180));
+
+}
+
+// Set the start and end of an entry from the ends of two lists of waypoints, false if either is empty
+static bool setEntryPoints(EndpointEntry *entry, List *firstPoints, List *lastPoints) {
+
+    Waypoint *first = getFromFront(firstPoints);
+    Waypoint *last = getFromBack(lastPoints);
+
+    if (first == NULL || last == NULL) {
+        return false;
+    }
+
+    setEntryPoint(&entry->startLatitude, &entry->startLongitude, &entry->startCosLatitude, first);
+    setEntryPoint(&entry->endLatitude, &entry->endLongitude, &entry->endCosLatitude, last);
+
+    return true;
+
+}
+
+bool setRouteEntry(EndpointEntry *entry, const Route *rt) {
+
+    if (entry == NULL || rt == NULL) {
+        return false;
+    }
+
+    return setEntryPoints(entry, rt->waypoints, rt->waypoints);
+
+}
+
+bool setTrackEntry(EndpointEntry *entry, const Track *tr) {
+
+    if (entry == NULL || tr == NULL) {
+        return false;
+    }
+
+    TrackSegment *firstSeg = getFromFront(tr->segments);
+    TrackSegment *lastSeg = getFromBack(tr->segments);
+
+    if (firstSeg == NULL) {
+        return false;
+    }
+
+    return setEntryPoints(entry, firstSeg->waypoints, lastSeg->waypoints);
+
+}
+
+// Check if the start of an entry can be found through the latitude band
+static bool isBoxable(const EndpointEntry *entry) {
+
+    return isfinite(entry->startLatitude) && isfinite(entry->startLongitude) && fabs(entry->startLatitude) <= 90;
+
+}
+
+static int compareStartLatitudes(const void *first, const void *second) {
+
+    double lat1 = ((const EndpointEntry *)first)->startLatitude;
+    double lat2 = ((const EndpointEntry *)second)->startLatitude;
+
+    return (lat1 > lat2) - (lat1 < lat2);
+
+}
+
+static int compareIds(const void *first, const void *second) {
+
+    int id1 = *(const int *)first;
+    int id2 = *(const int *)second;
+
+    return (id1 > id2) - (id1 < id2);
+
+}
+
+EndpointIndex *createEndpointIndex(const EndpointEntry *entries, int length) {
+
+    if (length < 0 || (entries == NULL && length > 0)) {
+        return NULL;
+    }
+
+    EndpointIndex *index = malloc(sizeof(EndpointIndex) + sizeof(EndpointEntry) * length);
+    if (index == NULL) {
+        return NULL;
+    }
+
+    index->length = length;
+    index->entries = (EndpointEntry *)(index + 1);
+
+    // Boxable entries go to the front, in their original order, the others to the back
+    int front = 0;
+    int back = length;
+    for (int i = 0; i < length; i++) {
+        if (isBoxable(&entries[i])) {
+            index->entries[front++] = entries[i];
+        } else {
+            index->entries[--back] = entries[i];
+        }
+    }
+
+    index->sortedLength = front;
+    qsort(index->entries, front, sizeof(EndpointEntry), &compareStartLatitudes);
+
+    return index;
+
+}
+
+void deleteEndpointIndex(void *data) {
+
+    free(data);
+
+}
+
+int getEndpointIndexLength(const EndpointIndex *index) {
+
+    if (index == NULL) {
+        return 0;
+    }
+
+    return index->length;
+
+}
+
+// The exact test of getRoutesBetween, with the cosines of the source and destination computed by the caller
+static bool isEntryBetween(const EndpointEntry *entry, double sourceLat, double sourceLong, double cosSource,
+    double destLat, double destLong, double cosDest, double delta) {
+
+    return haversineWithCos(entry->startLatitude, entry->startLongitude, entry->startCosLatitude, sourceLat, sourceLong,
+            cosSource) <= delta
+        && haversineWithCos(entry->endLatitude, entry->endLongitude, entry->endCosLatitude, destLat, destLong,
+            cosDest) <= delta;
+
+}
+
+// Find the first sorted entry with a start latitude of at least lat
+static int lowerBound(const EndpointIndex *index, double lat) {
+
+    int low = 0;
+    int high = index->sortedLength;
+
+    while (low < high) {
+
+        int middle = low + (high - low) / 2;
+
+        if (index->entries[middle].startLatitude < lat) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+
+    }
+
+    return low;
+
+}
+
+int findEndpointsBetween(const EndpointIndex *index, double sourceLat, double sourceLong, double destLat,
+    double destLong, double delta, int *ids) {
+
+    if (index == NULL || ids == NULL || delta < 0) {
+        return 0;
+    }
+
+    double cosSource = cos(sourceLat * (M_PI/180));
+    double cosDest = cos(destLat * (M_PI/180));
+
+    int count = 0;
+
+    // The entries the box can not describe are always checked
+    for (int i = index->sortedLength; i < index->length; i++) {
+        const EndpointEntry *entry = &index->entries[i];
+        if (isEntryBetween(entry, sourceLat, sourceLong, cosSource, destLat, destLong, cosDest, delta)) {
+            ids[count++] = entry->id;
+        }
+    }
+
+    int first = 0;
+    int last = index->sortedLength;
+    double maxLongDiff = 180;
+
+    double deltaInRadians = delta / EARTH_RADIUS;
+
+    // Points within delta are at most delta / radius radians away in latitude. The box only holds for a source that
+    // is on the globe, and is useless if delta reaches half way around it
+    if (isfinite(sourceLat) && isfinite(sourceLong) && fabs(sourceLat) <= 90 && deltaInRadians < M_PI) {
+
+        double maxLatDiff = deltaInRadians * (180/M_PI) * (1 + BOX_SLACK) + BOX_SLACK;
+        double minLat = sourceLat - maxLatDiff;
+        double maxLat = sourceLat + maxLatDiff;
+
+        first = lowerBound(index, minLat);
+        last = lowerBound(index, nextafter(maxLat, INFINITY));
+
+        // From the haversine formula, cos(lat1) * cos(lat2) * sin^2(dLon / 2) <= sin^2(delta / 2) for any point within
+        // delta. The smallest cosine in the band gives the widest longitude difference, unless the band has a pole
+        double maxAbsLat = fmax(fabs(minLat), fabs(maxLat));
+        if (maxAbsLat < 90) {
+
+            double ratio = sin(deltaInRadians / 2) / sqrt(cos(maxAbsLat * (M_PI/180)) * cosSource);
+            if (ratio < 1) {
+                maxLongDiff = 2 * asin(ratio) * (180/M_PI) * (1 + BOX_SLACK) + BOX_SLACK;
+            }
+
+        }
+
+    }
+
+    for (int i = first; i < last; i++) {
+
+        const EndpointEntry *entry = &index->entries[i];
+
+        // Longitude difference the short way around, haversine treats longitudes 360 degrees apart as the same
+        if (maxLongDiff < 180) {
+
+            double longDiff = fmod(fabs(entry->startLongitude - sourceLong), 360);
+            if (longDiff > 180) {
+                longDiff = 360 - longDiff;
+            }
+
+            if (longDiff > maxLongDiff) {
+                continue;
+            }
+
+        }
+
+        if (isEntryBetween(entry, sourceLat, sourceLong, cosSource, destLat, destLong, cosDest, delta)) {
+            ids[count++] = entry->id;
+        }
+
+    }
+
+    // Back to the order the caller gave the entries in
+    qsort(ids, count, sizeof(int), &compareIds);
+
+    return count;
+
+}
+
+// Index the first and last points of every route, with its position in the doc as the id
+static EndpointIndex *indexRoutes(Route **routes, int length) {
+
+    EndpointEntry *entries = malloc(sizeof(EndpointEntry) * (length > 0 ? length : 1));
+    if (entries == NULL) {
+        return NULL;
+    }
+
+    int count = 0;
+    for (int i = 0; i < length; i++) {
+
+        EndpointEntry *entry = &entries[count];
+
+        if (setRouteEntry(entry, routes[i])) {
+            entry->id = i;
+            count++;
+        }
+
+    }
+
+    EndpointIndex *index = createEndpointIndex(entries, count);
+
+    free(entries);
+
+    return index;
+
+}
+
+// Same for tracks
+static EndpointIndex *indexTracks(Track **tracks, int length) {
+
+    EndpointEntry *entries = malloc(sizeof(EndpointEntry) * (length > 0 ? length : 1));
+    if (entries == NULL) {
+        return NULL;
+    }
+
+    int count = 0;
+    for (int i = 0; i < length; i++) {
+
+        EndpointEntry *entry = &entries[count];
+
+        if (setTrackEntry(entry, tracks[i])) {
+            entry->id = i;
+            count++;
+        }
+
+    }
+
+    EndpointIndex *index = createEndpointIndex(entries, count);
+
+    free(entries);
+
+    return index;
+
+}
+
+// Copy the data of a list into an array, in order
+static void listToArray(List *list, void **array) {
+
+    void *elem;
+    ListIterator iter = createIterator(list);
+
+    int i = 0;
+    while ((elem = nextElement(&iter)) != NULL) {
+        array[i++] = elem;
+    }
+
+}
+
+static GPXIndex *createGPXIndex(const GPXdoc *doc) {
+
+    int routeCount = getLength(doc->routes);
+    int trackCount = getLength(doc->tracks);
+
+    // The index and both path arrays are one allocation
+    GPXIndex *index = malloc(sizeof(GPXIndex) + sizeof(void *) * (routeCount + trackCount));
+    if (index == NULL) {
+        return NULL;
+    }
+
+    index->generation = doc->generation;
+    index->routeCount = routeCount;
+    index->trackCount = trackCount;
+    index->routes = (Route **)(index + 1);
+    index->tracks = (Track **)(index->routes + routeCount);
+
+    listToArray(doc->routes, (void **)index->routes);
+    listToArray(doc->tracks, (void **)index->tracks);
+
+    index->routeLengths = NULL;
+    index->trackLengths = NULL;
+    index->cleanup = NULL;
+
+    index->routeEndpoints = indexRoutes(index->routes, routeCount);
+    index->trackEndpoints = indexTracks(index->tracks, trackCount);
+
+    if (index->routeEndpoints == NULL || index->trackEndpoints == NULL) {
+        deleteGPXIndex(index);
+        return NULL;
+    }
+
+    return index;
+
+}
+
+void deleteGPXIndex(void *data) {
+
+    if (data == NULL) {
+        return;
+    }
+
+    GPXIndex *index = (GPXIndex *)data;
+    deleteEndpointIndex(index->routeEndpoints);
+    deleteEndpointIndex(index->trackEndpoints);
+    deleteLengthIndex(index->routeLengths);
+    deleteLengthIndex(index->trackLengths);
+    free(index);
+
+}
+
+// Check that the index still matches its doc. Besides the generation, catches paths added or removed with the List
+// API as long as the number of paths or the first or last one changed, the same way isWaypointArrayCurrent does
+static bool isGPXIndexCurrent(const GPXdoc *doc, const GPXIndex *index) {
+
+    if (index->generation != doc->generation || index->routeCount != getLength(doc->routes)
+        || index->trackCount != getLength(doc->tracks)) {
+        return false;
+    }
+
+    if (index->routeCount > 0 && (index->routes[0] != getFromFront(doc->routes)
+        || index->routes[index->routeCount - 1] != getFromBack(doc->routes))) {
+        return false;
+    }
+
+    return index->trackCount == 0 || (index->tracks[0] == getFromFront(doc->tracks)
+        && index->tracks[index->trackCount - 1] == getFromBack(doc->tracks));
+
+}
+
+const GPXIndex *getGPXIndex(const GPXdoc *doc) {
+
+    if (doc == NULL || doc->routes == NULL || doc->tracks == NULL) {
+        return NULL;
+    }
+
+    GPXIndex *index = doc->index;
+
+    if (index != NULL && isGPXIndexCurrent(doc, index)) {
+        return index;
+    }
+
+    // The index is not part of the doc's value, so it is replaced even through a const doc
+    GPXdoc *docToEdit = (GPXdoc *)doc;
+
+    if (index != NULL) {
+        arenaReleaseCleanup(doc->arena, index->cleanup);
+        deleteGPXIndex(index);
+    }
+
+    docToEdit->index = createGPXIndex(doc);
+
+    // An arena doc frees its index with the rest of the doc
+    if (docToEdit->index != NULL) {
+        docToEdit->index->cleanup = arenaAdopt(doc->arena, docToEdit->index, &deleteGPXIndex);
+    }
+
+    return docToEdit->index;
+
+}
+
+// Run the query on one of the endpoint indexes and put the matching paths in a new list, in doc order
+static List *findPathsBetween(const EndpointIndex *endpoints, void **paths, List *tmpList, float sourceLat,
+    float sourceLong, float destLat, float destLong, float delta) {
+
+    int *ids = malloc(sizeof(int) * (getEndpointIndexLength(endpoints) > 0 ? getEndpointIndexLength(endpoints) : 1));
+    if (ids == NULL) {
+        freeList(tmpList);
+        return NULL;
+    }
+
+    int count = findEndpointsBetween(endpoints, sourceLat, sourceLong, destLat, destLong, delta, ids);
+
+    for (int i = 0; i < count; i++) {
+        insertBack(tmpList, paths[ids[i]]);
+    }
+
+    free(ids);
+
+    // If the list is empty, free it and return NULL, same as getRoutesBetween
+    if (count == 0) {
+        freeList(tmpList);
+        return NULL;
+    }
+
+    return tmpList;
+
+}
+
+List *findRoutesBetween(const GPXIndex *index, float sourceLat, float sourceLong, float destLat, float destLong,
+    float delta) {
+
+    if (index == NULL || delta < 0) {
+        return NULL;
+    }
+
+    // Dummy delete, so freeing the list does not delete the doc's routes
+    List *tmpList = initializeList(&routeToString, &dummyDelete, &compareRoutes);
+
+    return findPathsBetween(index->routeEndpoints, (void **)index->routes, tmpList, sourceLat, sourceLong, destLat,
+        destLong, delta);
+
+}
+
+List *findTracksBetween(const GPXIndex *index, float sourceLat, float sourceLong, float destLat, float destLong,
+    float delta) {
+
+    if (index == NULL || delta < 0) {
+        return NULL;
+    }
+
+    List *tmpList = initializeList(&trackToString, &dummyDelete, &compareTracks);
+
+    return findPathsBetween(index->trackEndpoints, (void **)index->tracks, tmpList, sourceLat, sourceLong, destLat,
+        destLong, delta);
+
+}
+
+// Index the lengths of routes or tracks, by position
+static LengthIndex *indexLengths(void **paths, int length, float (*getPathLen)(const void *)) {
+
+    LengthEntry *entries = malloc(sizeof(LengthEntry) * (length > 0 ? length : 1));
+    if (entries == NULL) {
+        return NULL;
+    }
+
+    for (int i = 0; i < length; i++) {
+        entries[i].length = getPathLen(paths[i]);
+        entries[i].id = i;
+    }
+
+    LengthIndex *lengths = createLengthIndex(entries, length);
+
+    free(entries);
+
+    return lengths;
+
+}
+
+static float getAnyRouteLen(const void *path) {
+
+    return getRouteLen((const Route *)path);
+
+}
+
+static float getAnyTrackLen(const void *path) {
+
+    return getTrackLen((const Track *)path);
+
+}
+
+// Get the length index of the routes of a doc index, building it the first time. NULL if malloc fails
+static const LengthIndex *getRouteLengths(const GPXIndex *index) {
+
+    // Built lazily even through a const index, like the index itself through a const doc
+    if (index->routeLengths == NULL) {
+        ((GPXIndex *)index)->routeLengths = indexLengths((void **)index->routes, index->routeCount, &getAnyRouteLen);
+    }
+
+    return index->routeLengths;
+
+}
+
+static const LengthIndex *getTrackLengths(const GPXIndex *index) {
+
+    if (index->trackLengths == NULL) {
+        ((GPXIndex *)index)->trackLengths = indexLengths((void **)index->tracks, index->trackCount, &getAnyTrackLen);
+    }
+
+    return index->trackLengths;
+
+}
+
+int countRoutesWithLength(const GPXIndex *index, float len, float delta) {
+
+    if (index == NULL) {
+        return 0;
+    }
+
+    return countLengthsWithin(getRouteLengths(index), len, delta);
+
+}
+
+int countTracksWithLength(const GPXIndex *index, float len, float delta) {
+
+    if (index == NULL) {
+        return 0;
+    }
+
+    return countLengthsWithin(getTrackLengths(index), len, delta);
+
+}
+
+// Run the query on one of the length indexes and put the matching paths in a new list, in doc order
+static List *findPathsWithLength(const LengthIndex *lengths, void **paths, List *tmpList, float len, float delta) {
+
+    int *ids = malloc(sizeof(int) * (getLengthIndexLength(lengths) > 0 ? getLengthIndexLength(lengths) : 1));
+    if (lengths == NULL || ids == NULL) {
+        free(ids);
+        freeList(tmpList);
+        return NULL;
+    }
+
+    int count = findLengthsWithin(lengths, len, delta, ids);
+
+    for (int i = 0; i < count; i++) {
+        insertBack(tmpList, paths[ids[i]]);
+    }
+
+    free(ids);
+
+    if (count == 0) {
+        freeList(tmpList);
+        return NULL;
+    }
+
+    return tmpList;
+
+}
+
+List *findRoutesWithLength(const GPXIndex *index, float len, float delta) {
+
+    if (index == NULL || len < 0 || delta < 0) {
+        return NULL;
+    }
+
+    // Dummy delete, so freeing the list does not delete the doc's routes
+    List *tmpList = initializeList(&routeToString, &dummyDelete, &compareRoutes);
+
+    return findPathsWithLength(getRouteLengths(index), (void **)index->routes, tmpList, len, delta);
+
+}
+
+List *findTracksWithLength(const GPXIndex *index, float len, float delta) {
+
+    if (index == NULL || len < 0 || delta < 0) {
+        return NULL;
+    }
+
+    List *tmpList = initializeList(&trackToString, &dummyDelete, &compareTracks);
+
+    return findPathsWithLength(getTrackLengths(index), (void **)index->tracks, tmpList, len, delta);
+
+}
@@ -0,0 +1,136 @@
+#include "GPXLengthIndex.h" // Included necessary header
+
+struct LengthIndex {
+    int length;
+
+    // Sorted by length, then id
+    LengthEntry *entries;
+};
+
+static int compareLengthEntries(const void *first, const void *second) {
+
+    const LengthEntry *entry1 = (const LengthEntry *)first;
+    const LengthEntry *entry2 = (const LengthEntry *)second;
+
+    if (entry1->length != entry2->length) {
+        return entry1->length < entry2->length ? -1 : 1;
+    }
+
+    return (entry1->id > entry2->id) - (entry1->id < entry2->id);
+
+}
+
+static int compareIds(const void *first, const void *second) {
+
+    int id1 = *(const int *)first;
+    int id2 = *(const int *)second;
+
+    return (id1 > id2) - (id1 < id2);
+
+}
+
+LengthIndex *createLengthIndex(const LengthEntry *entries, int length) {
+
+    if (entries == NULL && length > 0) {
+        return NULL;
+    }
+
+    LengthIndex *index = malloc(sizeof(LengthIndex) + sizeof(LengthEntry) * (length > 0 ? length : 1));
+    if (index == NULL) {
+        return NULL;
+    }
+
+    index->entries = (LengthEntry *)(index + 1);
+    index->length = 0;
+
+    // NaN can not be sorted and never matches anything
+    for (int i = 0; i < length; i++) {
+        if (!isnan(entries[i].length)) {
+            index->entries[index->length++] = entries[i];
+        }
+    }
+
+    qsort(index->entries, index->length, sizeof(LengthEntry), &compareLengthEntries);
+
+    return index;
+
+}
+
+void deleteLengthIndex(void *data) {
+
+    free(data);
+
+}
+
+int getLengthIndexLength(const LengthIndex *index) {
+
+    return index != NULL ? index->length : 0;
+
+}
+
+// First entry whose difference from len is above the bound, or at or above it if inclusive. The difference is
+// computed exactly as numRoutesWithLength computes it
+static int searchDifference(const LengthIndex *index, float len, float bound, bool inclusive) {
+
+    int low = 0;
+    int high = index->length;
+
+    while (low < high) {
+
+        int middle = low + (high - low) / 2;
+        float difference = index->entries[middle].length - len;
+
+        if (inclusive ? difference >= bound : difference > bound) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+
+    }
+
+    return low;
+
+}
+
+// The run of entries within delta of len, from *first up to but not including the return value
+static int findRun(const LengthIndex *index, float len, float delta, int *first) {
+
+    *first = searchDifference(index, len, -delta, true);
+
+    return searchDifference(index, len, delta, false);
+
+}
+
+int countLengthsWithin(const LengthIndex *index, float len, float delta) {
+
+    if (index == NULL || len < 0 || delta < 0) {
+        return 0;
+    }
+
+    int first;
+    int end = findRun(index, len, delta, &first);
+
+    return end > first ? end - first : 0;
+
+}
+
+int findLengthsWithin(const LengthIndex *index, float len, float delta, int *ids) {
+
+    if (index == NULL || ids == NULL || len < 0 || delta < 0) {
+        return 0;
+    }
+
+    int first;
+    int end = findRun(index, len, delta, &first);
+
+    int count = 0;
+    for (int i = first; i < end; i++) {
+        ids[count++] = index->entries[i].id;
+    }
+
+    // The run is in length order, the callers want the paths in the order they are in
+    qsort(ids, count, sizeof(int), &compareIds);
+
+    return count;
+
+}
@@ -0,0 +1,422 @@
+#include "GPXNameIndex.h" // Included necessary header
+#include "GPXHelpers.h"
+
+// Fewest entries a table makes room for
+#define MIN_NAME_CAPACITY 16
+
+typedef struct {
+    void *object;
+
+    // Address of the object's name, so a rename is seen without touching the entry
+    char **name;
+    unsigned int hash;
+
+    // Next entry in the same bucket, further down the list, or -1
+    int next;
+} NameEntry;
+
+typedef struct {
+    // Number of entries, the length of the list when it was built. -1 if the table must be rebuilt
+    int length;
+    int capacity;
+
+    // Power of two at least as large as the capacity. Each bucket is the first entry of its chain, or -1
+    int bucketCount;
+    int *buckets;
+
+    // In list order, so the position of an entry is its position in the list
+    NameEntry *entries;
+} NameTable;
+
+struct GPXNameIndex {
+    NameTable waypoints;
+    NameTable routes;
+    NameTable tracks;
+};
+
+// FNV-1a, cheap and good enough for the short names found in GPX files
+static unsigned int hashName(const char *name) {
+
+    unsigned int hash = 2166136261u;
+
+    for (const unsigned char *c = (const unsigned char *)name; *c != '\0'; c++) {
+        hash = (hash ^ *c) * 16777619u;
+    }
+
+    return hash;
+
+}
+
+static char **getWaypointName(void *object) { return &((Waypoint *)object)->name; }
+
+static char **getRouteName(void *object) { return &((Route *)object)->name; }
+
+static char **getTrackName(void *object) { return &((Track *)object)->name; }
+
+// Link an entry into its bucket, after the entries that come before it in the list
+static void linkEntry(NameTable *table, int position) {
+
+    NameEntry *entry = &table->entries[position];
+    int *link = &table->buckets[entry->hash & (table->bucketCount - 1)];
+
+    while (*link != -1 && *link < position) {
+        link = &table->entries[*link].next;
+    }
+
+    entry->next = *link;
+    *link = position;
+
+}
+
+static void unlinkEntry(NameTable *table, int position) {
+
+    int *link = &table->buckets[table->entries[position].hash & (table->bucketCount - 1)];
+
+    while (*link != -1 && *link != position) {
+        link = &table->entries[*link].next;
+    }
+
+    if (*link == position) {
+        *link = table->entries[position].next;
+    }
+
+}
+
+static void clearTable(NameTable *table) {
+
+    free(table->buckets);
+    free(table->entries);
+
+    table->length = -1;
+    table->capacity = 0;
+    table->bucketCount = 0;
+    table->buckets = NULL;
+    table->entries = NULL;
+
+}
+
+// Fill a table from a list, with room for twice as many entries so appends rarely rebuild it. false if malloc fails
+static bool buildTable(NameTable *table, const List *list, char **(*nameOf)(void *object)) {
+
+    clearTable(table);
+
+    int length = getLength((List *)list);
+
+    int capacity = length * 2 > MIN_NAME_CAPACITY ? length * 2 : MIN_NAME_CAPACITY;
+    int bucketCount = 1;
+    while (bucketCount < capacity) {
+        bucketCount *= 2;
+    }
+
+    table->entries = malloc(sizeof(NameEntry) * capacity);
+    table->buckets = malloc(sizeof(int) * bucketCount);
+    if (table->entries == NULL || table->buckets == NULL) {
+        clearTable(table);
+        return false;
+    }
+
+    table->capacity = capacity;
+    table->bucketCount = bucketCount;
+
+    for (int i = 0; i < bucketCount; i++) {
+        table->buckets[i] = -1;
+    }
+
+    void *elem;
+    int position = 0;
+    ListIterator iter = createIterator((List *)list);
+
+    while ((elem = nextElement(&iter)) != NULL) {
+
+        NameEntry *entry = &table->entries[position];
+        entry->object = elem;
+        entry->name = nameOf(elem);
+        entry->hash = *entry->name != NULL ? hashName(*entry->name) : 0;
+        entry->next = -1;
+
+        position++;
+
+    }
+
+    // Linking from the back puts every chain in list order without walking it
+    for (int i = position - 1; i >= 0; i--) {
+        int bucket = table->entries[i].hash & (bucketCount - 1);
+        table->entries[i].next = table->buckets[bucket];
+        table->buckets[bucket] = i;
+    }
+
+    table->length = position;
+
+    return true;
+
+}
+
+// Get the index of a doc, creating an empty one first if it has none. NULL if malloc fails
+static GPXNameIndex *getNameIndex(const GPXdoc *doc) {
+
+    if (doc->names != NULL) {
+        return doc->names;
+    }
+
+    GPXNameIndex *index = malloc(sizeof(GPXNameIndex));
+    if (index == NULL) {
+        return NULL;
+    }
+
+    index->waypoints = (NameTable){ -1, 0, 0, NULL, NULL };
+    index->routes = (NameTable){ -1, 0, 0, NULL, NULL };
+    index->tracks = (NameTable){ -1, 0, 0, NULL, NULL };
+
+    // The index is not part of the doc's value, so it is added even through a const doc. An arena doc frees it with
+    // the rest of the doc
+    ((GPXdoc *)doc)->names = index;
+    arenaAdopt(doc->arena, index, &deleteNameIndex);
+
+    return index;
+
+}
+
+// Check that a table still matches its list. Catches objects added or removed without going through the API, as long
+// as the length or the first or last object changed, the same way isWaypointArrayCurrent does
+static bool isTableCurrent(const NameTable *table, const List *list) {
+
+    int length = getLength((List *)list);
+    if (table->length != length) {
+        return false;
+    }
+
+    if (length == 0) {
+        return true;
+    }
+
+    return table->entries[0].object == getFromFront((List *)list)
+        && table->entries[length - 1].object == getFromBack((List *)list);
+
+}
+
+// Get a table of a doc's index, building it first if it is missing or stale. NULL if malloc fails
+static NameTable *getTable(const GPXdoc *doc, NameTable *(*tableOf)(GPXNameIndex *index), const List *list,
+    char **(*nameOf)(void *object)) {
+
+    if (list == NULL) {
+        return NULL;
+    }
+
+    GPXNameIndex *index = getNameIndex(doc);
+    if (index == NULL) {
+        return NULL;
+    }
+
+    NameTable *table = tableOf(index);
+    if (isTableCurrent(table, list)) {
+        return table;
+    }
+
+    return buildTable(table, list, nameOf) ? table : NULL;
+
+}
+
+static NameTable *waypointTableOf(GPXNameIndex *index) { return &index->waypoints; }
+
+static NameTable *routeTableOf(GPXNameIndex *index) { return &index->routes; }
+
+static NameTable *trackTableOf(GPXNameIndex *index) { return &index->tracks; }
+
+static void *findInTable(const NameTable *table, const char *name) {
+
+    unsigned int hash = hashName(name);
+
+    for (int i = table->buckets[hash & (table->bucketCount - 1)]; i != -1; i = table->entries[i].next) {
+
+        const NameEntry *entry = &table->entries[i];
+
+        if (entry->hash == hash && *entry->name != NULL && strcmp(*entry->name, name) == 0) {
+            return entry->object;
+        }
+
+    }
+
+    return NULL;
+
+}
+
+// The linear scan the lookups fall back on if the table can not be built or misses
+static void *scanList(const List *list, const char *name, char **(*nameOf)(void *object)) {
+
+    void *elem;
+    ListIterator iter = createIterator((List *)list);
+
+    while ((elem = nextElement(&iter)) != NULL) {
+
+        char *elemName = *nameOf(elem);
+        if (elemName != NULL && strcmp(elemName, name) == 0) {
+            return elem;
+        }
+
+    }
+
+    return NULL;
+
+}
+
+static void *findByName(const GPXdoc *doc, const char *name, NameTable *(*tableOf)(GPXNameIndex *index),
+    const List *list, char **(*nameOf)(void *object)) {
+
+    if (doc == NULL || name == NULL || list == NULL) {
+        return NULL;
+    }
+
+    NameTable *table = getTable(doc, tableOf, list, nameOf);
+    if (table == NULL) {
+        return scanList(list, name, nameOf);
+    }
+
+    // A hit is trusted, checking for an earlier object renamed by hand would cost the scan the table saves
+    void *found = findInTable(table, name);
+    if (found != NULL) {
+        return found;
+    }
+
+    // A name changed by hand is still in the chain of its old name, so a miss is checked with the scan. If the scan
+    // finds the object the table is out of date, and it is rebuilt on the next lookup
+    found = scanList(list, name, nameOf);
+    if (found != NULL) {
+        table->length = -1;
+    }
+
+    return found;
+
+}
+
+Waypoint *findWaypointByName(const GPXdoc *doc, const char *name) {
+
+    return doc != NULL ? findByName(doc, name, &waypointTableOf, doc->waypoints, &getWaypointName) : NULL;
+
+}
+
+Route *findRouteByName(const GPXdoc *doc, const char *name) {
+
+    return doc != NULL ? findByName(doc, name, &routeTableOf, doc->routes, &getRouteName) : NULL;
+
+}
+
+Track *findTrackByName(const GPXdoc *doc, const char *name) {
+
+    return doc != NULL ? findByName(doc, name, &trackTableOf, doc->tracks, &getTrackName) : NULL;
+
+}
+
+static void *getAt(const GPXdoc *doc, int index, NameTable *(*tableOf)(GPXNameIndex *index), const List *list,
+    char **(*nameOf)(void *object)) {
+
+    if (doc == NULL || list == NULL || index < 1 || index > getLength((List *)list)) {
+        return NULL;
+    }
+
+    const NameTable *table = getTable(doc, tableOf, list, nameOf);
+    if (table != NULL) {
+        return table->entries[index - 1].object;
+    }
+
+    // Walk the list if the table can not be built
+    void *elem;
+    ListIterator iter = createIterator((List *)list);
+
+    for (int i = 1; (elem = nextElement(&iter)) != NULL; i++) {
+        if (i == index) {
+            return elem;
+        }
+    }
+
+    return NULL;
+
+}
+
+Route *getRouteAt(const GPXdoc *doc, int index) {
+
+    return doc != NULL ? getAt(doc, index, &routeTableOf, doc->routes, &getRouteName) : NULL;
+
+}
+
+Track *getTrackAt(const GPXdoc *doc, int index) {
+
+    return doc != NULL ? getAt(doc, index, &trackTableOf, doc->tracks, &getTrackName) : NULL;
+
+}
+
+void addRouteToNameIndex(const GPXdoc *doc, Route *rt) {
+
+    if (doc == NULL || doc->names == NULL || rt == NULL) {
+        return;
+    }
+
+    NameTable *table = &doc->names->routes;
+
+    // Only a table that was current before the route was appended can take it, any other is rebuilt when next used
+    if (table->length == -1 || table->length + 1 != getLength(doc->routes) || getFromBack(doc->routes) != rt) {
+        return;
+    }
+
+    // Out of room, the next lookup rebuilds the table twice as large
+    if (table->length == table->capacity) {
+        table->length = -1;
+        return;
+    }
+
+    int position = table->length;
+
+    NameEntry *entry = &table->entries[position];
+    entry->object = rt;
+    entry->name = &rt->name;
+    entry->hash = rt->name != NULL ? hashName(rt->name) : 0;
+
+    linkEntry(table, position);
+    table->length++;
+
+}
+
+void renameInNameIndex(const GPXdoc *doc, int type, int index) {
+
+    if (doc == NULL || doc->names == NULL) {
+        return;
+    }
+
+    NameTable *table = type == 1 ? &doc->names->routes : &doc->names->tracks;
+    if (table->length == -1 || index < 1 || index > table->length) {
+        return;
+    }
+
+    // The name of the entry already points at the new name, only its hash and chain change
+    int position = index - 1;
+    NameEntry *entry = &table->entries[position];
+
+    unlinkEntry(table, position);
+    entry->hash = *entry->name != NULL ? hashName(*entry->name) : 0;
+    linkEntry(table, position);
+
+}
+
+void invalidateNameIndex(const GPXdoc *doc, int type) {
+
+    if (doc == NULL || doc->names == NULL) {
+        return;
+    }
+
+    clearTable(type == 1 ? &doc->names->routes : &doc->names->tracks);
+
+}
+
+void deleteNameIndex(void *data) {
+
+    if (data == NULL) {
+        return;
+    }
+
+    GPXNameIndex *index = (GPXNameIndex *)data;
+
+    clearTable(&index->waypoints);
+    clearTable(&index->routes);
+    clearTable(&index->tracks);
+    free(index);
+
+}
@@ -1,5 +1,19 @@
+#define _POSIX_C_SOURCE 200809L
+#include <sys/stat.h>
 #include "GPXParser.h"
 #include "GPXHelpers.h"
+#include "GPXSchemaCache.h"
+#include "GPXStringBuilder.h"
+#include "GPXStreamReader.h"
+#include "GPXWaypointArray.h"
+#include "GPXPathMetrics.h"
+#include "GPXIndex.h"
+#include "GPXNameIndex.h"
+#include "GPXWriter.h"
+#include "GPXImage.h"
+#include "GPXView.h"
+#include "GPXStats.h"
+#include "GPXTrace.h"
 #include "LinkedListAPI.h"
 
 /** Function to create an GPX object based on the contents of an GPX file.
@@ -12,7 +26,7 @@
  *@return the pinter to the new struct or NULL
  *@param fileName - a string containing the name of the GPX file
 **/
-GPXdoc *createGPXdoc(char* fileName) {
+static GPXdoc *parseGPXFile(char* fileName) {
 
     // Initialize a xmlDoc variable
     xmlDoc *doc = NULL;
@@ -32,14 +46,15 @@ GPXdoc *createGPXdoc(char* fileName) {
     LIBXML_TEST_VERSION
 
     // Calls the xmlReadFile function to get a parse-able tree
+    uint64_t spanStart = beginTraceSpan();
     doc = xmlReadFile(fileName, NULL, 0);
+    endTraceSpan("xmlReadFile", spanStart);
 
     // If the function failed for any reason, it will return NULL
     if (doc == NULL) {
 
-        // Free doc and cleanup any variables that could have been used by the XML parser
+        // Free doc
         xmlFreeDoc(doc);
-        xmlCleanupParser();
 
         return NULL;
 
@@ -51,24 +66,22 @@ GPXdoc *createGPXdoc(char* fileName) {
     // If the tree is empty, or if it is not a gpx file
     if (root_node == NULL || strcmp((const char *) root_node->name, "gpx") != 0) {
 
-        // Free doc and cleanup any variables used by the parser
+        // Free doc
         xmlFreeDoc(doc);
-        xmlCleanupParser();
 
         return NULL;
 
     }
 
-    // Malloc space for a new GPXdoc struct
-    GPXdoc *newDoc = malloc(sizeof(GPXdoc));
+    // Create a new GPXdoc struct, with an arena that the doc and everything in it is allocated from
+    GPXdoc *newDoc = newGPXdoc(createArena());
     
     // Checking if namespace exists and is not an empty string (which makes the file invalid)
     if (root_node->ns == NULL || root_node->ns->href == NULL || strcmp((const char *)root_node->ns->href, "") == 0) {
 
         // Freeing
         xmlFreeDoc(doc);
-        xmlCleanupParser();
-        free(newDoc);
+        deleteGPXdoc(newDoc);
 
         return NULL;
 
@@ -105,52 +118,52 @@ GPXdoc *createGPXdoc(char* fileName) {
             // Creator flag is set to 1
             creatorCheck++;
 
-            // Mallocing enough space for creator, and then copying it into the struct
-            newDoc->creator = malloc(strlen(cont) + 1);
-            strcpy(newDoc->creator, cont);
+            // Copying creator into the struct
+            newDoc->creator = copyString(newDoc->arena, cont);
 
         }
     }
 
-    // If no creator attribute
-    if (creatorCheck == 0) {
-
-        // Freeing
-        xmlFreeDoc(doc);
-        xmlCleanupParser();
-        free(newDoc);
-
-        return NULL;
-
-    } else if (versionCheck == 0) { // If no version attribute
+    // If no creator or no version attribute
+    if (creatorCheck == 0 || versionCheck == 0) {
 
-        // Freeing
+        // Freeing, the doc takes its creator with it
         xmlFreeDoc(doc);
-        xmlCleanupParser();
-        free(newDoc->creator); // Free creator too
-        free(newDoc);
+        deleteGPXdoc(newDoc);
 
         return NULL;
 
     }
 
-    // Initialize all the lists in the struct, because they can't be NULL
-    newDoc->waypoints = initializeList(&waypointToString, &deleteWaypoint, &compareWaypoints);
-    newDoc->routes = initializeList(&routeToString, &deleteRoute, &compareRoutes);
-    newDoc->tracks = initializeList(&trackToString, &deleteTrack, &compareTracks);
-
     // Call recursiveReader to input all the other information into the doc
+    uint64_t statStart = startParserStat();
     recursiveReader(root_node, newDoc);
+    endParserStat(STAT_RECURSIVE_READER, statStart, 0);
 
-    // Freeing the tree (since we have a parsed struct now) and cleanup any variables used/allocated by the parser
+    // Freeing the tree (since we have a parsed struct now). libxml2's global state is kept alive for the
+    // cached schemas and is only torn down by cleanupSchemaCache
     xmlFreeDoc(doc);
-    xmlCleanupParser();
 
     // Return a pointer to the new GPXDoc struct, so we can change it later on
     return newDoc;
 
 }
 
+GPXdoc *createGPXdoc(char* fileName) {
+
+    uint64_t statStart = startParserStat();
+
+    GPXdoc *newDoc = parseGPXFile(fileName);
+
+    // xmlReadFile reads the whole file, so its size is the bytes parsed
+    struct stat fileInfo;
+    long bytes = newDoc != NULL && stat(fileName, &fileInfo) == 0 ? fileInfo.st_size : 0;
+    endParserStat(STAT_CREATE_GPXDOC, statStart, bytes);
+
+    return newDoc;
+
+}
+
 /** Function to create a string representation of an GPX object.
  *@pre GPX object exists, is not null, and is valid
  *@post GPX has not been modified in any way, and a string representing the GPX contents has been created
@@ -164,73 +177,35 @@ char *GPXdocToString(GPXdoc* doc) {
         return NULL;
     }
 
-    // Call toString on each of the lists
-    char *waypoints = toString(doc->waypoints);
-    char *routes = toString(doc->routes);
-    char *tracks = toString(doc->tracks);
-
-
-    // To avoid any undefined behavior if the strings are empty
-
-    if (waypoints[0] == '\0') {
-        
-        // Free the old pointer
-        free(waypoints);
-
-        // Malloc enough space for the string "NO WAYPOINTS!" with null terminator, and then copy it
-        waypoints = malloc(14);
-        strcpy(waypoints, "NO WAYPOINTS!");
-
-    }
-
-    if (routes[0] == '\0') {
-
-        // Free the old pointer
-        free(routes);
+    StringBuilder sb;
+    initStringBuilder(&sb, 256);
 
-        // Malloc enough space for the string "NO ROUTES!" with null terminator, and then copy it
-        routes = malloc(11);
-        strcpy(routes, "NO ROUTES!");
+    appendFormat(&sb, "\nnamespace: %s\nversion: %g\ncreator: %s\n\n", doc->namespace, doc->version, doc->creator);
 
+    // Write each list straight into the builder, with a placeholder if the list is empty
+    if (getLength(doc->waypoints) == 0) {
+        appendString(&sb, "NO WAYPOINTS!");
+    } else {
+        appendListString(&sb, doc->waypoints, appendWaypointString);
     }
+    appendString(&sb, "\n\n");
 
-    if (tracks[0] == '\0') {
-
-        // Free the old pointer
-        free(tracks);
-
-        // Malloc enough space for the string "NO TRACKS!" with null terminator, and then copy it
-        tracks = malloc(11);
-        strcpy(tracks, "NO TRACKS!");
-
+    if (getLength(doc->routes) == 0) {
+        appendString(&sb, "NO ROUTES!");
+    } else {
+        appendListString(&sb, doc->routes, appendRouteString);
     }
-    
-    // Otherwise malloc enough space for the complete string, which is the length of all the substrings + the length of labels
-    int length = strlen(doc->namespace) + strlen(doc->creator) + strlen(waypoints) + strlen(routes) + strlen(tracks) + 43;
-    char *tmpStr = malloc(length);
-
-    // If the malloc failed
-    if (tmpStr == NULL) {
-
-        free(waypoints);
-        free(routes);
-        free(tracks);
-        free(tmpStr);
-
-        return NULL;
+    appendString(&sb, "\n\n");
 
+    if (getLength(doc->tracks) == 0) {
+        appendString(&sb, "NO TRACKS!");
+    } else {
+        appendListString(&sb, doc->tracks, appendTrackString);
     }
+    appendChar(&sb, '\n');
 
-    // Copy the new string into the return string using sprintf
-    sprintf(tmpStr, "\nnamespace: %s\nversion: %g\ncreator: %s\n\n%s\n\n%s\n\n%s\n", doc->namespace, doc->version, doc->creator, waypoints, routes, tracks);
-
-    // Free the strings retrieved from the toString calls to prevent memory leaks
-    free(waypoints);
-    free(routes);
-    free(tracks);
-
-    // Return the new string
-    return tmpStr;
+    // Return the new string, NULL if an allocation failed
+    return finishStringBuilder(&sb);
 
 }
 
@@ -247,8 +222,15 @@ void deleteGPXdoc(GPXdoc* doc) {
         return;
     }
 
+    // Everything in an arena doc, including the doc itself and any objects it adopted, goes with the arena
+    if (doc->arena != NULL) {
+        destroyArena(doc->arena);
+        return;
+    }
 
     free(doc->creator);
+    deleteGPXIndex(doc->index);
+    deleteNameIndex(doc->names);
 
     freeList(doc->waypoints);
     freeList(doc->routes);
@@ -466,28 +448,8 @@ int getNumGPXData(const GPXdoc* doc) {
 // Return NULL if the waypoint does not exist
 Waypoint *getWaypoint(const GPXdoc* doc, char* name) {
 
-    // If the doc is NULL, or the name is NULL, return NULL
-    if (doc == NULL || name == NULL) {
-        return NULL;
-    }
-
-    // Iterate through the waypoints list
-    void *elem;
-    List *list = doc->waypoints;
-    ListIterator iter = createIterator(list);
-
-	while ((elem = nextElement(&iter)) != NULL) {
-
-        // Cast to Waypoint
-        Waypoint *tmpWpt = (Waypoint *)elem;
-
-        // If a match with the name is found, return the pointer to that element
-        if (strcmp(tmpWpt->name, name) == 0) {
-            return tmpWpt;
-        }
-	}
-
-    return NULL;
+    // The doc's name index finds the first waypoint with the name without a scan
+    return findWaypointByName(doc, name);
 
 }
 
@@ -495,28 +457,7 @@ Waypoint *getWaypoint(const GPXdoc* doc, char* name) {
 // Return NULL if the track does not exist 
 Track *getTrack(const GPXdoc* doc, char* name) {
 
-    // If the doc is NULL, or the name is NULL, return NULL
-    if (doc == NULL || name == NULL) {
-        return NULL;
-    }
-
-    // Iterate through the routes list
-    void *elem;
-    List *list = doc->tracks;
-    ListIterator iter = createIterator(list);
-
-	while ((elem = nextElement(&iter)) != NULL) {
-
-        // Cast to Track
-        Track *tmpTrk = (Track *)elem;
-
-        // If a match with the name is found, return the pointer to that element
-        if (strcmp(tmpTrk->name, name) == 0) {
-            return tmpTrk;
-        }
-	}
-
-    return NULL;
+    return findTrackByName(doc, name);
 
 }
 
@@ -524,28 +465,7 @@ Track *getTrack(const GPXdoc* doc, char* name) {
 // Return NULL if the route does not exist
 Route *getRoute(const GPXdoc* doc, char* name) {
 
-    // If the doc is NULL, or the name is NULL, return NULL
-    if (doc == NULL || name == NULL) {
-        return NULL;
-    }
-
-    // Iterate through the tracks list
-    void *elem;
-    List *list = doc->routes;
-    ListIterator iter = createIterator(list);
-
-	while ((elem = nextElement(&iter)) != NULL) {
-
-        // Cast to Route
-        Route *tmpRte = (Route *)elem;
-
-        // If a match with the name is found, return the pointer to that element
-        if (strcmp(tmpRte->name, name) == 0) {
-            return tmpRte;
-        }
-	}
-
-    return NULL;
+    return findRouteByName(doc, name);
 
 }
 
@@ -572,6 +492,23 @@ void deleteGpxData(void *data) {
     GPXData *tmpData = (GPXData *)data;
     free(tmpData);
 
+}
+void appendListString(StringBuilder *sb, List *list, void (*appendData)(StringBuilder *sb, const void *data)) {
+
+    // Same layout as toString in LinkedListAPI, every element preceded by a newline
+    void *elem;
+    ListIterator iter = createIterator(list);
+    while ((elem = nextElement(&iter)) != NULL) {
+        appendChar(sb, '\n');
+        appendData(sb, elem);
+    }
+
+}
+void appendGpxDataString(StringBuilder *sb, const void *data) {
+
+    const GPXData *tmpData = (const GPXData *)data;
+    appendFormat(sb, "\t\t%s: %s\n", tmpData->name, tmpData->value);
+
 }
 char *gpxDataToString(void *data) {
 
@@ -579,15 +516,11 @@ char *gpxDataToString(void *data) {
         return NULL;
     }
 
-    GPXData *tmpData = (GPXData *)data;
-    
-    int length = strlen(tmpData->name) + strlen(tmpData->value) + 6;
-    char *tmpStr = malloc(length);
-    if (tmpStr == NULL) {
-        return NULL;
-    }
-    sprintf(tmpStr, "\t\t%s: %s\n", tmpData->name, tmpData->value);
-    return tmpStr;
+    StringBuilder sb;
+    initStringBuilder(&sb, 64);
+    appendGpxDataString(&sb, data);
+
+    return finishStringBuilder(&sb);
     
 }
 int compareGpxData(const void *first, const void *second) { return 0; }
@@ -609,6 +542,13 @@ void deleteWaypoint(void *data) {
 
     free(tmpWpt);
 
+}
+void appendWaypointString(StringBuilder *sb, const void *data) {
+
+    const Waypoint *tmpWpt = (const Waypoint *)data;
+    appendFormat(sb, "\tWAYPOINT\n\t\tname: %s | lat: %f | lon: %f\n", tmpWpt->name, tmpWpt->latitude, tmpWpt->longitude);
+    appendListString(sb, tmpWpt->otherData, appendGpxDataString);
+
 }
 char *waypointToString(void *data) {
     
@@ -616,20 +556,11 @@ char *waypointToString(void *data) {
         return NULL;
     }
 
-    Waypoint *tmpWpt = (Waypoint *)data;
-    char *other = toString(tmpWpt->otherData);
-    
-    int length = strlen(tmpWpt->name) + strlen(other) + 76;
-
-    char *tmpStr = malloc(length);
-    if (tmpStr == NULL) {
-        return NULL;
-    }
-    
-    sprintf(tmpStr, "\tWAYPOINT\n\t\tname: %s | lat: %f | lon: %f\n%s", tmpWpt->name, tmpWpt->latitude, tmpWpt->longitude, other);
-    free(other);
+    StringBuilder sb;
+    initStringBuilder(&sb, 128);
+    appendWaypointString(&sb, data);
 
-    return tmpStr;
+    return finishStringBuilder(&sb);
 
 }
 int compareWaypoints(const void *first, const void *second) { return 0; }
@@ -642,10 +573,21 @@ void deleteRoute(void *data) {
 
     Route *tmpRte = (Route *)data;
     free(tmpRte->name);
+    deleteWaypointArray(tmpRte->points);
+    deletePathMetrics(tmpRte->metrics);
     freeList(tmpRte->waypoints);
     freeList(tmpRte->otherData);
     free(tmpRte);
 
+}
+void appendRouteString(StringBuilder *sb, const void *data) {
+
+    const Route *tmpRte = (const Route *)data;
+    appendFormat(sb, "\tROUTE\n\t\tname: %s\n", tmpRte->name);
+    appendListString(sb, tmpRte->waypoints, appendWaypointString);
+    appendChar(sb, '\n');
+    appendListString(sb, tmpRte->otherData, appendGpxDataString);
+
 }
 char *routeToString(void *data) {
 
@@ -653,23 +595,11 @@ char *routeToString(void *data) {
         return NULL;
     }
 
-    Route *tmpRte = (Route *)data;
-
-    char *waypoints = toString(tmpRte->waypoints);
-    char *other = toString(tmpRte->otherData);
-
-    int length = strlen(tmpRte->name) + strlen(waypoints) + strlen(other) + 18;
-    char *tmpStr = malloc(length);
-    if (tmpStr == NULL) {
-        return NULL;
-    }
-    
-    sprintf(tmpStr, "\tROUTE\n\t\tname: %s\n%s\n%s", tmpRte->name, waypoints, other);
-    free(waypoints);
-    free(other);
+    StringBuilder sb;
+    initStringBuilder(&sb, 256);
+    appendRouteString(&sb, data);
 
-    return tmpStr;
-    
+    return finishStringBuilder(&sb);
 
 }
 int compareRoutes(const void *first, const void *second) { return 0; }
@@ -681,9 +611,17 @@ void deleteTrackSegment(void *data) {
     }
 
     TrackSegment *tmpTrkSeg = (TrackSegment *)data;
+    deleteWaypointArray(tmpTrkSeg->points);
     freeList(tmpTrkSeg->waypoints);
     free(tmpTrkSeg);
 
+}
+void appendTrackSegmentString(StringBuilder *sb, const void *data) {
+
+    const TrackSegment *tmpTrkSeg = (const TrackSegment *)data;
+    appendString(sb, "\tTRACK SEGMENT\n");
+    appendListString(sb, tmpTrkSeg->waypoints, appendWaypointString);
+
 }
 char *trackSegmentToString(void *data) {
     
@@ -691,20 +629,11 @@ char *trackSegmentToString(void *data) {
         return NULL;
     }
 
-    TrackSegment *tmpTrkSeg = (TrackSegment *)data;
-    char *waypoints = toString(tmpTrkSeg->waypoints);
-
-    int length = strlen(waypoints) + 16;
-
-    char *tmpStr = malloc(length);
-    if (tmpStr == NULL) {
-        return NULL;
-    }
-    
-    sprintf(tmpStr, "\tTRACK SEGMENT\n%s", waypoints);
-    free(waypoints);
+    StringBuilder sb;
+    initStringBuilder(&sb, 256);
+    appendTrackSegmentString(&sb, data);
 
-    return tmpStr;
+    return finishStringBuilder(&sb);
 
 }
 int compareTrackSegments(const void *first, const void *second) { return 0; }
@@ -717,10 +646,20 @@ void deleteTrack(void *data) {
 
     Track *tmpTrk = (Track *)data;
     free(tmpTrk->name);
+    deletePathMetrics(tmpTrk->metrics);
     freeList(tmpTrk->segments);
     freeList(tmpTrk->otherData);
     free(tmpTrk);
 
+}
+void appendTrackString(StringBuilder *sb, const void *data) {
+
+    const Track *tmpTrk = (const Track *)data;
+    appendFormat(sb, "\tTRACK\n\t\tname: %s\n\n", tmpTrk->name);
+    appendListString(sb, tmpTrk->segments, appendTrackSegmentString);
+    appendString(sb, "\n\n");
+    appendListString(sb, tmpTrk->otherData, appendGpxDataString);
+
 }
 char *trackToString(void *data) {
 
@@ -728,36 +667,17 @@ char *trackToString(void *data) {
         return NULL;
     }
 
-    Track *tmpTrk = (Track *)data;
-    char *segments = toString(tmpTrk->segments);
-    char *other = toString(tmpTrk->otherData);
-
-    int length = strlen(tmpTrk->name) + strlen(segments) + strlen(other) + 20;
-
-    char *tmpStr = malloc(length);
-    if (tmpStr == NULL) {
-        return NULL;
-    }
-    
-    sprintf(tmpStr, "\tTRACK\n\t\tname: %s\n\n%s\n\n%s", tmpTrk->name, segments, other);
-    free(segments);
-    free(other);
+    StringBuilder sb;
+    initStringBuilder(&sb, 256);
+    appendTrackString(&sb, data);
 
-    return tmpStr;
+    return finishStringBuilder(&sb);
 
 }
 int compareTracks(const void *first, const void *second) { return 0; }
 
-// Create a GPXdoc struct if a valid file is provided, validated by a schema file
-GPXdoc *createValidGPXdoc(char* fileName, char *gpxSchemaFile) {
-
-    // Initialize a xmlDoc variable
-    xmlDoc *doc = NULL;
-
-    // If the user enters no filename, return NULL
-    if (fileName == NULL || gpxSchemaFile == NULL) {
-        return NULL;
-    }
+// Create a GPXdoc struct if a valid file is provided, validated by a schema file. Sets bytes to the bytes of XML read
+static GPXdoc *readValidGPXFile(char* fileName, char *gpxSchemaFile, long *bytes) {
 
     /*
      * this initialize the library and check potential ABI mismatches
@@ -768,143 +688,77 @@ GPXdoc *createValidGPXdoc(char* fileName, char *gpxSchemaFile) {
      */
     LIBXML_TEST_VERSION
 
-    // Calls the xmlReadFile function to get a parse-able tree
-    doc = xmlReadFile(fileName, NULL, 0);
-
-    // If the function failed for any reason, it will return NULL
-    if (doc == NULL) {
-
-        // Free doc and cleanup any variables that could have been used by the XML parser
-        xmlFreeDoc(doc);
-        xmlCleanupParser();
-
-        return NULL;
+    // A binary image made from this file and schema already holds the valid GPXdoc, no need to parse it again
+    uint64_t spanStart = beginTraceSpan();
+    GPXdoc *cachedDoc = loadCachedGPXdoc(fileName, gpxSchemaFile);
+    endTraceSpan("loadCachedGPXdoc", spanStart);
 
+    if (cachedDoc != NULL) {
+        return cachedDoc;
     }
 
-    xmlSchema *schema = NULL;
+    // Borrow the compiled schema from the cache instead of parsing the .xsd again
+    spanStart = beginTraceSpan();
+    xmlSchema *schema = acquireSchema(gpxSchemaFile);
+    endTraceSpan("acquireSchema", spanStart);
 
-    xmlLineNumbersDefault(1);
-
-    xmlSchemaParserCtxt *newCtxt = xmlSchemaNewParserCtxt(gpxSchemaFile);
-
-    schema = xmlSchemaParse(newCtxt);
-    xmlSchemaFreeParserCtxt(newCtxt);
-
-    xmlSchemaValidCtxt *ctxt = xmlSchemaNewValidCtxt(schema);
-    int ret = xmlSchemaValidateDoc(ctxt, doc);
-    xmlSchemaFreeValidCtxt(ctxt);
-    xmlSchemaFree(schema);
-    xmlSchemaCleanupTypes();
-
-    if (ret != 0) {
-        xmlFreeDoc(doc);
-        xmlCleanupParser();
+    if (schema == NULL) {
         return NULL;
     }
 
-    // Initialize a new xmlNode to the root element of the returned tree
-    xmlNode *root_node = xmlDocGetRootElement(doc);
-
-    // If the tree is empty, or if it is not a gpx file
-    if (root_node == NULL || strcmp((const char *) root_node->name, "gpx") != 0) {
-
-        // Free doc and cleanup any variables used by the parser
-        xmlFreeDoc(doc);
-        xmlCleanupParser();
-
+    xmlTextReader *reader = xmlReaderForFile(fileName, NULL, 0);
+    if (reader == NULL) {
+        releaseSchema(schema);
         return NULL;
-
     }
 
-    // Malloc space for a new GPXdoc struct
-    GPXdoc *newDoc = malloc(sizeof(GPXdoc));
-    
-    // Checking if namespace exists and is not an empty string (which makes the file invalid)
-    if (root_node->ns == NULL || root_node->ns->href == NULL || strcmp((const char *)root_node->ns->href, "") == 0) {
-
-        // Freeing
-        xmlFreeDoc(doc);
-        xmlCleanupParser();
-        free(newDoc);
-
+    // Attach the schema to the reader, so the file is validated while the GPXdoc is built from it,
+    // in a single read of the file and without a DOM
+    if (xmlTextReaderSetSchema(reader, schema) != 0) {
+        xmlFreeTextReader(reader);
+        releaseSchema(schema);
         return NULL;
-
     }
 
-    // Otherwise, copy namespace into the struct
-    strcpy(newDoc->namespace, (const char *) root_node->ns->href);
-
-    // Flag variables to keep track of if the doc has a version and creator
-    int versionCheck = 0, creatorCheck = 0;
-
-    // Declaring an attribute iterator
-    xmlAttr *attr;
-
-    // Looping through all the attributes of the root node, until NULL is hit
-    for (attr = root_node->properties; attr != NULL; attr = attr->next) {
-
-        // Setting the value, name and content variables
-        xmlNode *value = attr->children;
-        char *attrName = (char *)attr->name;
-        char *cont = (char *)(value->content);
-
-        // If the version attribute is found
-        if (strcmp(attrName, "version") == 0) {
-
-            // Version flag is set to 1
-            versionCheck++;
-
-            // Copy the double value of content into the struct, using atof
-            newDoc->version = atof(cont);
-
-        } else if (strcmp(attrName, "creator") == 0) { // If the creator attribute is found
-
-            // Creator flag is set to 1
-            creatorCheck++;
+    GPXdoc *newDoc = readGPXdoc(reader);
 
-            // Mallocing enough space for creator, and then copying it into the struct
-            newDoc->creator = malloc(strlen(cont) + 1);
-            strcpy(newDoc->creator, cont);
-
-        }
+    // readGPXdoc reads to the end of the file, so every validation error has been seen by now
+    if (newDoc != NULL && xmlTextReaderIsValid(reader) != 1) {
+        deleteGPXdoc(newDoc);
+        newDoc = NULL;
     }
 
-    // If no creator attribute
-    if (creatorCheck == 0) {
+    *bytes = xmlTextReaderByteConsumed(reader);
 
-        // Freeing
-        xmlFreeDoc(doc);
-        xmlCleanupParser();
-        free(newDoc);
+    // libxml2's global state is kept alive for the cached schemas and is only torn down by cleanupSchemaCache
+    xmlFreeTextReader(reader);
+    releaseSchema(schema);
 
-        return NULL;
+    // Keep the result next to the file, so the next load can skip the parse
+    spanStart = beginTraceSpan();
+    saveCachedGPXdoc(newDoc, fileName, gpxSchemaFile);
+    endTraceSpan("saveCachedGPXdoc", spanStart);
 
-    } else if (versionCheck == 0) { // If no version attribute
+    // Return a pointer to the new GPXDoc struct, so we can change it later on
+    return newDoc;
 
-        // Freeing
-        xmlFreeDoc(doc);
-        xmlCleanupParser();
-        free(newDoc->creator); // Free creator too
-        free(newDoc);
+}
 
-        return NULL;
+GPXdoc *createValidGPXdoc(char* fileName, char *gpxSchemaFile) {
 
+    // If the user enters no filename, return NULL
+    if (fileName == NULL || gpxSchemaFile == NULL) {
+        return NULL;
     }
 
-    // Initialize all the lists in the struct, because they can't be NULL
-    newDoc->waypoints = initializeList(&waypointToString, &deleteWaypoint, &compareWaypoints);
-    newDoc->routes = initializeList(&routeToString, &deleteRoute, &compareRoutes);
-    newDoc->tracks = initializeList(&trackToString, &deleteTrack, &compareTracks);
+    uint64_t statStart = startParserStat();
 
-    // Call recursiveReader to input all the other information into the doc
-    recursiveReader(root_node, newDoc);
+    // Stays 0 if the doc came from its binary image, or the file could not be read
+    long bytes = 0;
+    GPXdoc *newDoc = readValidGPXFile(fileName, gpxSchemaFile, &bytes);
 
-    // Freeing the tree (since we have a parsed struct now) and cleanup any variables used/allocated by the parser
-    xmlFreeDoc(doc);
-    xmlCleanupParser();
+    endParserStat(STAT_CREATE_VALID_GPXDOC, statStart, bytes > 0 ? bytes : 0);
 
-    // Return a pointer to the new GPXDoc struct, so we can change it later on
     return newDoc;
 
 }
@@ -924,34 +778,17 @@ bool validateGPXDoc(GPXdoc *doc, char *gpxSchemaFile) {
         return false;
     }
 
-    // Try and convert the GPXdoc struct to an XML tree, if it fails, return false
-    xmlDoc *tmpDoc = gpxDocToXMLDoc(doc);
-    if (tmpDoc == NULL) {
+    xmlSchema *schema = acquireSchema(gpxSchemaFile);
+    if (schema == NULL) {
         return false;
     }
 
-    // Validation the same as in the previous function, using the XML struct
-    xmlSchema *schema = NULL;
-    xmlSchemaParserCtxt *newCtxt = NULL;
+    // Write the GPXdoc as XML straight into a validating parser instead of converting it to an XML tree first.
+    // Fails if the doc cannot be written
+    bool valid = validateGPXdocStream(doc, schema);
+    releaseSchema(schema);
 
-    xmlLineNumbersDefault(1);
-
-    newCtxt = xmlSchemaNewParserCtxt(gpxSchemaFile);
-
-    schema = xmlSchemaParse(newCtxt);
-    xmlSchemaFreeParserCtxt(newCtxt);
-
-    xmlSchemaValidCtxt *ctxt = xmlSchemaNewValidCtxt(schema);
-    int ret = xmlSchemaValidateDoc(ctxt, tmpDoc);
-    xmlSchemaFreeValidCtxt(ctxt);
-    xmlSchemaFree(schema);
-    xmlSchemaCleanupTypes();
-
-
-    xmlFreeDoc(tmpDoc);
-    xmlCleanupParser();
-
-    if (ret != 0) {
+    if (!valid) {
         return false;
     }
 
@@ -990,23 +827,16 @@ bool writeGPXdoc(GPXdoc *doc, char *fileName) {
         return false;
     }
 
-    xmlDoc *tmpDoc = gpxDocToXMLDoc(doc);
-    if (tmpDoc == NULL) {
-        return false;
-    }
+    uint64_t statStart = startParserStat();
 
-    // Try and save the file, return false if it failed
-    if (xmlSaveFormatFileEnc(fileName, tmpDoc, "UTF-8", 1) == -1) {
-        xmlFreeDoc(tmpDoc);
-        xmlCleanupParser();
-        return false;
-    }
+    // Stream the XML straight to the file, with the indentation xmlSaveFormatFileEnc gave it, instead of building a
+    // DOM of the whole doc first
+    long written = writeGPXdocToFile(doc, fileName, true);
 
-    // Freeing
-    xmlFreeDoc(tmpDoc);
-    xmlCleanupParser();
+    // Failed writes are counted too, with no bytes
+    endParserStat(STAT_WRITE_GPXDOC, statStart, written > 0 ? written : 0);
 
-    return true;
+    return written >= 0;
 
 }
 
@@ -1017,7 +847,9 @@ float getRouteLen (const Route *rt) {
         return 0.0;
     }
 
-    return getTotalWaypointsLen(rt->waypoints);
+    const PathMetrics *metrics = getRouteMetrics(rt);
+
+    return metrics != NULL ? metrics->length : 0.0;
 
 }
 
@@ -1028,7 +860,9 @@ float getTrackLen (const Track *tr) {
         return 0.0;
     }
 
-    return getTotalTrackSegLen(tr->segments);
+    const PathMetrics *metrics = getTrackMetrics(tr);
+
+    return metrics != NULL ? metrics->length : 0.0;
 
 }
 
@@ -1046,70 +880,54 @@ float round10 (float len) {
 // Function to find the number of routes with a specific length ± delta value
 int numRoutesWithLength(const GPXdoc* doc, float len, float delta) {
 
-    int total = 0;
-
     // Error checking
     if (doc == NULL || len < 0 || delta < 0) {
-        return total;
+        return 0;
     }
 
     if (doc->routes == NULL) {
-        return total;
+        return 0;
     }
 
-    void *elem;
-    List *routeList = doc->routes;
-    ListIterator routeIter = createIterator(routeList);
-
-    // Loop through all routes in the doc
-	while ((elem = nextElement(&routeIter)) != NULL) {
-
-        // Cast to Route
-        Route *tmpRte = (Route *)elem;
-
-        float length = getRouteLen(tmpRte);
-
-        // If the lengths are within delta of each other, increment count
-        if (fabs(length - len) <= delta) {
-            total++;
-        }
-
-	}
-    
-    return total;
+    // The doc's index keeps the route lengths sorted, so the count is two binary searches
+    return countRoutesWithLength(getGPXIndex(doc), len, delta);
     
 }
 
 // Same as the last function, except for tracks instead
 int numTracksWithLength(const GPXdoc* doc, float len, float delta) {
 
-    int total = 0;
-
     if (doc == NULL || len < 0 || delta < 0) {
-        return total;
+        return 0;
     }
 
     if (doc->tracks == NULL) {
-        return total;
+        return 0;
     }
 
-    void *elem;
-    List *trackList = doc->tracks;
-    ListIterator trackIter = createIterator(trackList);
+    return countTracksWithLength(getGPXIndex(doc), len, delta);
 
-	while ((elem = nextElement(&trackIter)) != NULL) {
+}
 
-        Track *tmpTrk = (Track *)elem;
+// Get a list of the routes counted by numRoutesWithLength
+List *getRoutesWithLength(const GPXdoc* doc, float len, float delta) {
 
-        float length = getTrackLen(tmpTrk);
+    if (doc == NULL || doc->routes == NULL || len < 0 || delta < 0) {
+        return NULL;
+    }
 
-        if (fabs(length - len) <= delta) {
-            total++;
-        }
+    return findRoutesWithLength(getGPXIndex(doc), len, delta);
 
-	}
-    
-    return total;
+}
+
+// Same as the last function, except for tracks
+List *getTracksWithLength(const GPXdoc* doc, float len, float delta) {
+
+    if (doc == NULL || doc->tracks == NULL || len < 0 || delta < 0) {
+        return NULL;
+    }
+
+    return findTracksWithLength(getGPXIndex(doc), len, delta);
 
 }
 
@@ -1124,20 +942,11 @@ bool isLoopRoute(const Route* route, float delta) {
         return false;
     }
 
-    if (getLength(route->waypoints) < 4) {
-        return false;
-    }
-
-    // Get the first and last points in the route
-    Waypoint *tmpWpt1 = getFromFront(route->waypoints);
-    Waypoint *tmpWpt2 = getFromBack(route->waypoints);
+    // The distance between the first and last point is kept with the route's length, -1 if it has fewer than 4 points
+    const PathMetrics *metrics = getRouteMetrics(route);
 
     // If the distance is within delta, it is a loop
-    if (haversine(tmpWpt1->latitude, tmpWpt1->longitude, tmpWpt2->latitude, tmpWpt2->longitude) < delta) {
-        return true;
-    }
-
-    return false;
+    return metrics != NULL && metrics->endDistance >= 0 && metrics->endDistance < delta;
 
 }
 
@@ -1152,38 +961,11 @@ bool isLoopTrack(const Track *tr, float delta) {
         return false;
     }
 
-    int totalLength = 0;
+    // Distance from the first point of the first segment to the last point of the last segment, -1 if the track has
+    // fewer than 4 points in total or either of those segments is empty
+    const PathMetrics *metrics = getTrackMetrics(tr);
 
-    void *elem;
-    List *trackSegList = tr->segments;
-    ListIterator trackSegIter = createIterator(trackSegList);
-
-    // Count the total number of track points (in all segments), to see if there is more than 4
-    while((elem = nextElement(&trackSegIter)) != NULL) {
-
-        TrackSegment *tmpTrkSeg = (TrackSegment *)elem;
-        totalLength += getLength(tmpTrkSeg->waypoints);
-
-    }
-
-    if (totalLength < 4) {
-        return false;
-    }
-
-    // Get first point from first segment
-    TrackSegment *tmpSeg1 = getFromFront(tr->segments);
-    Waypoint *tmpWpt1 = getFromFront(tmpSeg1->waypoints);
-
-    // Get last point from last segment
-    TrackSegment *tmpSeg2 = getFromBack(tr->segments);
-    Waypoint *tmpWpt2 = getFromBack(tmpSeg2->waypoints);
-
-    // If the distance is within delta of each other, it is a loop
-    if (haversine(tmpWpt1->latitude, tmpWpt1->longitude, tmpWpt2->latitude, tmpWpt2->longitude) < delta) {
-        return true;
-    }
-
-    return false;
+    return metrics != NULL && metrics->endDistance >= 0 && metrics->endDistance < delta;
 
 }
 
@@ -1194,45 +976,8 @@ List *getRoutesBetween(const GPXdoc* doc, float sourceLat, float sourceLong, flo
         return NULL;
     }
 
-    // Initialize new list, with a dummy delete, so it will not delete the originals when freed
-    List *tmpList = initializeList(&routeToString, &dummyDelete, &compareRoutes);
-
-    void *elem;
-    List *routeList = doc->routes;
-    ListIterator routeIter = createIterator(routeList);
-
-    int count = 0;
-	while ((elem = nextElement(&routeIter)) != NULL) {
-
-        Route *tmpRte = (Route *)elem;
-
-        Waypoint *tmpWpt1 = getFromFront(tmpRte->waypoints);
-        if (tmpWpt1 == NULL) {
-            continue;
-        }
-
-        // If the distance between the source latitude and longitude, and the first point of the route is within delta, check the last points as well
-        if (haversine(tmpWpt1->latitude, tmpWpt1->longitude, sourceLat, sourceLong) <= delta) {
-
-            Waypoint *tmpWpt2 = getFromBack(tmpRte->waypoints);
-
-            // If the last points are also within delta of each other, then add to the list
-            if (haversine(tmpWpt2->latitude, tmpWpt2->longitude, destLat, destLong) <= delta) {
-                insertBack(tmpList, tmpRte);
-                count++;
-            }
-
-        }
-
-	}
-
-    // If the list is empty, free it and return NULL
-    if (count == 0) {
-        freeList(tmpList);
-        return NULL;
-    }
-
-    return tmpList;
+    // The doc's index narrows the routes down to the ones that start near the source before the exact check
+    return findRoutesBetween(getGPXIndex(doc), sourceLat, sourceLong, destLat, destLong, delta);
 
 }
 
@@ -1243,269 +988,178 @@ List *getTracksBetween(const GPXdoc* doc, float sourceLat, float sourceLong, flo
         return NULL;
     }
 
-    List *tmpList = initializeList(&trackToString, &dummyDelete, &compareTracks);
-
-    void *elem;
-    List *trackList = doc->tracks;
-    ListIterator trackIter = createIterator(trackList);
-
-    int count = 0;
-	while ((elem = nextElement(&trackIter)) != NULL) {
-
-
-        Track *tmpTrk = (Track *)elem;
-
-        TrackSegment *tmpSeg1 = getFromFront(tmpTrk->segments);
-        if (tmpSeg1 == NULL) {
-            continue;
-        }
-
-        Waypoint *tmpWpt1 = getFromFront(tmpSeg1->waypoints);
-        if (tmpWpt1 == NULL) {
-            continue;
-        }
-
-        if (haversine(tmpWpt1->latitude, tmpWpt1->longitude, sourceLat, sourceLong) <= delta) {
+    return findTracksBetween(getGPXIndex(doc), sourceLat, sourceLong, destLat, destLong, delta);
 
-            TrackSegment *tmpSeg2 = getFromBack(tmpTrk->segments);
-            Waypoint *tmpWpt2 = getFromBack(tmpSeg2->waypoints);
+}
 
-            if (haversine(tmpWpt2->latitude, tmpWpt2->longitude, destLat, destLong) <= delta) {
-                insertBack(tmpList, tmpTrk);
-                count++;
-            }
+// Write a track in JSON format into a string builder
+void appendTrackJSON(StringBuilder *sb, const Track *tr) {
 
-        }
+    // If the track is NULL, write an empty JSON 'object'
+    if (tr == NULL) {
+        appendString(sb, "{}");
+        return;
+    }
 
-	}
+    // If the track has no name, the name becomes "None"
+    const char *name = tr->name[0] == '\0' ? "None" : tr->name;
 
-    if (count == 0) {
-        freeList(tmpList);
-        return NULL;
-    }
-    
-    return tmpList;
+    appendFormat(sb, "{\"name\":\"%s\",\"len\":%.1f,\"loop\":%s}", name, round10(getTrackLen(tr)), isLoopTrack(tr, 10) ? "true" : "false");
 
 }
 
 // Convert a track to a string in JSON format
 char *trackToJSON(const Track *tr) {
 
-    // Malloc enough space for the brackets and null terminator
-    int totalLength = 3;
-    char *retString = malloc(totalLength);
+    uint64_t statStart = startParserStat();
 
-    // If the track is NULL, return an empty JSON 'object'
-    if (tr == NULL) {
-        strcpy(retString, "{}");
-        return retString;
-    }
+    StringBuilder sb;
+    initStringBuilder(&sb, 64);
+    appendTrackJSON(&sb, tr);
 
-    char *tmpName;
-    // If the track has no name
-    if (tr->name[0] == '\0') {
-        // Realloc space for 4 extra characters
-        retString = realloc(retString, totalLength + 4);
-        tmpName = malloc(5);
-        // name becomes "None"
-        strcpy(tmpName, "None");
-    } else {
-        // Otherwise realloc enough space for the name, and copy the name into tmpName
-        int nameLength = strlen(tr->name);
-        totalLength += nameLength;
-        retString = realloc(retString, totalLength);
-        tmpName = malloc(nameLength + 1);
-        strcpy(tmpName, tr->name);
-    }
+    return endJSONStat(STAT_TRACK_TO_JSON, statStart, finishStringBuilder(&sb));
 
-    // Track length should have maximum 100 chars
+}
 
-    if (isLoopTrack(tr, 10)) {
-        totalLength += 4; // For true
-    } else {
-        totalLength += 5; // For false
-    }
-    totalLength += 124; // For the labels
+// Write the fields of a route JSON object, without the braces, so other functions can add fields of their own
+void appendRouteJSONFields(StringBuilder *sb, const Route *rt) {
 
-    // Realloc the total length
-    retString = realloc(retString, totalLength);
+    const char *name = rt->name[0] == '\0' ? "None" : rt->name;
 
-    // Copy the string in
-    sprintf(retString, "{\"name\":\"%s\",\"len\":%.1f,\"loop\":%s}", tmpName, round10(getTrackLen(tr)), isLoopTrack(tr, 10) ? "true" : "false");
-
-    // Free temp name variable
-    free(tmpName);
-    
-    return retString;
+    appendFormat(sb, "\"name\":\"%s\",\"numPoints\":%d,\"len\":%.1f,\"loop\":%s", name, getLength(rt->waypoints), round10(getRouteLen(rt)), isLoopRoute(rt, 10) ? "true" : "false");
 
 }
 
-// Same as the last function but for route, so different fields
-char *routeToJSON(const Route *rt) {
-
-    int totalLength = 3;
-    char *retString = malloc(totalLength);
+// Write a route in JSON format into a string builder
+void appendRouteJSON(StringBuilder *sb, const Route *rt) {
 
     if (rt == NULL) {
-        strcpy(retString, "{}");
-        return retString;
+        appendString(sb, "{}");
+        return;
     }
 
-    char *tmpName;
-    if (rt->name[0] == '\0') {
-        retString = realloc(retString, totalLength + 4);
-        tmpName = malloc(5);
-        strcpy(tmpName, "None");
-    } else {
-        int nameLength = strlen(rt->name);
-        totalLength += nameLength;
-        retString = realloc(retString, totalLength);
-        tmpName = malloc(nameLength + 1);
-        strcpy(tmpName, rt->name);
-    }
+    appendChar(sb, '{');
+    appendRouteJSONFields(sb, rt);
+    appendChar(sb, '}');
 
-    // numPoints number should have maximum 100 chars
-    // same for routeLen
+}
 
-    if (isLoopRoute(rt, 10)) {
-        totalLength += 4; // For true
-    } else {
-        totalLength += 5; // for false
-    }
-    totalLength += 237; // For the labels
+// Same as the last function but for route, so different fields
+char *routeToJSON(const Route *rt) {
 
-    retString = realloc(retString, totalLength);
-    sprintf(retString, "{\"name\":\"%s\",\"numPoints\":%d,\"len\":%.1f,\"loop\":%s}", tmpName, getLength(rt->waypoints), round10(getRouteLen(rt)), isLoopRoute(rt, 10) ? "true" : "false");
-    
-    free(tmpName);
+    uint64_t statStart = startParserStat();
 
-    return retString;
+    StringBuilder sb;
+    initStringBuilder(&sb, 96);
+    appendRouteJSON(&sb, rt);
+
+    return endJSONStat(STAT_ROUTE_TO_JSON, statStart, finishStringBuilder(&sb));
     
 }
 
-// Convert a route list to a JSON string
-char *routeListToJSON(const List *list) {
+// Write a route list in JSON format into a string builder. Not counted in the statistics itself, so the functions
+// that use it for part of their output only count their own stage
+static void appendRouteListJSON(StringBuilder *sb, const List *list) {
 
-    // Malloc enough space for the brackets
-    int totalLength = 3;
-    char *retString = malloc(totalLength);
-
-    // If the list is empty, copy in the brackets and return
+    // If the list is empty, the result is just the brackets
     if (list == NULL) {
-        strcpy(retString, "[]");
-        return retString;
+        appendString(sb, "[]");
+        return;
     }
 
     void *elem;
-    List *routeList = (List *)list;
-    ListIterator routeIter = createIterator(routeList);
+    ListIterator routeIter = createIterator((List *)list);
 
     // Start the list with the first bracket
-    strcpy(retString, "[");
+    appendChar(sb, '[');
 
-    int lastIndex = getLength(routeList) - 1;
     int i = 0;
 	while ((elem = nextElement(&routeIter)) != NULL) {
 
-        // Cast to Route
-        Route *tmpRte = (Route *)elem;
+        // Separate the routes with commas
+        if (i > 0) {
+            appendChar(sb, ',');
+        }
 
         // Convert the route to JSON using previous function
-        char *routeJSONString = routeToJSON(tmpRte);
-        int lengthOfJSONString = strlen(routeJSONString);
-
-        // If it is not the last route, then copy a comma after every string
-        if (i != lastIndex) {
-            totalLength += lengthOfJSONString + 1; // 1 for the comma
-            retString = realloc(retString, totalLength);
-            strcat(retString, routeJSONString);
-            strcat(retString, ",");
-        } else {
-            totalLength += lengthOfJSONString;
-            retString = realloc(retString, totalLength);
-            strcat(retString, routeJSONString);
-        }
-        free(routeJSONString);
+        appendRouteJSON(sb, (Route *)elem);
 
         i++;
 
 	}
 
-    // Close the list and return
-    strcat(retString, "]");
+    // Close the list
+    appendChar(sb, ']');
 
-    return retString;
+}
+
+// Convert a route list to a JSON string
+char *routeListToJSON(const List *list) {
+
+    uint64_t statStart = startParserStat();
+
+    StringBuilder sb;
+    initStringBuilder(&sb, 256);
+    appendRouteListJSON(&sb, list);
+
+    return endJSONStat(STAT_ROUTE_LIST_TO_JSON, statStart, finishStringBuilder(&sb));
 
 }
 
 // Same as previous function, except for lists of tracks
 char *trackListToJSON(const List *list) {
 
-    int totalLength = 3;
-    char *retString = malloc(totalLength);
+    uint64_t statStart = startParserStat();
+
+    StringBuilder sb;
+    initStringBuilder(&sb, 256);
 
     if (list == NULL) {
-        strcpy(retString, "[]");
-        return retString;
+        appendString(&sb, "[]");
+        return endJSONStat(STAT_TRACK_LIST_TO_JSON, statStart, finishStringBuilder(&sb));
     }
 
     void *elem;
-    List *trackList = (List *)list;
-    ListIterator trackIter = createIterator(trackList);
+    ListIterator trackIter = createIterator((List *)list);
 
-    strcpy(retString, "[");
+    appendChar(&sb, '[');
 
-    int lastIndex = getLength(trackList) - 1;
     int i = 0;
 	while ((elem = nextElement(&trackIter)) != NULL) {
 
-        Track *tmpTrk = (Track *)elem;
-
-        char *trackJSONString = trackToJSON(tmpTrk);
-        int lengthOfJSONString = strlen(trackJSONString);
-
-        if (i != lastIndex) {
-            totalLength += lengthOfJSONString + 1;
-            retString = realloc(retString, totalLength);
-            strcat(retString, trackJSONString);
-            strcat(retString, ",");
-        } else {
-            totalLength += lengthOfJSONString;
-            retString = realloc(retString, totalLength);
-            strcat(retString, trackJSONString);
+        if (i > 0) {
+            appendChar(&sb, ',');
         }
-        free(trackJSONString);
+
+        appendTrackJSON(&sb, (Track *)elem);
 
         i++;
 
 	}
 
-    strcat(retString, "]");
+    appendChar(&sb, ']');
 
-    return retString;
+    return endJSONStat(STAT_TRACK_LIST_TO_JSON, statStart, finishStringBuilder(&sb));
 
 }
 
 // Convert a GPX doc to JSON string
 char *GPXtoJSON(const GPXdoc *gpx) {
 
-    int totalLength = 3;
-    char *retString = malloc(totalLength);
+    uint64_t statStart = startParserStat();
+
+    StringBuilder sb;
+    initStringBuilder(&sb, 128);
 
     // Error checking
     if (gpx == NULL || gpx->creator == NULL || gpx->creator[0] == '\0') {
-        strcpy(retString, "{}");
-        return retString;
+        appendString(&sb, "{}");
+        return endJSONStat(STAT_GPX_TO_JSON, statStart, finishStringBuilder(&sb));
     }
 
-    // Version number should have maximum 100 chars
-
-    totalLength += 464 + strlen(gpx->creator); // For the labels and 300 for the other 3 numbers
-    retString = realloc(retString, totalLength);
+    appendFormat(&sb, "{\"version\":%g,\"creator\":\"%s\",\"numWaypoints\":%d,\"numRoutes\":%d,\"numTracks\":%d}", gpx->version, gpx->creator, getNumWaypoints(gpx), getNumRoutes(gpx), getNumTracks(gpx));
 
-    sprintf(retString, "{\"version\":%g,\"creator\":\"%s\",\"numWaypoints\":%d,\"numRoutes\":%d,\"numTracks\":%d}", gpx->version, gpx->creator, getNumWaypoints(gpx), getNumRoutes(gpx), getNumTracks(gpx));
-
-    return retString;
+    return endJSONStat(STAT_GPX_TO_JSON, statStart, finishStringBuilder(&sb));
 
 }
 
@@ -1518,6 +1172,19 @@ void addWaypoint(Route *rt, Waypoint *pt) {
 
     insertBack(rt->waypoints, pt);
 
+    // The packed points and the metrics no longer match the list, they are rebuilt by the next query. The end point
+    // of the route just changed, so the index of its doc is stale too
+    rt->generation++;
+    if (rt->docGeneration != NULL) {
+        (*rt->docGeneration)++;
+    }
+
+    invalidateWaypointArray(rt->waypoints, &rt->points);
+    invalidatePathMetrics(rt->waypoints, &rt->metrics);
+
+    // If the route belongs to an arena doc, the arena now frees the point with the doc
+    arenaAdopt(getListArena(rt->waypoints), pt, &deleteWaypoint);
+
 }
 
 // Add a route to a GPXdoc
@@ -1527,7 +1194,12 @@ void addRoute(GPXdoc *doc, Route *rt) {
         return;
     }
 
-    insertBack(doc->routes, rt);
+    insertRoute(doc, rt);
+    doc->generation++;
+
+    arenaAdopt(doc->arena, rt, &deleteRoute);
+
+    addRouteToNameIndex(doc, rt);
 
 }
 
@@ -1538,22 +1210,24 @@ GPXdoc *JSONtoGPX(const char *gpxString) {
         return NULL;
     }
 
-    char *tmpStr = malloc(strlen(gpxString) + 1);
-    strcpy(tmpStr, gpxString);
-
-    GPXdoc *newGPXDoc = malloc(sizeof(GPXdoc));
+    // The new doc gets its own arena, like the ones the loaders create
+    GPXdoc *newGPXDoc = newGPXdoc(createArena());
     if (newGPXDoc == NULL) {
         return NULL;
     }
 
+    char *tmpStr = malloc(strlen(gpxString) + 1);
+    strcpy(tmpStr, gpxString);
+
     // The separators to get only the values
     char separators[6] = "{}:,\"";
-    char *token = strtok(tmpStr, separators);
+    char *savePtr = NULL;
+    char *token = strtok_r(tmpStr, separators, &savePtr);
     int i = 0;
     char tokens[4][100];
     while (token != NULL) {
         strcpy(tokens[i], token);
-        token = strtok(NULL, separators);
+        token = strtok_r(NULL, separators, &savePtr);
         i++;
     }
     free(tmpStr);
@@ -1562,19 +1236,13 @@ GPXdoc *JSONtoGPX(const char *gpxString) {
         if (strcmp(tokens[j], "version") == 0) {
             newGPXDoc->version = atof(tokens[j + 1]);
         } else if (strcmp(tokens[j], "creator") == 0) {
-            newGPXDoc->creator = malloc(strlen(tokens[j + 1]) + 1);
-            strcpy(newGPXDoc->creator, tokens[j + 1]);
+            newGPXDoc->creator = copyString(newGPXDoc->arena, tokens[j + 1]);
         }
     }
 
     // Namespace will always be the same
     strcpy(newGPXDoc->namespace, "http://www.topografix.com/GPX/1/1");
 
-    // Initialize lists
-    newGPXDoc->waypoints = initializeList(&waypointToString, &deleteWaypoint, &compareWaypoints);
-    newGPXDoc->routes = initializeList(&routeToString, &deleteRoute, &compareRoutes);
-    newGPXDoc->tracks = initializeList(&trackToString, &deleteTrack, &compareTracks);
-
     return newGPXDoc;
 
 }
@@ -1595,12 +1263,13 @@ Waypoint *JSONtoWaypoint(const char* gpxString) {
     }
 
     char separators[6] = "{}:,\"";
-    char *token = strtok(tmpStr, separators);
+    char *savePtr = NULL;
+    char *token = strtok_r(tmpStr, separators, &savePtr);
     int i = 0;
     char tokens[4][100];
     while (token != NULL) {
         strcpy(tokens[i], token);
-        token = strtok(NULL, separators);
+        token = strtok_r(NULL, separators, &savePtr);
         i++;
     }
     free(tmpStr);
@@ -1638,26 +1307,32 @@ Route *JSONtoRoute(const char* gpxString) {
     }
 
     char separators[6] = "{}:,\"";
-    char *token = strtok(tmpStr, separators);
+    char *savePtr = NULL;
+    char *token = strtok_r(tmpStr, separators, &savePtr);
     int i = 0;
-    char tokens[2][100];
-    while (token != NULL) {
-        strcpy(tokens[i], token);
-        token = strtok(NULL, separators);
+    char tokens[2][100] = { "", "" };
+    while (token != NULL && i < 2) {
+        snprintf(tokens[i], sizeof(tokens[i]), "%s", token);
+        token = strtok_r(NULL, separators, &savePtr);
         i++;
     }
     free(tmpStr);
 
-    for (int j = 0; j < 2; j++) {
-        if (strcmp(tokens[j], "name") == 0) {
-            printf("%s\n",tokens[j + 1]);
-            newRoute->name = malloc(strlen(tokens[j + 1]) + 1);
-            strcpy(newRoute->name, tokens[j + 1]);
-        }
+    // Only {"name":"..."} makes a route, anything else is not one
+    if (strcmp(tokens[0], "name") != 0) {
+        free(newRoute);
+        return NULL;
     }
 
+    newRoute->name = malloc(strlen(tokens[1]) + 1);
+    strcpy(newRoute->name, tokens[1]);
+
     newRoute->waypoints = initializeList(&waypointToString, &deleteWaypoint, &compareWaypoints);
     newRoute->otherData = initializeList(&gpxDataToString, &deleteGpxData, &compareGpxData);
+    newRoute->points = NULL;
+    newRoute->metrics = NULL;
+    newRoute->generation = 0;
+    newRoute->docGeneration = NULL;
 
     return newRoute;
 
@@ -1668,435 +1343,431 @@ Route *JSONtoRoute(const char* gpxString) {
 // Get the GPXdata of a file after validating
 char *getGPXDataIfValid (char *gpxFile, char *schemaFile) {
 
-    GPXdoc *tmpGPXDoc = createValidGPXdoc(gpxFile, schemaFile);
+    uint64_t spanStart = beginTraceSpan();
 
-    char *retString = GPXtoJSON(tmpGPXDoc);
+    // The summary only needs counts, which the file's image has without building a GPXdoc
+    GPXImage *view = openGPXView(gpxFile, schemaFile);
 
-    deleteGPXdoc(tmpGPXDoc);
+    char *retString = viewToJSON(view);
+
+    closeGPXImage(view);
 
+    endTraceSpan("getGPXDataIfValid", spanStart);
     return retString;
 
 }
 
 // New version of the trackToJSON, which has an extra field, which is num points
-char *newTrackToJSON (const Track *tr) {
-
-    int totalLength = 3;
-    char *retString = malloc(totalLength);
+void appendNewTrackJSON (StringBuilder *sb, const Track *tr) {
 
     if (tr == NULL) {
-        strcpy(retString, "{}");
-        return retString;
-    }
-
-    char *tmpName;
-    if (tr->name[0] == '\0') {
-        retString = realloc(retString, totalLength + 4);
-        tmpName = malloc(5);
-        strcpy(tmpName, "None");
-    } else {
-        int nameLength = strlen(tr->name);
-        totalLength += nameLength;
-        retString = realloc(retString, totalLength);
-        tmpName = malloc(nameLength + 1);
-        strcpy(tmpName, tr->name);
+        appendString(sb, "{}");
+        return;
     }
 
-    // Tracklen should have maximum 100 chars
+    const char *name = tr->name[0] == '\0' ? "None" : tr->name;
 
-    if (isLoopTrack(tr, 10)) {
-        totalLength += 4; // For true
-    } else {
-        totalLength += 5; // For false
-    }
-    totalLength += 160; // For the labels
-    retString = realloc(retString, totalLength);
+    // The number of points of all segments is kept with the track's length
+    const PathMetrics *metrics = getTrackMetrics(tr);
+    int numPoints = metrics != NULL ? metrics->numPoints : 0;
 
-    int numPoints = 0;
+    appendFormat(sb, "{\"name\":\"%s\",\"numPoints\":%d,\"len\":%.1f,\"loop\":%s}", name, numPoints, round10(getTrackLen(tr)), isLoopTrack(tr, 10) ? "true" : "false");
 
-    void *elem;
-    List *trackSegList = tr->segments;
-    ListIterator trackSegIter = createIterator(trackSegList);
+}
 
-    while((elem = nextElement(&trackSegIter)) != NULL) {
+char *newTrackToJSON (const Track *tr) {
 
-        TrackSegment *tmpTrkSeg = (TrackSegment *)elem;
-        numPoints += getLength(tmpTrkSeg->waypoints);
+    uint64_t statStart = startParserStat();
 
-    }
+    StringBuilder sb;
+    initStringBuilder(&sb, 96);
+    appendNewTrackJSON(&sb, tr);
 
-    sprintf(retString, "{\"name\":\"%s\",\"numPoints\":%d,\"len\":%.1f,\"loop\":%s}", tmpName, numPoints ,round10(getTrackLen(tr)), isLoopTrack(tr, 10) ? "true" : "false");
-    free(tmpName);
-    
-    return retString;
+    return endJSONStat(STAT_NEW_TRACK_TO_JSON, statStart, finishStringBuilder(&sb));
 
 }
 
-// New trackListToJSON as well, to incorporate previous change
-char *newTrackListToJSON (const List *list) {
-
-    int totalLength = 3;
-    char *retString = malloc(totalLength);
+// Same as appendRouteListJSON, for the new track format
+static void appendNewTrackListJSON(StringBuilder *sb, const List *list) {
 
     if (list == NULL) {
-        strcpy(retString, "[]");
-        return retString;
+        appendString(sb, "[]");
+        return;
     }
 
     void *elem;
-    List *trackList = (List *)list;
-    ListIterator trackIter = createIterator(trackList);
+    ListIterator trackIter = createIterator((List *)list);
 
-    strcpy(retString, "[");
+    appendChar(sb, '[');
 
-    int lastIndex = getLength(trackList) - 1;
     int i = 0;
 	while ((elem = nextElement(&trackIter)) != NULL) {
 
-        Track *tmpTrk = (Track *)elem;
-
-        char *trackJSONString = newTrackToJSON(tmpTrk);
-        int lengthOfJSONString = strlen(trackJSONString);
-        if (i != lastIndex) {
-            totalLength += lengthOfJSONString + 1;
-            retString = realloc(retString, totalLength);
-            strcat(retString, trackJSONString);
-            strcat(retString, ",");
-        } else {
-            totalLength += lengthOfJSONString;
-            retString = realloc(retString, totalLength);
-            strcat(retString, trackJSONString);
+        if (i > 0) {
+            appendChar(sb, ',');
         }
-        free(trackJSONString);
+
+        appendNewTrackJSON(sb, (Track *)elem);
 
         i++;
 
 	}
 
-    strcat(retString, "]");
+    appendChar(sb, ']');
 
-    return retString;
+}
+
+// New trackListToJSON as well, to incorporate previous change
+char *newTrackListToJSON (const List *list) {
+
+    uint64_t statStart = startParserStat();
+
+    StringBuilder sb;
+    initStringBuilder(&sb, 256);
+    appendNewTrackListJSON(&sb, list);
+
+    return endJSONStat(STAT_NEW_TRACK_LIST_TO_JSON, statStart, finishStringBuilder(&sb));
+
+}
+
+// Get the routes and tracks information from a GPXdoc, in that order
+char *routesAndTracksToJSON (const GPXdoc *doc) {
+
+    uint64_t statStart = startParserStat();
+
+    StringBuilder sb;
+    initStringBuilder(&sb, 1024);
+
+    // The route list and the track list, written straight into the result
+    appendString(&sb, "{\"routes\":");
+    appendRouteListJSON(&sb, doc->routes);
+    appendString(&sb, ",\"tracks\":");
+    appendNewTrackListJSON(&sb, doc->tracks);
+    appendChar(&sb, '}');
+
+    return endJSONStat(STAT_ROUTES_AND_TRACKS_TO_JSON, statStart, finishStringBuilder(&sb));
 
 }
 
 // Get the routes and tracks information from a file, in that order
 char *getRoutesAndTracksFromFile (char *gpxFile, char *schemaFile) {
 
-    // Create a valid GPXdoc struct
-    GPXdoc *tmpGPXDoc = createValidGPXdoc(gpxFile, schemaFile);
+    uint64_t spanStart = beginTraceSpan();
 
-    // Get the route list and track list separately
-    char *routeListString = routeListToJSON(tmpGPXDoc->routes);
-    char *trackListString = newTrackListToJSON(tmpGPXDoc->tracks);
-
-    // Malloc enough space for both strings, labels and null terminator
-    char *retString = malloc(strlen(routeListString) + strlen(trackListString) + 22);
+    // Read the paths straight from the file's image
+    GPXImage *view = openGPXView(gpxFile, schemaFile);
+    if (view == NULL) {
+        char *retString = malloc(3);
+        strcpy(retString, "{}");
+        endTraceSpan("getRoutesAndTracksFromFile", spanStart);
+        return retString;
+    }
 
-    // Copy into return string
-    sprintf(retString, "{\"routes\":%s,\"tracks\":%s}", routeListString, trackListString);
+    char *retString = viewRoutesAndTracksToJSON(view);
 
-    // Free other strings and delete the temporary GPXdoc
-    free(routeListString);
-    free(trackListString);
-    deleteGPXdoc(tmpGPXDoc);
+    closeGPXImage(view);
 
+    endTraceSpan("getRoutesAndTracksFromFile", spanStart);
     return retString;
 
 }
 
 // Similar function to before, this time for converting otherData to JSON format
-char *gpxDataToJSON (GPXData *data) {
-
-    int totalLength = 3;
-    char *retString = malloc(totalLength);
+void appendGpxDataJSON (StringBuilder *sb, const GPXData *data) {
 
     if (data == NULL) {
-        strcpy(retString, "{}");
-        return retString;
+        appendString(sb, "{}");
+        return;
     }
 
-    int nameLength = strlen(data->name);
-    totalLength += nameLength;
-    retString = realloc(retString, totalLength);
-    char *tmpName = malloc(nameLength + 1);
-    strcpy(tmpName, data->name);
-
-    int dataLength = strlen(data->value);
+    appendFormat(sb, "{\"name\":\"%s\",\"value\":\"", data->name);
 
-    for (int i = 0; i < dataLength; i++) {
-        if (data->value[i] == '\n') {
-            data->value[i] = ' ';
+    // Newlines are written as spaces, without changing the value stored in the doc
+    size_t start = sb->length;
+    appendString(sb, data->value);
+    if (sb->str != NULL) {
+        for (size_t i = start; i < sb->length; i++) {
+            if (sb->str[i] == '\n') {
+                sb->str[i] = ' ';
+            }
         }
     }
 
-    totalLength += dataLength;
-    retString = realloc(retString, totalLength);
-    char *value = malloc(dataLength + 1);
-    strcpy(value, data->value);
+    appendString(sb, "\"}");
 
-    totalLength += 20;
-    retString = realloc(retString, totalLength);
+}
 
-    sprintf(retString, "{\"name\":\"%s\",\"value\":\"%s\"}", tmpName, value);
-    free(tmpName);
-    free(value);
+char *gpxDataToJSON (GPXData *data) {
 
-    return retString;
+    uint64_t statStart = startParserStat();
 
-}
+    StringBuilder sb;
+    initStringBuilder(&sb, 64);
+    appendGpxDataJSON(&sb, data);
 
-// Simialr function again, for a list of otherData
-char *gpxDataListToJSON (List *otherDataList) {
+    return endJSONStat(STAT_GPX_DATA_TO_JSON, statStart, finishStringBuilder(&sb));
 
-    int totalLength = 3;
-    char *retString = malloc(totalLength);
+}
+
+// Same as appendRouteListJSON, for a list of otherData
+static void appendGpxDataListJSON(StringBuilder *sb, List *otherDataList) {
 
     if (otherDataList == NULL) {
-        strcpy(retString, "[]");
-        return retString;
+        appendString(sb, "[]");
+        return;
     }
 
     void *elem;
     ListIterator dataIter = createIterator(otherDataList);
 
-    strcpy(retString, "[");
+    appendChar(sb, '[');
 
-    int lastIndex = getLength(otherDataList) - 1;
     int i = 0;
 	while ((elem = nextElement(&dataIter)) != NULL) {
 
-        GPXData *tmpData = (GPXData *)elem;
-
-        char *dataString = gpxDataToJSON(tmpData);
-        int lengthOfJSONString = strlen(dataString);
-        if (i != lastIndex) {
-            totalLength += lengthOfJSONString + 1;
-            retString = realloc(retString, totalLength);
-            strcat(retString, dataString);
-            strcat(retString, ",");
-        } else {
-            totalLength += lengthOfJSONString;
-            retString = realloc(retString, totalLength);
-            strcat(retString, dataString);
+        if (i > 0) {
+            appendChar(sb, ',');
         }
-        free(dataString);
+
+        appendGpxDataJSON(sb, (GPXData *)elem);
 
         i++;
 
 	}
 
-    strcat(retString, "]");
-
-    return retString;
+    appendChar(sb, ']');
 
 }
 
-// Get otherData based on route/track index in the original file
-char *getOtherData (char *gpxFile, char *schemaFile, int type, int index) {
-
-    GPXdoc *tmpGPXDoc = createValidGPXdoc(gpxFile, schemaFile);
+// Simialr function again, for a list of otherData
+char *gpxDataListToJSON (List *otherDataList) {
 
-    // Routes
-    if (type == 1) {
+    uint64_t statStart = startParserStat();
 
-        void *elem;
-        List *routeList = tmpGPXDoc->routes;
-        ListIterator routeIter = createIterator(routeList);
+    StringBuilder sb;
+    initStringBuilder(&sb, 256);
+    appendGpxDataListJSON(&sb, otherDataList);
 
-        char *retString = NULL;
+    return endJSONStat(STAT_GPX_DATA_LIST_TO_JSON, statStart, finishStringBuilder(&sb));
 
-        // Loop through until the index is hit and return the otherData list in JSON format
-        int i = 1;
-        while((elem = nextElement(&routeIter)) != NULL) {
+}
 
-            Route *tmpRoute = (Route *)elem;
-            if (i == index) {
-                retString = gpxDataListToJSON(tmpRoute->otherData);
-                deleteGPXdoc(tmpGPXDoc);
-                return retString;
-            }
+// Get otherData based on route/track index (starting at 1) in a GPXdoc
+char *otherDataToJSON (const GPXdoc *doc, int type, int index) {
 
-            i++;
-        }
+    uint64_t statStart = startParserStat();
 
-        retString = malloc(3);
-        strcpy(retString, "[]");
+    StringBuilder sb;
+    initStringBuilder(&sb, 256);
 
-        deleteGPXdoc(tmpGPXDoc);
+    // The otherData list of the route or track at index, "[]" if the index was not found
+    if (type == 1) {
+        Route *tmpRoute = getRouteAt(doc, index);
+        appendGpxDataListJSON(&sb, tmpRoute != NULL ? tmpRoute->otherData : NULL);
+    } else {
+        Track *tmpTrack = getTrackAt(doc, index);
+        appendGpxDataListJSON(&sb, tmpTrack != NULL ? tmpTrack->otherData : NULL);
+    }
 
-        return retString;
+    return endJSONStat(STAT_OTHER_DATA_TO_JSON, statStart, finishStringBuilder(&sb));
 
-    } else {
+}
 
-        // Tracks
+// Get otherData based on route/track index in the original file
+char *getOtherData (char *gpxFile, char *schemaFile, int type, int index) {
 
-        void *elem;
-        List *trackList = tmpGPXDoc->tracks;
-        ListIterator trackIter = createIterator(trackList);
+    uint64_t spanStart = beginTraceSpan();
 
-        char *retString = NULL;
+    GPXdoc *tmpGPXDoc = createValidGPXdoc(gpxFile, schemaFile);
+    if (tmpGPXDoc == NULL) {
+        char *retString = malloc(3);
+        strcpy(retString, "[]");
+        endTraceSpan("getOtherData", spanStart);
+        return retString;
+    }
 
-        // Loop through until the index is hit and return the otherData list in JSON format
-        int i = 1;
-        while((elem = nextElement(&trackIter)) != NULL) {
+    char *retString = otherDataToJSON(tmpGPXDoc, type, index);
 
-            Track *tmpTrack = (Track *)elem;
-            if (i == index) {
-                retString = gpxDataListToJSON(tmpTrack->otherData);
-                deleteGPXdoc(tmpGPXDoc);
-                return retString;
-            }
+    deleteGPXdoc(tmpGPXDoc);
 
-            i++;
-        }
+    endTraceSpan("getOtherData", spanStart);
+    return retString;
 
-        retString = malloc(3);
-        strcpy(retString, "[]");
+}
 
-        deleteGPXdoc(tmpGPXDoc);
+// Replace the name of a route/track. Names that are arena memory cannot be realloc'd, so the new name is copied
+// into the arena and the old one is left for the arena to free
+static void replaceName(GPXArena *arena, char **name, const char *newName) {
 
-        return retString;
+    if (arenaOwns(arena, *name)) {
+        *name = copyString(arena, newName);
+        return;
+    }
 
+    int newNameLength = strlen(newName);
+    // If more space is needed for the name, realloc enough space
+    if (newNameLength > strlen(*name)) {
+        *name = realloc(*name, newNameLength + 1);
     }
+    // Copy in the new name to the struct
+    strcpy(*name, newName);
 
 }
 
-// Rename a route/track based on index in the original file
-int renameRoute (char *gpxFile, char *schemaFile, int type, int index, char *newName) {
+// Rename a route/track based on index (starting at 1) in a GPXdoc, returns 1 on success and 0 on fail
+int renamePath (GPXdoc *doc, int type, int index, char *newName) {
 
-    GPXdoc *tmpGPXDoc = createValidGPXdoc(gpxFile, schemaFile);
+    if (doc == NULL || newName == NULL) {
+        return 0;
+    }
 
     // Routes
     if (type == 1) {
 
-        void *elem;
-        List *routeList = tmpGPXDoc->routes;
-        ListIterator routeIter = createIterator(routeList);
-
-        int i = 1;
-        while((elem = nextElement(&routeIter)) != NULL) {
+        Route *tmpRoute = getRouteAt(doc, index);
+        if (tmpRoute == NULL) {
+            return 0;
+        }
 
-            Route *tmpRoute = (Route *)elem;
+        replaceName(doc->arena, &tmpRoute->name, newName);
 
-            if (i == index) {
-                int newNameLength = strlen(newName);
-                // If more space is needed for the name, realloc enough space
-                if (newNameLength > strlen(tmpRoute->name)) {
-                    tmpRoute->name = realloc(tmpRoute->name, newNameLength + 1);
-                }
-                // Copy in the new name to the struct
-                strcpy(tmpRoute->name, newName);
-
-                // Write the struct back to same file to update changes
-                if (writeGPXdoc(tmpGPXDoc, gpxFile)) {
-                    deleteGPXdoc(tmpGPXDoc);
-                    return 1;
-                } else {
-                    deleteGPXdoc(tmpGPXDoc);
-                    return 0;
-                }
-            }
+    } else {
 
-            i++;
+        // Tracks
+        Track *tmpTrack = getTrackAt(doc, index);
+        if (tmpTrack == NULL) {
+            return 0;
         }
 
-        deleteGPXdoc(tmpGPXDoc);
+        replaceName(doc->arena, &tmpTrack->name, newName);
 
-        // Return 0 on fail
-        return 0;
+    }
 
-    } else {
+    // Move the path to the chain of its new name
+    renameInNameIndex(doc, type, index);
 
-        // Tracks
+    return 1;
 
-        void *elem;
-        List *trackList = tmpGPXDoc->tracks;
-        ListIterator trackIter = createIterator(trackList);
+}
 
-        int i = 1;
-        while((elem = nextElement(&trackIter)) != NULL) {
+// Remove a route/track based on index (starting at 1) from a GPXdoc and delete it, returns 1 on success and 0 on fail
+int removePath (GPXdoc *doc, int type, int index) {
 
-            Track *tmpTrack = (Track *)elem;
-            if (i == index) {
-                int newNameLength = strlen(newName);
-                if (newNameLength > strlen(tmpTrack->name)) {
-                    tmpTrack->name = realloc(tmpTrack->name, newNameLength + 1);
-                }
-                strcpy(tmpTrack->name, newName);
-                if (writeGPXdoc(tmpGPXDoc, gpxFile)) {
-                    deleteGPXdoc(tmpGPXDoc);
-                    return 1;
-                } else {
-                    deleteGPXdoc(tmpGPXDoc);
-                    return 0;
-                }
-            }
+    if (doc == NULL) {
+        return 0;
+    }
 
-            i++;
+    List *list = type == 1 ? doc->routes : doc->tracks;
+    void *path = type == 1 ? (void *)getRouteAt(doc, index) : (void *)getTrackAt(doc, index);
+
+    if (path == NULL || removeDataFromList(list, path) == NULL) {
+        return 0;
+    }
+
+    // A path an arena doc loaded itself is arena memory and goes with the doc. One it adopted, or any path of a doc
+    // put together with malloc, is deleted now
+    if (!arenaOwns(doc->arena, path)) {
+
+        arenaRelease(doc->arena, path);
+
+        if (type == 1) {
+            deleteRoute(path);
+        } else {
+            deleteTrack(path);
         }
 
-        deleteGPXdoc(tmpGPXDoc);
+    }
 
-        // Return 0 on fail
-        return 0;
+    // The paths after it moved up one, so the doc's indexes are stale
+    invalidateNameIndex(doc, type);
+    doc->generation++;
+
+    return 1;
+
+}
+
+// Rename a route/track based on index in the original file
+int renameRoute (char *gpxFile, char *schemaFile, int type, int index, char *newName) {
+
+    uint64_t spanStart = beginTraceSpan();
 
+    GPXdoc *tmpGPXDoc = createValidGPXdoc(gpxFile, schemaFile);
+    if (tmpGPXDoc == NULL) {
+        endTraceSpan("renameRoute", spanStart);
+        return 0;
     }
 
+    uint64_t editStart = beginTraceSpan();
+    int renamed = renamePath(tmpGPXDoc, type, index, newName);
+    endTraceSpan("renamePath", editStart);
+
+    // Write the struct back to same file to update changes
+    renamed = renamed && writeGPXdoc(tmpGPXDoc, gpxFile);
+
+    deleteGPXdoc(tmpGPXDoc);
+
+    endTraceSpan("renameRoute", spanStart);
+    return renamed;
+
 }
 
 // Create an empty GPX file
 int createEmptyGPX (char *outputFilename, char *creator) {
 
-    GPXdoc *newDoc = malloc(sizeof(GPXdoc));
+    uint64_t spanStart = beginTraceSpan();
+
+    GPXdoc *newDoc = newGPXdoc(createArena());
 
     // Default version and namespace
     newDoc->version = 1.1;
     strcpy(newDoc->namespace, "http://www.topografix.com/GPX/1/1");
 
     // Copy in creator name
-    newDoc->creator = malloc(strlen(creator) + 1);
-    strcpy(newDoc->creator, creator);
+    newDoc->creator = copyString(newDoc->arena, creator);
 
-    // Initialize lists
-    newDoc->waypoints = initializeList(&waypointToString, &deleteWaypoint, &compareWaypoints);
-    newDoc->routes = initializeList(&routeToString, &deleteRoute, &compareRoutes);
-    newDoc->tracks = initializeList(&trackToString, &deleteTrack, &compareTracks);
+    // Validate, then write to file
+    int created = validateGPXDoc(newDoc, "gpx.xsd") && writeGPXdoc(newDoc, outputFilename);
 
-    if (!validateGPXDoc(newDoc, "gpx.xsd")) {
-        deleteGPXdoc(newDoc);
-        return 0;
-    }
+    deleteGPXdoc(newDoc);
 
-    // Write to file
-    if (writeGPXdoc(newDoc, outputFilename)) {
-        return 1;
-    }
-
-    return 0;
+    endTraceSpan("createEmptyGPX", spanStart);
+    return created;
 
 }
 
 // Wrapper function to add a new route to a file
 int addRouteToFile (char *gpxFile, char *routeNameJSON) {
 
-    // Create a new route from the JSON string
+    uint64_t spanStart = beginTraceSpan();
+
+    // Create a new route from the JSON string. Without one there is nothing to add, so the file is left alone
     Route *newRoute = JSONtoRoute(routeNameJSON);
+    if (newRoute == NULL) {
+        endTraceSpan("addRouteToFile", spanStart);
+        return 0;
+    }
 
     // Create a temporary GPXdoc struct
     GPXdoc *tmpGPXDoc = createValidGPXdoc(gpxFile, "gpx.xsd");
     if (tmpGPXDoc == NULL) {
+        deleteRoute(newRoute);
+        endTraceSpan("addRouteToFile", spanStart);
         return 0;
     }
 
     // Add the route to the GPXdoc struct
+    uint64_t editStart = beginTraceSpan();
     addRoute(tmpGPXDoc, newRoute);
+    endTraceSpan("addRoute", editStart);
 
     // Attempt to write to file
     if (writeGPXdoc(tmpGPXDoc, gpxFile)) {
         deleteGPXdoc(tmpGPXDoc);
+        endTraceSpan("addRouteToFile", spanStart);
         return 1;
     } else {
         deleteGPXdoc(tmpGPXDoc);
+        endTraceSpan("addRouteToFile", spanStart);
         return 0;
     }
 
@@ -2105,9 +1776,12 @@ int addRouteToFile (char *gpxFile, char *routeNameJSON) {
 // Add a waypoint to a route in a file
 int addWaypointToRouteInFile (char *gpxFile, char *waypointJSON) {
 
+    uint64_t spanStart = beginTraceSpan();
+
     // Create a valid GPXdoc struct
     GPXdoc *tmpGPXDoc = createValidGPXdoc(gpxFile, "gpx.xsd");
     if (tmpGPXDoc == NULL) {
+        endTraceSpan("addWaypointToRouteInFile", spanStart);
         return 0;
     }
 
@@ -2118,41 +1792,85 @@ int addWaypointToRouteInFile (char *gpxFile, char *waypointJSON) {
     Waypoint *waypointToAdd = JSONtoWaypoint(waypointJSON);
 
     // Add the waypoint to the route
+    uint64_t editStart = beginTraceSpan();
     addWaypoint(tmpRoute, waypointToAdd);
+    endTraceSpan("addWaypoint", editStart);
 
     // Attempt to write to file
     if (writeGPXdoc(tmpGPXDoc, gpxFile)) {
         deleteGPXdoc(tmpGPXDoc);
+        endTraceSpan("addWaypointToRouteInFile", spanStart);
         return 1;
     } else {
         deleteGPXdoc(tmpGPXDoc);
+        endTraceSpan("addWaypointToRouteInFile", spanStart);
         return 0;
     }
 
 }
 
+// Get the routes between two points of a GPXdoc as a JSON string
+char *routesBetweenToJSON (const GPXdoc *doc, float lat1, float lon1, float lat2, float lon2, float delta) {
+
+    uint64_t statStart = startParserStat();
+
+    // Get routes between points
+    List *routeList = getRoutesBetween(doc, lat1, lon1, lat2, lon2, delta);
+
+    // Convert list to JSON
+    StringBuilder sb;
+    initStringBuilder(&sb, 256);
+    appendRouteListJSON(&sb, routeList);
+
+    // The list does not own the routes, so this only frees the list itself
+    if (routeList != NULL) {
+        freeList(routeList);
+    }
+
+    return endJSONStat(STAT_ROUTES_BETWEEN_TO_JSON, statStart, finishStringBuilder(&sb));
+
+}
+
+// Same as last function but for tracks
+char *tracksBetweenToJSON (const GPXdoc *doc, float lat1, float lon1, float lat2, float lon2, float delta) {
+
+    uint64_t statStart = startParserStat();
+
+    List *trackList = getTracksBetween(doc, lat1, lon1, lat2, lon2, delta);
+
+    StringBuilder sb;
+    initStringBuilder(&sb, 256);
+    appendNewTrackListJSON(&sb, trackList);
+
+    if (trackList != NULL) {
+        freeList(trackList);
+    }
+
+    return endJSONStat(STAT_TRACKS_BETWEEN_TO_JSON, statStart, finishStringBuilder(&sb));
+
+}
+
 // Alternate version of getRoutesBetween, with return format of JSON string instead of List
 char *getRoutesBetweenJSON (char *gpxFile, float lat1, float lon1, float lat2, float lon2, float delta) {
 
+    uint64_t spanStart = beginTraceSpan();
+
     char *retString = NULL;
 
-    // Try and create valid GPXdoc
-    GPXdoc *tmpGPXDoc = createValidGPXdoc(gpxFile, "gpx.xsd");
-    if (tmpGPXDoc == NULL) {
+    // Try and open a view of the valid file
+    GPXImage *view = openGPXView(gpxFile, "gpx.xsd");
+    if (view == NULL) {
         retString = malloc(3);
         strcpy(retString, "{}");
+        endTraceSpan("getRoutesBetweenJSON", spanStart);
         return retString;
     }
 
-    // Get rourtes between points
-    List *routeList = getRoutesBetween(tmpGPXDoc, lat1, lon1, lat2, lon2, delta);
-
-    // Convert list to JSON
-    retString = routeListToJSON(routeList);
+    retString = viewRoutesBetweenToJSON(view, lat1, lon1, lat2, lon2, delta);
 
-    // Delete temporary GPXdoc
-    deleteGPXdoc(tmpGPXDoc);
+    closeGPXImage(view);
 
+    endTraceSpan("getRoutesBetweenJSON", spanStart);
     return retString;
 
 }
@@ -2160,138 +1878,165 @@ char *getRoutesBetweenJSON (char *gpxFile, float lat1, float lon1, float lat2, f
 // Same as last function but for tracks
 char *getTracksBetweenJSON (char *gpxFile, float lat1, float lon1, float lat2, float lon2, float delta) {
 
+    uint64_t spanStart = beginTraceSpan();
+
     char *retString = NULL;
 
-    GPXdoc *tmpGPXDoc = createValidGPXdoc(gpxFile, "gpx.xsd");
-    if (tmpGPXDoc == NULL) {
+    GPXImage *view = openGPXView(gpxFile, "gpx.xsd");
+    if (view == NULL) {
         retString = malloc(3);
         strcpy(retString, "{}");
+        endTraceSpan("getTracksBetweenJSON", spanStart);
         return retString;
     }
 
-    List *trackList = getTracksBetween(tmpGPXDoc, lat1, lon1, lat2, lon2, delta);
+    retString = viewTracksBetweenToJSON(view, lat1, lon1, lat2, lon2, delta);
 
-    retString = newTrackListToJSON(trackList);
-
-    deleteGPXdoc(tmpGPXDoc);
+    closeGPXImage(view);
 
+    endTraceSpan("getTracksBetweenJSON", spanStart);
     return retString;
 
 }
 
+// Get the number of paths in a GPXdoc with a specific length
+char *pathsWithLengthToJSON (const GPXdoc *doc, float length) {
+
+    uint64_t statStart = startParserStat();
+
+    // Get routes/tracks with the specific length, default delta value of 10
+    int routesWithLen = numRoutesWithLength(doc, length, 10);
+    int tracksWithLen = numTracksWithLength(doc, length, 10);
+
+    // Copy the formatted JSON return string
+    StringBuilder sb;
+    initStringBuilder(&sb, 32);
+    appendFormat(&sb, "{\"rt\":%d,\"tr\":%d}", routesWithLen, tracksWithLen);
+
+    return endJSONStat(STAT_PATHS_WITH_LENGTH_TO_JSON, statStart, finishStringBuilder(&sb));
+
+}
+
 // Get paths with specific length
 char *getPathsWithLength (char *gpxFile, float length) {
 
-    char *retString = malloc(3);
+    uint64_t spanStart = beginTraceSpan();
 
-    GPXdoc *tmpGPXDoc = createValidGPXdoc(gpxFile, "gpx.xsd");
-    if (tmpGPXDoc == NULL) {
+    GPXImage *view = openGPXView(gpxFile, "gpx.xsd");
+    if (view == NULL) {
+        char *retString = malloc(3);
         strcpy(retString, "{}");
+        endTraceSpan("getPathsWithLength", spanStart);
         return retString;
     }
 
-    // Get routes/tracks with the specific length, default delta value of 10
-    int routesWithLen = numRoutesWithLength(tmpGPXDoc, length, 10);
-    int tracksWithLen = numTracksWithLength(tmpGPXDoc, length, 10);
+    char *retString = viewPathsWithLengthToJSON(view, length);
 
-    // Copy the formatted JSON return string
-    retString = realloc(retString, 80);
-    sprintf(retString, "{\"rt\":%d,\"tr\":%d}", routesWithLen, tracksWithLen);
-    
+    closeGPXImage(view);
+
+    endTraceSpan("getPathsWithLength", spanStart);
     return retString;
 
 }
 
 // Similar to previous toJSON functions, except for waypoint 
-char *waypointToJSON (Waypoint *wpt) {
-
-    int totalLength = 3;
-    char *retString = malloc(totalLength);
+void appendWaypointJSON (StringBuilder *sb, const Waypoint *wpt) {
 
     if (wpt == NULL) {
-        strcpy(retString, "{}");
-        return retString;
+        appendString(sb, "{}");
+        return;
     }
 
-    int nameLength = strlen(wpt->name);
-    totalLength += nameLength;
-    retString = realloc(retString, totalLength);
-    char *tmpName = malloc(nameLength + 1);
-    strcpy(tmpName, wpt->name);
-
-    totalLength += 80;
-    retString = realloc(retString, totalLength);
-
-    sprintf(retString, "{\"name\":\"%s\",\"latitude\":%f,\"longitude\":%f}", tmpName, wpt->latitude, wpt->longitude);
-    free(tmpName);
-
-    return retString;
+    appendFormat(sb, "{\"name\":\"%s\",\"latitude\":%f,\"longitude\":%f}", wpt->name, wpt->latitude, wpt->longitude);
 
 }
 
-// Simialr to previous ListToJSON functions, except for waypoint lists
-char *waypointListToJSON (char *gpxFile, int index) {
+char *waypointToJSON (Waypoint *wpt) {
 
-    int totalLength = 3;
-    char *retString = malloc(totalLength);
+    uint64_t statStart = startParserStat();
 
-    GPXdoc *doc = createValidGPXdoc(gpxFile, "gpx.xsd");
-    if (doc == NULL) {
-        strcpy(retString, "{}");
-        return retString;
-    }
+    StringBuilder sb;
+    initStringBuilder(&sb, 96);
+    appendWaypointJSON(&sb, wpt);
 
-    Route *tmpRte;
-    ListIterator routeIter = createIterator(doc->routes);
-    int j = 0;
-    while ((tmpRte = nextElement(&routeIter)) != NULL) {
-        if (j == index) {
-            break;
-        }
-        j++;
-    }
+    return endJSONStat(STAT_WAYPOINT_TO_JSON, statStart, finishStringBuilder(&sb));
 
-    List *list = tmpRte->waypoints;
+}
 
-    if (list == NULL) {
-        strcpy(retString, "[]");
-        deleteGPXdoc(doc);
-        return retString;
+// Simialr to previous ListToJSON functions, except for the waypoints of a route
+void appendRoutePointsJSON (StringBuilder *sb, const Route *rt) {
+
+    if (rt == NULL || rt->waypoints == NULL) {
+        appendString(sb, "[]");
+        return;
     }
 
     void *elem;
-    ListIterator dataIter = createIterator(list);
+    ListIterator dataIter = createIterator(rt->waypoints);
 
-    strcpy(retString, "[");
+    appendChar(sb, '[');
 
-    int lastIndex = getLength(list) - 1;
     int i = 0;
 	while ((elem = nextElement(&dataIter)) != NULL) {
 
-        Waypoint *tmpWpt = (Waypoint *)elem;
-
-        char *dataString = waypointToJSON(tmpWpt);
-        int lengthOfJSONString = strlen(dataString);
-        if (i != lastIndex) {
-            totalLength += lengthOfJSONString + 1; // 1 for the comma
-            retString = realloc(retString, totalLength);
-            strcat(retString, dataString);
-            strcat(retString, ",");
-        } else {
-            totalLength += lengthOfJSONString;
-            retString = realloc(retString, totalLength);
-            strcat(retString, dataString);
+        if (i > 0) {
+            appendChar(sb, ',');
         }
-        free(dataString);
+
+        appendWaypointJSON(sb, (Waypoint *)elem);
 
         i++;
 
 	}
 
-    strcat(retString, "]");
+    appendChar(sb, ']');
+
+}
+
+char *routePointsToJSON (const Route *rt) {
+
+    uint64_t statStart = startParserStat();
+
+    StringBuilder sb;
+    initStringBuilder(&sb, 256);
+    appendRoutePointsJSON(&sb, rt);
+
+    return endJSONStat(STAT_ROUTE_POINTS_TO_JSON, statStart, finishStringBuilder(&sb));
+
+}
+
+// Get the waypoints of the route at index (starting at 0) in a GPXdoc as a JSON string
+char *routeWaypointsToJSON (const GPXdoc *doc, int index) {
+
+    uint64_t statStart = startParserStat();
+
+    // getRouteAt counts from 1. A route that is not there gives "[]"
+    StringBuilder sb;
+    initStringBuilder(&sb, 256);
+    appendRoutePointsJSON(&sb, getRouteAt(doc, index + 1));
+
+    return endJSONStat(STAT_ROUTE_WAYPOINTS_TO_JSON, statStart, finishStringBuilder(&sb));
+
+}
+
+// Get the waypoints of the route at index in a file as a JSON string
+char *waypointListToJSON (char *gpxFile, int index) {
+
+    uint64_t spanStart = beginTraceSpan();
+
+    GPXdoc *doc = createValidGPXdoc(gpxFile, "gpx.xsd");
+    if (doc == NULL) {
+        char *retString = malloc(3);
+        strcpy(retString, "{}");
+        endTraceSpan("waypointListToJSON", spanStart);
+        return retString;
+    }
+
+    char *retString = routeWaypointsToJSON(doc, index);
 
     deleteGPXdoc(doc);
 
+    endTraceSpan("waypointListToJSON", spanStart);
     return retString;
 
 }
@@ -2299,8 +2044,11 @@ char *waypointListToJSON (char *gpxFile, int index) {
 // Return the last route of a particular file as a JSON string
 char *lastRouteToJSON (char *gpxFile) {
 
+    uint64_t spanStart = beginTraceSpan();
+
     GPXdoc *tmpGPXDoc = createValidGPXdoc(gpxFile, "gpx.xsd");
     if (tmpGPXDoc == NULL) {
+        endTraceSpan("lastRouteToJSON", spanStart);
         return 0;
     }
 
@@ -2310,6 +2058,70 @@ char *lastRouteToJSON (char *gpxFile) {
 
     deleteGPXdoc(tmpGPXDoc);
 
+    endTraceSpan("lastRouteToJSON", spanStart);
+    return retString;
+
+}
+
+// Convert every route of a GPXdoc, together with its waypoints, to one JSON array in a single pass over the routes.
+// Each element is the routeToJSON object with an extra "waypoints" field holding the waypointToJSON objects
+char *routesWithWaypointsToJSON (const GPXdoc *doc) {
+
+    uint64_t statStart = startParserStat();
+
+    StringBuilder sb;
+    initStringBuilder(&sb, 1024);
+
+    if (doc == NULL || doc->routes == NULL) {
+        appendString(&sb, "[]");
+        return endJSONStat(STAT_ROUTES_WITH_WAYPOINTS_TO_JSON, statStart, finishStringBuilder(&sb));
+    }
+
+    appendChar(&sb, '[');
+
+    void *elem;
+    ListIterator routeIter = createIterator(doc->routes);
+
+    int i = 0;
+	while ((elem = nextElement(&routeIter)) != NULL) {
+
+        Route *tmpRte = (Route *)elem;
+
+        if (i > 0) {
+            appendChar(&sb, ',');
+        }
+
+        // The route object with the waypoints added as one more field
+        appendChar(&sb, '{');
+        appendRouteJSONFields(&sb, tmpRte);
+        appendString(&sb, ",\"waypoints\":");
+        appendRoutePointsJSON(&sb, tmpRte);
+        appendChar(&sb, '}');
+
+        i++;
+
+	}
+
+    appendChar(&sb, ']');
+
+    return endJSONStat(STAT_ROUTES_WITH_WAYPOINTS_TO_JSON, statStart, finishStringBuilder(&sb));
+
+}
+
+// Get every route of a file with its waypoints, parsing the file once
+char *getRoutesWithWaypoints (char *gpxFile, char *schemaFile) {
+
+    GPXdoc *tmpGPXDoc = createValidGPXdoc(gpxFile, schemaFile);
+    if (tmpGPXDoc == NULL) {
+        char *retString = malloc(3);
+        strcpy(retString, "[]");
+        return retString;
+    }
+
+    char *retString = routesWithWaypointsToJSON(tmpGPXDoc);
+
+    deleteGPXdoc(tmpGPXDoc);
+
     return retString;
 
 }
@@ -0,0 +1,173 @@
+#include "GPXPathMetrics.h" // Included necessary header
+#include "GPXHelpers.h"
+#include "GPXWaypointArray.h"
+
+// Grow a bounding box to take in the points of a packed array
+static void addToBoundingBox(PathMetrics *metrics, const WaypointArray *points) {
+
+    for (int i = 0; i < points->length; i++) {
+
+        if (metrics->numPoints == 0 && i == 0) {
+            metrics->minLatitude = metrics->maxLatitude = points->latitudes[0];
+            metrics->minLongitude = metrics->maxLongitude = points->longitudes[0];
+        }
+
+        metrics->minLatitude = fmin(metrics->minLatitude, points->latitudes[i]);
+        metrics->maxLatitude = fmax(metrics->maxLatitude, points->latitudes[i]);
+        metrics->minLongitude = fmin(metrics->minLongitude, points->longitudes[i]);
+        metrics->maxLongitude = fmax(metrics->maxLongitude, points->longitudes[i]);
+
+    }
+
+}
+
+// Distance from the first point of one array to the last point of another, the test of isLoopRoute and isLoopTrack
+static double getEndDistance(const WaypointArray *first, const WaypointArray *last) {
+
+    int end = last->length - 1;
+
+    return haversineWithCos(first->latitudes[0], first->longitudes[0], first->cosLatitudes[0],
+        last->latitudes[end], last->longitudes[end], last->cosLatitudes[end]);
+
+}
+
+// Allocate the metrics of a path and remember what they are worked out from. NULL if malloc fails
+static PathMetrics *newPathMetrics(const List *list, unsigned long generation, int sourceLength) {
+
+    PathMetrics *metrics = malloc(sizeof(PathMetrics));
+    if (metrics == NULL) {
+        return NULL;
+    }
+
+    metrics->length = 0.0;
+    metrics->numPoints = 0;
+    metrics->endDistance = -1;
+    metrics->minLatitude = metrics->minLongitude = metrics->maxLatitude = metrics->maxLongitude = 0.0;
+    metrics->generation = generation;
+    metrics->sourceLength = sourceLength;
+
+    // Arena documents free the metrics with the rest of the document
+    metrics->cleanup = arenaAdopt(getListArena(list), metrics, &deletePathMetrics);
+
+    return metrics;
+
+}
+
+static bool isPathMetricsCurrent(const PathMetrics *metrics, unsigned long generation, int sourceLength) {
+
+    return metrics != NULL && metrics->generation == generation && metrics->sourceLength == sourceLength;
+
+}
+
+const PathMetrics *getRouteMetrics(const Route *rt) {
+
+    if (rt == NULL || rt->waypoints == NULL) {
+        return NULL;
+    }
+
+    int sourceLength = getLength(rt->waypoints);
+    if (isPathMetricsCurrent(rt->metrics, rt->generation, sourceLength)) {
+        return rt->metrics;
+    }
+
+    // The cache is not part of the route's value, so it is updated even through a const route
+    PathMetrics **cached = &((Route *)rt)->metrics;
+    invalidatePathMetrics(rt->waypoints, cached);
+
+    const WaypointArray *points = getRoutePoints(rt);
+    if (points == NULL) {
+        return NULL;
+    }
+
+    PathMetrics *metrics = newPathMetrics(rt->waypoints, rt->generation, sourceLength);
+    if (metrics == NULL) {
+        return NULL;
+    }
+
+    metrics->length = getPointsLen(points);
+    addToBoundingBox(metrics, points);
+    metrics->numPoints = points->length;
+
+    if (points->length >= 4) {
+        metrics->endDistance = getEndDistance(points, points);
+    }
+
+    *cached = metrics;
+
+    return metrics;
+
+}
+
+const PathMetrics *getTrackMetrics(const Track *tr) {
+
+    if (tr == NULL || tr->segments == NULL) {
+        return NULL;
+    }
+
+    int sourceLength = getLength(tr->segments);
+    // Nothing in the API adds points to a track, so only its number of segments is checked
+    if (isPathMetricsCurrent(tr->metrics, 0, sourceLength)) {
+        return tr->metrics;
+    }
+
+    PathMetrics **cached = &((Track *)tr)->metrics;
+    invalidatePathMetrics(tr->segments, cached);
+
+    PathMetrics *metrics = newPathMetrics(tr->segments, 0, sourceLength);
+    if (metrics == NULL) {
+        return NULL;
+    }
+
+    metrics->length = getTotalTrackSegLen(tr->segments);
+
+    void *elem;
+    ListIterator trackSegIter = createIterator(tr->segments);
+
+    while ((elem = nextElement(&trackSegIter)) != NULL) {
+
+        const WaypointArray *points = getSegmentPoints((TrackSegment *)elem);
+        if (points == NULL) {
+            continue;
+        }
+
+        addToBoundingBox(metrics, points);
+        metrics->numPoints += points->length;
+
+    }
+
+    // The first point of the first segment and the last point of the last one, as in isLoopTrack
+    if (metrics->numPoints >= 4) {
+
+        const WaypointArray *first = getSegmentPoints(getFromFront(tr->segments));
+        const WaypointArray *last = getSegmentPoints(getFromBack(tr->segments));
+
+        if (first != NULL && last != NULL && first->length > 0 && last->length > 0) {
+            metrics->endDistance = getEndDistance(first, last);
+        }
+
+    }
+
+    *cached = metrics;
+
+    return metrics;
+
+}
+
+void deletePathMetrics(void *data) {
+
+    free(data);
+
+}
+
+void invalidatePathMetrics(const List *list, PathMetrics **metrics) {
+
+    if (metrics == NULL || *metrics == NULL) {
+        return;
+    }
+
+    // Same as invalidateWaypointArray, the arena must forget metrics it adopted before they are freed
+    arenaReleaseCleanup(getListArena(list), (*metrics)->cleanup);
+    deletePathMetrics(*metrics);
+    *metrics = NULL;
+
+}
@@ -0,0 +1,228 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <sys/stat.h>
+#include "GPXSchemaCache.h" // Included necessary header
+#include "GPXStats.h"
+
+// One compiled schema, together with what it was compiled from
+typedef struct {
+    char *path;
+    struct timespec mtime;
+    off_t size;
+    xmlSchema *schema;
+    int refCount;
+    bool stale;
+} SchemaCacheEntry;
+
+// All compiled schemas, created on first use. The lock guards the list and the entries' reference counts; the
+// compiled schemas themselves are only read while validating, which libxml2 allows from any number of threads
+static List *schemaCache = NULL;
+static pthread_mutex_t schemaCacheLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Set up libxml2's global state once, when the library is loaded and before any thread can call into it.
+// It stays up until cleanupSchemaCache, so no call tears it down under another thread
+__attribute__((constructor))
+static void initParserLibrary(void) {
+
+    xmlInitParser();
+
+}
+
+// List helper functions for the cache entries
+static void deleteSchemaCacheEntry(void *data) {
+
+    if (data == NULL) {
+        return;
+    }
+
+    SchemaCacheEntry *entry = (SchemaCacheEntry *)data;
+    xmlSchemaFree(entry->schema);
+    free(entry->path);
+    free(entry);
+
+}
+static char *schemaCacheEntryToString(void *data) {
+
+    if (data == NULL) {
+        return NULL;
+    }
+
+    SchemaCacheEntry *entry = (SchemaCacheEntry *)data;
+
+    char *tmpStr = malloc(strlen(entry->path) + 40);
+    if (tmpStr == NULL) {
+        return NULL;
+    }
+    sprintf(tmpStr, "%s (refs: %d%s)", entry->path, entry->refCount, entry->stale ? ", stale" : "");
+
+    return tmpStr;
+
+}
+// Entries are compared by identity, so deleteDataFromList removes exactly the entry it is given
+static int compareSchemaCacheEntries(const void *first, const void *second) { return first == second ? 0 : 1; }
+
+// Compile a schema file of size bytes, returns NULL if the file is not a valid schema
+static xmlSchema *compileSchema(const char *gpxSchemaFile, off_t size) {
+
+    uint64_t statStart = startParserStat();
+
+    xmlSchemaParserCtxt *newCtxt = xmlSchemaNewParserCtxt(gpxSchemaFile);
+    if (newCtxt == NULL) {
+        return NULL;
+    }
+
+    xmlSchema *schema = xmlSchemaParse(newCtxt);
+    xmlSchemaFreeParserCtxt(newCtxt);
+
+    endParserStat(STAT_SCHEMA_COMPILE, statStart, size);
+
+    return schema;
+
+}
+
+// Borrow the compiled schema for a file, compiling it if it is not cached or has changed on disk
+xmlSchema *acquireSchema(const char *gpxSchemaFile) {
+
+    if (gpxSchemaFile == NULL || gpxSchemaFile[0] == '\0') {
+        return NULL;
+    }
+
+    // The modification time and size tell us whether a cached copy is still current
+    struct stat fileInfo;
+    if (stat(gpxSchemaFile, &fileInfo) != 0) {
+        return NULL;
+    }
+
+    // Held while a missing schema is compiled too, so threads that need it at the same time compile it only once
+    pthread_mutex_lock(&schemaCacheLock);
+
+    if (schemaCache == NULL) {
+        schemaCache = initializeList(&schemaCacheEntryToString, &deleteSchemaCacheEntry, &compareSchemaCacheEntries);
+    }
+
+    void *elem;
+    ListIterator cacheIter = createIterator(schemaCache);
+
+    while ((elem = nextElement(&cacheIter)) != NULL) {
+
+        SchemaCacheEntry *entry = (SchemaCacheEntry *)elem;
+
+        if (entry->stale || strcmp(entry->path, gpxSchemaFile) != 0) {
+            continue;
+        }
+
+        // Cache hit, hand out another reference
+        if (entry->mtime.tv_sec == fileInfo.st_mtim.tv_sec && entry->mtime.tv_nsec == fileInfo.st_mtim.tv_nsec
+            && entry->size == fileInfo.st_size) {
+            entry->refCount++;
+            pthread_mutex_unlock(&schemaCacheLock);
+            return entry->schema;
+        }
+
+        // The file changed, so this copy is retired (it is freed now, or when its last borrower releases it)
+        entry->stale = true;
+        if (entry->refCount == 0) {
+            deleteSchemaCacheEntry(deleteDataFromList(schemaCache, entry));
+        }
+        break;
+
+    }
+
+    // Cache miss, compile and store the schema
+    xmlSchema *schema = compileSchema(gpxSchemaFile, fileInfo.st_size);
+    if (schema == NULL) {
+        pthread_mutex_unlock(&schemaCacheLock);
+        return NULL;
+    }
+
+    SchemaCacheEntry *newEntry = malloc(sizeof(SchemaCacheEntry));
+    newEntry->path = malloc(strlen(gpxSchemaFile) + 1);
+    strcpy(newEntry->path, gpxSchemaFile);
+    newEntry->mtime = fileInfo.st_mtim;
+    newEntry->size = fileInfo.st_size;
+    newEntry->schema = schema;
+    newEntry->refCount = 1;
+    newEntry->stale = false;
+
+    insertBack(schemaCache, newEntry);
+
+    pthread_mutex_unlock(&schemaCacheLock);
+
+    return schema;
+
+}
+
+// Give back a borrowed schema
+void releaseSchema(xmlSchema *schema) {
+
+    if (schema == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&schemaCacheLock);
+
+    if (schemaCache == NULL) {
+        pthread_mutex_unlock(&schemaCacheLock);
+        return;
+    }
+
+    void *elem;
+    ListIterator cacheIter = createIterator(schemaCache);
+
+    while ((elem = nextElement(&cacheIter)) != NULL) {
+
+        SchemaCacheEntry *entry = (SchemaCacheEntry *)elem;
+
+        if (entry->schema != schema) {
+            continue;
+        }
+
+        entry->refCount--;
+
+        // Retired schemas are only kept alive for their remaining borrowers
+        if (entry->stale && entry->refCount <= 0) {
+            deleteSchemaCacheEntry(deleteDataFromList(schemaCache, entry));
+        }
+
+        break;
+
+    }
+
+    pthread_mutex_unlock(&schemaCacheLock);
+
+}
+
+// Compile a schema ahead of time so the first request does not pay for it
+int initSchemaCache(char *gpxSchemaFile) {
+
+    LIBXML_TEST_VERSION
+
+    xmlSchema *schema = acquireSchema(gpxSchemaFile);
+    if (schema == NULL) {
+        return 0;
+    }
+
+    // Drop our reference, the entry itself stays cached
+    releaseSchema(schema);
+
+    return 1;
+
+}
+
+// Free all the cached schemas and cleanup any variables used by the XML functions
+void cleanupSchemaCache(void) {
+
+    pthread_mutex_lock(&schemaCacheLock);
+
+    if (schemaCache != NULL) {
+        freeList(schemaCache);
+        schemaCache = NULL;
+    }
+
+    pthread_mutex_unlock(&schemaCacheLock);
+
+    xmlSchemaCleanupTypes();
+    xmlCleanupParser();
+
+}
@@ -0,0 +1,290 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "GPXStats.h" // Included necessary header
+#include "GPXStringBuilder.h"
+#include "GPXTrace.h"
+
+// Names of the stages, in the order of ParserStat
+static const char *statNames[NUM_PARSER_STATS] = {
+    "createGPXdoc", "createValidGPXdoc", "readGPXdoc", "recursiveReader", "schemaCompile", "schemaValidate",
+    "writeGPXdoc", "GPXtoJSON", "routeToJSON", "trackToJSON", "routeListToJSON", "trackListToJSON", "newTrackToJSON",
+    "newTrackListToJSON", "routesAndTracksToJSON", "gpxDataToJSON", "gpxDataListToJSON", "otherDataToJSON",
+    "routesBetweenToJSON", "tracksBetweenToJSON", "pathsWithLengthToJSON", "waypointToJSON", "routePointsToJSON",
+    "routeWaypointsToJSON", "routesWithWaypointsToJSON", "viewToJSON", "viewRouteListToJSON", "viewTrackListToJSON",
+    "viewRoutesAndTracksToJSON", "viewRoutesBetweenToJSON", "viewTracksBetweenToJSON", "viewPathsWithLengthToJSON"
+};
+
+typedef struct {
+    uint64_t calls;
+    uint64_t nanoseconds;
+    uint64_t maxNanoseconds;
+    uint64_t bytes;
+} StatTotals;
+
+// Counters of one thread. Only the thread itself writes them; they are atomic so that readers on other threads see
+// whole values, and relaxed, so writing one costs the same as a plain store
+typedef struct {
+    _Atomic uint64_t calls;
+    _Atomic uint64_t nanoseconds;
+    _Atomic uint64_t maxNanoseconds;
+    _Atomic uint64_t bytes;
+} StatCounters;
+
+typedef struct ThreadStats {
+    StatCounters counters[NUM_PARSER_STATS];
+    struct ThreadStats *next;
+} ThreadStats;
+
+static _Thread_local ThreadStats *threadStats = NULL;
+
+// The counters of the live threads, and the totals of the threads that have exited
+static ThreadStats *liveThreads = NULL;
+static StatTotals exitedTotals[NUM_PARSER_STATS];
+static pthread_mutex_t statsLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Its destructor folds the counters of a thread into exitedTotals when the thread exits
+static pthread_key_t statsKey;
+static pthread_once_t statsKeyOnce = PTHREAD_ONCE_INIT;
+
+static uint64_t load(_Atomic uint64_t *counter) {
+
+    return atomic_load_explicit(counter, memory_order_relaxed);
+
+}
+
+static void store(_Atomic uint64_t *counter, uint64_t value) {
+
+    atomic_store_explicit(counter, value, memory_order_relaxed);
+
+}
+
+static void retireThreadStats(void *data) {
+
+    ThreadStats *stats = (ThreadStats *)data;
+
+    pthread_mutex_lock(&statsLock);
+
+    for (int i = 0; i < NUM_PARSER_STATS; i++) {
+
+        exitedTotals[i].calls += load(&stats->counters[i].calls);
+        exitedTotals[i].nanoseconds += load(&stats->counters[i].nanoseconds);
+        exitedTotals[i].bytes += load(&stats->counters[i].bytes);
+
+        uint64_t maxNanoseconds = load(&stats->counters[i].maxNanoseconds);
+        if (maxNanoseconds > exitedTotals[i].maxNanoseconds) {
+            exitedTotals[i].maxNanoseconds = maxNanoseconds;
+        }
+
+    }
+
+    for (ThreadStats **link = &liveThreads; *link != NULL; link = &(*link)->next) {
+        if (*link == stats) {
+            *link = stats->next;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&statsLock);
+
+    free(stats);
+
+}
+
+static void createStatsKey(void) {
+
+    pthread_key_create(&statsKey, &retireThreadStats);
+
+}
+
+// Get the counters of the calling thread, registering them on its first call. NULL if malloc fails
+static ThreadStats *getThreadStats(void) {
+
+    if (threadStats != NULL) {
+        return threadStats;
+    }
+
+    ThreadStats *stats = calloc(1, sizeof(ThreadStats));
+    if (stats == NULL) {
+        return NULL;
+    }
+
+    pthread_once(&statsKeyOnce, &createStatsKey);
+    pthread_setspecific(statsKey, stats);
+
+    pthread_mutex_lock(&statsLock);
+    stats->next = liveThreads;
+    liveThreads = stats;
+    pthread_mutex_unlock(&statsLock);
+
+    threadStats = stats;
+
+    return stats;
+
+}
+
+uint64_t startParserStat(void) {
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000u + now.tv_nsec;
+
+}
+
+void endParserStat(ParserStat stat, uint64_t start, uint64_t bytes) {
+
+    uint64_t end = startParserStat();
+    uint64_t elapsed = end - start;
+
+    ThreadStats *stats = getThreadStats();
+    if (stats == NULL || stat < 0 || stat >= NUM_PARSER_STATS) {
+        return;
+    }
+
+    // Every counted stage is a span of the trace as well
+    recordTraceSpan(statNames[stat], start, end);
+
+    StatCounters *counters = &stats->counters[stat];
+
+    store(&counters->calls, load(&counters->calls) + 1);
+    store(&counters->nanoseconds, load(&counters->nanoseconds) + elapsed);
+    store(&counters->bytes, load(&counters->bytes) + bytes);
+
+    if (elapsed > load(&counters->maxNanoseconds)) {
+        store(&counters->maxNanoseconds, elapsed);
+    }
+
+}
+
+char *endJSONStat(ParserStat stat, uint64_t start, char *json) {
+
+    endParserStat(stat, start, json != NULL ? strlen(json) : 0);
+
+    return json;
+
+}
+
+// Add up the counters of every thread, live or exited
+static void getTotals(StatTotals *totals) {
+
+    pthread_mutex_lock(&statsLock);
+
+    memcpy(totals, exitedTotals, sizeof(exitedTotals));
+
+    for (ThreadStats *stats = liveThreads; stats != NULL; stats = stats->next) {
+
+        for (int i = 0; i < NUM_PARSER_STATS; i++) {
+
+            totals[i].calls += load(&stats->counters[i].calls);
+            totals[i].nanoseconds += load(&stats->counters[i].nanoseconds);
+            totals[i].bytes += load(&stats->counters[i].bytes);
+
+            uint64_t maxNanoseconds = load(&stats->counters[i].maxNanoseconds);
+            if (maxNanoseconds > totals[i].maxNanoseconds) {
+                totals[i].maxNanoseconds = maxNanoseconds;
+            }
+
+        }
+
+    }
+
+    pthread_mutex_unlock(&statsLock);
+
+}
+
+char *getParserStatsJSON(void) {
+
+    StatTotals totals[NUM_PARSER_STATS];
+    getTotals(totals);
+
+    StringBuilder sb;
+    initStringBuilder(&sb, 4096);
+
+    appendChar(&sb, '{');
+
+    for (int i = 0; i < NUM_PARSER_STATS; i++) {
+        appendFormat(&sb, "%s\"%s\":{\"calls\":%llu,\"totalNs\":%llu,\"maxNs\":%llu,\"bytes\":%llu}", i > 0 ? "," : "",
+            statNames[i], (unsigned long long)totals[i].calls, (unsigned long long)totals[i].nanoseconds,
+            (unsigned long long)totals[i].maxNanoseconds, (unsigned long long)totals[i].bytes);
+    }
+
+    appendChar(&sb, '}');
+
+    char *retString = finishStringBuilder(&sb);
+    if (retString == NULL) {
+        retString = malloc(3);
+        if (retString != NULL) {
+            strcpy(retString, "{}");
+        }
+    }
+
+    return retString;
+
+}
+
+// Write one metric family, with a sample for every stage
+static void appendMetric(StringBuilder *sb, const char *name, const char *type, const char *help,
+    const double *values) {
+
+    appendFormat(sb, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+
+    for (int i = 0; i < NUM_PARSER_STATS; i++) {
+        appendFormat(sb, "%s{stage=\"%s\"} %.10g\n", name, statNames[i], values[i]);
+    }
+
+}
+
+char *getParserStatsPrometheus(void) {
+
+    StatTotals totals[NUM_PARSER_STATS];
+    getTotals(totals);
+
+    double calls[NUM_PARSER_STATS], seconds[NUM_PARSER_STATS], maxSeconds[NUM_PARSER_STATS], bytes[NUM_PARSER_STATS];
+
+    for (int i = 0; i < NUM_PARSER_STATS; i++) {
+        calls[i] = totals[i].calls;
+        seconds[i] = totals[i].nanoseconds / 1e9;
+        maxSeconds[i] = totals[i].maxNanoseconds / 1e9;
+        bytes[i] = totals[i].bytes;
+    }
+
+    StringBuilder sb;
+    initStringBuilder(&sb, 8192);
+
+    appendMetric(&sb, "gpxparser_calls_total", "counter", "Number of times each parser stage ran.", calls);
+    appendMetric(&sb, "gpxparser_seconds_total", "counter", "Total time spent in each parser stage.", seconds);
+    appendMetric(&sb, "gpxparser_max_seconds", "gauge", "Longest single run of each parser stage.", maxSeconds);
+    appendMetric(&sb, "gpxparser_bytes_total", "counter", "Bytes read, validated or produced by each parser stage.",
+        bytes);
+
+    char *retString = finishStringBuilder(&sb);
+    if (retString == NULL) {
+        retString = calloc(1, 1);
+    }
+
+    return retString;
+
+}
+
+void resetParserStats(void) {
+
+    pthread_mutex_lock(&statsLock);
+
+    memset(exitedTotals, 0, sizeof(exitedTotals));
+
+    for (ThreadStats *stats = liveThreads; stats != NULL; stats = stats->next) {
+        for (int i = 0; i < NUM_PARSER_STATS; i++) {
+            store(&stats->counters[i].calls, 0);
+            store(&stats->counters[i].nanoseconds, 0);
+            store(&stats->counters[i].maxNanoseconds, 0);
+            store(&stats->counters[i].bytes, 0);
+        }
+    }
+
+    pthread_mutex_unlock(&statsLock);
+
+}
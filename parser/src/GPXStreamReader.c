@@ -0,0 +1,356 @@
+#include "GPXStreamReader.h" // Included necessary header
+#include "GPXHelpers.h"
+#include "GPXStats.h"
+
+// Expand the element under the reader and read it as a waypoint into the given list.
+// The expanded subtree is freed by the reader once it moves past the element
+static int streamPoint(xmlTextReader *reader, List *listToInsertInto) {
+
+    xmlNode *node = xmlTextReaderExpand(reader);
+    if (node == NULL) {
+        return -1;
+    }
+
+    insertWaypoints(node, newWaypoint(getListArena(listToInsertInto)), listToInsertInto);
+
+    return 1;
+
+}
+
+// Expand the element under the reader and copy its content, used for the name of a route or track
+static int streamName(xmlTextReader *reader, GPXArena *arena, char **name) {
+
+    xmlNode *node = xmlTextReaderExpand(reader);
+    if (node == NULL) {
+        return -1;
+    }
+
+    // Same as recursiveReader, if there is more than one name the last one is kept
+    char *content = (char *)xmlNodeGetContent(node);
+    if (arena == NULL) {
+        free(*name);
+    }
+    *name = copyString(arena, content);
+    xmlFree(content);
+
+    return 1;
+
+}
+
+// Expand the element under the reader and add it to otherData, with the same checks recursiveReader uses
+static int streamOtherData(xmlTextReader *reader, List *otherData) {
+
+    xmlNode *node = xmlTextReaderExpand(reader);
+    if (node == NULL) {
+        return -1;
+    }
+
+    if (node->name[0] != '\0' && !isspace(node->name[0]) && node->children && node->children->content
+        && node->children->content[0] != '\0') {
+
+        char *content = (char *)xmlNodeGetContent(node);
+        insertBack(otherData, newGPXData(getListArena(otherData), (const char *)node->name, content));
+
+        xmlFree(content);
+
+    }
+
+    return 1;
+
+}
+
+// Read the children of a trkseg one at a time, keeping every trkpt
+static int streamTrackSegment(xmlTextReader *reader, List *segments) {
+
+    TrackSegment *tmpTrkSeg = newTrackSegment(getListArena(segments));
+
+    // Insert first, so the segment is freed with the track if the file turns out to be broken
+    insertBack(segments, tmpTrkSeg);
+
+    if (xmlTextReaderIsEmptyElement(reader)) {
+        return 1;
+    }
+
+    int depth = xmlTextReaderDepth(reader);
+
+    // Loop through the children of the segment, the loop stops at the segment's end tag
+    int ret = xmlTextReaderRead(reader);
+    while (ret == 1 && xmlTextReaderDepth(reader) > depth) {
+
+        if (xmlTextReaderNodeType(reader) == XML_READER_TYPE_ELEMENT) {
+
+            if (strcmp((const char *)xmlTextReaderConstLocalName(reader), "trkpt") == 0) {
+                ret = streamPoint(reader, tmpTrkSeg->waypoints);
+            }
+
+            // Skip the rest of the child, including anything that was not read
+            if (ret == 1) {
+                ret = xmlTextReaderNext(reader);
+            }
+
+        } else {
+            ret = xmlTextReaderRead(reader);
+        }
+
+    }
+
+    return ret;
+
+}
+
+// Read a rte element one child at a time and add it to the doc
+static int streamRoute(xmlTextReader *reader, GPXdoc *docToEdit) {
+
+    GPXArena *arena = docToEdit->arena;
+    Route *tmpRte = newRoute(arena);
+
+    int ret = 1;
+
+    if (!xmlTextReaderIsEmptyElement(reader)) {
+
+        int depth = xmlTextReaderDepth(reader);
+
+        ret = xmlTextReaderRead(reader);
+        while (ret == 1 && xmlTextReaderDepth(reader) > depth) {
+
+            if (xmlTextReaderNodeType(reader) == XML_READER_TYPE_ELEMENT) {
+
+                const char *childName = (const char *)xmlTextReaderConstLocalName(reader);
+
+                if (strcmp(childName, "name") == 0) {
+                    ret = streamName(reader, arena, &tmpRte->name);
+                } else if (strcmp(childName, "rtept") == 0) {
+                    ret = streamPoint(reader, tmpRte->waypoints);
+                } else {
+                    ret = streamOtherData(reader, tmpRte->otherData);
+                }
+
+                if (ret == 1) {
+                    ret = xmlTextReaderNext(reader);
+                }
+
+            } else {
+                ret = xmlTextReaderRead(reader);
+            }
+
+        }
+
+    }
+
+    // If the name is NULL, then assign it an empty string
+    if (tmpRte->name == NULL) {
+        tmpRte->name = copyString(arena, "");
+    }
+
+    insertRoute(docToEdit, tmpRte);
+
+    return ret;
+
+}
+
+// Read a trk element one child at a time and add it to the doc. Segments are streamed too, since a
+// track log is usually one track holding almost the whole file
+static int streamTrack(xmlTextReader *reader, GPXdoc *docToEdit) {
+
+    GPXArena *arena = docToEdit->arena;
+    Track *tmpTrk = newTrack(arena);
+
+    int ret = 1;
+
+    if (!xmlTextReaderIsEmptyElement(reader)) {
+
+        int depth = xmlTextReaderDepth(reader);
+
+        ret = xmlTextReaderRead(reader);
+        while (ret == 1 && xmlTextReaderDepth(reader) > depth) {
+
+            if (xmlTextReaderNodeType(reader) == XML_READER_TYPE_ELEMENT) {
+
+                const char *childName = (const char *)xmlTextReaderConstLocalName(reader);
+
+                if (strcmp(childName, "name") == 0) {
+                    ret = streamName(reader, arena, &tmpTrk->name);
+                } else if (strcmp(childName, "trkseg") == 0) {
+                    ret = streamTrackSegment(reader, tmpTrk->segments);
+                } else {
+                    ret = streamOtherData(reader, tmpTrk->otherData);
+                }
+
+                // After a segment the reader is on its end tag, where Next just moves on like Read
+                if (ret == 1) {
+                    ret = xmlTextReaderNext(reader);
+                }
+
+            } else {
+                ret = xmlTextReaderRead(reader);
+            }
+
+        }
+
+    }
+
+    // Same as the route, a track without a name gets an empty string
+    if (tmpTrk->name == NULL) {
+        tmpTrk->name = copyString(arena, "");
+    }
+
+    insertBack(docToEdit->tracks, tmpTrk);
+
+    return ret;
+
+}
+
+// Read the attributes of the root element into a new GPXdoc, NULL if it is not a valid gpx root
+static GPXdoc *readRootElement(xmlTextReader *reader) {
+
+    // If it is not a gpx file
+    if (strcmp((const char *)xmlTextReaderConstLocalName(reader), "gpx") != 0) {
+        return NULL;
+    }
+
+    // Checking if namespace exists and is not an empty string (which makes the file invalid)
+    const char *namespace = (const char *)xmlTextReaderConstNamespaceUri(reader);
+    if (namespace == NULL || namespace[0] == '\0' || strlen(namespace) >= 256) {
+        return NULL;
+    }
+
+    // The doc and everything read into it is allocated from its own arena
+    GPXdoc *newDoc = newGPXdoc(createArena());
+    strcpy(newDoc->namespace, namespace);
+
+    int versionCheck = 0;
+
+    // Looping through all the attributes of the root node, namespace declarations are not attributes in the DOM
+    int ret = xmlTextReaderMoveToFirstAttribute(reader);
+    while (ret == 1) {
+
+        if (!xmlTextReaderIsNamespaceDecl(reader)) {
+
+            const char *attrName = (const char *)xmlTextReaderConstLocalName(reader);
+            const char *cont = (const char *)xmlTextReaderConstValue(reader);
+
+            if (strcmp(attrName, "version") == 0) {
+
+                versionCheck++;
+                newDoc->version = atof(cont);
+
+            } else if (strcmp(attrName, "creator") == 0) {
+
+                newDoc->creator = copyString(newDoc->arena, cont);
+
+            }
+
+        }
+
+        ret = xmlTextReaderMoveToNextAttribute(reader);
+
+    }
+    xmlTextReaderMoveToElement(reader);
+
+    // No creator or no version attribute
+    if (newDoc->creator == NULL || versionCheck == 0) {
+        deleteGPXdoc(newDoc);
+        return NULL;
+    }
+
+    return newDoc;
+
+}
+
+// Read the whole file under the reader into a new GPXdoc, NULL if it is not a GPX file
+static GPXdoc *readDocument(xmlTextReader *reader) {
+
+    // Skip anything before the root element, e.g. comments or a DOCTYPE
+    int ret = xmlTextReaderRead(reader);
+    while (ret == 1 && xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT) {
+        ret = xmlTextReaderRead(reader);
+    }
+
+    if (ret != 1) {
+        return NULL;
+    }
+
+    GPXdoc *newDoc = readRootElement(reader);
+    if (newDoc == NULL) {
+        return NULL;
+    }
+
+    // Read the rest of the file in document order, the handlers leave the reader on the last node of their element
+    ret = xmlTextReaderRead(reader);
+    while (ret == 1) {
+
+        if (xmlTextReaderNodeType(reader) == XML_READER_TYPE_ELEMENT) {
+
+            const char *elementName = (const char *)xmlTextReaderConstLocalName(reader);
+
+            if (strcmp(elementName, "wpt") == 0) {
+                ret = streamPoint(reader, newDoc->waypoints);
+            } else if (strcmp(elementName, "rte") == 0) {
+                ret = streamRoute(reader, newDoc);
+            } else if (strcmp(elementName, "trk") == 0) {
+                ret = streamTrack(reader, newDoc);
+            } else {
+                // Anything else is looked into, like recursiveReader does
+                ret = xmlTextReaderRead(reader);
+                continue;
+            }
+
+            if (ret == 1) {
+                ret = xmlTextReaderNext(reader);
+            }
+
+        } else {
+            ret = xmlTextReaderRead(reader);
+        }
+
+    }
+
+    // A parse error part way through makes the whole file invalid, same as xmlReadFile
+    if (ret != 0) {
+        deleteGPXdoc(newDoc);
+        return NULL;
+    }
+
+    return newDoc;
+
+}
+
+GPXdoc *readGPXdoc(xmlTextReader *reader) {
+
+    if (reader == NULL) {
+        return NULL;
+    }
+
+    uint64_t statStart = startParserStat();
+
+    GPXdoc *newDoc = readDocument(reader);
+
+    // -1 if the reader can not tell
+    long bytes = xmlTextReaderByteConsumed(reader);
+    endParserStat(STAT_READ_GPXDOC, statStart, bytes > 0 ? bytes : 0);
+
+    return newDoc;
+
+}
+
+GPXdoc *createGPXdocStreaming(char *fileName) {
+
+    // If the user enters no filename, return NULL
+    if (fileName == NULL) {
+        return NULL;
+    }
+
+    LIBXML_TEST_VERSION
+
+    xmlTextReader *reader = xmlReaderForFile(fileName, NULL, 0);
+    if (reader == NULL) {
+        return NULL;
+    }
+
+    GPXdoc *newDoc = readGPXdoc(reader);
+
+    xmlFreeTextReader(reader);
+
+    return newDoc;
+
+}
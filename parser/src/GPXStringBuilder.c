@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "GPXStringBuilder.h" // Included necessary header
+
+// Make sure there is room for extra more characters plus the null terminator, doubling the buffer when it is full
+static bool reserveSpace(StringBuilder *sb, size_t extra) {
+
+    // A previous allocation failed, so the builder stays empty
+    if (sb->str == NULL) {
+        return false;
+    }
+
+    size_t needed = sb->length + extra + 1;
+    if (needed <= sb->capacity) {
+        return true;
+    }
+
+    size_t newCapacity = sb->capacity * 2;
+    if (newCapacity < needed) {
+        newCapacity = needed;
+    }
+
+    char *newStr = realloc(sb->str, newCapacity);
+    if (newStr == NULL) {
+        free(sb->str);
+        sb->str = NULL;
+        return false;
+    }
+
+    sb->str = newStr;
+    sb->capacity = newCapacity;
+
+    return true;
+
+}
+
+void initStringBuilder(StringBuilder *sb, size_t initialCapacity) {
+
+    if (initialCapacity < 16) {
+        initialCapacity = 16;
+    }
+
+    sb->str = malloc(initialCapacity);
+    sb->length = 0;
+    sb->capacity = initialCapacity;
+
+    if (sb->str != NULL) {
+        sb->str[0] = '\0';
+    }
+
+}
+
+void appendStringLength(StringBuilder *sb, const char *str, size_t len) {
+
+    if (!reserveSpace(sb, len)) {
+        return;
+    }
+
+    memcpy(sb->str + sb->length, str, len);
+    sb->length += len;
+    sb->str[sb->length] = '\0';
+
+}
+
+void appendString(StringBuilder *sb, const char *str) {
+
+    appendStringLength(sb, str, strlen(str));
+
+}
+
+void appendChar(StringBuilder *sb, char c) {
+
+    if (!reserveSpace(sb, 1)) {
+        return;
+    }
+
+    sb->str[sb->length++] = c;
+    sb->str[sb->length] = '\0';
+
+}
+
+void appendFormat(StringBuilder *sb, const char *format, ...) {
+
+    if (sb->str == NULL) {
+        return;
+    }
+
+    // First try to print into the space that is already there
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(sb->str + sb->length, sb->capacity - sb->length, format, args);
+    va_end(args);
+
+    if (written < 0) {
+        return;
+    }
+
+    // It did not fit, so grow the buffer and print again
+    if ((size_t)written >= sb->capacity - sb->length) {
+
+        if (!reserveSpace(sb, written)) {
+            return;
+        }
+
+        va_start(args, format);
+        vsnprintf(sb->str + sb->length, sb->capacity - sb->length, format, args);
+        va_end(args);
+
+    }
+
+    sb->length += written;
+
+}
+
+char *finishStringBuilder(StringBuilder *sb) {
+
+    char *retString = sb->str;
+
+    sb->str = NULL;
+    sb->length = 0;
+    sb->capacity = 0;
+
+    return retString;
+
+}
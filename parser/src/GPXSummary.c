@@ -0,0 +1,187 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include "GPXSummary.h" // Included necessary header
+#include "GPXCorpus.h"
+#include "GPXStringBuilder.h"
+#include "GPXView.h"
+
+// The files of one call, shared by its worker threads
+typedef struct {
+    // Directory the names are in, NULL if the names are paths already
+    const char *dirName;
+    char **fileNames;
+    int count;
+    const char *schemaFile;
+
+    // Summary of each file by position, NULL for invalid files. Each slot is only written by the thread that took it
+    char **summaries;
+
+    // Position of the next file no thread has taken yet
+    atomic_int nextFile;
+} SummaryJob;
+
+// Get the summary JSON of one file, NULL if it is not valid
+static char *summarizeFile(const SummaryJob *job, int i) {
+
+    char *path = job->fileNames[i];
+    if (job->dirName != NULL) {
+        path = malloc(strlen(job->dirName) + strlen(job->fileNames[i]) + 2);
+        if (path == NULL) {
+            return NULL;
+        }
+        sprintf(path, "%s/%s", job->dirName, job->fileNames[i]);
+    }
+
+    GPXImage *view = openGPXView(path, (char *)job->schemaFile);
+
+    if (job->dirName != NULL) {
+        free(path);
+    }
+
+    // Same test getGPXDataIfValid uses, a doc without a creator gives "{}"
+    if (view == NULL || view->header->creator == 0) {
+        closeGPXImage(view);
+        return NULL;
+    }
+
+    StringBuilder sb;
+    initStringBuilder(&sb, 128);
+
+    appendFormat(&sb, "{\"filename\":\"%s\",\"version\":%g,\"creator\":\"%s\",\"numWaypoints\":%d,\"numRoutes\":%d,"
+        "\"numTracks\":%d}", job->fileNames[i], view->header->version, getImageString(view, view->header->creator),
+        getViewNumWaypoints(view), getViewNumRoutes(view), getViewNumTracks(view));
+
+    closeGPXImage(view);
+
+    return finishStringBuilder(&sb);
+
+}
+
+// Take files until there are none left
+static void *summaryWorker(void *arg) {
+
+    SummaryJob *job = (SummaryJob *)arg;
+
+    int i;
+    while ((i = atomic_fetch_add(&job->nextFile, 1)) < job->count) {
+        job->summaries[i] = summarizeFile(job, i);
+    }
+
+    return NULL;
+
+}
+
+// Number of threads to use for a number of files: one per core, but no more than there are files
+static int getSummaryThreadCount(int count) {
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+    int threadCount = cores > 0 ? (int)cores : 1;
+    if (threadCount > MAX_SUMMARY_THREADS) {
+        threadCount = MAX_SUMMARY_THREADS;
+    }
+    if (threadCount > count) {
+        threadCount = count;
+    }
+
+    return threadCount;
+
+}
+
+// Summarize the files of a job and join the summaries into one JSON array
+static char *runSummaryJob(SummaryJob *job) {
+
+    StringBuilder sb;
+    initStringBuilder(&sb, 128 * (job->count + 1));
+
+    job->summaries = calloc(job->count > 0 ? job->count : 1, sizeof(char *));
+    if (job->summaries == NULL) {
+        appendString(&sb, "[]");
+        return finishStringBuilder(&sb);
+    }
+
+    atomic_init(&job->nextFile, 0);
+
+    // The calling thread is one of the workers. If a thread can not be started the others take its share
+    pthread_t threads[MAX_SUMMARY_THREADS];
+    int started = 0;
+    int threadCount = getSummaryThreadCount(job->count);
+
+    for (int i = 1; i < threadCount; i++) {
+        if (pthread_create(&threads[started], NULL, &summaryWorker, job) == 0) {
+            started++;
+        }
+    }
+
+    summaryWorker(job);
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    appendString(&sb, "[");
+
+    bool first = true;
+    for (int i = 0; i < job->count; i++) {
+
+        if (job->summaries[i] == NULL) {
+            continue;
+        }
+
+        if (!first) {
+            appendString(&sb, ",");
+        }
+        appendString(&sb, job->summaries[i]);
+        first = false;
+
+        free(job->summaries[i]);
+
+    }
+
+    appendString(&sb, "]");
+
+    free(job->summaries);
+
+    return finishStringBuilder(&sb);
+
+}
+
+char *getFileSummaries (char **fileNames, int count, char *schemaFile) {
+
+    if (fileNames == NULL || count < 0 || schemaFile == NULL) {
+        char *retString = malloc(3);
+        strcpy(retString, "[]");
+        return retString;
+    }
+
+    SummaryJob job = {.dirName = NULL, .fileNames = fileNames, .count = count, .schemaFile = schemaFile};
+
+    return runSummaryJob(&job);
+
+}
+
+char *getDirSummaries (char *dirName, char *schemaFile) {
+
+    char **names = NULL;
+    int count = dirName == NULL || schemaFile == NULL ? -1 : listGPXFiles(dirName, &names);
+
+    if (count < 0) {
+        char *retString = malloc(3);
+        strcpy(retString, "[]");
+        return retString;
+    }
+
+    SummaryJob job = {.dirName = dirName, .fileNames = names, .count = count, .schemaFile = schemaFile};
+    char *retString = runSummaryJob(&job);
+
+    for (int i = 0; i < count; i++) {
+        free(names[i]);
+    }
+    free(names);
+
+    return retString;
+
+}
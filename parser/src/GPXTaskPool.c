@@ -0,0 +1,263 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "GPXTaskPool.h" // Included necessary header
+
+// A parallelFor waiting for its pieces
+typedef struct {
+    // Pieces that are pushed or running but not finished
+    atomic_int pending;
+} TaskGroup;
+
+// A piece of the range of a parallelFor
+typedef struct {
+    RangeFunction body;
+    void *arg;
+    int begin;
+    int end;
+    int grain;
+    TaskGroup *group;
+} Task;
+
+// Tasks from top to bottom - 1. The owner uses the bottom, thieves the top
+typedef struct {
+    pthread_mutex_t lock;
+    Task *tasks;
+    int capacity;
+    int top;
+    int bottom;
+} TaskDeque;
+
+// Deque 0 is shared by the threads outside the pool that call parallelFor, deque n belongs to worker n
+static TaskDeque deques[MAX_POOL_THREADS];
+static int dequeCount = 1;
+static int threadCount = 1;
+static pthread_once_t poolOnce = PTHREAD_ONCE_INIT;
+
+// The deque of the current thread
+static _Thread_local int ownDeque = 0;
+
+// Tasks sitting in any deque. Idle workers sleep on the condition until it is positive
+static atomic_int queuedTasks = 0;
+static pthread_mutex_t sleepLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sleepCondition = PTHREAD_COND_INITIALIZER;
+
+// Add a task at the bottom of the current thread's deque and wake a sleeping worker. Returns false if malloc fails
+static bool pushTask(const Task *task) {
+
+    TaskDeque *deque = &deques[ownDeque];
+
+    pthread_mutex_lock(&deque->lock);
+
+    if (deque->bottom == deque->capacity) {
+
+        // Slide the tasks down over the stolen ones first, only grow if the deque is really full
+        if (deque->top > 0) {
+            memmove(deque->tasks, deque->tasks + deque->top, (deque->bottom - deque->top) * sizeof(Task));
+            deque->bottom -= deque->top;
+            deque->top = 0;
+        } else {
+            int newCapacity = deque->capacity == 0 ? 64 : deque->capacity * 2;
+            Task *newTasks = realloc(deque->tasks, newCapacity * sizeof(Task));
+            if (newTasks == NULL) {
+                pthread_mutex_unlock(&deque->lock);
+                return false;
+            }
+            deque->tasks = newTasks;
+            deque->capacity = newCapacity;
+        }
+
+    }
+
+    deque->tasks[deque->bottom] = *task;
+    deque->bottom++;
+
+    pthread_mutex_unlock(&deque->lock);
+
+    atomic_fetch_add(&queuedTasks, 1);
+
+    if (dequeCount > 1) {
+        pthread_mutex_lock(&sleepLock);
+        pthread_cond_signal(&sleepCondition);
+        pthread_mutex_unlock(&sleepLock);
+    }
+
+    return true;
+
+}
+
+// Take the newest task of the current thread's deque, or else the oldest task of another one
+static bool takeTask(Task *task) {
+
+    for (int k = 0; k < dequeCount; k++) {
+
+        TaskDeque *deque = &deques[(ownDeque + k) % dequeCount];
+        bool found = false;
+
+        pthread_mutex_lock(&deque->lock);
+
+        if (deque->top < deque->bottom) {
+
+            if (k == 0) {
+                deque->bottom--;
+                *task = deque->tasks[deque->bottom];
+            } else {
+                *task = deque->tasks[deque->top];
+                deque->top++;
+            }
+
+            if (deque->top == deque->bottom) {
+                deque->top = 0;
+                deque->bottom = 0;
+            }
+
+            found = true;
+
+        }
+
+        pthread_mutex_unlock(&deque->lock);
+
+        if (found) {
+            atomic_fetch_sub(&queuedTasks, 1);
+            return true;
+        }
+
+    }
+
+    return false;
+
+}
+
+// Run a task, first pushing the upper half of it for as long as it is larger than the grain
+static void runTask(Task task) {
+
+    while (task.end - task.begin > task.grain) {
+
+        int middle = task.begin + (task.end - task.begin) / 2;
+
+        Task upper = task;
+        upper.begin = middle;
+
+        atomic_fetch_add(&task.group->pending, 1);
+        if (!pushTask(&upper)) {
+            // Nowhere to put it, so this thread runs the whole rest itself
+            atomic_fetch_sub(&task.group->pending, 1);
+            break;
+        }
+
+        task.end = middle;
+
+    }
+
+    task.body(task.arg, task.begin, task.end);
+
+    atomic_fetch_sub(&task.group->pending, 1);
+
+}
+
+static void *poolWorker(void *arg) {
+
+    ownDeque = (int)(intptr_t)arg;
+
+    Task task;
+
+    while (true) {
+
+        if (takeTask(&task)) {
+            runTask(task);
+            continue;
+        }
+
+        pthread_mutex_lock(&sleepLock);
+        while (atomic_load(&queuedTasks) <= 0) {
+            pthread_cond_wait(&sleepCondition, &sleepLock);
+        }
+        pthread_mutex_unlock(&sleepLock);
+
+    }
+
+    return NULL;
+
+}
+
+// Start one worker per core besides the caller. The workers live as long as the process
+static void startPool(void) {
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+    int wanted = cores > 0 ? (int)cores : 1;
+    if (wanted > MAX_POOL_THREADS) {
+        wanted = MAX_POOL_THREADS;
+    }
+
+    for (int i = 0; i < wanted; i++) {
+        pthread_mutex_init(&deques[i].lock, NULL);
+    }
+
+    // The deques must all exist before the first worker starts looking at them
+    dequeCount = wanted;
+
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+
+    // A worker that can not be started just leaves its deque empty
+    for (int i = 1; i < wanted; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, &attributes, &poolWorker, (void *)(intptr_t)i) == 0) {
+            threadCount++;
+        }
+    }
+
+    pthread_attr_destroy(&attributes);
+
+}
+
+void parallelFor(int count, int grain, RangeFunction body, void *arg) {
+
+    if (count <= 0 || body == NULL) {
+        return;
+    }
+
+    if (grain < 1) {
+        grain = 1;
+    }
+
+    pthread_once(&poolOnce, &startPool);
+
+    if (threadCount == 1 || count <= grain) {
+        body(arg, 0, count);
+        return;
+    }
+
+    TaskGroup group;
+    atomic_init(&group.pending, 1);
+
+    Task task = {.body = body, .arg = arg, .begin = 0, .end = count, .grain = grain, .group = &group};
+    runTask(task);
+
+    // Help with whatever is queued, this range or any other, until every piece of this range is done
+    while (atomic_load(&group.pending) > 0) {
+        if (takeTask(&task)) {
+            runTask(task);
+        } else {
+            sched_yield();
+        }
+    }
+
+}
+
+int getTaskPoolThreadCount(void) {
+
+    pthread_once(&poolOnce, &startPool);
+
+    return threadCount;
+
+}
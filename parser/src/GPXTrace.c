@@ -0,0 +1,320 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "GPXTrace.h" // Included necessary header
+#include "GPXStringBuilder.h"
+
+// One span. Its thread writes it while dumps may read it, so the fields are atomic; relaxed, since the head of the
+// buffer orders them
+typedef struct {
+    _Atomic(const char *) name;
+    _Atomic uint64_t start;
+    _Atomic uint64_t end;
+} TraceSpan;
+
+// A span as read out of a buffer
+typedef struct {
+    const char *name;
+    uint64_t start;
+    uint64_t end;
+} SpanCopy;
+
+// Spans of one thread. Span i is at spans[i % MAX_TRACE_SPANS]; head is the number of spans ever recorded, and
+// clearedAt the head at the last clearParserTrace
+typedef struct TraceBuffer {
+    int tid;
+    _Atomic uint64_t head;
+    _Atomic uint64_t clearedAt;
+    TraceSpan spans[MAX_TRACE_SPANS];
+
+    // Set once the thread has exited, guarded by traceLock
+    bool retired;
+    struct TraceBuffer *next;
+} TraceBuffer;
+
+static _Atomic bool tracing = false;
+
+static _Thread_local TraceBuffer *threadBuffer = NULL;
+
+// Every buffer ever made. The lock only guards the list, recording a span never takes it
+static TraceBuffer *traceBuffers = NULL;
+static int numTraceBuffers = 0;
+static pthread_mutex_t traceLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Its destructor retires the buffer of a thread when the thread exits
+static pthread_key_t traceKey;
+static pthread_once_t traceKeyOnce = PTHREAD_ONCE_INIT;
+
+// Where GPXPARSER_TRACE asked for the trace to be written at exit, NULL if nowhere
+static char *traceFileAtExit = NULL;
+
+static uint64_t getTraceTime(void) {
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000u + now.tv_nsec;
+
+}
+
+static void writeTraceAtExit(void) {
+
+    writeParserTrace(traceFileAtExit);
+    free(traceFileAtExit);
+
+}
+
+// Read GPXPARSER_TRACE once, when the library is loaded
+__attribute__((constructor))
+static void initParserTracing(void) {
+
+    const char *setting = getenv("GPXPARSER_TRACE");
+    if (setting == NULL || setting[0] == '\0' || strcmp(setting, "0") == 0) {
+        return;
+    }
+
+    if (strcmp(setting, "1") != 0) {
+        traceFileAtExit = malloc(strlen(setting) + 1);
+        if (traceFileAtExit != NULL) {
+            strcpy(traceFileAtExit, setting);
+            atexit(&writeTraceAtExit);
+        }
+    }
+
+    setParserTracing(true);
+
+}
+
+// The spans of an exited thread stay in its buffer until the buffer is handed to a new thread, which then records
+// under the same tid. The two threads never ran at the same time, so their spans do not overlap
+static void retireTraceBuffer(void *data) {
+
+    pthread_mutex_lock(&traceLock);
+    ((TraceBuffer *)data)->retired = true;
+    pthread_mutex_unlock(&traceLock);
+
+}
+
+static void createTraceKey(void) {
+
+    pthread_key_create(&traceKey, &retireTraceBuffer);
+
+}
+
+// Get the buffer of the calling thread, taking a retired one or making one on its first span. NULL if malloc fails
+static TraceBuffer *getThreadBuffer(void) {
+
+    if (threadBuffer != NULL) {
+        return threadBuffer;
+    }
+
+    pthread_once(&traceKeyOnce, &createTraceKey);
+    pthread_mutex_lock(&traceLock);
+
+    TraceBuffer *buffer = traceBuffers;
+    while (buffer != NULL && !buffer->retired) {
+        buffer = buffer->next;
+    }
+
+    if (buffer != NULL) {
+        buffer->retired = false;
+    } else {
+
+        buffer = calloc(1, sizeof(TraceBuffer));
+        if (buffer == NULL) {
+            pthread_mutex_unlock(&traceLock);
+            return NULL;
+        }
+
+        buffer->tid = ++numTraceBuffers;
+        buffer->next = traceBuffers;
+        traceBuffers = buffer;
+
+    }
+
+    pthread_mutex_unlock(&traceLock);
+
+    pthread_setspecific(traceKey, buffer);
+    threadBuffer = buffer;
+
+    return buffer;
+
+}
+
+void setParserTracing(bool enabled) {
+
+    atomic_store_explicit(&tracing, enabled, memory_order_relaxed);
+
+}
+
+bool isParserTracing(void) {
+
+    return atomic_load_explicit(&tracing, memory_order_relaxed);
+
+}
+
+uint64_t beginTraceSpan(void) {
+
+    return isParserTracing() ? getTraceTime() : 0;
+
+}
+
+void endTraceSpan(const char *name, uint64_t start) {
+
+    if (start != 0) {
+        recordTraceSpan(name, start, getTraceTime());
+    }
+
+}
+
+void recordTraceSpan(const char *name, uint64_t start, uint64_t end) {
+
+    if (!isParserTracing()) {
+        return;
+    }
+
+    TraceBuffer *buffer = getThreadBuffer();
+    if (buffer == NULL) {
+        return;
+    }
+
+    // Only this thread moves the head, so the slot is ours until the head is published past it
+    uint64_t head = atomic_load_explicit(&buffer->head, memory_order_relaxed);
+    TraceSpan *span = &buffer->spans[head % MAX_TRACE_SPANS];
+
+    atomic_store_explicit(&span->name, name, memory_order_relaxed);
+    atomic_store_explicit(&span->start, start, memory_order_relaxed);
+    atomic_store_explicit(&span->end, end, memory_order_relaxed);
+
+    atomic_store_explicit(&buffer->head, head + 1, memory_order_release);
+
+}
+
+// Append the spans of one buffer to the trace. Returns the number appended
+static int appendBufferSpans(StringBuilder *sb, TraceBuffer *buffer, SpanCopy *copy, int pid, int written) {
+
+    uint64_t head = atomic_load_explicit(&buffer->head, memory_order_acquire);
+    uint64_t first = atomic_load_explicit(&buffer->clearedAt, memory_order_relaxed);
+    if (head > MAX_TRACE_SPANS && head - MAX_TRACE_SPANS > first) {
+        first = head - MAX_TRACE_SPANS;
+    }
+
+    for (uint64_t i = first; i < head; i++) {
+        TraceSpan *span = &buffer->spans[i % MAX_TRACE_SPANS];
+        copy[i - first].name = atomic_load_explicit(&span->name, memory_order_relaxed);
+        copy[i - first].start = atomic_load_explicit(&span->start, memory_order_relaxed);
+        copy[i - first].end = atomic_load_explicit(&span->end, memory_order_relaxed);
+    }
+
+    // The thread may have kept recording while the spans were copied. The span it is writing now is number
+    // newHead, which overwrites number newHead - MAX_TRACE_SPANS, so only the spans after that one are whole
+    atomic_thread_fence(memory_order_acquire);
+    uint64_t newHead = atomic_load_explicit(&buffer->head, memory_order_relaxed);
+
+    uint64_t firstWhole = first;
+    if (newHead + 1 > MAX_TRACE_SPANS && newHead + 1 - MAX_TRACE_SPANS > firstWhole) {
+        firstWhole = newHead + 1 - MAX_TRACE_SPANS;
+    }
+
+    int appended = 0;
+
+    for (uint64_t i = firstWhole; i < head; i++) {
+
+        SpanCopy *span = &copy[i - first];
+
+        appendFormat(sb, "%s{\"name\":\"%s\",\"cat\":\"gpxparser\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,"
+            "\"tid\":%d}", written + appended > 0 ? "," : "", span->name, span->start / 1e3,
+            (span->end - span->start) / 1e3, pid, buffer->tid);
+
+        appended++;
+
+    }
+
+    return appended;
+
+}
+
+char *getParserTraceJSON(void) {
+
+    StringBuilder sb;
+    initStringBuilder(&sb, 4096);
+
+    appendString(&sb, "{\"traceEvents\":[");
+
+    SpanCopy *copy = malloc(sizeof(SpanCopy) * MAX_TRACE_SPANS);
+    if (copy != NULL) {
+
+        int pid = (int)getpid();
+        int written = 0;
+
+        pthread_mutex_lock(&traceLock);
+
+        for (TraceBuffer *buffer = traceBuffers; buffer != NULL; buffer = buffer->next) {
+            written += appendBufferSpans(&sb, buffer, copy, pid, written);
+        }
+
+        pthread_mutex_unlock(&traceLock);
+
+        free(copy);
+
+    }
+
+    appendString(&sb, "]}");
+
+    char *retString = finishStringBuilder(&sb);
+    if (retString == NULL) {
+        retString = malloc(strlen("{\"traceEvents\":[]}") + 1);
+        if (retString != NULL) {
+            strcpy(retString, "{\"traceEvents\":[]}");
+        }
+    }
+
+    return retString;
+
+}
+
+bool writeParserTrace(const char *fileName) {
+
+    if (fileName == NULL) {
+        return false;
+    }
+
+    char *trace = getParserTraceJSON();
+    if (trace == NULL) {
+        return false;
+    }
+
+    FILE *file = fopen(fileName, "w");
+    if (file == NULL) {
+        free(trace);
+        return false;
+    }
+
+    bool written = fputs(trace, file) >= 0;
+    if (fclose(file) != 0) {
+        written = false;
+    }
+
+    free(trace);
+
+    return written;
+
+}
+
+void clearParserTrace(void) {
+
+    pthread_mutex_lock(&traceLock);
+
+    for (TraceBuffer *buffer = traceBuffers; buffer != NULL; buffer = buffer->next) {
+        atomic_store_explicit(&buffer->clearedAt, atomic_load_explicit(&buffer->head, memory_order_acquire),
+            memory_order_relaxed);
+    }
+
+    pthread_mutex_unlock(&traceLock);
+
+}
@@ -0,0 +1,449 @@
+#include "GPXView.h" // Included necessary header
+#include "GPXHelpers.h"
+#include "GPXDistance.h"
+#include "GPXStats.h"
+#include "GPXTrace.h"
+
+GPXImage *openGPXView(char *fileName, char *schemaFile) {
+
+    if (fileName == NULL || schemaFile == NULL) {
+        return NULL;
+    }
+
+    uint64_t spanStart = beginTraceSpan();
+    GPXImage *view = openCachedGPXImage(fileName, schemaFile);
+    endTraceSpan("openCachedGPXImage", spanStart);
+
+    if (view != NULL) {
+        return view;
+    }
+
+    // No fresh image, so the file is loaded once the normal way, which writes one if it can
+    GPXdoc *doc = createValidGPXdoc(fileName, schemaFile);
+    if (doc == NULL) {
+        return NULL;
+    }
+
+    view = openCachedGPXImage(fileName, schemaFile);
+    if (view == NULL) {
+        view = createGPXImage(doc);
+    }
+
+    deleteGPXdoc(doc);
+
+    return view;
+
+}
+
+int getViewNumWaypoints(const GPXImage *view) {
+
+    return view == NULL ? 0 : view->header->waypointCount;
+
+}
+
+int getViewNumRoutes(const GPXImage *view) {
+
+    return view == NULL ? 0 : view->header->routeCount;
+
+}
+
+int getViewNumTracks(const GPXImage *view) {
+
+    return view == NULL ? 0 : view->header->trackCount;
+
+}
+
+int getViewNumSegments(const GPXImage *view) {
+
+    return view == NULL ? 0 : view->header->segmentCount;
+
+}
+
+// Distance between two points of a view, with the cached cosines
+static double viewDistance(const GPXImage *view, uint32_t first, uint32_t second) {
+
+    return haversineWithCos(view->latitudes[first], view->longitudes[first], view->cosLatitudes[first],
+        view->latitudes[second], view->longitudes[second], view->cosLatitudes[second]);
+
+}
+
+// Number of points in all the segments of a track
+static int getViewTrackPoints(const GPXImage *view, const GPXImageTrack *track) {
+
+    int numPoints = 0;
+    for (uint32_t s = track->firstSegment; s < track->firstSegment + track->segmentCount; s++) {
+        numPoints += view->segments[s].pointCount;
+    }
+
+    return numPoints;
+
+}
+
+float getViewRouteLen(const GPXImage *view, int route) {
+
+    if (view == NULL || route < 0 || route >= getViewNumRoutes(view)) {
+        return 0.0;
+    }
+
+    // The points of a route are a contiguous range of the point arrays
+    const GPXImageRoute *rt = &view->routes[route];
+
+    return getPathLength(view->latitudes + rt->firstPoint, view->longitudes + rt->firstPoint,
+        view->cosLatitudes + rt->firstPoint, rt->pointCount);
+
+}
+
+float getViewTrackLen(const GPXImage *view, int track) {
+
+    float total = 0.0;
+
+    if (view == NULL || track < 0 || track >= getViewNumTracks(view)) {
+        return total;
+    }
+
+    const GPXImageTrack *tr = &view->tracks[track];
+
+    // Same sum as getTotalTrackSegLen: each segment, and the gap from the end of one segment to the start of the next
+    PathPoints stackPaths[16];
+    PathPoints *paths = stackPaths;
+
+    if (tr->segmentCount > 16) {
+        paths = malloc(sizeof(PathPoints) * tr->segmentCount);
+        if (paths == NULL) {
+            return total;
+        }
+    }
+
+    int pathCount = 0;
+
+    for (uint32_t s = tr->firstSegment; s < tr->firstSegment + tr->segmentCount; s++) {
+
+        const GPXImageSegment *seg = &view->segments[s];
+
+        // An empty segment has no ends to join, so it is skipped
+        if (seg->pointCount == 0) {
+            continue;
+        }
+
+        paths[pathCount] = (PathPoints){view->latitudes + seg->firstPoint, view->longitudes + seg->firstPoint,
+            view->cosLatitudes + seg->firstPoint, seg->pointCount};
+        pathCount++;
+
+    }
+
+    total = getJoinedPathLength(paths, pathCount);
+
+    if (paths != stackPaths) {
+        free(paths);
+    }
+
+    return total;
+
+}
+
+bool isViewLoopRoute(const GPXImage *view, int route, float delta) {
+
+    if (view == NULL || delta < 0 || route < 0 || route >= getViewNumRoutes(view)) {
+        return false;
+    }
+
+    const GPXImageRoute *rt = &view->routes[route];
+    if (rt->pointCount < 4) {
+        return false;
+    }
+
+    return viewDistance(view, rt->firstPoint, rt->firstPoint + rt->pointCount - 1) < delta;
+
+}
+
+bool isViewLoopTrack(const GPXImage *view, int track, float delta) {
+
+    if (view == NULL || delta < 0 || track < 0 || track >= getViewNumTracks(view)) {
+        return false;
+    }
+
+    const GPXImageTrack *tr = &view->tracks[track];
+    if (getViewTrackPoints(view, tr) < 4) {
+        return false;
+    }
+
+    // First point of the first segment and last point of the last one, neither of which may be empty
+    const GPXImageSegment *firstSeg = &view->segments[tr->firstSegment];
+    const GPXImageSegment *lastSeg = &view->segments[tr->firstSegment + tr->segmentCount - 1];
+
+    if (firstSeg->pointCount == 0 || lastSeg->pointCount == 0) {
+        return false;
+    }
+
+    return viewDistance(view, firstSeg->firstPoint, lastSeg->firstPoint + lastSeg->pointCount - 1) < delta;
+
+}
+
+int numViewRoutesWithLength(const GPXImage *view, float len, float delta) {
+
+    int total = 0;
+
+    if (view == NULL || len < 0 || delta < 0) {
+        return total;
+    }
+
+    for (int r = 0; r < getViewNumRoutes(view); r++) {
+        if (fabs(getViewRouteLen(view, r) - len) <= delta) {
+            total++;
+        }
+    }
+
+    return total;
+
+}
+
+int numViewTracksWithLength(const GPXImage *view, float len, float delta) {
+
+    int total = 0;
+
+    if (view == NULL || len < 0 || delta < 0) {
+        return total;
+    }
+
+    for (int t = 0; t < getViewNumTracks(view); t++) {
+        if (fabs(getViewTrackLen(view, t) - len) <= delta) {
+            total++;
+        }
+    }
+
+    return total;
+
+}
+
+// The exact test getRoutesBetween makes, for a path from point first to point last
+static bool isViewPathBetween(const GPXImage *view, uint32_t first, uint32_t last, double sourceLat, double sourceLong,
+    double cosSource, double destLat, double destLong, double cosDest, double delta) {
+
+    return haversineWithCos(view->latitudes[first], view->longitudes[first], view->cosLatitudes[first], sourceLat,
+            sourceLong, cosSource) <= delta
+        && haversineWithCos(view->latitudes[last], view->longitudes[last], view->cosLatitudes[last], destLat, destLong,
+            cosDest) <= delta;
+
+}
+
+int getViewRoutesBetween(const GPXImage *view, float sourceLat, float sourceLong, float destLat, float destLong,
+    float delta, int *paths) {
+
+    if (view == NULL || paths == NULL || delta < 0) {
+        return 0;
+    }
+
+    double cosSource = cos(sourceLat * (M_PI/180));
+    double cosDest = cos(destLat * (M_PI/180));
+
+    int count = 0;
+
+    for (int r = 0; r < getViewNumRoutes(view); r++) {
+
+        const GPXImageRoute *rt = &view->routes[r];
+
+        if (rt->pointCount > 0 && isViewPathBetween(view, rt->firstPoint, rt->firstPoint + rt->pointCount - 1,
+            sourceLat, sourceLong, cosSource, destLat, destLong, cosDest, delta)) {
+            paths[count++] = r;
+        }
+
+    }
+
+    return count;
+
+}
+
+int getViewTracksBetween(const GPXImage *view, float sourceLat, float sourceLong, float destLat, float destLong,
+    float delta, int *paths) {
+
+    if (view == NULL || paths == NULL || delta < 0) {
+        return 0;
+    }
+
+    double cosSource = cos(sourceLat * (M_PI/180));
+    double cosDest = cos(destLat * (M_PI/180));
+
+    int count = 0;
+
+    for (int t = 0; t < getViewNumTracks(view); t++) {
+
+        const GPXImageTrack *tr = &view->tracks[t];
+        if (tr->segmentCount == 0) {
+            continue;
+        }
+
+        // Same ends as setTrackEntry, a track whose first or last segment is empty is never between anything
+        const GPXImageSegment *firstSeg = &view->segments[tr->firstSegment];
+        const GPXImageSegment *lastSeg = &view->segments[tr->firstSegment + tr->segmentCount - 1];
+
+        if (firstSeg->pointCount > 0 && lastSeg->pointCount > 0 && isViewPathBetween(view, firstSeg->firstPoint,
+            lastSeg->firstPoint + lastSeg->pointCount - 1, sourceLat, sourceLong, cosSource, destLat, destLong,
+            cosDest, delta)) {
+            paths[count++] = t;
+        }
+
+    }
+
+    return count;
+
+}
+
+char *viewToJSON(const GPXImage *view) {
+
+    uint64_t statStart = startParserStat();
+
+    StringBuilder sb;
+    initStringBuilder(&sb, 128);
+
+    if (view == NULL || view->header->creator == 0) {
+        appendString(&sb, "{}");
+        return endJSONStat(STAT_VIEW_TO_JSON, statStart, finishStringBuilder(&sb));
+    }
+
+    appendFormat(&sb, "{\"version\":%g,\"creator\":\"%s\",\"numWaypoints\":%d,\"numRoutes\":%d,\"numTracks\":%d}",
+        view->header->version, getImageString(view, view->header->creator), getViewNumWaypoints(view),
+        getViewNumRoutes(view), getViewNumTracks(view));
+
+    return endJSONStat(STAT_VIEW_TO_JSON, statStart, finishStringBuilder(&sb));
+
+}
+
+// Write a route of a view in JSON format, same as appendRouteJSON
+static void appendViewRouteJSON(StringBuilder *sb, const GPXImage *view, int route) {
+
+    const GPXImageRoute *rt = &view->routes[route];
+    const char *name = rt->name == 0 ? "None" : getImageString(view, rt->name);
+
+    appendFormat(sb, "{\"name\":\"%s\",\"numPoints\":%d,\"len\":%.1f,\"loop\":%s}", name, (int)rt->pointCount,
+        round10(getViewRouteLen(view, route)), isViewLoopRoute(view, route, 10) ? "true" : "false");
+
+}
+
+// Same as appendNewTrackJSON
+static void appendViewTrackJSON(StringBuilder *sb, const GPXImage *view, int track) {
+
+    const GPXImageTrack *tr = &view->tracks[track];
+    const char *name = tr->name == 0 ? "None" : getImageString(view, tr->name);
+
+    appendFormat(sb, "{\"name\":\"%s\",\"numPoints\":%d,\"len\":%.1f,\"loop\":%s}", name, getViewTrackPoints(view, tr),
+        round10(getViewTrackLen(view, track)), isViewLoopTrack(view, track, 10) ? "true" : "false");
+
+}
+
+// Write a JSON array of paths of a view, all of them if paths is NULL and the listed ones otherwise
+static void appendViewListJSON(StringBuilder *sb, const GPXImage *view, const int *paths, int count,
+    void (*appendPath)(StringBuilder *sb, const GPXImage *view, int path)) {
+
+    appendChar(sb, '[');
+
+    for (int i = 0; i < count; i++) {
+
+        if (i > 0) {
+            appendChar(sb, ',');
+        }
+
+        appendPath(sb, view, paths != NULL ? paths[i] : i);
+
+    }
+
+    appendChar(sb, ']');
+
+}
+
+char *viewRouteListToJSON(const GPXImage *view) {
+
+    uint64_t statStart = startParserStat();
+
+    StringBuilder sb;
+    initStringBuilder(&sb, 256);
+    appendViewListJSON(&sb, view, NULL, getViewNumRoutes(view), &appendViewRouteJSON);
+
+    return endJSONStat(STAT_VIEW_ROUTE_LIST_TO_JSON, statStart, finishStringBuilder(&sb));
+
+}
+
+char *viewTrackListToJSON(const GPXImage *view) {
+
+    uint64_t statStart = startParserStat();
+
+    StringBuilder sb;
+    initStringBuilder(&sb, 256);
+    appendViewListJSON(&sb, view, NULL, getViewNumTracks(view), &appendViewTrackJSON);
+
+    return endJSONStat(STAT_VIEW_TRACK_LIST_TO_JSON, statStart, finishStringBuilder(&sb));
+
+}
+
+char *viewRoutesAndTracksToJSON(const GPXImage *view) {
+
+    uint64_t statStart = startParserStat();
+
+    StringBuilder sb;
+    initStringBuilder(&sb, 512);
+
+    appendString(&sb, "{\"routes\":");
+    appendViewListJSON(&sb, view, NULL, getViewNumRoutes(view), &appendViewRouteJSON);
+    appendString(&sb, ",\"tracks\":");
+    appendViewListJSON(&sb, view, NULL, getViewNumTracks(view), &appendViewTrackJSON);
+    appendChar(&sb, '}');
+
+    return endJSONStat(STAT_VIEW_ROUTES_AND_TRACKS_TO_JSON, statStart, finishStringBuilder(&sb));
+
+}
+
+char *viewRoutesBetweenToJSON(const GPXImage *view, float lat1, float lon1, float lat2, float lon2, float delta) {
+
+    uint64_t statStart = startParserStat();
+
+    StringBuilder sb;
+    initStringBuilder(&sb, 256);
+
+    int numRoutes = getViewNumRoutes(view);
+    int *routes = malloc(sizeof(int) * (numRoutes > 0 ? numRoutes : 1));
+
+    if (routes != NULL) {
+        int count = getViewRoutesBetween(view, lat1, lon1, lat2, lon2, delta, routes);
+        appendViewListJSON(&sb, view, routes, count, &appendViewRouteJSON);
+        free(routes);
+    } else {
+        appendString(&sb, "[]");
+    }
+
+    return endJSONStat(STAT_VIEW_ROUTES_BETWEEN_TO_JSON, statStart, finishStringBuilder(&sb));
+
+}
+
+char *viewTracksBetweenToJSON(const GPXImage *view, float lat1, float lon1, float lat2, float lon2, float delta) {
+
+    uint64_t statStart = startParserStat();
+
+    StringBuilder sb;
+    initStringBuilder(&sb, 256);
+
+    int numTracks = getViewNumTracks(view);
+    int *tracks = malloc(sizeof(int) * (numTracks > 0 ? numTracks : 1));
+
+    if (tracks != NULL) {
+        int count = getViewTracksBetween(view, lat1, lon1, lat2, lon2, delta, tracks);
+        appendViewListJSON(&sb, view, tracks, count, &appendViewTrackJSON);
+        free(tracks);
+    } else {
+        appendString(&sb, "[]");
+    }
+
+    return endJSONStat(STAT_VIEW_TRACKS_BETWEEN_TO_JSON, statStart, finishStringBuilder(&sb));
+
+}
+
+char *viewPathsWithLengthToJSON(const GPXImage *view, float length) {
+
+    uint64_t statStart = startParserStat();
+
+    StringBuilder sb;
+    initStringBuilder(&sb, 32);
+    appendFormat(&sb, "{\"rt\":%d,\"tr\":%d}", numViewRoutesWithLength(view, length, 10),
+        numViewTracksWithLength(view, length, 10));
+
+    return endJSONStat(STAT_VIEW_PATHS_WITH_LENGTH_TO_JSON, statStart, finishStringBuilder(&sb));
+
+}
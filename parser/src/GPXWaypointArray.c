@@ -0,0 +1,268 @@
+#include "GPXWaypointArray.h" // Included necessary header
+#include "GPXHelpers.h"
+#include "GPXDistance.h"
+
+// Hash of a name, used to intern the names of a list
+static unsigned int hashName(const char *str) {
+
+    // FNV-1a
+    unsigned int hash = 2166136261u;
+    for (; *str != '\0'; str++) {
+        hash = (hash ^ (unsigned char)*str) * 16777619u;
+    }
+
+    return hash;
+
+}
+
+// Find for every point the first point with the same name, so repeated names are only stored once.
+// Returns the number of bytes the distinct names need, or -1 if malloc fails
+static long internNames(Waypoint **waypoints, int length, int *firstWithName) {
+
+    // Open addressing table of point indexes, at most half full
+    int capacity = 16;
+    while (capacity < length * 2) {
+        capacity *= 2;
+    }
+
+    int *table = malloc(sizeof(int) * capacity);
+    if (table == NULL) {
+        return -1;
+    }
+
+    for (int i = 0; i < capacity; i++) {
+        table[i] = -1;
+    }
+
+    long namesLength = 0;
+
+    for (int i = 0; i < length; i++) {
+
+        const char *name = waypoints[i]->name != NULL ? waypoints[i]->name : "";
+        int slot = hashName(name) & (capacity - 1);
+
+        // Probe until the name or an empty slot is found
+        while (table[slot] != -1) {
+            const char *other = waypoints[table[slot]]->name != NULL ? waypoints[table[slot]]->name : "";
+            if (strcmp(name, other) == 0) {
+                break;
+            }
+            slot = (slot + 1) & (capacity - 1);
+        }
+
+        if (table[slot] == -1) {
+            table[slot] = i;
+            namesLength += strlen(name) + 1;
+        }
+
+        firstWithName[i] = table[slot];
+
+    }
+
+    free(table);
+
+    return namesLength;
+
+}
+
+// Point the arrays of a packed block at their place in it: the struct, then the doubles, the pointers, the offsets
+// and the names
+static void layOutWaypointArray(WaypointArray *points, int length) {
+
+    points->length = length;
+    points->latitudes = (double *)(points + 1);
+    points->longitudes = points->latitudes + length;
+    points->cosLatitudes = points->longitudes + length;
+    points->waypoints = (Waypoint **)(points->cosLatitudes + length);
+    points->nameOffsets = (int *)(points->waypoints + length);
+    points->names = (char *)(points->nameOffsets + length);
+
+}
+
+WaypointArray *createWaypointArray(const List *waypoints) {
+
+    if (waypoints == NULL) {
+        return NULL;
+    }
+
+    int length = getLength((List *)waypoints);
+
+    // Everything goes in one block. It is allocated without the names first, since their size is not known yet
+    size_t arraysSize = sizeof(WaypointArray) + (3 * sizeof(double) + sizeof(Waypoint *) + sizeof(int)) * length;
+
+    WaypointArray *points = malloc(arraysSize + 1);
+    if (points == NULL) {
+        return NULL;
+    }
+
+    layOutWaypointArray(points, length);
+
+    void *elem;
+    ListIterator waypointIter = createIterator((List *)waypoints);
+
+    int i = 0;
+    while ((elem = nextElement(&waypointIter)) != NULL) {
+
+        Waypoint *tmpWpt = (Waypoint *)elem;
+
+        points->latitudes[i] = tmpWpt->latitude;
+        points->longitudes[i] = tmpWpt->longitude;
+        points->cosLatitudes[i] = cos(tmpWpt->latitude * (M_PI/180));
+        points->waypoints[i] = tmpWpt;
+
+        i++;
+
+    }
+
+    // nameOffsets holds the first point with the same name until the names are copied
+    long namesLength = internNames(points->waypoints, length, points->nameOffsets);
+
+    WaypointArray *grown = namesLength >= 0 ? realloc(points, arraysSize + namesLength + 1) : NULL;
+    if (grown == NULL) {
+        free(points);
+        return NULL;
+    }
+
+    points = grown;
+    layOutWaypointArray(points, length);
+
+    int namesUsed = 0;
+    for (i = 0; i < length; i++) {
+
+        // The first point with a name copies it, the others point at that copy, which always comes before them
+        int first = points->nameOffsets[i];
+
+        if (first == i) {
+            const char *name = points->waypoints[i]->name != NULL ? points->waypoints[i]->name : "";
+            strcpy(points->names + namesUsed, name);
+            points->nameOffsets[i] = namesUsed;
+            namesUsed += strlen(name) + 1;
+        } else {
+            points->nameOffsets[i] = points->nameOffsets[first];
+        }
+
+    }
+
+    // Spare terminator, so an empty list still has a valid names table
+    points->names[namesUsed] = '\0';
+    points->cleanup = NULL;
+
+    return points;
+
+}
+
+void deleteWaypointArray(void *data) {
+
+    free(data);
+
+}
+
+void invalidateWaypointArray(const List *waypoints, WaypointArray **points) {
+
+    if (points == NULL || *points == NULL) {
+        return;
+    }
+
+    // Arrays of arena lists are adopted by the arena, so it must forget them before they are freed
+    arenaReleaseCleanup(getListArena(waypoints), (*points)->cleanup);
+    deleteWaypointArray(*points);
+    *points = NULL;
+
+}
+
+// Check that a packed array still matches its list. Catches lists changed without going through the API,
+// as long as the length or the first or last point changed
+static bool isWaypointArrayCurrent(const List *waypoints, const WaypointArray *points) {
+
+    int length = getLength((List *)waypoints);
+    if (points->length != length) {
+        return false;
+    }
+
+    if (length == 0) {
+        return true;
+    }
+
+    return points->waypoints[0] == getFromFront((List *)waypoints)
+        && points->waypoints[length - 1] == getFromBack((List *)waypoints);
+
+}
+
+// Return the packed array cached in *points, building it first if needed
+static const WaypointArray *getPoints(const List *waypoints, WaypointArray **points) {
+
+    if (waypoints == NULL) {
+        return NULL;
+    }
+
+    if (*points != NULL && isWaypointArrayCurrent(waypoints, *points)) {
+        return *points;
+    }
+
+    invalidateWaypointArray(waypoints, points);
+
+    *points = createWaypointArray(waypoints);
+
+    // Arena documents free the array with the rest of the document
+    if (*points != NULL) {
+        (*points)->cleanup = arenaAdopt(getListArena(waypoints), *points, &deleteWaypointArray);
+    }
+
+    return *points;
+
+}
+
+const WaypointArray *getRoutePoints(const Route *rt) {
+
+    if (rt == NULL) {
+        return NULL;
+    }
+
+    // The cache is not part of the route's value, so it is updated even through a const route
+    return getPoints(rt->waypoints, &((Route *)rt)->points);
+
+}
+
+const WaypointArray *getSegmentPoints(const TrackSegment *seg) {
+
+    if (seg == NULL) {
+        return NULL;
+    }
+
+    return getPoints(seg->waypoints, &((TrackSegment *)seg)->points);
+
+}
+
+double getPointLatitude(const WaypointArray *points, int i) {
+
+    return points->latitudes[i];
+
+}
+
+double getPointLongitude(const WaypointArray *points, int i) {
+
+    return points->longitudes[i];
+
+}
+
+const char *getPointName(const WaypointArray *points, int i) {
+
+    return points->names + points->nameOffsets[i];
+
+}
+
+List *getPointOtherData(const WaypointArray *points, int i) {
+
+    return points->waypoints[i]->otherData;
+
+}
+
+float getPointsLen(const WaypointArray *points) {
+
+    if (points == NULL) {
+        return 0.0;
+    }
+
+    return getPathLength(points->latitudes, points->longitudes, points->cosLatitudes, points->length);
+
+}
@@ -0,0 +1,636 @@
+#define _POSIX_C_SOURCE 200809L
+// realpath is an XSI function
+#define _XOPEN_SOURCE 700
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "GPXWriter.h" // Included necessary header
+#include "GPXHelpers.h"
+#include "GPXStats.h"
+
+// Bytes collected before they are handed to the output function
+#define OUTPUT_BUFFER_SIZE 65536
+
+// Where the XML of a GPXdoc is going, and how far it has got
+typedef struct {
+    GPXOutputFunction output;
+    void *context;
+    char *buffer;
+    int length;
+    bool indent;
+
+    // Set once the output function fails, everything after that is dropped
+    bool failed;
+} XMLOutput;
+
+static void flushOutput(XMLOutput *out) {
+
+    if (!out->failed && out->length > 0 && out->output(out->context, out->buffer, out->length) != out->length) {
+        out->failed = true;
+    }
+
+    out->length = 0;
+
+}
+
+static void appendBytes(XMLOutput *out, const char *bytes, int len) {
+
+    // Nearly everything fits in what is left of the buffer
+    if (len <= OUTPUT_BUFFER_SIZE - out->length) {
+        memcpy(out->buffer + out->length, bytes, len);
+        out->length += len;
+        return;
+    }
+
+    while (len > 0) {
+
+        if (out->length == OUTPUT_BUFFER_SIZE) {
+            flushOutput(out);
+        }
+
+        int chunk = OUTPUT_BUFFER_SIZE - out->length < len ? OUTPUT_BUFFER_SIZE - out->length : len;
+        memcpy(out->buffer + out->length, bytes, chunk);
+
+        out->length += chunk;
+        bytes += chunk;
+        len -= chunk;
+
+    }
+
+}
+
+static void appendText(XMLOutput *out, const char *text) {
+
+    appendBytes(out, text, strlen(text));
+
+}
+
+// Append text with the characters escaped the way xmlSaveFormatFileEnc escapes them, in an attribute value or in the
+// content of an element
+static void appendEscaped(XMLOutput *out, const char *text, bool attribute) {
+
+    const char *run = text;
+
+    for (const char *cur = text; *cur != '\0'; cur++) {
+
+        const char *entity;
+
+        switch (*cur) {
+            case '&': entity = "&amp;"; break;
+            case '<': entity = "&lt;"; break;
+            case '>': entity = "&gt;"; break;
+            case '\r': entity = "&#13;"; break;
+            case '"': entity = attribute ? "&quot;" : NULL; break;
+            case '\n': entity = attribute ? "&#10;" : NULL; break;
+            case '\t': entity = attribute ? "&#9;" : NULL; break;
+            default: entity = NULL;
+        }
+
+        if (entity != NULL) {
+            appendBytes(out, run, cur - run);
+            appendText(out, entity);
+            run = cur + 1;
+        }
+
+    }
+
+    appendBytes(out, run, strlen(run));
+
+}
+
+// Start a line at depth levels in, when indenting
+static void startLine(XMLOutput *out, int depth) {
+
+    // Deep enough for trkpt, the deepest element
+    static const char spaces[] = "        ";
+
+    if (out->indent) {
+        appendBytes(out, spaces, depth * 2);
+    }
+
+}
+
+static void endLine(XMLOutput *out) {
+
+    if (out->indent) {
+        appendBytes(out, "\n", 1);
+    }
+
+}
+
+// Write <name>text</name> on a line of its own
+static void writeTextElement(XMLOutput *out, int depth, const char *name, const char *text) {
+
+    startLine(out, depth);
+    appendBytes(out, "<", 1);
+    appendText(out, name);
+    appendBytes(out, ">", 1);
+    appendEscaped(out, text, false);
+    appendBytes(out, "</", 2);
+    appendText(out, name);
+    appendBytes(out, ">", 1);
+    endLine(out);
+
+}
+
+// End a start tag, with /> if the element has no children. Returns hasChildren
+static bool endStartTag(XMLOutput *out, bool hasChildren) {
+
+    appendText(out, hasChildren ? ">" : "/>");
+    endLine(out);
+
+    return hasChildren;
+
+}
+
+static void writeEndTag(XMLOutput *out, int depth, const char *name) {
+
+    startLine(out, depth);
+    appendBytes(out, "</", 2);
+    appendText(out, name);
+    appendBytes(out, ">", 1);
+    endLine(out);
+
+}
+
+// Write otherData elements. Fails on an empty name or value
+static int writeGPXDataElements(XMLOutput *out, int depth, List *otherData) {
+
+    void *data;
+    ListIterator otherDataIter = createIterator(otherData);
+
+    while ((data = nextElement(&otherDataIter)) != NULL) {
+
+        GPXData *tmpData = (GPXData *)data;
+
+        if (tmpData->name[0] == '\0' || tmpData->value[0] == '\0') {
+            return -1;
+        }
+
+        writeTextElement(out, depth, tmpData->name, tmpData->value);
+
+    }
+
+    return 0;
+
+}
+
+// Write waypoints as elements named type. Fails on coordinates out of range or a NULL name
+static int writeWaypointElements(XMLOutput *out, int depth, List *waypoints, const char *type) {
+
+    void *elem;
+    ListIterator waypointIter = createIterator(waypoints);
+    char buffer[128];
+
+	while ((elem = nextElement(&waypointIter)) != NULL) {
+
+        Waypoint *tmpWpt = (Waypoint *)elem;
+
+        // Error checking
+        if ((tmpWpt->latitude > 90 || tmpWpt->latitude < -90) || (tmpWpt->longitude > 180 || tmpWpt->longitude < -180)) {
+            return -1;
+        }
+
+        // Invalid waypoint
+        if (tmpWpt->name == NULL) {
+            return -1;
+        }
+
+        startLine(out, depth);
+        appendBytes(out, "<", 1);
+        appendText(out, type);
+        appendBytes(out, buffer, sprintf(buffer, " lat=\"%f\" lon=\"%f\"", tmpWpt->latitude, tmpWpt->longitude));
+
+        if (!endStartTag(out, tmpWpt->name[0] != '\0' || getLength(tmpWpt->otherData) > 0)) {
+            continue;
+        }
+
+        // If no name, there is no name element
+        if (tmpWpt->name[0] != '\0') {
+            writeTextElement(out, depth + 1, "name", tmpWpt->name);
+        }
+
+        if (writeGPXDataElements(out, depth + 1, tmpWpt->otherData) != 0) {
+            return -1;
+        }
+
+        writeEndTag(out, depth, type);
+
+	}
+
+    return 0;
+
+}
+
+// Write routes: name, otherData, then the points. Fails on a NULL name or a point that can not be written
+static int writeRouteElements(XMLOutput *out, int depth, List *routes) {
+
+    void *elem;
+    ListIterator routeIter = createIterator(routes);
+
+	while ((elem = nextElement(&routeIter)) != NULL) {
+
+        Route *tmpRte = (Route *)elem;
+
+        if (tmpRte->name == NULL) {
+            return -1;
+        }
+
+        startLine(out, depth);
+        appendText(out, "<rte");
+
+        bool hasChildren = tmpRte->name[0] != '\0' || getLength(tmpRte->otherData) > 0
+            || getLength(tmpRte->waypoints) > 0;
+        if (!endStartTag(out, hasChildren)) {
+            continue;
+        }
+
+        if (tmpRte->name[0] != '\0') {
+            writeTextElement(out, depth + 1, "name", tmpRte->name);
+        }
+
+        if (writeGPXDataElements(out, depth + 1, tmpRte->otherData) != 0) {
+            return -1;
+        }
+
+        if (writeWaypointElements(out, depth + 1, tmpRte->waypoints, "rtept") != 0) {
+            return -1;
+        }
+
+        writeEndTag(out, depth, "rte");
+
+	}
+
+    return 0;
+
+}
+
+// Write tracks and their segments, in the same order as routes. Fails the same way
+static int writeTrackElements(XMLOutput *out, int depth, List *tracks) {
+
+    void *elem;
+    ListIterator trackIter = createIterator(tracks);
+
+	while ((elem = nextElement(&trackIter)) != NULL) {
+
+        Track *tmpTrk = (Track *)elem;
+
+        if (tmpTrk->name == NULL) {
+            return -1;
+        }
+
+        startLine(out, depth);
+        appendText(out, "<trk");
+
+        bool hasChildren = tmpTrk->name[0] != '\0' || getLength(tmpTrk->otherData) > 0
+            || getLength(tmpTrk->segments) > 0;
+        if (!endStartTag(out, hasChildren)) {
+            continue;
+        }
+
+        if (tmpTrk->name[0] != '\0') {
+            writeTextElement(out, depth + 1, "name", tmpTrk->name);
+        }
+
+        if (writeGPXDataElements(out, depth + 1, tmpTrk->otherData) != 0) {
+            return -1;
+        }
+
+        void *segElem;
+        ListIterator trackSegIter = createIterator(tmpTrk->segments);
+
+        while ((segElem = nextElement(&trackSegIter)) != NULL) {
+
+            TrackSegment *tmpTrkSeg = (TrackSegment *)segElem;
+
+            startLine(out, depth + 1);
+            appendText(out, "<trkseg");
+
+            if (!endStartTag(out, getLength(tmpTrkSeg->waypoints) > 0)) {
+                continue;
+            }
+
+            if (writeWaypointElements(out, depth + 2, tmpTrkSeg->waypoints, "trkpt") != 0) {
+                return -1;
+            }
+
+            writeEndTag(out, depth + 1, "trkseg");
+
+        }
+
+        writeEndTag(out, depth, "trk");
+
+	}
+
+    return 0;
+
+}
+
+// Write the whole document
+static int writeDocument(XMLOutput *out, const GPXdoc *doc) {
+
+    char buffer[64];
+
+    appendText(out, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+
+    // Root element with the namespace, version and creator, in the order xmlSaveFormatFileEnc wrote them
+    appendText(out, "<gpx xmlns=\"");
+    appendEscaped(out, doc->namespace, true);
+    appendBytes(out, buffer, sprintf(buffer, "\" version=\"%g\" creator=\"", doc->version));
+    appendEscaped(out, doc->creator, true);
+    appendBytes(out, "\"", 1);
+
+    bool hasChildren = getLength(doc->waypoints) > 0 || getLength(doc->routes) > 0 || getLength(doc->tracks) > 0;
+
+    if (endStartTag(out, hasChildren)) {
+
+        if (writeWaypointElements(out, 1, doc->waypoints, "wpt") != 0) {
+            return -1;
+        }
+
+        if (writeRouteElements(out, 1, doc->routes) != 0) {
+            return -1;
+        }
+
+        if (writeTrackElements(out, 1, doc->tracks) != 0) {
+            return -1;
+        }
+
+        writeEndTag(out, 0, "gpx");
+
+    }
+
+    // The document always ends with a newline, indented or not
+    if (!out->indent) {
+        appendBytes(out, "\n", 1);
+    }
+
+    return 0;
+
+}
+
+int writeGPXdocToOutput(const GPXdoc *doc, GPXOutputFunction output, void *context, bool indent) {
+
+    if (doc == NULL || doc->creator == NULL || output == NULL) {
+        return -1;
+    }
+
+    XMLOutput out = { output, context, malloc(OUTPUT_BUFFER_SIZE), 0, indent, false };
+    if (out.buffer == NULL) {
+        return -1;
+    }
+
+    int ret = writeDocument(&out, doc);
+
+    // Hand over what is left, unless the doc could not be written anyway
+    if (ret == 0) {
+        flushOutput(&out);
+    }
+
+    free(out.buffer);
+
+    return ret == 0 && !out.failed ? 0 : -1;
+
+}
+
+// Where writeGPXdocToFile's output goes
+typedef struct {
+    int fd;
+    long written;
+} FileOutput;
+
+// Output function that writes each chunk to the file
+static int writeToFile(void *context, const char *buffer, int len) {
+
+    FileOutput *output = (FileOutput *)context;
+    int done = 0;
+
+    while (done < len) {
+
+        ssize_t ret = write(output->fd, buffer + done, len - done);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+
+        done += ret;
+
+    }
+
+    output->written += len;
+
+    return len;
+
+}
+
+// Create a new temporary file next to fileName, open for reading and writing. It gets the permissions any new file
+// would, 0666 less the umask. Returns its descriptor and sets *tmpFile to its name, or -1 if it can not be created
+static int createTempFile(const char *fileName, char **tmpFile) {
+
+    static atomic_uint tempCount = 0;
+
+    size_t size = strlen(fileName) + 32;
+    char *name = malloc(size);
+    if (name == NULL) {
+        return -1;
+    }
+
+    // Another process or thread may be writing the same file, so names are tried until one is free
+    for (int attempt = 0; attempt < 100; attempt++) {
+
+        snprintf(name, size, "%s.%ld.%u.tmp", fileName, (long)getpid(), atomic_fetch_add(&tempCount, 1));
+
+        int fd = open(name, O_RDWR | O_CREAT | O_EXCL, 0666);
+        if (fd >= 0) {
+            *tmpFile = name;
+            return fd;
+        }
+
+        if (errno != EEXIST) {
+            break;
+        }
+
+    }
+
+    free(name);
+
+    return -1;
+
+}
+
+// Copy the complete temporary file over a file in place, for a file with other hard links, which a rename would
+// split off from them. Returns 0, or -1 if the copy failed
+static int copyIntoFile(int tmpFd, const char *fileName) {
+
+    char *buffer = malloc(OUTPUT_BUFFER_SIZE);
+    int fd = buffer != NULL ? open(fileName, O_WRONLY | O_TRUNC) : -1;
+    if (fd < 0) {
+        free(buffer);
+        return -1;
+    }
+
+    FileOutput output = { fd, 0 };
+    int ret = lseek(tmpFd, 0, SEEK_SET) == 0 ? 0 : -1;
+
+    while (ret == 0) {
+
+        ssize_t len = read(tmpFd, buffer, OUTPUT_BUFFER_SIZE);
+        if (len < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (len <= 0) {
+            ret = len == 0 ? 0 : -1;
+            break;
+        }
+
+        if (writeToFile(&output, buffer, len) != len) {
+            ret = -1;
+        }
+
+    }
+
+    if (close(fd) != 0) {
+        ret = -1;
+    }
+
+    free(buffer);
+
+    return ret;
+
+}
+
+long writeGPXdocToFile(const GPXdoc *doc, const char *fileName, bool indent) {
+
+    if (doc == NULL || fileName == NULL) {
+        return -1;
+    }
+
+    // A symbolic link is written through, so it stays a link to the file it points at. realpath fails for a file
+    // that does not exist yet, which is written by its own name
+    char *target = realpath(fileName, NULL);
+    const char *path = target != NULL ? target : fileName;
+
+    struct stat info;
+    bool exists = stat(path, &info) == 0;
+
+    // Write to a temporary file next to the file, and only put it in place once it is complete
+    char *tmpFile = NULL;
+    int fd = createTempFile(path, &tmpFile);
+    if (fd < 0) {
+        free(target);
+        return -1;
+    }
+
+    FileOutput output = { fd, 0 };
+    int ret = writeGPXdocToOutput(doc, &writeToFile, &output, indent);
+
+    if (ret == 0 && exists && info.st_nlink > 1) {
+
+        // The other links must see the new contents, so the file is overwritten instead of replaced
+        ret = copyIntoFile(fd, path);
+        if (close(fd) != 0) {
+            ret = -1;
+        }
+
+        unlink(tmpFile);
+
+    } else {
+
+        // A file that is replaced keeps its owner and permissions. Only root can give a file to another user, so not
+        // being allowed to is not an error. The mode is set last, since a change of owner can clear the setuid bits
+        if (ret == 0 && exists) {
+            if (fchown(fd, info.st_uid, info.st_gid) != 0 && errno != EPERM) {
+                ret = -1;
+            }
+            if (fchmod(fd, info.st_mode & 07777) != 0) {
+                ret = -1;
+            }
+        }
+
+        if (close(fd) != 0) {
+            ret = -1;
+        }
+
+        if (ret != 0 || rename(tmpFile, path) != 0) {
+            ret = -1;
+            unlink(tmpFile);
+        }
+
+    }
+
+    free(tmpFile);
+    free(target);
+
+    return ret == 0 ? output.written : -1;
+
+}
+
+// Output function that hands each chunk straight to the validating parser
+static int pushToParser(void *context, const char *buffer, int len) {
+
+    xmlParserCtxt *parserCtxt = (xmlParserCtxt *)context;
+
+    if (xmlParseChunk(parserCtxt, buffer, len, 0) != 0) {
+        return -1;
+    }
+
+    return len;
+
+}
+
+bool validateGPXdocStream(const GPXdoc *doc, xmlSchema *schema) {
+
+    if (doc == NULL || schema == NULL) {
+        return false;
+    }
+
+    uint64_t statStart = startParserStat();
+
+    // With no SAX callbacks of its own the parser only feeds the validator and never builds a tree
+    xmlSAXHandler emptySAX;
+    memset(&emptySAX, 0, sizeof(xmlSAXHandler));
+    emptySAX.initialized = XML_SAX2_MAGIC;
+
+    xmlParserCtxt *parserCtxt = xmlCreatePushParserCtxt(&emptySAX, NULL, NULL, 0, NULL);
+    if (parserCtxt == NULL) {
+        return false;
+    }
+
+    // Plug the schema validator into the parser's SAX callbacks, the same way xmlSchemaValidateStream does
+    xmlSchemaValidCtxt *validCtxt = xmlSchemaNewValidCtxt(schema);
+    xmlSchemaSAXPlugStruct *plug = NULL;
+    if (validCtxt != NULL) {
+        plug = xmlSchemaSAXPlug(validCtxt, &parserCtxt->sax, &parserCtxt->userData);
+    }
+
+    if (plug == NULL) {
+        xmlSchemaFreeValidCtxt(validCtxt);
+        xmlFreeParserCtxt(parserCtxt);
+        return false;
+    }
+
+    // The XML goes to pushToParser instead of a file, without indentation since the parser would only skip it
+    int ret = writeGPXdocToOutput(doc, &pushToParser, parserCtxt, false);
+
+    // Tell the parser the document is complete, so the end of the root element is validated too
+    if (ret == 0 && xmlParseChunk(parserCtxt, NULL, 0, 1) != 0) {
+        ret = -1;
+    }
+
+    bool valid = ret == 0 && parserCtxt->wellFormed && xmlSchemaIsValid(validCtxt) == 1;
+
+    long bytes = xmlByteConsumed(parserCtxt);
+    endParserStat(STAT_SCHEMA_VALIDATE, statStart, bytes > 0 ? bytes : 0);
+
+    xmlSchemaSAXUnplug(plug);
+    xmlSchemaFreeValidCtxt(validCtxt);
+    xmlFreeParserCtxt(parserCtxt);
+
+    return valid;
+
+}
@@ -0,0 +1,76 @@
+/*
+ * Command line front end of the synthetic GPX generator, see SyntheticGPX.h
+ *
+ * Usage: generateGPX output.gpx [--points N] [--waypoints N] [--routes N] [--route-points N] [--tracks N]
+ *        [--segments N] [--segment-points N] [--other-data N] [--seed N]
+ *
+ * --points picks all the counts for a file of about N points; the other options then override single counts
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SyntheticGPX.h"
+
+static void printUsage(const char *program) {
+
+    fprintf(stderr, "Usage: %s output.gpx [--points N] [--waypoints N] [--routes N] [--route-points N] [--tracks N]\n"
+        "       [--segments N] [--segment-points N] [--other-data N] [--seed N]\n", program);
+
+}
+
+int main(int argc, char **argv) {
+
+    if (argc < 2 || argv[1][0] == '-') {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    SyntheticParams params = getSyntheticParams(10000);
+
+    for (int i = 2; i < argc; i++) {
+
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 1;
+        }
+
+        const char *option = argv[i];
+        long value = strtol(argv[++i], NULL, 10);
+
+        if (strcmp(option, "--points") == 0) {
+            unsigned int seed = params.seed;
+            params = getSyntheticParams(value);
+            params.seed = seed;
+        } else if (strcmp(option, "--waypoints") == 0) {
+            params.waypoints = value;
+        } else if (strcmp(option, "--routes") == 0) {
+            params.routes = value;
+        } else if (strcmp(option, "--route-points") == 0) {
+            params.routePoints = value;
+        } else if (strcmp(option, "--tracks") == 0) {
+            params.tracks = value;
+        } else if (strcmp(option, "--segments") == 0) {
+            params.segments = value;
+        } else if (strcmp(option, "--segment-points") == 0) {
+            params.segmentPoints = value;
+        } else if (strcmp(option, "--other-data") == 0) {
+            params.otherData = value;
+        } else if (strcmp(option, "--seed") == 0) {
+            params.seed = value;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+
+    }
+
+    if (!writeSyntheticGPX(argv[1], &params)) {
+        fprintf(stderr, "Could not write %s\n", argv[1]);
+        return 1;
+    }
+
+    printf("%s: %ld points\n", argv[1], getSyntheticPointCount(&params));
+
+    return 0;
+
+}
@@ -0,0 +1,497 @@
+/*
+ * Test of the doc index (see GPXIndex.h) and the name index (see GPXNameIndex.h). Loads a synthetic GPX file and
+ * checks that getRoutesBetween, getTracksBetween and the length queries, which go through the doc index, return
+ * exactly the paths a linear scan of the doc finds, in the same order, and that getRoute and getTrack return the first
+ * path with a name like the scan. The checks are repeated after the doc is edited through the API, through the List
+ * API and by hand, and the index of one doc must survive edits to another.
+ *
+ * Usage: indexTest [--dir directory]
+ * Prints every mismatch, and exits with 1 if there were any.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "GPXParser.h"
+#include "GPXHelpers.h"
+#include "GPXIndex.h"
+#include "SyntheticGPX.h"
+
+// Queries made at each stage of the test
+#define NUM_QUERIES 400
+
+// Names looked up at each stage, besides those of the first and last paths
+#define NUM_NAME_QUERIES 200
+
+// Metres, from a near miss up to most of the synthetic area
+static const float deltas[] = { 0, 5, 50, 300, 3000, 20000 };
+
+static int numChecks = 0;
+static int numFailures = 0;
+
+// Same seedable generator as the synthetic files, so every run makes the same queries
+static unsigned int nextRandom(unsigned int *state) {
+
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+
+    return *state;
+
+}
+
+// Random offset of up to about a kilometre
+static double jitter(unsigned int *state) {
+
+    return ((int)(nextRandom(state) % 2001) - 1000) / 1e5;
+
+}
+
+/* The linear scans the indexed queries must agree with, as getRoutesBetween and numRoutesWithLength were written
+ * before the index */
+
+static bool endsBetween(const Waypoint *first, const Waypoint *last, float sourceLat, float sourceLong, float destLat,
+    float destLong, float delta) {
+
+    if (first == NULL || last == NULL) {
+        return false;
+    }
+
+    return haversine(first->latitude, first->longitude, sourceLat, sourceLong) <= delta
+        && haversine(last->latitude, last->longitude, destLat, destLong) <= delta;
+
+}
+
+static int scanRoutesBetween(const GPXdoc *doc, float sourceLat, float sourceLong, float destLat, float destLong,
+    float delta, void **found) {
+
+    int count = 0;
+
+    void *elem;
+    ListIterator iter = createIterator(doc->routes);
+
+    while ((elem = nextElement(&iter)) != NULL) {
+
+        Route *rt = (Route *)elem;
+
+        if (endsBetween(getFromFront(rt->waypoints), getFromBack(rt->waypoints), sourceLat, sourceLong, destLat,
+            destLong, delta)) {
+            found[count++] = rt;
+        }
+
+    }
+
+    return count;
+
+}
+
+static int scanTracksBetween(const GPXdoc *doc, float sourceLat, float sourceLong, float destLat, float destLong,
+    float delta, void **found) {
+
+    int count = 0;
+
+    void *elem;
+    ListIterator iter = createIterator(doc->tracks);
+
+    while ((elem = nextElement(&iter)) != NULL) {
+
+        Track *tr = (Track *)elem;
+
+        TrackSegment *firstSeg = getFromFront(tr->segments);
+        TrackSegment *lastSeg = getFromBack(tr->segments);
+        if (firstSeg == NULL || lastSeg == NULL) {
+            continue;
+        }
+
+        if (endsBetween(getFromFront(firstSeg->waypoints), getFromBack(lastSeg->waypoints), sourceLat, sourceLong,
+            destLat, destLong, delta)) {
+            found[count++] = tr;
+        }
+
+    }
+
+    return count;
+
+}
+
+static int scanWithLength(List *paths, bool routes, float len, float delta, void **found) {
+
+    int count = 0;
+
+    void *elem;
+    ListIterator iter = createIterator(paths);
+
+    while ((elem = nextElement(&iter)) != NULL) {
+
+        float length = routes ? getRouteLen(elem) : getTrackLen(elem);
+
+        if (fabs(length - len) <= delta) {
+            found[count++] = elem;
+        }
+
+    }
+
+    return count;
+
+}
+
+// The first path of a list with a name, as getRoute and getTrack were written before the name index
+static void *scanByName(List *paths, bool routes, const char *name) {
+
+    void *elem;
+    ListIterator iter = createIterator(paths);
+
+    while ((elem = nextElement(&iter)) != NULL) {
+
+        char *pathName = routes ? ((Route *)elem)->name : ((Track *)elem)->name;
+
+        if (pathName != NULL && strcmp(pathName, name) == 0) {
+            return elem;
+        }
+
+    }
+
+    return NULL;
+
+}
+
+// Get the path at a position of a list, starting at 1. Walks the list, so the test does not depend on any index
+static void *getPathAt(List *paths, int position) {
+
+    ListIterator iter = createIterator(paths);
+    void *elem = nextElement(&iter);
+
+    for (int i = 1; i < position && elem != NULL; i++) {
+        elem = nextElement(&iter);
+    }
+
+    return elem;
+
+}
+
+/* Comparisons */
+
+// Compare a list returned by a query to what the scan found. The list is freed
+static void expectPaths(const char *what, List *result, void **expected, int expectedCount) {
+
+    numChecks++;
+
+    int count = result != NULL ? getLength(result) : 0;
+    bool same = count == expectedCount;
+
+    if (same && result != NULL) {
+
+        void *elem;
+        ListIterator iter = createIterator(result);
+
+        int i = 0;
+        while (same && (elem = nextElement(&iter)) != NULL) {
+            same = elem == expected[i++];
+        }
+
+    }
+
+    if (!same) {
+        printf("FAIL %s: %d paths, the scan found %d\n", what, count, expectedCount);
+        numFailures++;
+    }
+
+    if (result != NULL) {
+        freeList(result);
+    }
+
+}
+
+// Compare getRoute or getTrack for a name to what the scan finds
+static void expectNamed(const char *stage, const GPXdoc *doc, bool routes, const char *name) {
+
+    numChecks++;
+
+    // getRoute and getTrack do not change the name, they only predate const
+    void *found = routes ? (void *)getRoute(doc, (char *)name) : (void *)getTrack(doc, (char *)name);
+    void *expected = scanByName(routes ? doc->routes : doc->tracks, routes, name);
+
+    if (found != expected) {
+        printf("FAIL %s: get%s(\"%s\") is not the first %s with that name\n", stage, routes ? "Route" : "Track", name,
+            routes ? "route" : "track");
+        numFailures++;
+    }
+
+}
+
+static void expectCount(const char *what, int count, int expectedCount) {
+
+    numChecks++;
+
+    if (count != expectedCount) {
+        printf("FAIL %s: %d, the scan found %d\n", what, count, expectedCount);
+        numFailures++;
+    }
+
+}
+
+// Get the first or last point of a route, or a hub if the route has no points. at is the position of the route, 0
+// for a random one
+static void pickPoint(const GPXdoc *doc, unsigned int *state, int at, bool fromEnd, double *lat, double *lon) {
+
+    *lat = SYNTHETIC_HUB_LATITUDE;
+    *lon = SYNTHETIC_HUB_LONGITUDE;
+
+    int numRoutes = getLength(doc->routes);
+    if (numRoutes == 0) {
+        return;
+    }
+
+    Route *rt = getPathAt(doc->routes, at > 0 ? at : (int)(nextRandom(state) % numRoutes) + 1);
+    Waypoint *wpt = rt != NULL ? (fromEnd ? getFromBack(rt->waypoints) : getFromFront(rt->waypoints)) : NULL;
+
+    if (wpt != NULL) {
+        *lat = wpt->latitude;
+        *lon = wpt->longitude;
+    }
+
+}
+
+// Look up the names of the first and last routes and tracks, of a sample of the others and one no path has
+static void checkNames(const char *stage, const GPXdoc *doc, unsigned int *state) {
+
+    for (int type = 0; type < 2; type++) {
+
+        bool routes = type == 0;
+        List *paths = routes ? doc->routes : doc->tracks;
+        int numPaths = getLength(paths);
+
+        for (int q = 0; q < NUM_NAME_QUERIES + 2 && numPaths > 0; q++) {
+
+            int at = q == 0 ? 1 : q == 1 ? numPaths : (int)(nextRandom(state) % numPaths) + 1;
+            void *path = getPathAt(paths, at);
+            char *name = routes ? ((Route *)path)->name : ((Track *)path)->name;
+
+            if (name != NULL) {
+                expectNamed(stage, doc, routes, name);
+            }
+
+        }
+
+        expectNamed(stage, doc, routes, "No path has this name");
+
+    }
+
+}
+
+// Run every query on the doc and compare it to the scans
+static void checkDoc(const char *stage, const GPXdoc *doc, unsigned int seed) {
+
+    int numPaths = getLength(doc->routes) + getLength(doc->tracks);
+
+    void **expected = malloc(sizeof(void *) * (numPaths + 1));
+    if (expected == NULL) {
+        printf("FAIL %s: out of memory\n", stage);
+        numFailures++;
+        return;
+    }
+
+    char what[128];
+    unsigned int state = seed;
+
+    for (int q = 0; q < NUM_QUERIES; q++) {
+
+        // The first queries are at the ends of the first and last routes, which the edits below change
+        int at = q < 4 ? 1 : q < 8 ? getLength(doc->routes) : 0;
+
+        double sourceLat, sourceLong, destLat, destLong;
+        pickPoint(doc, &state, at, false, &sourceLat, &sourceLong);
+        pickPoint(doc, &state, at, true, &destLat, &destLong);
+
+        // Most queries are moved off the exact end points, so the paths near the edge of delta are tested too
+        if (q % 4 > 1) {
+            sourceLat += jitter(&state);
+            sourceLong += jitter(&state);
+            destLat += jitter(&state);
+            destLong += jitter(&state);
+        }
+
+        float delta = deltas[nextRandom(&state) % (sizeof(deltas) / sizeof(deltas[0]))];
+
+        int count = scanRoutesBetween(doc, sourceLat, sourceLong, destLat, destLong, delta, expected);
+        snprintf(what, sizeof(what), "%s: getRoutesBetween query %d", stage, q);
+        expectPaths(what, getRoutesBetween(doc, sourceLat, sourceLong, destLat, destLong, delta), expected, count);
+
+        count = scanTracksBetween(doc, sourceLat, sourceLong, destLat, destLong, delta, expected);
+        snprintf(what, sizeof(what), "%s: getTracksBetween query %d", stage, q);
+        expectPaths(what, getTracksBetween(doc, sourceLat, sourceLong, destLat, destLong, delta), expected, count);
+
+    }
+
+    // Lengths of actual paths, so some queries land exactly on one
+    for (int q = 0; q < NUM_QUERIES; q++) {
+
+        bool routes = q % 2 == 0;
+        List *paths = routes ? doc->routes : doc->tracks;
+
+        float len = nextRandom(&state) % 20000;
+        if (q % 3 == 0 && getLength(paths) > 0) {
+            int at = nextRandom(&state) % getLength(paths) + 1;
+            len = routes ? getRouteLen(getPathAt(paths, at)) : getTrackLen(getPathAt(paths, at));
+        }
+
+        float delta = deltas[nextRandom(&state) % (sizeof(deltas) / sizeof(deltas[0]))];
+
+        int count = scanWithLength(paths, routes, len, delta, expected);
+
+        snprintf(what, sizeof(what), "%s: num%sWithLength query %d", stage, routes ? "Routes" : "Tracks", q);
+        expectCount(what, routes ? numRoutesWithLength(doc, len, delta) : numTracksWithLength(doc, len, delta),
+            count);
+
+        snprintf(what, sizeof(what), "%s: get%sWithLength query %d", stage, routes ? "Routes" : "Tracks", q);
+        expectPaths(what, routes ? getRoutesWithLength(doc, len, delta) : getTracksWithLength(doc, len, delta),
+            expected, count);
+
+    }
+
+    free(expected);
+
+    checkNames(stage, doc, &state);
+
+}
+
+static Waypoint *makeWaypoint(double lat, double lon) {
+
+    char json[128];
+    snprintf(json, sizeof(json), "{\"lat\":%f,\"lon\":%f}", lat, lon);
+
+    return JSONtoWaypoint(json);
+
+}
+
+static Route *makeRoute(const char *name, double lat, double lon, int numPoints) {
+
+    char json[128];
+    snprintf(json, sizeof(json), "{\"name\":\"%s\"}", name);
+
+    Route *rt = JSONtoRoute(json);
+    if (rt == NULL) {
+        return NULL;
+    }
+
+    for (int i = 0; i < numPoints; i++) {
+        addWaypoint(rt, makeWaypoint(lat + i * 0.001, lon + i * 0.001));
+    }
+
+    return rt;
+
+}
+
+int main(int argc, char **argv) {
+
+    const char *dirName = "/tmp";
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc) {
+            dirName = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--dir directory]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    char fileName[512];
+    snprintf(fileName, sizeof(fileName), "%s/indexTest.gpx", dirName);
+
+    SyntheticParams params = getSyntheticParams(60000);
+    params.otherData = 0;
+
+    GPXdoc *doc = writeSyntheticGPX(fileName, &params) ? createGPXdoc(fileName) : NULL;
+    GPXdoc *other = doc != NULL ? createGPXdoc(fileName) : NULL;
+    remove(fileName);
+
+    if (doc == NULL || other == NULL) {
+        printf("FAIL could not generate and load %s\n", fileName);
+        deleteGPXdoc(doc);
+        deleteGPXdoc(other);
+        return 1;
+    }
+
+    checkDoc("loaded doc", doc, 1);
+
+    // Edits to another doc must leave this one's index alone
+    const GPXIndex *index = getGPXIndex(doc);
+    addWaypoint(getFromFront(other->routes), makeWaypoint(SYNTHETIC_HUB_LATITUDE, SYNTHETIC_HUB_LONGITUDE));
+    removePath(other, 2, 1);
+
+    numChecks++;
+    if (getGPXIndex(doc) != index) {
+        printf("FAIL editing another doc rebuilt the index\n");
+        numFailures++;
+    }
+
+    // addWaypoint moves the end of a route
+    Route *moved = getPathAt(doc->routes, getLength(doc->routes) / 2);
+    addWaypoint(moved, makeWaypoint(SYNTHETIC_HUB_LATITUDE + 0.05, SYNTHETIC_HUB_LONGITUDE + 0.05));
+    checkDoc("after addWaypoint", doc, 2);
+
+    addRoute(doc, makeRoute("added", SYNTHETIC_HUB_LATITUDE, SYNTHETIC_HUB_LONGITUDE, 5));
+    checkDoc("after addRoute", doc, 3);
+
+    removePath(doc, 1, 1);
+    removePath(doc, 2, getLength(doc->tracks));
+    checkDoc("after removePath", doc, 4);
+
+    // renamePath moves a path to the chain of its new name. A route renamed to the name of a later one comes before
+    // it in the chain, so it is the one found
+    char oldRouteName[64];
+    char oldTrackName[64];
+    snprintf(oldRouteName, sizeof(oldRouteName), "%s", ((Route *)getPathAt(doc->routes, 3))->name);
+    snprintf(oldTrackName, sizeof(oldTrackName), "%s", ((Track *)getPathAt(doc->tracks, 1))->name);
+
+    char *laterName = ((Route *)getPathAt(doc->routes, 10))->name;
+
+    renamePath(doc, 1, 3, "Renamed route");
+    renamePath(doc, 1, 2, laterName);
+    renamePath(doc, 2, 1, "Renamed track");
+    checkDoc("after renamePath", doc, 5);
+
+    expectNamed("after renamePath", doc, true, "Renamed route");
+    expectNamed("after renamePath", doc, true, oldRouteName);
+    expectNamed("after renamePath", doc, true, laterName);
+    expectNamed("after renamePath", doc, false, "Renamed track");
+    expectNamed("after renamePath", doc, false, oldTrackName);
+
+    // A name changed by hand is not in the chain of its new name, the lookups must fall back on the scan. The names
+    // are edited in place, the way a caller can without knowing who allocated them
+    Route *handRoute = getPathAt(doc->routes, getLength(doc->routes) / 3);
+    Track *handTrack = getPathAt(doc->tracks, getLength(doc->tracks) / 3);
+    snprintf(oldRouteName, sizeof(oldRouteName), "%s", handRoute->name);
+    snprintf(oldTrackName, sizeof(oldTrackName), "%s", handTrack->name);
+    handRoute->name[0] = 'X';
+    handTrack->name[0] = 'X';
+
+    expectNamed("after editing names by hand", doc, true, handRoute->name);
+    expectNamed("after editing names by hand", doc, true, oldRouteName);
+    expectNamed("after editing names by hand", doc, false, handTrack->name);
+    expectNamed("after editing names by hand", doc, false, oldTrackName);
+    checkDoc("after editing names by hand", doc, 6);
+
+    // Through the List API the doc's generation does not change. The last route is swapped for another and the
+    // counts stay the same, the index must still see it. The new route is made first so it can not get the address
+    // of the removed one, which is deleted as a caller would
+    Route *swapped = makeRoute("swapped", SYNTHETIC_HUB_LATITUDE, SYNTHETIC_HUB_LONGITUDE, 3);
+
+    Route *removed = removeDataFromList(doc->routes, getFromBack(doc->routes));
+    if (!arenaOwns(doc->arena, removed)) {
+        arenaRelease(doc->arena, removed);
+        deleteRoute(removed);
+    }
+
+    insertBack(doc->routes, swapped);
+    arenaAdopt(doc->arena, swapped, &deleteRoute);
+    checkDoc("after swapping a route with the List API", doc, 7);
+
+    deleteGPXdoc(doc);
+    deleteGPXdoc(other);
+
+    printf("%d checks, %d failed\n", numChecks, numFailures);
+
+    return numFailures > 0 ? 1 : 0;
+
+}
@@ -23,10 +23,66 @@ List * initializeList(char* (*printFunction)(void* toBePrinted),void (*deleteFun
 	tmpList->deleteData = deleteFunction;
 	tmpList->compare = compareFunction;
 	tmpList->printData = printFunction;
+
+	tmpList->allocNode = NULL;
+	tmpList->allocContext = NULL;
 	
 	return tmpList;
 }
 
+/** Function to initialize a list whose List struct and nodes come from a custom allocator.
+*@return pointer to the list head, NULL if the allocator failed
+*@param printFunction function pointer to print a single node of the list
+*@param deleteFunction function pointer to delete a single piece of data from the list
+*@param compareFunction function pointer to compare two nodes of the list in order to test for equality or order
+*@param allocFunction function pointer to allocate the List struct and the nodes
+*@param allocContext passed to allocFunction
+**/
+List * initializeListWithAllocator(char* (*printFunction)(void* toBePrinted),void (*deleteFunction)(void* toBeDeleted),int (*compareFunction)(const void* first,const void* second),void* (*allocFunction)(void* context, size_t size),void* allocContext){
+    assert(printFunction != NULL);
+    assert(deleteFunction != NULL);
+    assert(compareFunction != NULL);
+    assert(allocFunction != NULL);
+
+    List * tmpList = allocFunction(allocContext, sizeof(List));
+	if (tmpList == NULL){
+		return NULL;
+	}
+	
+	tmpList->head = NULL;
+	tmpList->tail = NULL;
+
+	tmpList->length = 0;
+
+	tmpList->deleteData = deleteFunction;
+	tmpList->compare = compareFunction;
+	tmpList->printData = printFunction;
+
+	tmpList->allocNode = allocFunction;
+	tmpList->allocContext = allocContext;
+	
+	return tmpList;
+}
+
+//Creates a node for a list, using the list's allocator if it has one
+static Node* initializeListNode(List* list, void* data){
+	if (list->allocNode == NULL){
+		return initializeNode(data);
+	}
+
+	Node* tmpNode = (Node*)list->allocNode(list->allocContext, sizeof(Node));
+	
+	if (tmpNode == NULL){
+		return NULL;
+	}
+	
+	tmpNode->data = data;
+	tmpNode->previous = NULL;
+	tmpNode->next = NULL;
+	
+	return tmpNode;
+}
+
 
 /** Deletes the entire linked list, freeing all memory.
 * uses the supplied function pointer to release allocated memory for the data
@@ -37,7 +93,9 @@ List * initializeList(char* (*printFunction)(void* toBePrinted),void (*deleteFun
 void freeList(List* list){	
 
     clearList(list);
-	free(list);
+	if (list != NULL && list->allocNode == NULL){
+		free(list);
+	}
 }
 
 /** Clears the list: frees the contents of the list - Node structs and data stored in them - 
@@ -63,7 +121,9 @@ void clearList(List* list){
 		list->deleteData(list->head->data);
 		tmp = list->head;
 		list->head = list->head->next;
-		free(tmp);
+		if (list->allocNode == NULL){
+			free(tmp);
+		}
 	}
 	
 	list->head = NULL;
@@ -107,7 +167,7 @@ void insertBack(List* list, void* toBeAdded){
 	
 	(list->length)++;
 
-	Node* newNode = initializeNode(toBeAdded);
+	Node* newNode = initializeListNode(list, toBeAdded);
 	
     if (list->head == NULL && list->tail == NULL){
         list->head = newNode;
@@ -132,7 +192,7 @@ void insertFront(List* list, void* toBeAdded){
 	
 	(list->length)++;
 
-	Node* newNode = initializeNode(toBeAdded);
+	Node* newNode = initializeListNode(list, toBeAdded);
 	
     if (list->head == NULL && list->tail == NULL){
         list->head = newNode;
@@ -170,6 +230,30 @@ void* getFromBack(List * list){
 	return list->tail->data;
 }
 
+//Unlink a node, free it unless it came from the list's allocator, and return its data
+static void* unlinkNode(List* list, Node* delNode){
+	if (delNode->previous != NULL){
+		delNode->previous->next = delNode->next;
+	}else{
+		list->head = delNode->next;
+	}
+	
+	if (delNode->next != NULL){
+		delNode->next->previous = delNode->previous;
+	}else{
+		list->tail = delNode->previous;
+	}
+	
+	void* data = delNode->data;
+	if (list->allocNode == NULL){
+		free(delNode);
+	}
+	
+	(list->length)--;
+
+	return data;
+}
+
 void* deleteDataFromList(List* list, void* toBeDeleted){
 	if (list == NULL || toBeDeleted == NULL){
 		return NULL;
@@ -179,28 +263,7 @@ void* deleteDataFromList(List* list, void* toBeDeleted){
 	
 	while(tmp != NULL){
 		if (list->compare(toBeDeleted, tmp->data) == 0){
-			//Unlink the node
-			Node* delNode = tmp;
-			
-			if (tmp->previous != NULL){
-				tmp->previous->next = delNode->next;
-			}else{
-				list->head = delNode->next;
-			}
-			
-			if (tmp->next != NULL){
-				tmp->next->previous = delNode->previous;
-			}else{
-				list->tail = delNode->previous;
-			}
-			
-			void* data = delNode->data;
-			free(delNode);
-			
-			(list->length)--;
-
-			return data;
-			
+			return unlinkNode(list, tmp);
 		}else{
 			tmp = tmp->next;
 		}
@@ -209,6 +272,20 @@ void* deleteDataFromList(List* list, void* toBeDeleted){
 	return NULL;
 }
 
+void* removeDataFromList(List* list, void* toBeRemoved){
+	if (list == NULL || toBeRemoved == NULL){
+		return NULL;
+	}
+	
+	for (Node* tmp = list->head; tmp != NULL; tmp = tmp->next){
+		if (tmp->data == toBeRemoved){
+			return unlinkNode(list, tmp);
+		}
+	}
+	
+	return NULL;
+}
+
 
 /** Uses the comparison function pointer to place the element in the 
 * appropriate position in the list.
@@ -252,7 +329,7 @@ void insertSorted(List *list, void *toBeAdded){
 			free(currDescr);
 			free(newDescr);
 		
-			Node* newNode = initializeNode(toBeAdded);
+			Node* newNode = initializeListNode(list, toBeAdded);
 			newNode->next = currNode;
 			newNode->previous = currNode->previous;
 			currNode->previous->next = newNode;
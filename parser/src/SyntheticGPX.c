@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SyntheticGPX.h"
+
+// Number of hubs the paths start near, and how far apart they are in degrees
+#define NUM_HUBS 8
+#define HUB_SPACING 0.05
+
+// Largest step between two points of a path in degrees, about 50 metres
+#define MAX_STEP 0.0005
+
+typedef struct {
+    const char *name;
+
+    // Position in the order the otherData kinds are given out. writeGPXdoc puts a point's name before its otherData,
+    // so the kinds the schema wants after the name come first, and the written files of named points stay valid
+    int rank;
+} OtherDataKind;
+
+// Kinds of otherData a wpt can have, in the order the schema wants them. name goes between geoidheight and cmt
+static const OtherDataKind otherDataKinds[] = {
+    { "ele", 8 }, { "time", 9 }, { "magvar", 10 }, { "geoidheight", 11 }, { "cmt", 1 }, { "desc", 0 }, { "src", 4 },
+    { "sym", 2 }, { "type", 3 }, { "sat", 5 }, { "hdop", 6 }, { "vdop", 7 }
+};
+
+#define NUM_BEFORE_NAME 4
+
+// xorshift32, so the files do not depend on the C library's rand
+static double nextRandom(unsigned int *state) {
+
+    unsigned int x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+
+    return (double)x / 4294967296.0;
+
+}
+
+static void writeOtherData(FILE *file, const char *kind, long pointNumber, unsigned int *state) {
+
+    if (strcmp(kind, "ele") == 0) {
+        fprintf(file, "<ele>%.1f</ele>", 300.0 + nextRandom(state) * 50.0);
+    } else if (strcmp(kind, "time") == 0) {
+        long seconds = pointNumber * 5;
+        fprintf(file, "<time>2021-%02ld-%02ldT%02ld:%02ld:%02ldZ</time>", 1 + seconds / 2419200 % 12,
+            1 + seconds / 86400 % 28, seconds / 3600 % 24, seconds / 60 % 60, seconds % 60);
+    } else if (strcmp(kind, "magvar") == 0) {
+        fprintf(file, "<magvar>%.1f</magvar>", nextRandom(state) * 359.0);
+    } else if (strcmp(kind, "geoidheight") == 0) {
+        fprintf(file, "<geoidheight>%.1f</geoidheight>", -35.0 + nextRandom(state));
+    } else if (strcmp(kind, "sat") == 0) {
+        fprintf(file, "<sat>%d</sat>", 4 + (int)(nextRandom(state) * 8));
+    } else if (strcmp(kind, "hdop") == 0 || strcmp(kind, "vdop") == 0) {
+        fprintf(file, "<%s>%.1f</%s>", kind, 0.5 + nextRandom(state) * 2, kind);
+    } else {
+        fprintf(file, "<%s>%s %ld</%s>", kind, kind, pointNumber, kind);
+    }
+
+}
+
+// Write one point with its name and otherData. The position is moved one step on
+static void writePoint(FILE *file, const char *element, const char *name, long pointNumber, double *latitude,
+    double *longitude, const SyntheticParams *params, unsigned int *state) {
+
+    fprintf(file, "<%s lat=\"%.6f\" lon=\"%.6f\">", element, *latitude, *longitude);
+
+    int numKinds = sizeof(otherDataKinds) / sizeof(otherDataKinds[0]);
+    for (int i = 0; i < numKinds; i++) {
+
+        if (i == NUM_BEFORE_NAME && name != NULL) {
+            fprintf(file, "<name>%s</name>", name);
+        }
+
+        if (otherDataKinds[i].rank < params->otherData) {
+            writeOtherData(file, otherDataKinds[i].name, pointNumber, state);
+        }
+
+    }
+
+    fprintf(file, "</%s>\n", element);
+
+    *latitude += (nextRandom(state) - 0.5) * 2 * MAX_STEP;
+    *longitude += (nextRandom(state) - 0.5) * 2 * MAX_STEP;
+
+}
+
+// Start a path a little way from one of the hubs
+static void startPath(double *latitude, double *longitude, unsigned int *state) {
+
+    int hub = (int)(nextRandom(state) * NUM_HUBS);
+
+    *latitude = SYNTHETIC_HUB_LATITUDE + (hub % 4) * HUB_SPACING + (nextRandom(state) - 0.5) * MAX_STEP;
+    *longitude = SYNTHETIC_HUB_LONGITUDE + (hub / 4) * HUB_SPACING + (nextRandom(state) - 0.5) * MAX_STEP;
+
+}
+
+SyntheticParams getSyntheticParams(long totalPoints) {
+
+    // A tenth of the points are waypoints, three tenths are in routes of 30 points, and the rest are in tracks of 4
+    // segments of 150 points
+    SyntheticParams params;
+
+    params.waypoints = totalPoints / 10;
+    params.routePoints = 30;
+    params.routes = totalPoints * 3 / 10 / params.routePoints;
+    params.segments = 4;
+    params.segmentPoints = 150;
+    params.tracks = totalPoints * 6 / 10 / (params.segments * params.segmentPoints);
+    params.otherData = 2;
+    params.seed = 2750;
+
+    return params;
+
+}
+
+long getSyntheticPointCount(const SyntheticParams *params) {
+
+    return params->waypoints + (long)params->routes * params->routePoints
+        + (long)params->tracks * params->segments * params->segmentPoints;
+
+}
+
+bool writeSyntheticGPX(const char *fileName, const SyntheticParams *params) {
+
+    if (fileName == NULL || params == NULL || params->waypoints < 0 || params->routes < 0 || params->routePoints < 0
+        || params->tracks < 0 || params->segments < 0 || params->segmentPoints < 0 || params->otherData < 0
+        || params->otherData > MAX_SYNTHETIC_OTHER_DATA) {
+        return false;
+    }
+
+    FILE *file = fopen(fileName, "w");
+    if (file == NULL) {
+        return false;
+    }
+
+    // xorshift never leaves 0
+    unsigned int state = params->seed != 0 ? params->seed : 1;
+    long pointNumber = 0;
+    double latitude, longitude;
+    char name[48];
+
+    fprintf(file, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+    fprintf(file, "<gpx xmlns=\"http://www.topografix.com/GPX/1/1\" version=\"1.1\" creator=\"SyntheticGPX\">\n");
+
+    for (int i = 0; i < params->waypoints; i++) {
+        startPath(&latitude, &longitude, &state);
+        snprintf(name, sizeof(name), "Waypoint %d", i);
+        writePoint(file, "wpt", name, pointNumber++, &latitude, &longitude, params, &state);
+    }
+
+    for (int i = 0; i < params->routes; i++) {
+
+        fprintf(file, "<rte><name>Route %d</name>", i);
+        if (params->otherData > 0) {
+            fprintf(file, "<desc>Synthetic route %d</desc>", i);
+        }
+        fprintf(file, "\n");
+
+        startPath(&latitude, &longitude, &state);
+        for (int j = 0; j < params->routePoints; j++) {
+            snprintf(name, sizeof(name), "Route %d point %d", i, j);
+            writePoint(file, "rtept", name, pointNumber++, &latitude, &longitude, params, &state);
+        }
+
+        fprintf(file, "</rte>\n");
+
+    }
+
+    for (int i = 0; i < params->tracks; i++) {
+
+        fprintf(file, "<trk><name>Track %d</name>", i);
+        if (params->otherData > 0) {
+            fprintf(file, "<desc>Synthetic track %d</desc>", i);
+        }
+        fprintf(file, "\n");
+
+        // The segments of a track follow on from each other
+        startPath(&latitude, &longitude, &state);
+        for (int j = 0; j < params->segments; j++) {
+
+            fprintf(file, "<trkseg>\n");
+            for (int k = 0; k < params->segmentPoints; k++) {
+                writePoint(file, "trkpt", NULL, pointNumber++, &latitude, &longitude, params, &state);
+            }
+            fprintf(file, "</trkseg>\n");
+
+        }
+
+        fprintf(file, "</trk>\n");
+
+    }
+
+    fprintf(file, "</gpx>\n");
+
+    bool written = !ferror(file);
+    if (fclose(file) != 0) {
+        written = false;
+    }
+
+    return written;
+
+}